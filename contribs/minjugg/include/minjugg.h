@@ -32,26 +32,73 @@ typedef enum jug_expression_dtype_e {
     JUG_EXPRESSION_DTYPE_UINT16 = 8,
     JUG_EXPRESSION_DTYPE_UINT32 = 9,
     JUG_EXPRESSION_DTYPE_UINT64 = 10,
+    JUG_EXPRESSION_DTYPE_BOOL = 11,  // 0/1 bytes; computed as UINT8 and stored as `value != 0`
 } jug_expression_dtype_t;
 
+/* Instruction set the kernels are compiled for; ISAs that the host lacks are lowered to the best one it has */
+typedef enum jug_expression_isa_e {
+    JUG_EXPRESSION_ISA_AUTO = 0,
+    JUG_EXPRESSION_ISA_BASELINE = 1,
+    JUG_EXPRESSION_ISA_AVX2 = 2,
+    JUG_EXPRESSION_ISA_AVX512 = 3,
+} jug_expression_isa_t;
+
 INA_API(ina_rc_t) jug_init(void);
 INA_API(void) jug_destroy(void);
 
 INA_API(ina_rc_t) jug_expression_new(jug_expression_t **expr, jug_expression_dtype_t dtype);
 INA_API(void) jug_expression_free(jug_expression_t **expr);
 
+/* The dtype of every variable, in binding order; by default inputs have the dtype of the output */
+INA_API(ina_rc_t) jug_expression_set_input_dtypes(jug_expression_t *e,
+                                                  int num_vars,
+                                                  const jug_expression_dtype_t *dtypes);
+
+/*
+ * Mark the variables that are broadcast to the `ndim`-dimensional output.  These are read through
+ * the per-input strides of the kernel parameters (0 along the broadcast dimensions).
+ */
+INA_API(ina_rc_t) jug_expression_set_input_broadcast(jug_expression_t *e,
+                                                     int8_t ndim,
+                                                     int num_vars,
+                                                     const bool *broadcast);
+
+/* By default the kernels are compiled for the best ISA of the host (JUG_EXPRESSION_ISA_AUTO) */
+INA_API(ina_rc_t) jug_expression_set_isa(jug_expression_t *e, jug_expression_isa_t isa);
+
+/*
+ * The variables `i0` ... `i7` are reserved for the position of the element being computed along
+ * each dimension (unless an input has the same name).  Returns the dimension of an index variable
+ * named by the `len` first chars of `name`, or -1.
+ */
+INA_API(int) jug_index_var(const char *name, size_t len);
+
 INA_API(ina_rc_t) jug_expression_compile(jug_expression_t *e,
                                          const char *expr,
                                          int num_vars,
                                          void *vars,
                                          uint64_t *function_addr);
 
+/* Several expressions over the same variables, evaluated in one loop; output k goes to outs[k] */
+INA_API(ina_rc_t) jug_expression_compile_multi(jug_expression_t *e,
+                                               int nexprs,
+                                               const char **exprs,
+                                               int num_vars,
+                                               void *vars,
+                                               uint64_t *function_addr);
+
 INA_API(ina_rc_t) jug_udf_compile(jug_expression_t *e,
                                   int llvm_bc_len,
                                   const char *llvm_bc,
                                   const char *name,
                                   uint64_t *function_addr);
 
+/* Process-wide cache of compiled expressions; objects are also kept on disk if a directory is set */
+INA_API(ina_rc_t) jug_expression_cache_set_dir(const char *dirpath);
+INA_API(void) jug_expression_cache_stats(int64_t *hits, int64_t *misses, int64_t *nentries);
+INA_API(int64_t) jug_expression_cache_disk_hits(void);
+INA_API(void) jug_expression_cache_clear(void);
+
 INA_API(ina_rc_t) jug_udf_registry_new(jug_udf_registry_t **udf_registry);
 INA_API(void) jug_udf_registry_free(jug_udf_registry_t **udf_registry);
 
@@ -97,6 +144,14 @@ typedef enum te_expr_type_e {
     EXPR_TYPE_FMOD,
     EXPR_TYPE_MIN,
     EXPR_TYPE_MAX,
+    EXPR_TYPE_LT,
+    EXPR_TYPE_LE,
+    EXPR_TYPE_GT,
+    EXPR_TYPE_GE,
+    EXPR_TYPE_EQ,
+    EXPR_TYPE_NE,
+    EXPR_TYPE_SHL,
+    EXPR_TYPE_SHR,
     EXPR_TYPE_CUSTOM
 } te_expr_type_t;
 
@@ -107,6 +162,26 @@ typedef struct jug_te_variable {
     void *context;
 } jug_te_variable;
 
+/* An expression whose variables are kernel inputs or the results of earlier nodes of a graph */
+typedef struct jug_expression_node_s {
+    const char *expr;
+    int num_vars;
+    const char **var_names;
+    int *var_refs;  // >= 0: index of a kernel input; < 0: node -var_refs[i] - 1
+} jug_expression_node_t;
+
+/*
+ * Compile a graph of expressions into a single kernel; every node is inlined into the loop body and
+ * the last `nouts` nodes are the outputs.  `vars` describes the `num_vars` kernel inputs.
+ */
+INA_API(ina_rc_t) jug_expression_compile_graph(jug_expression_t *e,
+                                               int nnodes,
+                                               jug_expression_node_t *nodes,
+                                               int nouts,
+                                               int num_vars,
+                                               void *vars,
+                                               uint64_t *function_addr);
+
 INA_API(int) jug_udf_func_get_arity(jug_udf_function_t *f);
 
 INA_API(uint64_t) jug_udf_func_get_ptr(jug_udf_function_t *f);
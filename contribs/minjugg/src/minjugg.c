@@ -11,6 +11,9 @@
 
 #include <minjugg.h>
 
+#include <ctype.h>
+#include <stdlib.h>
+
 #include <llvm-c/Core.h>
 #include <llvm-c/ExecutionEngine.h>
 #include <llvm-c/Target.h>
@@ -54,8 +57,14 @@ struct jug_udf_function_s {
 struct jug_expression_s {
     LLVMContextRef context;
     LLVMModuleRef mod;
+    bool mod_owned;  // false once the module belongs to an execution engine
     LLVMExecutionEngineRef engine;
-    jug_expression_dtype_t dtype;
+    jug_expression_dtype_t dtype;  // the dtype of the output
+    jug_expression_dtype_t compute_dtype;  // the dtype the expression is evaluated in
+    jug_expression_dtype_t input_dtypes[IARRAY_EXPR_OPERANDS_MAX];  // 0 means the same as the output
+    int8_t ndim;  // the number of dimensions of the output (only needed for broadcasting)
+    bool input_broadcast[IARRAY_EXPR_OPERANDS_MAX];  // whether the inputs are broadcast
+    jug_expression_isa_t isa;  // the instruction set requested for the kernel
     ina_hashtable_t *fun_map;
     ina_hashtable_t *decl_cache;
     void **fun_map_te;
@@ -63,14 +72,39 @@ struct jug_expression_s {
     int32_t typesize;
     LLVMTypeRef expr_type;
     ina_mempool_t *variable_mempool;
+    struct _jug_jit_cache_entry_s *cache_entry;  // the cache entry whose code is used, if any
 };
 
 static char *_jug_def_triple = NULL;
 static LLVMTargetDataRef _jug_data_ref = NULL;
 static LLVMTargetMachineRef _jug_tm_ref = NULL;
+static jug_expression_isa_t _jug_host_isa = JUG_EXPRESSION_ISA_BASELINE;
 
 static jug_udf_registry_t *udf_registry = NULL;
 
+/*
+ * Process-wide cache of compiled expressions.  The key is made of the normalized expression,
+ * the dtype, the ordered variable names and the target CPU; the cache owns the execution engine
+ * so that the function pointer stays valid after the jug_expression_t is freed.  Every expression
+ * using the code of an entry holds a reference to it, so that clearing the cache only disposes
+ * the engines nobody uses; the others are disposed when their last expression is freed.
+ */
+typedef struct _jug_jit_cache_entry_s {
+    ina_str_t key;
+    LLVMExecutionEngineRef engine;
+    uint64_t function_addr;
+    int64_t nusers;  // the expressions using the code of the entry
+    bool cached;  // false once the entry has been dropped from the cache
+    struct _jug_jit_cache_entry_s *next;
+} _jug_jit_cache_entry_t;
+
+static ina_hashtable_t *_jug_jit_cache = NULL;
+static _jug_jit_cache_entry_t *_jug_jit_cache_entries = NULL;
+static int64_t _jug_jit_cache_hits = 0;
+static int64_t _jug_jit_cache_misses = 0;
+static int64_t _jug_jit_cache_disk_hits = 0;
+static int64_t _jug_jit_cache_nentries = 0;
+
 typedef LLVMValueRef(*_jug_llvm_fun_p_one_arg_t)(LLVMBuilderRef builder, LLVMValueRef arg, const char *name);
 typedef LLVMValueRef(*_jug_llvm_fun_p_two_arg_t)(LLVMBuilderRef builder, LLVMValueRef lhs, LLVMValueRef rhs, const char *name);
 
@@ -117,9 +151,52 @@ static const _jug_fun_type_t _jug_function_map[] = {
     {"EXPR_TYPE_FMOD", 1, 0, 2, NULL, NULL, "fmodf", "fmod", 0, 0, {0}, {0}},
     {"EXPR_TYPE_MIN", 1, 0, 2, NULL, NULL, "fminf", "fmin", 0, 0, "llvm.smin.", "llvm.umin."},
     {"EXPR_TYPE_MAX", 1, 0, 2, NULL, NULL, "fmaxf", "fmax", 0, 0, "llvm.smax.", "llvm.umax."},
+    /* comparisons are built from _jug_compare_map below */
+    {"EXPR_TYPE_LT", 0, 0, 2, NULL, NULL, {0}, {0}, 0, 0, {0}, {0}},
+    {"EXPR_TYPE_LE", 0, 0, 2, NULL, NULL, {0}, {0}, 0, 0, {0}, {0}},
+    {"EXPR_TYPE_GT", 0, 0, 2, NULL, NULL, {0}, {0}, 0, 0, {0}, {0}},
+    {"EXPR_TYPE_GE", 0, 0, 2, NULL, NULL, {0}, {0}, 0, 0, {0}, {0}},
+    {"EXPR_TYPE_EQ", 0, 0, 2, NULL, NULL, {0}, {0}, 0, 0, {0}, {0}},
+    {"EXPR_TYPE_NE", 0, 0, 2, NULL, NULL, {0}, {0}, 0, 0, {0}, {0}},
+    /* shifts only exist for integers */
+    {"EXPR_TYPE_SHL", 0, 0, 2, NULL, NULL, {0}, {0}, (void *) LLVMBuildShl, (void *) LLVMBuildShl, {0}, {0}},
+    {"EXPR_TYPE_SHR", 0, 0, 2, NULL, NULL, {0}, {0}, (void *) LLVMBuildLShr, (void *) LLVMBuildAShr, {0}, {0}},
     NULL, // MSVC does not allow the {} form, so express the sentinel as NULL
 };
 
+typedef struct _jug_compare_type_s {
+    char name[32];
+    LLVMIntPredicate uint_pred;
+    LLVMIntPredicate sint_pred;
+    LLVMRealPredicate real_pred;
+} _jug_compare_type_t;
+
+/* As in NumPy, only `!=` holds when comparing NaNs */
+static const _jug_compare_type_t _jug_compare_map[] = {
+    {"EXPR_TYPE_LT", LLVMIntULT, LLVMIntSLT, LLVMRealOLT},
+    {"EXPR_TYPE_LE", LLVMIntULE, LLVMIntSLE, LLVMRealOLE},
+    {"EXPR_TYPE_GT", LLVMIntUGT, LLVMIntSGT, LLVMRealOGT},
+    {"EXPR_TYPE_GE", LLVMIntUGE, LLVMIntSGE, LLVMRealOGE},
+    {"EXPR_TYPE_EQ", LLVMIntEQ, LLVMIntEQ, LLVMRealOEQ},
+    {"EXPR_TYPE_NE", LLVMIntNE, LLVMIntNE, LLVMRealUNE},
+};
+
+static bool _jug_dtype_is_float(jug_expression_dtype_t dtype);
+static bool _jug_dtype_is_unsigned(jug_expression_dtype_t dtype);
+
+/* Comparisons give 1 or 0 in the type of the expression, so that they can take part in arithmetic */
+static LLVMValueRef _jug_build_compare(jug_expression_t *e, const _jug_compare_type_t *c, LLVMValueRef lhs,
+                                       LLVMValueRef rhs)
+{
+    if (_jug_dtype_is_float(e->compute_dtype)) {
+        LLVMValueRef truth = LLVMBuildFCmp(e->builder, c->real_pred, lhs, rhs, c->name);
+        return LLVMBuildUIToFP(e->builder, truth, e->expr_type, "cmp");
+    }
+    LLVMIntPredicate pred = _jug_dtype_is_unsigned(e->compute_dtype) ? c->uint_pred : c->sint_pred;
+    LLVMValueRef truth = LLVMBuildICmp(e->builder, pred, lhs, rhs, c->name);
+    return LLVMBuildZExt(e->builder, truth, e->expr_type, "cmp");
+}
+
 static LLVMValueRef _jug_build_fun_call(jug_expression_t *e, const char *name, int num_args, LLVMValueRef *args)
 {
     ina_str_t fname = NULL;
@@ -135,19 +212,37 @@ static LLVMValueRef _jug_build_fun_call(jug_expression_t *e, const char *name, i
 
     INA_ASSERT_EQUAL(num_args, f->arity);
 
+    for (size_t i = 0; i < sizeof(_jug_compare_map) / sizeof(_jug_compare_type_t); ++i) {
+        if (strcmp(_jug_compare_map[i].name, name) == 0) {
+            return _jug_build_compare(e, &_jug_compare_map[i], args[0], args[1]);
+        }
+    }
+
+    /* integer cases without an LLVM intrinsic */
+    if (!_jug_dtype_is_float(e->compute_dtype)) {
+        bool is_unsigned = _jug_dtype_is_unsigned(e->compute_dtype);
+        if (strcmp("EXPR_TYPE_ABS", name) == 0 && is_unsigned) {
+            return args[0];
+        }
+        if (strcmp("EXPR_TYPE_FMOD", name) == 0) {
+            return is_unsigned ? LLVMBuildURem(e->builder, args[0], args[1], name) :
+                                 LLVMBuildSRem(e->builder, args[0], args[1], name);
+        }
+    }
+
     /* declare function - if required */
     LLVMTypeRef *param_types = NULL;
     LLVMValueRef fun_decl = NULL;
     if (f->require_decl) {
         const char *fun_name;
-        if (e->dtype == JUG_EXPRESSION_DTYPE_FLOAT) {
+        if (e->compute_dtype == JUG_EXPRESSION_DTYPE_FLOAT) {
             fun_name = f->decl_name_f32;
         }
-        else if (e->dtype == JUG_EXPRESSION_DTYPE_DOUBLE) {
+        else if (e->compute_dtype == JUG_EXPRESSION_DTYPE_DOUBLE) {
             fun_name = f->decl_name_f64;
         }
         else {
-            switch (e->dtype) {
+            switch (e->compute_dtype) {
                 case JUG_EXPRESSION_DTYPE_SINT8:
                     fname = ina_str_new_fromcstr(f->decl_name_sint_pre);
                     fname = ina_str_catcstr(fname, "i8");
@@ -166,19 +261,19 @@ static LLVMValueRef _jug_build_fun_call(jug_expression_t *e, const char *name, i
                     break;
                 case JUG_EXPRESSION_DTYPE_UINT8:
                     fname = ina_str_new_fromcstr(f->decl_name_uint_pre);
-                    fname = ina_str_catcstr(fname, "u8");
+                    fname = ina_str_catcstr(fname, "i8");
                     break;
                 case JUG_EXPRESSION_DTYPE_UINT16:
                     fname = ina_str_new_fromcstr(f->decl_name_uint_pre);
-                    fname = ina_str_catcstr(fname, "u16");
+                    fname = ina_str_catcstr(fname, "i16");
                     break;
                 case JUG_EXPRESSION_DTYPE_UINT32:
                     fname = ina_str_new_fromcstr(f->decl_name_uint_pre);
-                    fname = ina_str_catcstr(fname, "u32");
+                    fname = ina_str_catcstr(fname, "i32");
                     break;
                 case JUG_EXPRESSION_DTYPE_UINT64:
                     fname = ina_str_new_fromcstr(f->decl_name_uint_pre);
-                    fname = ina_str_catcstr(fname, "u64");
+                    fname = ina_str_catcstr(fname, "i64");
                     break;
                 default:
                     IARRAY_TRACE1(iarray.error, "Invalid data type");
@@ -190,7 +285,7 @@ static LLVMValueRef _jug_build_fun_call(jug_expression_t *e, const char *name, i
         if (fun_decl == NULL) {
             // We need special handling for ABS(INTEGER) because it requires a second argument
             LLVMTypeRef fn_type;
-            if (strcmp("EXPR_TYPE_ABS", name) == 0 && !(e->dtype == JUG_EXPRESSION_DTYPE_DOUBLE || e->dtype == JUG_EXPRESSION_DTYPE_FLOAT)) {
+            if (strcmp("EXPR_TYPE_ABS", name) == 0 && !(e->compute_dtype == JUG_EXPRESSION_DTYPE_DOUBLE || e->compute_dtype == JUG_EXPRESSION_DTYPE_FLOAT)) {
                 param_types = (LLVMTypeRef*)ina_mem_alloc(sizeof(LLVMTypeRef)*2);
                 param_types[0] = e->expr_type;
                 param_types[1] = LLVMInt1Type();
@@ -210,7 +305,7 @@ static LLVMValueRef _jug_build_fun_call(jug_expression_t *e, const char *name, i
     else {
         /* if not required, build IR instruction and return (ADD, SUB, MUL, DIV etc.) */
         void *fun_ref = NULL;
-        switch (e->dtype) {
+        switch (e->compute_dtype) {
             case JUG_EXPRESSION_DTYPE_FLOAT:
                 fun_ref = f->no_decl_ref_f32;
                 break;
@@ -227,6 +322,7 @@ static LLVMValueRef _jug_build_fun_call(jug_expression_t *e, const char *name, i
             case JUG_EXPRESSION_DTYPE_UINT16:
             case JUG_EXPRESSION_DTYPE_UINT32:
             case JUG_EXPRESSION_DTYPE_UINT64:
+            case JUG_EXPRESSION_DTYPE_BOOL:
                 fun_ref = f->uint_ref;
                 break;
         }
@@ -248,7 +344,7 @@ static LLVMValueRef _jug_build_fun_call(jug_expression_t *e, const char *name, i
     LLVMValueRef ret;
     INA_ASSERT_NOT_NULL(fun_decl);
     // We need special handling for ABS(INTEGER) because it requires a second argument
-    if (strcmp("EXPR_TYPE_ABS", name) == 0 && !(e->dtype == JUG_EXPRESSION_DTYPE_DOUBLE || e->dtype == JUG_EXPRESSION_DTYPE_FLOAT)) {
+    if (strcmp("EXPR_TYPE_ABS", name) == 0 && !(e->compute_dtype == JUG_EXPRESSION_DTYPE_DOUBLE || e->compute_dtype == JUG_EXPRESSION_DTYPE_FLOAT)) {
         LLVMValueRef c_zero = LLVMConstInt(LLVMInt1Type(), 0, 1);
         LLVMValueRef largs[] = { args[0],  c_zero};
         ret = LLVMBuildCall(e->builder, fun_decl, largs, 2, name);
@@ -291,14 +387,6 @@ static ina_rc_t _jug_register_functions(jug_expression_t *e)
         INA_HASHTABLE_DEFAULT_CAPACITY,
         INA_HASHTABLE_CF_DEFAULT, &e->fun_map);
 
-    ina_hashtable_new(INA_HASHTABLE_STR_KEY,
-        INA_HASH32_LOOKUP3,
-        INA_HASHTABLE_TYPE_DEFAULT,
-        INA_HASHTABLE_GROW_DEFAULT,
-        INA_HASHTABLE_SHRINK_DEFAULT,
-        INA_HASHTABLE_DEFAULT_CAPACITY,
-        INA_HASHTABLE_CF_DEFAULT, &e->decl_cache);
-
     int size = (sizeof(_jug_function_map) / sizeof(_jug_fun_type_t)) - 1; /* do not count the sentinel */
 
     e->fun_map_te = ina_mem_alloc(sizeof(void*) * size);
@@ -321,12 +409,95 @@ static ina_rc_t _jug_register_functions(jug_expression_t *e)
     return INA_SUCCESS;
 }
 
+/*
+ * Subtrees already compiled in the current scope, so that repeated subexpressions
+ * (e.g. sin(x) in sin(x)*sin(x) + cos(x)*cos(x)) are only computed once.
+ */
+typedef struct _jug_te_memo_s {
+    int nentries;
+    int capacity;
+    jug_te_expr **nodes;
+    LLVMValueRef *values;
+} _jug_te_memo_t;
+
+static bool _jug_te_equal(const jug_te_expr *a, const jug_te_expr *b)
+{
+    if (a == b) {
+        return true;
+    }
+    if (a->type != b->type || a->type == TE_CUSTOM) {
+        return false;
+    }
+    switch (a->type & 0x0000001F) {
+        case TE_CONSTANT:
+            // Compare the bits so that 0. and -0. are kept apart
+            return memcmp(&a->value, &b->value, sizeof(double)) == 0;
+        case TE_VARIABLE:
+            return strcmp(a->bound, b->bound) == 0;
+        default:
+            break;
+    }
+    if (!(a->type & TE_FUNCTION0) || a->function != b->function) {
+        return false;
+    }
+    int arity = a->type & 0x00000007;
+    for (int i = 0; i < arity; ++i) {
+        if (!_jug_te_equal((jug_te_expr *) a->parameters[i], (jug_te_expr *) b->parameters[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static LLVMValueRef _jug_te_memo_get(_jug_te_memo_t *memo, jug_te_expr *n)
+{
+    for (int i = 0; i < memo->nentries; ++i) {
+        if (_jug_te_equal(memo->nodes[i], n)) {
+            return memo->values[i];
+        }
+    }
+    return NULL;
+}
+
+static void _jug_te_memo_set(_jug_te_memo_t *memo, jug_te_expr *n, LLVMValueRef value)
+{
+    if (memo->nentries == memo->capacity) {
+        int capacity = memo->capacity == 0 ? 16 : memo->capacity * 2;
+        jug_te_expr **nodes = ina_mem_alloc(sizeof(jug_te_expr *) * capacity);
+        LLVMValueRef *values = ina_mem_alloc(sizeof(LLVMValueRef) * capacity);
+        if (memo->nentries > 0) {
+            memcpy(nodes, memo->nodes, sizeof(jug_te_expr *) * memo->nentries);
+            memcpy(values, memo->values, sizeof(LLVMValueRef) * memo->nentries);
+        }
+        INA_MEM_FREE_SAFE(memo->nodes);
+        INA_MEM_FREE_SAFE(memo->values);
+        memo->nodes = nodes;
+        memo->values = values;
+        memo->capacity = capacity;
+    }
+    memo->nodes[memo->nentries] = n;
+    memo->values[memo->nentries] = value;
+    memo->nentries++;
+}
+
+static void _jug_te_memo_free(_jug_te_memo_t *memo)
+{
+    INA_MEM_FREE_SAFE(memo->nodes);
+    INA_MEM_FREE_SAFE(memo->values);
+    memo->nentries = 0;
+    memo->capacity = 0;
+}
+
+static LLVMValueRef _jug_expr_compile_expression(jug_expression_t *e, jug_te_expr *n, ina_hashtable_t *params,
+                                                 _jug_te_memo_t *memo);
+
 typedef jug_expression_t* jug_expression_ptr_t;
 #define TE_FUN(...) ((LLVMValueRef(*)(__VA_ARGS__))e->fun_map_te[n->function])
-#define M(p) _jug_expr_compile_expression(e, n->parameters[p], params)
+#define M(p) _jug_expr_compile_expression(e, n->parameters[p], params, memo)
 #define TYPE_MASK(TYPE) ((TYPE)&0x0000001F)
 #define ARITY(TYPE) ( ((TYPE) & (TE_FUNCTION0 | TE_CLOSURE0)) ? ((TYPE) & 0x00000007) : 0 )
-static LLVMValueRef _jug_expr_compile_expression(jug_expression_t *e, jug_te_expr *n, ina_hashtable_t *params)
+static LLVMValueRef _jug_expr_compile_node(jug_expression_t *e, jug_te_expr *n, ina_hashtable_t *params,
+                                           _jug_te_memo_t *memo)
 {
     if (n->type == TE_CUSTOM) {
         jug_udf_function_t *udf_fun = (jug_udf_function_t *) n->parameters[0];
@@ -360,12 +531,13 @@ static LLVMValueRef _jug_expr_compile_expression(jug_expression_t *e, jug_te_exp
         switch (TYPE_MASK(n->type)) {
             case TE_CONSTANT: {
                 LLVMValueRef constant;
-                switch (e->dtype) {
+                switch (e->compute_dtype) {
                     case JUG_EXPRESSION_DTYPE_DOUBLE:
                     case JUG_EXPRESSION_DTYPE_FLOAT:
                         constant = LLVMConstReal(e->expr_type, n->value);
                         break;
                     case JUG_EXPRESSION_DTYPE_UINT8:
+                    case JUG_EXPRESSION_DTYPE_BOOL:
                         constant = LLVMConstInt(e->expr_type, (uint8_t) n->value, 0);
                         break;
                     case JUG_EXPRESSION_DTYPE_UINT16:
@@ -465,6 +637,24 @@ static LLVMValueRef _jug_expr_compile_expression(jug_expression_t *e, jug_te_exp
 #undef TYPE_MASK
 #undef ARITY
 
+static LLVMValueRef _jug_expr_compile_expression(jug_expression_t *e, jug_te_expr *n, ina_hashtable_t *params,
+                                                 _jug_te_memo_t *memo)
+{
+    // UDFs are not assumed to be pure, so their calls are never merged
+    bool memoizable = n->type != TE_CUSTOM && (n->type & TE_FUNCTION0) && (n->type & TE_FLAG_PURE);
+    if (memoizable) {
+        LLVMValueRef value = _jug_te_memo_get(memo, n);
+        if (value != NULL) {
+            return value;
+        }
+    }
+    LLVMValueRef value = _jug_expr_compile_node(e, n, params, memo);
+    if (memoizable && value != NULL) {
+        _jug_te_memo_set(memo, n, value);
+    }
+    return value;
+}
+
 #ifdef _JUG_DEBUG_DECLARE_PRINT_IN_IR
 static void debug_print(LLVMBuilderRef builder, LLVMModuleRef module, const char *fmt, LLVMValueRef value)
 {
@@ -475,58 +665,324 @@ static void debug_print(LLVMBuilderRef builder, LLVMModuleRef module, const char
 }
 #endif
 
-static LLVMValueRef _jug_expr_compile_function(
-    jug_expression_t *e,
-    const char *name,
-    jug_te_expr *expression,
-    int var_len,
-    jug_te_variable *vars)
+static LLVMTypeRef _jug_llvm_type(jug_expression_dtype_t dtype)
 {
-    ina_hashtable_t *param_values = NULL;
-
-    ina_hashtable_new(INA_HASHTABLE_STR_KEY,
-        INA_HASH32_LOOKUP3,
-        INA_HASHTABLE_TYPE_DEFAULT,
-        INA_HASHTABLE_GROW_DEFAULT,
-        INA_HASHTABLE_SHRINK_DEFAULT,
-        INA_HASHTABLE_DEFAULT_CAPACITY,
-        INA_HASHTABLE_CF_DEFAULT, &param_values);
-
-    LLVMTypeRef int32Type = LLVMInt32Type();
-
-    e->context = LLVMContextCreate();
-
-    LLVMValueRef constant_zero = LLVMConstInt(int32Type, 0, 1);
-    LLVMValueRef constant_one = LLVMConstInt(int32Type, 1, 1);
-    switch (e->dtype) {
+    switch (dtype) {
         case JUG_EXPRESSION_DTYPE_FLOAT:
-            e->expr_type = LLVMFloatType();
-            break;
+            return LLVMFloatType();
         case JUG_EXPRESSION_DTYPE_DOUBLE:
-            e->expr_type = LLVMDoubleType();
-            break;
+            return LLVMDoubleType();
         case JUG_EXPRESSION_DTYPE_SINT8:
         case JUG_EXPRESSION_DTYPE_UINT8:
-            e->expr_type = LLVMInt8Type();
-            break;
+        case JUG_EXPRESSION_DTYPE_BOOL:
+            return LLVMInt8Type();
         case JUG_EXPRESSION_DTYPE_SINT16:
         case JUG_EXPRESSION_DTYPE_UINT16:
-            e->expr_type = LLVMInt16Type();
-            break;
+            return LLVMInt16Type();
         case JUG_EXPRESSION_DTYPE_SINT32:
         case JUG_EXPRESSION_DTYPE_UINT32:
-            e->expr_type = LLVMInt32Type();
-            break;
+            return LLVMInt32Type();
         case JUG_EXPRESSION_DTYPE_SINT64:
         case JUG_EXPRESSION_DTYPE_UINT64:
-            e->expr_type = LLVMInt64Type();
-            break;
+            return LLVMInt64Type();
         default:
             return NULL;
     }
+}
+
+static bool _jug_dtype_is_float(jug_expression_dtype_t dtype)
+{
+    return dtype == JUG_EXPRESSION_DTYPE_DOUBLE || dtype == JUG_EXPRESSION_DTYPE_FLOAT;
+}
+
+static bool _jug_dtype_is_unsigned(jug_expression_dtype_t dtype)
+{
+    return (dtype >= JUG_EXPRESSION_DTYPE_UINT8 && dtype <= JUG_EXPRESSION_DTYPE_UINT64) ||
+           dtype == JUG_EXPRESSION_DTYPE_BOOL;
+}
+
+static int _jug_dtype_size(jug_expression_dtype_t dtype)
+{
+    switch (dtype) {
+        case JUG_EXPRESSION_DTYPE_DOUBLE:
+        case JUG_EXPRESSION_DTYPE_SINT64:
+        case JUG_EXPRESSION_DTYPE_UINT64:
+            return 8;
+        case JUG_EXPRESSION_DTYPE_FLOAT:
+        case JUG_EXPRESSION_DTYPE_SINT32:
+        case JUG_EXPRESSION_DTYPE_UINT32:
+            return 4;
+        case JUG_EXPRESSION_DTYPE_SINT16:
+        case JUG_EXPRESSION_DTYPE_UINT16:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+static jug_expression_dtype_t _jug_int_dtype(int size, bool is_unsigned)
+{
+    switch (size) {
+        case 1:
+            return is_unsigned ? JUG_EXPRESSION_DTYPE_UINT8 : JUG_EXPRESSION_DTYPE_SINT8;
+        case 2:
+            return is_unsigned ? JUG_EXPRESSION_DTYPE_UINT16 : JUG_EXPRESSION_DTYPE_SINT16;
+        case 4:
+            return is_unsigned ? JUG_EXPRESSION_DTYPE_UINT32 : JUG_EXPRESSION_DTYPE_SINT32;
+        default:
+            return is_unsigned ? JUG_EXPRESSION_DTYPE_UINT64 : JUG_EXPRESSION_DTYPE_SINT64;
+    }
+}
+
+/* Type promotion for two operands, following the NumPy rules */
+static jug_expression_dtype_t _jug_promote_dtypes(jug_expression_dtype_t a, jug_expression_dtype_t b)
+{
+    if (a == b) {
+        return a;
+    }
+    // As in NumPy, bools take the type of the other operand
+    if (a == JUG_EXPRESSION_DTYPE_BOOL || b == JUG_EXPRESSION_DTYPE_BOOL) {
+        return a == JUG_EXPRESSION_DTYPE_BOOL ? b : a;
+    }
+    int size_a = _jug_dtype_size(a);
+    int size_b = _jug_dtype_size(b);
+    if (_jug_dtype_is_float(a) && _jug_dtype_is_float(b)) {
+        return JUG_EXPRESSION_DTYPE_DOUBLE;
+    }
+    if (_jug_dtype_is_float(a) || _jug_dtype_is_float(b)) {
+        jug_expression_dtype_t f = _jug_dtype_is_float(a) ? a : b;
+        int int_size = _jug_dtype_is_float(a) ? size_b : size_a;
+        if (f == JUG_EXPRESSION_DTYPE_FLOAT && int_size <= 2) {
+            return JUG_EXPRESSION_DTYPE_FLOAT;
+        }
+        return JUG_EXPRESSION_DTYPE_DOUBLE;
+    }
+    if (_jug_dtype_is_unsigned(a) == _jug_dtype_is_unsigned(b)) {
+        return _jug_int_dtype(INA_MAX(size_a, size_b), _jug_dtype_is_unsigned(a));
+    }
+    int size_s = _jug_dtype_is_unsigned(a) ? size_b : size_a;
+    int size_u = _jug_dtype_is_unsigned(a) ? size_a : size_b;
+    if (size_s > size_u) {
+        return _jug_int_dtype(size_s, false);
+    }
+    if (size_u < 8) {
+        return _jug_int_dtype(2 * size_u, false);
+    }
+    return JUG_EXPRESSION_DTYPE_DOUBLE;
+}
+
+/*
+ * The whole expression is evaluated in the promoted type of its inputs.  If that is an integer
+ * type but the output is floating point, evaluate in the output type so that math functions work.
+ */
+static jug_expression_dtype_t _jug_compute_dtype(jug_expression_t *e, int var_len, jug_expression_dtype_t *var_dtypes)
+{
+    jug_expression_dtype_t compute_dtype = e->dtype;
+    for (int i = 0; i < var_len; ++i) {
+        var_dtypes[i] = e->input_dtypes[i] != 0 ? e->input_dtypes[i] : e->dtype;
+        compute_dtype = (i == 0) ? var_dtypes[i] : _jug_promote_dtypes(compute_dtype, var_dtypes[i]);
+    }
+    if (!_jug_dtype_is_float(compute_dtype) && _jug_dtype_is_float(e->dtype)) {
+        compute_dtype = e->dtype;
+    }
+    // Arithmetic on bools is done on their bytes
+    if (compute_dtype == JUG_EXPRESSION_DTYPE_BOOL) {
+        compute_dtype = JUG_EXPRESSION_DTYPE_UINT8;
+    }
+    return compute_dtype;
+}
+
+static LLVMValueRef _jug_build_cast(LLVMBuilderRef builder, LLVMValueRef val,
+                                    jug_expression_dtype_t from, jug_expression_dtype_t to)
+{
+    if (from == to) {
+        return val;
+    }
+    LLVMTypeRef to_type = _jug_llvm_type(to);
+    if (to == JUG_EXPRESSION_DTYPE_BOOL) {
+        LLVMValueRef zero = LLVMConstNull(LLVMTypeOf(val));
+        LLVMValueRef truth = _jug_dtype_is_float(from) ? LLVMBuildFCmp(builder, LLVMRealUNE, val, zero, "fne") :
+                                                         LLVMBuildICmp(builder, LLVMIntNE, val, zero, "ne");
+        return LLVMBuildZExt(builder, truth, to_type, "bool");
+    }
+    bool from_float = _jug_dtype_is_float(from);
+    bool to_float = _jug_dtype_is_float(to);
+    int from_size = _jug_dtype_size(from);
+    int to_size = _jug_dtype_size(to);
+
+    if (from_float && to_float) {
+        return to_size > from_size ? LLVMBuildFPExt(builder, val, to_type, "fpext") :
+                                     LLVMBuildFPTrunc(builder, val, to_type, "fptrunc");
+    }
+    if (!from_float && to_float) {
+        return _jug_dtype_is_unsigned(from) ? LLVMBuildUIToFP(builder, val, to_type, "uitofp") :
+                                              LLVMBuildSIToFP(builder, val, to_type, "sitofp");
+    }
+    if (from_float && !to_float) {
+        return _jug_dtype_is_unsigned(to) ? LLVMBuildFPToUI(builder, val, to_type, "fptoui") :
+                                            LLVMBuildFPToSI(builder, val, to_type, "fptosi");
+    }
+    if (to_size > from_size) {
+        return _jug_dtype_is_unsigned(from) ? LLVMBuildZExt(builder, val, to_type, "zext") :
+                                              LLVMBuildSExt(builder, val, to_type, "sext");
+    }
+    if (to_size < from_size) {
+        return LLVMBuildTrunc(builder, val, to_type, "trunc");
+    }
+    // Same width, different signedness: the bits are the same
+    return val;
+}
+
+static jug_expression_isa_t _jug_detect_host_isa(void)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    if (jug_utils_host_has_feature("avx512f") && jug_utils_host_has_feature("avx512dq") &&
+        jug_utils_host_has_feature("avx512vl")) {
+        return JUG_EXPRESSION_ISA_AVX512;
+    }
+    if (jug_utils_host_has_feature("avx2") && jug_utils_host_has_feature("fma")) {
+        return JUG_EXPRESSION_ISA_AVX2;
+    }
+#endif
+    return JUG_EXPRESSION_ISA_BASELINE;
+}
+
+/*
+ * The CPU the kernel is compiled for and its preferred vector width in bits (0 for the default
+ * of the CPU).  When the ISA is the host one, the host CPU is used so that the code is also tuned
+ * for it.  The vectorizer picks the SVML variants matching the resulting vector width.
+ */
+static const char *_jug_target_cpu(jug_expression_t *e, int *vector_width)
+{
+    jug_expression_isa_t isa = e->isa;
+    if (isa == JUG_EXPRESSION_ISA_AUTO || isa > _jug_host_isa) {
+        isa = _jug_host_isa;
+    }
+    // LLVM limits AVX-512 CPUs to 256-bit vectors unless told otherwise
+    *vector_width = isa == JUG_EXPRESSION_ISA_AVX512 ? 512 : 0;
+    if (isa == _jug_host_isa) {
+        return jug_utils_get_cpu_string();
+    }
+    return isa == JUG_EXPRESSION_ISA_AVX2 ? "haswell" : "x86-64";
+}
+
+static void _jug_add_fun_attribute(LLVMValueRef f, const char *name, const char *value)
+{
+    LLVMContextRef context = LLVMGetTypeContext(LLVMTypeOf(f));
+    LLVMAttributeRef attr = LLVMCreateStringAttribute(context, name, (unsigned) strlen(name),
+                                                      value, (unsigned) strlen(value));
+    LLVMAddAttributeAtIndex(f, LLVMAttributeFunctionIndex, attr);
+}
+
+static const char *const _jug_index_var_names[IARRAY_DIMENSION_MAX] = {
+    "i0", "i1", "i2", "i3", "i4", "i5", "i6", "i7"
+};
+
+INA_API(int) jug_index_var(const char *name, size_t len)
+{
+    if (len != 2 || name[0] != 'i' || name[1] < '0' || name[1] >= '0' + IARRAY_DIMENSION_MAX) {
+        return -1;
+    }
+    return name[1] - '0';
+}
+
+/* Index variables are bound to the names above, so bound inputs named alike are not taken for them */
+static bool _jug_te_uses_index(jug_te_expr *n, int dim)
+{
+    if (n == NULL) {
+        return false;
+    }
+    if (n->type == TE_VARIABLE) {
+        return n->bound == _jug_index_var_names[dim];
+    }
+    if (n->type == TE_CUSTOM) {
+        // The arguments of UDFs follow the function
+        int arity = jug_udf_func_get_arity((jug_udf_function_t *) n->parameters[0]);
+        for (int i = 1; i < arity + 1; ++i) {
+            if (_jug_te_uses_index((jug_te_expr *) n->parameters[i], dim)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    int arity = 0;
+    if (n->type & (TE_FUNCTION0 | TE_CLOSURE0)) {
+        arity = n->type & 0x00000007;
+    }
+    for (int i = 0; i < arity; ++i) {
+        if (_jug_te_uses_index((jug_te_expr *) n->parameters[i], dim)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Shifts have no floating point counterpart */
+static bool _jug_te_uses_shift(jug_te_expr *n)
+{
+    if (n == NULL) {
+        return false;
+    }
+    int first = 0;
+    int arity = 0;
+    if (n->type == TE_CUSTOM) {
+        // The arguments of UDFs follow the function
+        first = 1;
+        arity = jug_udf_func_get_arity((jug_udf_function_t *) n->parameters[0]);
+    }
+    else if (n->type & (TE_FUNCTION0 | TE_CLOSURE0)) {
+        arity = n->type & 0x00000007;
+        if (n->function == EXPR_TYPE_SHL || n->function == EXPR_TYPE_SHR) {
+            return true;
+        }
+    }
+    for (int i = first; i < first + arity; ++i) {
+        if (_jug_te_uses_shift((jug_te_expr *) n->parameters[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static LLVMValueRef _jug_expr_compile_function(
+    jug_expression_t *e,
+    const char *name,
+    jug_te_expr **expressions,
+    jug_expression_node_t *nodes,
+    int nnodes,
+    int nexprs,
+    int var_len)
+{
+    LLVMTypeRef int32Type = LLVMInt32Type();
+
+    e->context = LLVMContextCreate();
+
+    LLVMValueRef constant_zero = LLVMConstInt(int32Type, 0, 1);
+    LLVMValueRef constant_one = LLVMConstInt(int32Type, 1, 1);
+    LLVMTypeRef out_type = _jug_llvm_type(e->dtype);
+    if (out_type == NULL) {
+        return NULL;
+    }
+    jug_expression_dtype_t *var_dtypes = ina_mem_alloc(sizeof(jug_expression_dtype_t) * (var_len + 1));
+    e->compute_dtype = _jug_compute_dtype(e, var_len, var_dtypes);
+    e->expr_type = _jug_llvm_type(e->compute_dtype);
+
+    /* Folding and rewriting use floating point semantics */
+    if (_jug_dtype_is_float(e->compute_dtype)) {
+        for (int j = 0; j < nnodes; ++j) {
+            if (_jug_te_uses_shift(expressions[j])) {
+                IARRAY_TRACE1(iarray.error, "Shifts need integer operands and output");
+                ina_mem_free(var_dtypes);
+                return NULL;
+            }
+        }
+        for (int j = 0; j < nnodes; ++j) {
+            expressions[j] = jug_te_optimize(expressions[j]);
+        }
+    }
 
     /* define the parameter structure for prefilter */
-#define JUG_EVAL_PPARAMS_STRUCT_NUM_FIELDS 7
+#define JUG_EVAL_PPARAMS_STRUCT_NUM_FIELDS 15
     LLVMTypeRef params_struct = LLVMStructCreateNamed(e->context, "struct.iarray_eval_pparams_t");
     LLVMTypeRef *params_struct_types = ina_mem_alloc(sizeof(LLVMTypeRef) * JUG_EVAL_PPARAMS_STRUCT_NUM_FIELDS);
     params_struct_types[0] = LLVMInt32Type();  /* ninputs */
@@ -536,6 +992,14 @@ static LLVMValueRef _jug_expr_compile_function(
     params_struct_types[4] = LLVMPointerType(LLVMInt8Type(), 0);  /* out */
     params_struct_types[5] = LLVMInt32Type();  /* out_size */
     params_struct_types[6] = LLVMInt32Type();  /* out typesize */
+    params_struct_types[7] = LLVMInt8Type();  /* ndim */
+    params_struct_types[8] = LLVMPointerType(LLVMInt32Type(), 0);  /* window_shape */
+    params_struct_types[9] = LLVMPointerType(LLVMInt64Type(), 0);  /* window_start */
+    params_struct_types[10] = LLVMPointerType(LLVMInt32Type(), 0);  /* window_strides */
+    params_struct_types[11] = LLVMArrayType(LLVMInt64Type(), IARRAY_EXPR_USER_PARAMS_MAX);  /* user_params */
+    params_struct_types[12] = LLVMInt32Type();  /* nouts */
+    params_struct_types[13] = LLVMArrayType(LLVMPointerType(LLVMInt8Type(), 0), IARRAY_EXPR_OUTPUTS_MAX);  /* outs */
+    params_struct_types[14] = LLVMArrayType(LLVMPointerType(LLVMInt32Type(), 0), IARRAY_EXPR_OPERANDS_MAX);  /* input_strides */
 
     LLVMStructSetBody(params_struct, params_struct_types, JUG_EVAL_PPARAMS_STRUCT_NUM_FIELDS, 0);
 
@@ -545,6 +1009,16 @@ static LLVMValueRef _jug_expr_compile_function(
     LLVMTypeRef prototype = LLVMFunctionType(LLVMInt32Type(), param_types, 1, 0);
     LLVMValueRef f = LLVMAddFunction(e->mod, name, prototype);
 
+    /* the optimizer picks the subtarget (and so the vector width) from these attributes */
+    int vector_width;
+    _jug_add_fun_attribute(f, "target-cpu", _jug_target_cpu(e, &vector_width));
+    if (vector_width > 0) {
+        char width[16];
+        snprintf(width, sizeof(width), "%d", vector_width);
+        _jug_add_fun_attribute(f, "prefer-vector-width", width);
+        _jug_add_fun_attribute(f, "min-legal-vector-width", width);
+    }
+
     LLVMBasicBlockRef stackvar_sec = LLVMAppendBasicBlock(f, "stack_vars");
     LLVMBasicBlockRef loop_len = LLVMAppendBasicBlock(f, "loop_len");
     LLVMBasicBlockRef entry = LLVMAppendBasicBlock(f, "entry");
@@ -557,12 +1031,30 @@ static LLVMValueRef _jug_expr_compile_function(
 
     LLVMValueRef param_ptr = LLVMGetParam(f, 0);
 
-    LLVMValueRef local_output;
+    LLVMValueRef local_outputs[IARRAY_EXPR_OUTPUTS_MAX];
+    LLVMValueRef block_dims[IARRAY_DIMENSION_MAX];
+    LLVMValueRef *input_strides;
+    LLVMValueRef window_start = NULL;
+    bool any_broadcast = false;
+    for (int i = 0; i < var_len; ++i) {
+        any_broadcast = any_broadcast || e->input_broadcast[i];
+    }
+    bool uses_index[IARRAY_DIMENSION_MAX] = {0};
+    bool any_index = false;
+    for (int d = 0; d < e->ndim; ++d) {
+        for (int j = 0; j < nnodes; ++j) {
+            uses_index[d] = uses_index[d] || _jug_te_uses_index(expressions[j], d);
+        }
+        any_index = any_index || uses_index[d];
+    }
     LLVMValueRef *local_inputs;
     ina_str_t *local_input_labels;
     LLVMPositionBuilderAtEnd(e->builder, stackvar_sec);
     {
-        local_output = LLVMBuildAlloca(e->builder, LLVMPointerType(e->expr_type, 0), "local_output");
+        for (int k = 0; k < nexprs; ++k) {
+            local_outputs[k] = LLVMBuildAlloca(e->builder, LLVMPointerType(out_type, 0), "local_output");
+        }
+        input_strides = ina_mem_alloc(sizeof(LLVMValueRef) * (var_len * IARRAY_DIMENSION_MAX + 1));
         local_inputs = ina_mem_alloc(sizeof(LLVMValueRef*)*var_len); // leaking memory for now
         local_input_labels = ina_mem_alloc(sizeof(ina_str_t)*var_len); // leaking memory for now
 
@@ -575,13 +1067,15 @@ static LLVMValueRef _jug_expr_compile_function(
             local_inputs[i] = ina_mem_alloc(sizeof(LLVMValueRef));
 
             local_input_labels[i] = ina_str_sprintf("input[%d]", i); // leaking memory for now
-            local_inputs[i] = LLVMBuildAlloca(e->builder, LLVMPointerType(e->expr_type, 0), ina_str_cstr(local_input_labels[i]));
+            /* Every input is read at its own width */
+            LLVMTypeRef in_type = _jug_llvm_type(var_dtypes[i]);
+            local_inputs[i] = LLVMBuildAlloca(e->builder, LLVMPointerType(in_type, 0), ina_str_cstr(local_input_labels[i]));
 
             /* Load array of inputs */
             LLVMValueRef in_addr = LLVMBuildExtractValue(e->builder, inputs, i, "inputs[index]");
 
             /* Cast to value type */
-            LLVMTypeRef type_cast = LLVMPointerType(e->expr_type, 0);
+            LLVMTypeRef type_cast = LLVMPointerType(in_type, 0);
             LLVMValueRef cast_in = LLVMBuildCast(e->builder, LLVMBitCast, in_addr, type_cast, "cast[double*]");
 
             /* Store pointer in stack var */
@@ -590,8 +1084,57 @@ static LLVMValueRef _jug_expr_compile_function(
 
         LLVMValueRef out_ptr = LLVMBuildStructGEP(e->builder, param_ptr, 4, "out_ptr");
         LLVMValueRef out = LLVMBuildLoad(e->builder, out_ptr, "out");
-        LLVMValueRef out_cast = LLVMBuildCast(e->builder, LLVMBitCast, out, LLVMPointerType(e->expr_type, 0), "out_cast");
-        LLVMBuildStore(e->builder, out_cast, local_output);
+        LLVMValueRef out_cast = LLVMBuildCast(e->builder, LLVMBitCast, out, LLVMPointerType(out_type, 0), "out_cast");
+        LLVMBuildStore(e->builder, out_cast, local_outputs[0]);
+
+        /*
+         * Broadcast inputs are addressed through their own strides, from the coordinates of each
+         * element inside the window; the window dimensions come from its strides.  The index
+         * variables are these coordinates plus the start of the window.
+         */
+        if (any_broadcast || any_index) {
+            LLVMValueRef window_strides_ptr = LLVMBuildStructGEP(e->builder, param_ptr, 10, "window_strides_ptr");
+            LLVMValueRef window_strides = LLVMBuildLoad(e->builder, window_strides_ptr, "window_strides");
+            LLVMValueRef prev_stride = NULL;
+            for (int d = 0; d < e->ndim; ++d) {
+                LLVMValueRef d_index = LLVMConstInt(int32Type, d, 0);
+                LLVMValueRef stride_addr = LLVMBuildGEP(e->builder, window_strides, &d_index, 1, "window_strides[d]");
+                LLVMValueRef stride = LLVMBuildLoad(e->builder, stride_addr, "window_stride");
+                block_dims[d] = d > 0 ? LLVMBuildUDiv(e->builder, prev_stride, stride, "block_dim") : NULL;
+                prev_stride = stride;
+            }
+        }
+        if (any_index) {
+            LLVMValueRef window_start_ptr = LLVMBuildStructGEP(e->builder, param_ptr, 9, "window_start_ptr");
+            window_start = LLVMBuildLoad(e->builder, window_start_ptr, "window_start");
+        }
+        if (any_broadcast) {
+            LLVMValueRef in_strides_ptr = LLVMBuildStructGEP(e->builder, param_ptr, 14, "input_strides_ptr");
+            LLVMValueRef in_strides = LLVMBuildLoad(e->builder, in_strides_ptr, "input_strides");
+            for (int i = 0; i < var_len; ++i) {
+                if (!e->input_broadcast[i]) {
+                    continue;
+                }
+                LLVMValueRef strides_i = LLVMBuildExtractValue(e->builder, in_strides, i, "input_strides[i]");
+                for (int d = 0; d < e->ndim; ++d) {
+                    LLVMValueRef d_index = LLVMConstInt(int32Type, d, 0);
+                    LLVMValueRef stride_addr = LLVMBuildGEP(e->builder, strides_i, &d_index, 1, "input_strides[i][d]");
+                    input_strides[i * IARRAY_DIMENSION_MAX + d] = LLVMBuildLoad(e->builder, stride_addr, "input_stride");
+                }
+            }
+        }
+
+        /* The rest of the outputs of a multi-output expression */
+        if (nexprs > 1) {
+            LLVMValueRef outs_ptr = LLVMBuildStructGEP(e->builder, param_ptr, 13, "outs_ptr");
+            LLVMValueRef outs = LLVMBuildLoad(e->builder, outs_ptr, "outs");
+            for (int k = 1; k < nexprs; ++k) {
+                LLVMValueRef out_k = LLVMBuildExtractValue(e->builder, outs, k, "outs[k]");
+                LLVMValueRef out_k_cast = LLVMBuildCast(e->builder, LLVMBitCast, out_k, LLVMPointerType(out_type, 0),
+                                                        "out_cast");
+                LLVMBuildStore(e->builder, out_k_cast, local_outputs[k]);
+            }
+        }
 
         LLVMBuildBr(e->builder, loop_len);
     }
@@ -639,29 +1182,101 @@ static LLVMValueRef _jug_expr_compile_function(
         LLVMValueRef index = LLVMBuildLoad(e->builder, index_addr, "[index]");
 
         /* Load the scalar values from the inputs */
+        LLVMValueRef *input_values = ina_mem_alloc(sizeof(LLVMValueRef) * (var_len + 1));
         for (int i = 0; i < var_len; ++i) {
             LLVMValueRef stack_var = LLVMBuildLoad(e->builder, local_inputs[i], "load_stackvar");
-            LLVMValueRef addr = LLVMBuildGEP(e->builder, stack_var, &index, 1, "buffer[index]");
+            LLVMValueRef in_index = index;
+            if (e->input_broadcast[i]) {
+                /* Unravel the index in the window and apply the strides (0 along broadcast dimensions) */
+                LLVMValueRef rem = index;
+                in_index = constant_zero;
+                for (int d = e->ndim - 1; d >= 0; --d) {
+                    LLVMValueRef coord = rem;
+                    if (d > 0) {
+                        coord = LLVMBuildURem(e->builder, rem, block_dims[d], "coord");
+                        rem = LLVMBuildUDiv(e->builder, rem, block_dims[d], "rem");
+                    }
+                    LLVMValueRef offset = LLVMBuildMul(e->builder, coord, input_strides[i * IARRAY_DIMENSION_MAX + d],
+                                                       "offset");
+                    in_index = LLVMBuildAdd(e->builder, in_index, offset, "in_index");
+                }
+            }
+            LLVMValueRef addr = LLVMBuildGEP(e->builder, stack_var, &in_index, 1, "buffer[index]");
 
             /* Load scalar value */
             LLVMValueRef val = LLVMBuildLoad(e->builder, addr, "value");
             LLVMSetMetadata(val, LLVMInstructionValueKind, md_access);
-            const char *key = vars[i].name;
-            ina_hashtable_set_str(param_values, key, val);
+            /* Promote it in registers */
+            input_values[i] = _jug_build_cast(e->builder, val, var_dtypes[i], e->compute_dtype);
         }
 
-        /* compute the expression */
-        LLVMValueRef result = _jug_expr_compile_expression(e, expression, param_values);
-        if (result == NULL) {
-            INA_TRACE1(iarray.error, "Error compiling expression");
-            return NULL;
+        /* The position of the element, for the index variables */
+        LLVMValueRef index_values[IARRAY_DIMENSION_MAX] = {0};
+        if (any_index) {
+            LLVMValueRef rem = index;
+            for (int d = e->ndim - 1; d >= 0; --d) {
+                LLVMValueRef coord = rem;
+                if (d > 0) {
+                    coord = LLVMBuildURem(e->builder, rem, block_dims[d], "coord");
+                    rem = LLVMBuildUDiv(e->builder, rem, block_dims[d], "rem");
+                }
+                if (!uses_index[d]) {
+                    continue;
+                }
+                LLVMValueRef d_index = LLVMConstInt(int32Type, d, 0);
+                LLVMValueRef start_addr = LLVMBuildGEP(e->builder, window_start, &d_index, 1, "window_start[d]");
+                LLVMValueRef start = LLVMBuildLoad(e->builder, start_addr, "window_start_d");
+                LLVMValueRef coord64 = LLVMBuildZExt(e->builder, coord, LLVMInt64Type(), "coord64");
+                LLVMValueRef pos = LLVMBuildAdd(e->builder, start, coord64, "pos");
+                index_values[d] = _jug_build_cast(e->builder, pos, JUG_EXPRESSION_DTYPE_SINT64, e->compute_dtype);
+            }
         }
 
-        /* store the result */
-        LLVMValueRef local_out_ref = LLVMBuildLoad(e->builder, local_output, "local_output");
-        LLVMValueRef out_addr = LLVMBuildGEP(e->builder, local_out_ref, &index, 1, "out_addr");
-        LLVMValueRef store = LLVMBuildStore(e->builder, result, out_addr);
-        LLVMSetMetadata(store, LLVMInstructionValueKind, md_access);
+        /* Every node is computed once per element, in order, from the inputs and the nodes before it */
+        LLVMValueRef *node_values = ina_mem_alloc(sizeof(LLVMValueRef) * nnodes);
+        for (int j = 0; j < nnodes; ++j) {
+            ina_hashtable_t *param_values = NULL;
+            ina_hashtable_new(INA_HASHTABLE_STR_KEY,
+                INA_HASH32_LOOKUP3,
+                INA_HASHTABLE_TYPE_DEFAULT,
+                INA_HASHTABLE_GROW_DEFAULT,
+                INA_HASHTABLE_SHRINK_DEFAULT,
+                INA_HASHTABLE_DEFAULT_CAPACITY,
+                INA_HASHTABLE_CF_DEFAULT, &param_values);
+            for (int d = 0; d < e->ndim; ++d) {
+                if (index_values[d] != NULL) {
+                    ina_hashtable_set_str(param_values, _jug_index_var_names[d], index_values[d]);
+                }
+            }
+            // Inputs named like an index variable hide it
+            for (int v = 0; v < nodes[j].num_vars; ++v) {
+                int ref = nodes[j].var_refs[v];
+                LLVMValueRef val = ref >= 0 ? input_values[ref] : node_values[-ref - 1];
+                ina_hashtable_set_str(param_values, nodes[j].var_names[v], val);
+            }
+            // Variables are bound per node, so subexpressions are only shared within a node
+            _jug_te_memo_t memo = {0};
+            node_values[j] = _jug_expr_compile_expression(e, expressions[j], param_values, &memo);
+            _jug_te_memo_free(&memo);
+            ina_hashtable_free(&param_values);
+            if (node_values[j] == NULL) {
+                INA_TRACE1(iarray.error, "Error compiling expression");
+                return NULL;
+            }
+        }
+
+        /* store the results of the output nodes */
+        for (int k = 0; k < nexprs; ++k) {
+            LLVMValueRef result = node_values[nnodes - nexprs + k];
+
+            LLVMValueRef local_out_ref = LLVMBuildLoad(e->builder, local_outputs[k], "local_output");
+            LLVMValueRef out_addr = LLVMBuildGEP(e->builder, local_out_ref, &index, 1, "out_addr");
+            result = _jug_build_cast(e->builder, result, e->compute_dtype, e->dtype);
+            LLVMValueRef store = LLVMBuildStore(e->builder, result, out_addr);
+            LLVMSetMetadata(store, LLVMInstructionValueKind, md_access);
+        }
+        ina_mem_free(node_values);
+        ina_mem_free(input_values);
 
         LLVMValueRef loop_latch = LLVMBuildBr(e->builder, increment);
         LLVMSetMetadata(loop_latch, LLVMInstructionValueKind, md_node);
@@ -677,7 +1292,8 @@ static LLVMValueRef _jug_expr_compile_function(
 
     LLVMBuildRet(e->builder, constant_zero);
 
-    ina_hashtable_free(&param_values);
+    ina_mem_free(var_dtypes);
+    ina_mem_free(input_strides);
 
     return f;
 }
@@ -714,6 +1330,71 @@ static void _jug_declare_printf(LLVMModuleRef mod)
 }
 #endif
 
+/* FNV-1a */
+static uint64_t _jug_hash(const char *data, size_t len)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t) data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*
+ * Name of the module in the on-disk object cache.  Native code depends on the LLVM version, on the
+ * CPU it is compiled for (see _jug_target_cpu) and on the exact host CPU features, so all are part of the key.
+ */
+static ina_str_t _jug_object_cache_id(const char *key, const char *cpu)
+{
+    ina_str_t full_key = ina_str_sprintf("%s|%s|%s|%s|%s", key, jug_utils_get_llvm_version(), cpu,
+                                         jug_utils_get_cpu_string(), jug_utils_get_cpu_features_string());
+    size_t len = strlen(ina_str_cstr(full_key));
+    ina_str_t id = ina_str_sprintf("%s%016llx%08llx", JUG_OBJECT_CACHE_PREFIX,
+                                   (unsigned long long) _jug_hash(ina_str_cstr(full_key), len),
+                                   (unsigned long long) len);
+    ina_str_free(full_key);
+    return id;
+}
+
+/*
+ * Creates an execution engine out of a previously cached native object, skipping both
+ * IR generation and optimization.  The module is empty; MCJIT gets the code from the object cache.
+ */
+static ina_rc_t _jug_load_cached_object(const char *object_id,
+                                        const char *cpu,
+                                        const char *fname,
+                                        LLVMExecutionEngineRef *engine,
+                                        uint64_t *function_addr)
+{
+    if (!jug_utils_object_cache_contains(object_id)) {
+        return INA_ERROR(INA_ERR_FALSE);
+    }
+    LLVMModuleRef mod = LLVMModuleCreateWithName(object_id);
+    LLVMSetModuleDataLayout(mod, _jug_data_ref);
+    LLVMSetTarget(mod, _jug_def_triple);
+
+    LLVMExecutionEngineRef cached_engine = NULL;
+    if (jug_utils_create_execution_engine(mod, cpu, &cached_engine)) {
+        return INA_ERROR(INA_ERR_FAILED);
+    }
+    jug_utils_finalize_execution_engine(cached_engine);
+    uint64_t addr = LLVMGetFunctionAddress(cached_engine, fname);
+    if (addr == 0) {
+        // Stale or corrupted object; the caller compiles from scratch
+        LLVMDisposeExecutionEngine(cached_engine);
+        return INA_ERROR(INA_ERR_FALSE);
+    }
+    *engine = cached_engine;
+    *function_addr = addr;
+
+    jug_utils_jit_cache_lock();
+    _jug_jit_cache_disk_hits++;
+    jug_utils_jit_cache_unlock();
+
+    return INA_SUCCESS;
+}
+
 /*
  * Code common to jug_expression_compile and jug_udf_compile functions:
  * verifies module, optimizes, creates execution engine
@@ -721,6 +1402,8 @@ static void _jug_declare_printf(LLVMModuleRef mod)
 static LLVMBool _jug_prepare_module(LLVMModuleRef mod,
                                     LLVMContextRef context,
                                     bool reload,
+                                    const char *object_id,
+                                    const char *cpu,
                                     LLVMExecutionEngineRef *engine) {
     LLVMBool error;
     char *message = NULL;
@@ -753,6 +1436,11 @@ static LLVMBool _jug_prepare_module(LLVMModuleRef mod,
         }
     }
 
+    // The identifier decides whether the native object goes to the on-disk cache
+    if (object_id != NULL) {
+        LLVMSetModuleIdentifier(mod, object_id, strlen(object_id));
+    }
+
     // Optimze
     _jug_apply_optimisation_passes(mod);
 #ifdef _JUG_DEBUG_WRITE_BC_TO_FILE
@@ -762,7 +1450,7 @@ static LLVMBool _jug_prepare_module(LLVMModuleRef mod,
 #endif
 
     // Create execution engine
-    error = jug_utils_create_execution_engine(mod, engine);
+    error = jug_utils_create_execution_engine(mod, cpu, engine);
     //error = LLVMCreateExecutionEngineForModule(&e->engine, e->mod, &message);
     if (error) {
         fprintf(stderr, "LLVM execution engine creation error: '%s'\n", message);
@@ -774,6 +1462,237 @@ exit:
     return error;
 }
 
+static ina_str_t _jug_jit_cache_key(jug_expression_t *e, const char *expr_str, int num_vars, jug_te_variable *vars)
+{
+    // Whitespace does not change the meaning of an expression, so drop it
+    size_t len = strlen(expr_str);
+    char *normalized = (char *) ina_mem_alloc(len + 1);
+    size_t j = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (!isspace((unsigned char) expr_str[i])) {
+            normalized[j++] = expr_str[i];
+        }
+    }
+    normalized[j] = '\0';
+
+    int vector_width;
+    const char *cpu = _jug_target_cpu(e, &vector_width);
+    // The number of dimensions gives the index variables available
+    ina_str_t key = ina_str_sprintf("%s|%d|%d|%d|%s/%d|", normalized, (int) e->dtype, (int) e->ndim, num_vars, cpu,
+                                    vector_width);
+    for (int i = 0; i < num_vars; ++i) {
+        // Broadcast inputs are read differently (and the code depends on the number of dimensions)
+        ina_str_t var_key = e->input_broadcast[i] ?
+                            ina_str_sprintf("%s:%d@%d,", vars[i].name, (int) e->input_dtypes[i], (int) e->ndim) :
+                            ina_str_sprintf("%s:%d,", vars[i].name, (int) e->input_dtypes[i]);
+        key = ina_str_catcstr(key, ina_str_cstr(var_key));
+        ina_str_free(var_key);
+    }
+    ina_mem_free(normalized);
+
+    return key;
+}
+
+static void _jug_jit_cache_entry_free(_jug_jit_cache_entry_t *entry)
+{
+    LLVMDisposeExecutionEngine(entry->engine);
+    ina_str_free(entry->key);
+    ina_mem_free(entry);
+}
+
+/* Drop the reference of `e` to the cache entry it uses, if any */
+static void _jug_jit_cache_release(jug_expression_t *e)
+{
+    _jug_jit_cache_entry_t *entry = e->cache_entry;
+    if (entry == NULL) {
+        return;
+    }
+    e->cache_entry = NULL;
+    jug_utils_jit_cache_lock();
+    bool dispose = --entry->nusers == 0 && !entry->cached;
+    jug_utils_jit_cache_unlock();
+    if (dispose) {
+        _jug_jit_cache_entry_free(entry);
+    }
+}
+
+static bool _jug_jit_cache_lookup(jug_expression_t *e, ina_str_t key, uint64_t *function_addr)
+{
+    _jug_jit_cache_entry_t *entry = NULL;
+    jug_utils_jit_cache_lock();
+    if (_jug_jit_cache != NULL) {
+        ina_hashtable_get_str(_jug_jit_cache, ina_str_cstr(key), (void **) &entry);
+    }
+    if (entry != NULL) {
+        *function_addr = entry->function_addr;
+        entry->nusers++;
+        e->cache_entry = entry;
+        _jug_jit_cache_hits++;
+    }
+    else {
+        _jug_jit_cache_misses++;
+    }
+    jug_utils_jit_cache_unlock();
+
+    return entry != NULL;
+}
+
+/* On success the cache takes ownership of both the key and the execution engine of `e` */
+static bool _jug_jit_cache_insert(jug_expression_t *e, ina_str_t key, uint64_t function_addr)
+{
+    bool inserted = false;
+    jug_utils_jit_cache_lock();
+    if (_jug_jit_cache == NULL) {
+        ina_hashtable_new(INA_HASHTABLE_STR_KEY,
+                          INA_HASH32_LOOKUP3,
+                          INA_HASHTABLE_TYPE_DEFAULT,
+                          INA_HASHTABLE_GROW_DEFAULT,
+                          INA_HASHTABLE_SHRINK_DEFAULT,
+                          INA_HASHTABLE_DEFAULT_CAPACITY,
+                          INA_HASHTABLE_CF_DEFAULT, &_jug_jit_cache);
+    }
+    _jug_jit_cache_entry_t *entry = NULL;
+    ina_hashtable_get_str(_jug_jit_cache, ina_str_cstr(key), (void **) &entry);
+    // Another thread may have compiled the same expression in the meantime; keep the first one
+    if (entry == NULL) {
+        entry = (_jug_jit_cache_entry_t *) ina_mem_alloc(sizeof(_jug_jit_cache_entry_t));
+        entry->key = key;
+        entry->engine = e->engine;
+        entry->function_addr = function_addr;
+        entry->nusers = 1;
+        entry->cached = true;
+        entry->next = _jug_jit_cache_entries;
+        _jug_jit_cache_entries = entry;
+        ina_hashtable_set_str(_jug_jit_cache, ina_str_cstr(entry->key), entry);
+        _jug_jit_cache_nentries++;
+        e->engine = NULL;
+        e->cache_entry = entry;
+        inserted = true;
+    }
+    jug_utils_jit_cache_unlock();
+
+    return inserted;
+}
+
+static bool _jug_te_has_custom(jug_te_expr *n)
+{
+    if (n == NULL) {
+        return false;
+    }
+    if (n->type == TE_CUSTOM) {
+        return true;
+    }
+    int arity = 0;
+    if (n->type & (TE_FUNCTION0 | TE_CLOSURE0)) {
+        arity = n->type & 0x00000007;
+    }
+    for (int i = 0; i < arity; ++i) {
+        if (_jug_te_has_custom((jug_te_expr *) n->parameters[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+INA_API(ina_rc_t) jug_expression_cache_set_dir(const char *dirpath)
+{
+    if (jug_utils_object_cache_set_dir(dirpath)) {
+        IARRAY_TRACE1(iarray.error, "Cannot create the directory for the expression cache");
+        return INA_ERROR(INA_ERR_FAILED);
+    }
+    return INA_SUCCESS;
+}
+
+INA_API(void) jug_expression_cache_stats(int64_t *hits, int64_t *misses, int64_t *nentries)
+{
+    jug_utils_jit_cache_lock();
+    if (hits != NULL) {
+        *hits = _jug_jit_cache_hits;
+    }
+    if (misses != NULL) {
+        *misses = _jug_jit_cache_misses;
+    }
+    if (nentries != NULL) {
+        *nentries = _jug_jit_cache_nentries;
+    }
+    jug_utils_jit_cache_unlock();
+}
+
+INA_API(int64_t) jug_expression_cache_disk_hits()
+{
+    jug_utils_jit_cache_lock();
+    int64_t disk_hits = _jug_jit_cache_disk_hits;
+    jug_utils_jit_cache_unlock();
+    return disk_hits;
+}
+
+/* The entries still used by some expression are only dropped from the cache */
+INA_API(void) jug_expression_cache_clear()
+{
+    jug_utils_jit_cache_lock();
+    _jug_jit_cache_entry_t *entry = _jug_jit_cache_entries;
+    while (entry != NULL) {
+        _jug_jit_cache_entry_t *next = entry->next;
+        entry->cached = false;
+        entry->next = NULL;
+        if (entry->nusers == 0) {
+            _jug_jit_cache_entry_free(entry);
+        }
+        entry = next;
+    }
+    _jug_jit_cache_entries = NULL;
+    if (_jug_jit_cache != NULL) {
+        ina_hashtable_free(&_jug_jit_cache);
+        _jug_jit_cache = NULL;
+    }
+    _jug_jit_cache_hits = 0;
+    _jug_jit_cache_misses = 0;
+    _jug_jit_cache_disk_hits = 0;
+    _jug_jit_cache_nentries = 0;
+    jug_utils_jit_cache_unlock();
+}
+
+/*
+ * Drops the code of the last compilation: the engine is disposed unless it went to the cache
+ * (then only the reference to the entry is dropped), and so is the module if it is still ours.
+ */
+static void _jug_expression_release(jug_expression_t *e)
+{
+    if (e->engine != NULL) {
+        LLVMDisposeExecutionEngine(e->engine);
+        e->engine = NULL;
+    }
+    _jug_jit_cache_release(e);
+    if (e->mod != NULL && e->mod_owned) {
+        LLVMDisposeModule(e->mod);
+    }
+    e->mod = NULL;
+    e->mod_owned = false;
+}
+
+/*
+ * Every compilation builds its kernel in a new module: the previous one may be used by
+ * an engine shared through the cache, so neither it nor the declarations in it are reused.
+ */
+static void _jug_expression_new_module(jug_expression_t *e)
+{
+    e->mod = LLVMModuleCreateWithName("expr_engine");
+    e->mod_owned = true;
+    if (e->decl_cache != NULL) {
+        ina_hashtable_free(&e->decl_cache);
+    }
+    ina_hashtable_new(INA_HASHTABLE_STR_KEY,
+        INA_HASH32_LOOKUP3,
+        INA_HASHTABLE_TYPE_DEFAULT,
+        INA_HASHTABLE_GROW_DEFAULT,
+        INA_HASHTABLE_SHRINK_DEFAULT,
+        INA_HASHTABLE_DEFAULT_CAPACITY,
+        INA_HASHTABLE_CF_DEFAULT, &e->decl_cache);
+#ifdef _JUG_DEBUG_DECLARE_PRINT_IN_IR
+    _jug_declare_printf(e->mod);
+#endif
+}
+
 INA_API(ina_rc_t) jug_udf_registry_new(jug_udf_registry_t **udf_registry)
 {
     *udf_registry = (jug_udf_registry_t*)ina_mem_alloc(sizeof(jug_udf_registry_t));
@@ -837,6 +1756,13 @@ INA_API(ina_rc_t) jug_init()
             LLVMRelocDefault,
             LLVMCodeModelJITDefault);
     _jug_data_ref = LLVMCreateTargetDataLayout(_jug_tm_ref);
+    _jug_host_isa = _jug_detect_host_isa();
+
+    // Workers can share the on-disk cache of compiled expressions without any code change
+    const char *cache_dir = getenv("IARRAY_EXPR_CACHE_DIR");
+    if (cache_dir != NULL) {
+        jug_utils_object_cache_set_dir(cache_dir);
+    }
 
     udf_registry = (jug_udf_registry_t*)ina_mem_alloc(sizeof(jug_udf_registry_t));
     if (INA_FAILED(jug_udf_registry_new(&udf_registry))) {
@@ -854,6 +1780,7 @@ INA_API(void) jug_destroy()
 {
    // FIXME: Add code to clear the libraries (if still registered) as well
    jug_udf_registry_free(&udf_registry);
+   jug_expression_cache_clear();
 
 // FIXME: the code below makes some tests to fail.  Commenting this out for the time being.
 //    if (_jug_tm_ref != NULL) {
@@ -863,19 +1790,12 @@ INA_API(void) jug_destroy()
 }
 
 INA_API(ina_rc_t) jug_expression_new(jug_expression_t **expr, jug_expression_dtype_t dtype) {
-    LLVMModuleRef m;
     *expr = (jug_expression_t*)ina_mem_alloc(sizeof(jug_expression_t));
     memset(*expr, 0, sizeof(jug_expression_t));
     (*expr)->dtype = dtype;
-    (*expr)->mod = LLVMModuleCreateWithName("expr_engine");
-    m = (*expr)->mod;
+    (*expr)->compute_dtype = dtype;
     _jug_register_functions(*expr);
-
-#ifdef _JUG_DEBUG_DECLARE_PRINT_IN_IR
-    _jug_declare_printf(m);
-#else
-    INA_UNUSED(m);
-#endif
+    _jug_expression_new_module(*expr);
 
     if (INA_FAILED(ina_mempool_new(1024 * 4, NULL, INA_MEM_DYNAMIC, &(*expr)->variable_mempool))) {
         return ina_err_get_rc();
@@ -884,6 +1804,44 @@ INA_API(ina_rc_t) jug_expression_new(jug_expression_t **expr, jug_expression_dty
     return INA_SUCCESS;
 }
 
+INA_API(ina_rc_t) jug_expression_set_input_dtypes(jug_expression_t *e, int num_vars, const jug_expression_dtype_t *dtypes)
+{
+    if (num_vars < 0 || num_vars > IARRAY_EXPR_OPERANDS_MAX) {
+        IARRAY_TRACE1(iarray.error, "Too many inputs for the expression");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    for (int i = 0; i < num_vars; ++i) {
+        e->input_dtypes[i] = dtypes[i];
+    }
+    return INA_SUCCESS;
+}
+
+INA_API(ina_rc_t) jug_expression_set_isa(jug_expression_t *e, jug_expression_isa_t isa)
+{
+    if (isa < JUG_EXPRESSION_ISA_AUTO || isa > JUG_EXPRESSION_ISA_AVX512) {
+        IARRAY_TRACE1(iarray.error, "Invalid instruction set for the expression");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    e->isa = isa;
+    return INA_SUCCESS;
+}
+
+INA_API(ina_rc_t) jug_expression_set_input_broadcast(jug_expression_t *e,
+                                                     int8_t ndim,
+                                                     int num_vars,
+                                                     const bool *broadcast)
+{
+    if (num_vars < 0 || num_vars > IARRAY_EXPR_OPERANDS_MAX || ndim < 1 || ndim > IARRAY_DIMENSION_MAX) {
+        IARRAY_TRACE1(iarray.error, "Invalid broadcasting for the expression");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    e->ndim = ndim;
+    for (int i = 0; i < num_vars; ++i) {
+        e->input_broadcast[i] = broadcast[i];
+    }
+    return INA_SUCCESS;
+}
+
 INA_API(void) jug_expression_free(jug_expression_t **expr)
 {
     INA_VERIFY_FREE(expr);
@@ -896,12 +1854,7 @@ INA_API(void) jug_expression_free(jug_expression_t **expr)
     if ((*expr)->fun_map_te != NULL) {
         ina_mem_free((*expr)->fun_map_te);
     }
-    if ((*expr)->engine != NULL) {
-        LLVMDisposeExecutionEngine((*expr)->engine);
-    }
-    /*if ((*expr)->mod != NULL) {
-        LLVMDisposeModule((*expr)->mod);
-    }*/
+    _jug_expression_release(*expr);
     if ((*expr)->variable_mempool != NULL) {
         ina_mempool_free(&(*expr)->variable_mempool);
     }
@@ -944,12 +1897,25 @@ static ina_rc_t _jug_udf_compile(LLVMModuleRef *mod,
                                  int llvm_bc_len,
                                  const char *llvm_bc,
                                  const char *name,
+                                 const char *cpu,
                                  LLVMContextRef *context,
                                  uint64_t *function_addr) {
     char *message = NULL;
     LLVMMemoryBufferRef buffer;
     LLVMBool error;
     ina_rc_t rc = INA_SUCCESS;
+    ina_str_t object_id = NULL;
+
+    if (jug_utils_object_cache_enabled()) {
+        ina_str_t key = ina_str_sprintf("udf|%s|%d|%016llx", name, llvm_bc_len,
+                                        (unsigned long long) _jug_hash(llvm_bc, (size_t) llvm_bc_len));
+        object_id = _jug_object_cache_id(ina_str_cstr(key), cpu);
+        ina_str_free(key);
+        if (INA_SUCCEED(_jug_load_cached_object(ina_str_cstr(object_id), cpu, name, engine, function_addr))) {
+            *context = NULL;
+            goto exit;
+        }
+    }
 
     // Read the IR file into a buffer
     buffer = LLVMCreateMemoryBufferWithMemoryRange(llvm_bc, llvm_bc_len, name, 0);
@@ -965,7 +1931,7 @@ static ina_rc_t _jug_udf_compile(LLVMModuleRef *mod,
         goto exit;
     }
 
-    if (_jug_prepare_module(*mod, *context, false, engine)) {
+    if (_jug_prepare_module(*mod, *context, false, object_id != NULL ? ina_str_cstr(object_id) : NULL, cpu, engine)) {
         rc = INA_ERR_FAILED;
         goto exit;
     }
@@ -973,6 +1939,9 @@ static ina_rc_t _jug_udf_compile(LLVMModuleRef *mod,
     *function_addr = LLVMGetFunctionAddress(*engine, name);
 
 exit:
+    if (object_id != NULL) {
+        ina_str_free(object_id);
+    }
     LLVMDisposeMessage(message);
     // for some strange reason, this does a "pointer being freed was not allocated"
     //LLVMDisposeMemoryBuffer(memoryBuffer);
@@ -996,7 +1965,9 @@ INA_API(ina_rc_t) jug_udf_func_register(jug_udf_library_t *lib,
     udf_fun->return_type = return_type;
     udf_fun->name = ina_str_new_fromcstr(name);
 
-    if (INA_FAILED(_jug_udf_compile(&udf_fun->mod, &udf_fun->engine, llvm_bc_len, llvm_bc, name, &udf_fun->context, &udf_fun->function_ptr))) {
+    // Registered functions are not bound to any expression, so they are compiled for the host
+    if (INA_FAILED(_jug_udf_compile(&udf_fun->mod, &udf_fun->engine, llvm_bc_len, llvm_bc, name,
+                                    jug_utils_get_cpu_string(), &udf_fun->context, &udf_fun->function_ptr))) {
         return ina_err_get_rc();
     }
 
@@ -1057,7 +2028,12 @@ INA_API(ina_rc_t) jug_udf_compile(jug_expression_t *e,
                                   const char *name,
                                   uint64_t *function_addr)
 {
-    return _jug_udf_compile(&e->mod, &e->engine, llvm_bc_len, llvm_bc, name, &e->context, function_addr);
+    // The module parsed from the bitcode belongs to the engine
+    _jug_expression_release(e);
+    // Compiled for the ISA of the expression, as its kernels are
+    int vector_width;
+    const char *cpu = _jug_target_cpu(e, &vector_width);
+    return _jug_udf_compile(&e->mod, &e->engine, llvm_bc_len, llvm_bc, name, cpu, &e->context, function_addr);
 }
 
 INA_API(ina_rc_t) jug_expression_compile(jug_expression_t *e,
@@ -1066,24 +2042,193 @@ INA_API(ina_rc_t) jug_expression_compile(jug_expression_t *e,
                                          void *vars,
                                          uint64_t *function_addr)
 {
-    int parse_error = 0;
+    return jug_expression_compile_multi(e, 1, &expr_str, num_vars, vars, function_addr);
+}
 
+INA_API(ina_rc_t) jug_expression_compile_multi(jug_expression_t *e,
+                                               int nexprs,
+                                               const char **expr_strs,
+                                               int num_vars,
+                                               void *vars,
+                                               uint64_t *function_addr)
+{
+    if (nexprs < 1 || nexprs > IARRAY_EXPR_OUTPUTS_MAX) {
+        IARRAY_TRACE1(iarray.error, "Invalid number of expressions");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+
+    // Every expression is a node that sees all the inputs
     jug_te_variable *te_vars = (jug_te_variable*)vars;
-    jug_te_expr *expression = jug_te_compile(udf_registry, e->variable_mempool, expr_str, te_vars, num_vars, &parse_error);
-    if (parse_error) {
-        IARRAY_TRACE1(iarray.error, "Error parsing the expression with juggernaut");
+    const char **var_names = ina_mem_alloc(sizeof(char *) * (num_vars + 1));
+    int *var_refs = ina_mem_alloc(sizeof(int) * (num_vars + 1));
+    for (int i = 0; i < num_vars; ++i) {
+        var_names[i] = te_vars[i].name;
+        var_refs[i] = i;
+    }
+    jug_expression_node_t nodes[IARRAY_EXPR_OUTPUTS_MAX];
+    for (int k = 0; k < nexprs; ++k) {
+        nodes[k].expr = expr_strs[k];
+        nodes[k].num_vars = num_vars;
+        nodes[k].var_names = var_names;
+        nodes[k].var_refs = var_refs;
+    }
+
+    ina_rc_t rc = jug_expression_compile_graph(e, nexprs, nodes, nexprs, num_vars, vars, function_addr);
+
+    ina_mem_free(var_names);
+    ina_mem_free(var_refs);
+
+    return rc;
+}
+
+static ina_str_t _jug_graph_desc(int nnodes, jug_expression_node_t *nodes, int nouts)
+{
+    // Plain (multi-)expressions are just their texts, so that they share the cache entries
+    // of expressions compiled one by one
+    ina_str_t desc = ina_str_new_fromcstr(nodes[0].expr);
+    for (int j = 1; j < nnodes; ++j) {
+        desc = ina_str_catcstr(desc, ";");
+        desc = ina_str_catcstr(desc, nodes[j].expr);
+    }
+    if (nnodes == nouts) {
+        return desc;
+    }
+    // Otherwise the bindings of every node are part of the kernel
+    for (int j = 0; j < nnodes; ++j) {
+        desc = ina_str_catcstr(desc, "|");
+        for (int v = 0; v < nodes[j].num_vars; ++v) {
+            ina_str_t var_desc = ina_str_sprintf("%s=%d,", nodes[j].var_names[v], nodes[j].var_refs[v]);
+            desc = ina_str_catcstr(desc, ina_str_cstr(var_desc));
+            ina_str_free(var_desc);
+        }
+    }
+    ina_str_t outs_desc = ina_str_sprintf("|%d", nouts);
+    desc = ina_str_catcstr(desc, ina_str_cstr(outs_desc));
+    ina_str_free(outs_desc);
+    return desc;
+}
+
+INA_API(ina_rc_t) jug_expression_compile_graph(jug_expression_t *e,
+                                               int nnodes,
+                                               jug_expression_node_t *nodes,
+                                               int nouts,
+                                               int num_vars,
+                                               void *vars,
+                                               uint64_t *function_addr)
+{
+    int parse_error = 0;
+
+    if (nouts < 1 || nouts > IARRAY_EXPR_OUTPUTS_MAX || nnodes < nouts) {
+        IARRAY_TRACE1(iarray.error, "Invalid number of expressions");
         return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
     }
-    _jug_expr_compile_function(e, "expr_func", expression, num_vars, te_vars);
-    jug_te_free(expression);
+    for (int j = 0; j < nnodes; ++j) {
+        for (int v = 0; v < nodes[j].num_vars; ++v) {
+            int ref = nodes[j].var_refs[v];
+            // A node can only use the inputs and the nodes before it
+            if (ref >= num_vars || -ref - 1 >= j) {
+                IARRAY_TRACE1(iarray.error, "Invalid reference in an expression graph");
+                return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+            }
+        }
+    }
+
+    jug_te_variable *te_vars = (jug_te_variable*)vars;
+
+    ina_str_t graph_desc = _jug_graph_desc(nnodes, nodes, nouts);
+    ina_str_t cache_key = _jug_jit_cache_key(e, ina_str_cstr(graph_desc), num_vars, te_vars);
+    ina_str_free(graph_desc);
+    // The code compiled before, if any, is not used anymore
+    _jug_expression_release(e);
+    _jug_expression_new_module(e);
+    if (_jug_jit_cache_lookup(e, cache_key, function_addr)) {
+        ina_str_free(cache_key);
+        return INA_SUCCESS;
+    }
+
+    int vector_width;
+    const char *cpu = _jug_target_cpu(e, &vector_width);
+    // Expressions with UDFs are never written to disk, so a cached object is always safe to use
+    ina_str_t object_id = NULL;
+    if (jug_utils_object_cache_enabled()) {
+        object_id = _jug_object_cache_id(ina_str_cstr(cache_key), cpu);
+        if (INA_SUCCEED(_jug_load_cached_object(ina_str_cstr(object_id), cpu, "expr_func", &e->engine, function_addr))) {
+            ina_str_free(object_id);
+            if (!_jug_jit_cache_insert(e, cache_key, *function_addr)) {
+                ina_str_free(cache_key);
+            }
+            return INA_SUCCESS;
+        }
+    }
+
+    jug_te_expr **expressions = ina_mem_alloc(sizeof(jug_te_expr *) * nnodes);
+    // UDFs can be re-registered under the same name (and their address is embedded in the code),
+    // so do not cache expressions using them
+    bool cacheable = true;
+    for (int j = 0; j < nnodes; ++j) {
+        // Each node is parsed in its own scope, which includes the index variables not hidden by inputs
+        int node_num_vars = nodes[j].num_vars;
+        jug_te_variable *node_vars = ina_mem_alloc(sizeof(jug_te_variable) * (node_num_vars + e->ndim + 1));
+        memset(node_vars, 0, sizeof(jug_te_variable) * (node_num_vars + e->ndim + 1));
+        for (int v = 0; v < nodes[j].num_vars; ++v) {
+            node_vars[v].name = nodes[j].var_names[v];
+        }
+        for (int d = 0; d < e->ndim; ++d) {
+            bool hidden = false;
+            for (int v = 0; v < nodes[j].num_vars; ++v) {
+                hidden = hidden || strcmp(nodes[j].var_names[v], _jug_index_var_names[d]) == 0;
+            }
+            if (!hidden) {
+                node_vars[node_num_vars++].name = _jug_index_var_names[d];
+            }
+        }
+        expressions[j] = jug_te_compile(udf_registry, e->variable_mempool, nodes[j].expr, node_vars,
+                                        node_num_vars, &parse_error);
+        ina_mem_free(node_vars);
+        if (parse_error) {
+            IARRAY_TRACE1(iarray.error, "Error parsing the expression with juggernaut");
+            for (int i = 0; i < j; ++i) {
+                jug_te_free(expressions[i]);
+            }
+            ina_mem_free(expressions);
+            ina_str_free(cache_key);
+            if (object_id != NULL) {
+                ina_str_free(object_id);
+            }
+            return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+        }
+        cacheable = cacheable && !_jug_te_has_custom(expressions[j]);
+    }
+    LLVMValueRef f = _jug_expr_compile_function(e, "expr_func", expressions, nodes, nnodes, nouts, num_vars);
+    for (int j = 0; j < nnodes; ++j) {
+        jug_te_free(expressions[j]);
+    }
+    ina_mem_free(expressions);
+    if (f == NULL) {
+        ina_str_free(cache_key);
+        if (object_id != NULL) {
+            ina_str_free(object_id);
+        }
+        return INA_ERROR(INA_ERR_FAILED);
+    }
 
-    if (_jug_prepare_module(e->mod, e->context, true, &e->engine)) {
+    const char *module_id = (cacheable && object_id != NULL) ? ina_str_cstr(object_id) : NULL;
+    LLVMBool error = _jug_prepare_module(e->mod, e->context, true, module_id, cpu, &e->engine);
+    if (object_id != NULL) {
+        ina_str_free(object_id);
+    }
+    if (error) {
         IARRAY_TRACE1(iarray.error, "Error preparing LLVM module");
+        ina_str_free(cache_key);
         return INA_ERROR(INA_ERR_FAILED);
     }
 
     *function_addr = LLVMGetFunctionAddress(e->engine, "expr_func");
 
+    if (!cacheable || !_jug_jit_cache_insert(e, cache_key, *function_addr)) {
+        ina_str_free(cache_key);
+    }
+
     return INA_SUCCESS;
 }
 
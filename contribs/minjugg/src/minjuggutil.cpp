@@ -11,6 +11,11 @@
 
 #include "minjuggutil.h"
 #include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
 
 #include <llvm-c/Transforms/PassManagerBuilder.h>
 #include <llvm/Analysis/TargetLibraryInfo.h>
@@ -18,9 +23,100 @@
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Host.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
 
 using namespace llvm;
 
+static std::mutex jit_cache_mutex;
+
+/*
+ * Stores the native objects of the modules whose identifier starts with JUG_OBJECT_CACHE_PREFIX
+ * in a directory, so that they can be loaded back (without optimizing again) by other processes.
+ * The directory can be changed while engines are compiling, so it is only accessed under
+ * jit_cache_mutex and every operation works on its own copy.
+ */
+
+class JugObjectCache : public llvm::ObjectCache {
+public:
+    void setDir(const std::string &dirpath) {
+        std::lock_guard<std::mutex> lock(jit_cache_mutex);
+        dir = dirpath;
+    }
+
+    std::string getDir() {
+        std::lock_guard<std::mutex> lock(jit_cache_mutex);
+        return dir;
+    }
+
+    static bool getPath(const std::string &dir, const Module *M, std::string &path) {
+        const std::string &id = M->getModuleIdentifier();
+        if (dir.empty() || id.compare(0, strlen(JUG_OBJECT_CACHE_PREFIX), JUG_OBJECT_CACHE_PREFIX) != 0) {
+            return false;
+        }
+        path = getPath(dir, id);
+        return true;
+    }
+
+    static std::string getPath(const std::string &dir, const std::string &id) {
+        SmallString<256> path(dir);
+        sys::path::append(path, id + ".o");
+        return std::string(path.str());
+    }
+
+    void notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) override {
+        std::string dir = getDir();
+        std::string path;
+        if (!getPath(dir, M, path)) {
+            return;
+        }
+        // Write to a unique temporary and rename, so that concurrent writers never expose partial objects
+        int fd;
+        SmallString<256> tmp_model(dir);
+        sys::path::append(tmp_model, "tmp-%%%%%%%%.o");
+        SmallString<256> tmp_path;
+        if (sys::fs::createUniqueFile(tmp_model, fd, tmp_path)) {
+            return;
+        }
+        {
+            raw_fd_ostream out(fd, true);
+            out.write(Obj.getBufferStart(), Obj.getBufferSize());
+            out.close();
+            if (out.has_error()) {
+                out.clear_error();
+                sys::fs::remove(tmp_path);
+                return;
+            }
+        }
+        if (sys::fs::rename(tmp_path, path)) {
+            sys::fs::remove(tmp_path);
+        }
+    }
+
+    std::unique_ptr<MemoryBuffer> getObject(const Module *M) override {
+        std::string path;
+        if (!getPath(getDir(), M, path)) {
+            return nullptr;
+        }
+        auto buffer = MemoryBuffer::getFile(path);
+        if (!buffer) {
+            return nullptr;
+        }
+        return std::move(*buffer);
+    }
+
+private:
+    std::string dir;
+};
+
+static JugObjectCache object_cache;
+
 inline PassManagerBuilder *unwrap(LLVMPassManagerBuilderRef P) {
     return reinterpret_cast<PassManagerBuilder*>(P);
 }
@@ -49,11 +145,101 @@ extern "C" const char * jug_utils_get_cpu_string()
     return sys::getHostCPUName().data();
 }
 
-extern "C" int jug_utils_create_execution_engine(LLVMModuleRef mod, LLVMExecutionEngineRef *ee)
+extern "C" int jug_utils_host_has_feature(const char *feature)
+{
+    static StringMap<bool> host_features;
+    static std::once_flag flag;
+    std::call_once(flag, []() {
+        if (!sys::getHostCPUFeatures(host_features)) {
+            host_features.clear();
+        }
+    });
+    auto f = host_features.find(feature);
+    return f != host_features.end() && f->getValue();
+}
+
+// A NULL cpu means the host one
+extern "C" int jug_utils_create_execution_engine(LLVMModuleRef mod, const char *cpu, LLVMExecutionEngineRef *ee)
 {
     llvm::EngineBuilder b(std::unique_ptr<llvm::Module>(unwrap(mod)));
     b.setEngineKind(EngineKind::JIT);
-    b.setMCPU(sys::getHostCPUName().data());
-    *ee = wrap(b.create());
+    b.setMCPU(cpu != NULL ? cpu : sys::getHostCPUName().data());
+    llvm::ExecutionEngine *engine = b.create();
+    if (engine == nullptr) {
+        return 1;
+    }
+    if (!object_cache.getDir().empty()) {
+        engine->setObjectCache(&object_cache);
+    }
+    *ee = wrap(engine);
+    return 0;
+}
+
+extern "C" int jug_utils_finalize_execution_engine(LLVMExecutionEngineRef ee)
+{
+    unwrap(ee)->finalizeObject();
     return 0;
-}
\ No newline at end of file
+}
+
+extern "C" const char * jug_utils_get_llvm_version()
+{
+    return LLVM_VERSION_STRING;
+}
+
+extern "C" const char * jug_utils_get_cpu_features_string()
+{
+    static std::string features;
+    static std::once_flag flag;
+    std::call_once(flag, []() {
+        StringMap<bool> host_features;
+        std::vector<std::string> enabled;
+        if (sys::getHostCPUFeatures(host_features)) {
+            for (auto &f : host_features) {
+                if (f.getValue()) {
+                    enabled.push_back(f.getKey().str());
+                }
+            }
+        }
+        std::sort(enabled.begin(), enabled.end());
+        for (auto &f : enabled) {
+            features += "+" + f;
+        }
+    });
+    return features.c_str();
+}
+
+extern "C" int jug_utils_object_cache_set_dir(const char *dirpath)
+{
+    if (dirpath == NULL || dirpath[0] == '\0') {
+        object_cache.setDir("");
+        return 0;
+    }
+    if (sys::fs::create_directories(dirpath)) {
+        return 1;
+    }
+    object_cache.setDir(dirpath);
+    return 0;
+}
+
+extern "C" int jug_utils_object_cache_enabled()
+{
+    return !object_cache.getDir().empty();
+}
+
+extern "C" int jug_utils_object_cache_contains(const char *module_id)
+{
+    std::string dir = object_cache.getDir();
+    if (dir.empty()) {
+        return 0;
+    }
+    return sys::fs::exists(JugObjectCache::getPath(dir, module_id));
+}
+extern "C" void jug_utils_jit_cache_lock()
+{
+    jit_cache_mutex.lock();
+}
+
+extern "C" void jug_utils_jit_cache_unlock()
+{
+    jit_cache_mutex.unlock();
+}
@@ -16,14 +16,26 @@
 extern "C" {
 #endif
 
+/* Only modules whose identifier starts with this prefix go to the on-disk object cache */
+#define JUG_OBJECT_CACHE_PREFIX "jugcache-"
+
 typedef struct LLVMOpaquePassManagerBuilder *LLVMPassManagerBuilderRef;
 typedef struct LLVMOpaqueModule *LLVMModuleRef;
 typedef struct LLVMOpaqueExecutionEngine *LLVMExecutionEngineRef;
 
 int jug_util_set_svml_vector_library(void);
 int jug_utils_enable_loop_vectorize(LLVMPassManagerBuilderRef PMB);
-int jug_utils_create_execution_engine(LLVMModuleRef mod, LLVMExecutionEngineRef *ee);
+int jug_utils_create_execution_engine(LLVMModuleRef mod, const char *cpu, LLVMExecutionEngineRef *ee);
 const char * jug_utils_get_cpu_string(void);
+int jug_utils_host_has_feature(const char *feature);
+void jug_utils_jit_cache_lock(void);
+void jug_utils_jit_cache_unlock(void);
+const char * jug_utils_get_llvm_version(void);
+const char * jug_utils_get_cpu_features_string(void);
+int jug_utils_object_cache_set_dir(const char *dirpath);
+int jug_utils_object_cache_enabled(void);
+int jug_utils_object_cache_contains(const char *module_id);
+int jug_utils_finalize_execution_engine(LLVMExecutionEngineRef ee);
 
 #ifdef __cplusplus
 }
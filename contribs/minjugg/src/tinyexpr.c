@@ -119,6 +119,137 @@ void jug_te_free(jug_te_expr *n) {
     free(n);
 }
 
+
+static double te_fold(te_expr_type_t function, const double *a) {
+    switch (function) {
+        case EXPR_TYPE_ADD: return a[0] + a[1];
+        case EXPR_TYPE_SUB: return a[0] - a[1];
+        case EXPR_TYPE_MUL: return a[0] * a[1];
+        case EXPR_TYPE_DIVIDE: return a[0] / a[1];
+        case EXPR_TYPE_NEGATE: return -a[0];
+        case EXPR_TYPE_ABS: return fabs(a[0]);
+        case EXPR_TYPE_ACOS: return acos(a[0]);
+        case EXPR_TYPE_ASIN: return asin(a[0]);
+        case EXPR_TYPE_ATAN: return atan(a[0]);
+        case EXPR_TYPE_ATAN2: return atan2(a[0], a[1]);
+        case EXPR_TYPE_CEIL: return ceil(a[0]);
+        case EXPR_TYPE_COS: return cos(a[0]);
+        case EXPR_TYPE_COSH: return cosh(a[0]);
+        case EXPR_TYPE_EXP: return exp(a[0]);
+        case EXPR_TYPE_FLOOR: return floor(a[0]);
+        case EXPR_TYPE_LOG: return log(a[0]);
+        case EXPR_TYPE_LOG10: return log10(a[0]);
+        case EXPR_TYPE_POW: return pow(a[0], a[1]);
+        case EXPR_TYPE_SIN: return sin(a[0]);
+        case EXPR_TYPE_SINH: return sinh(a[0]);
+        case EXPR_TYPE_SQRT: return sqrt(a[0]);
+        case EXPR_TYPE_TAN: return tan(a[0]);
+        case EXPR_TYPE_TANH: return tanh(a[0]);
+        case EXPR_TYPE_FMOD: return fmod(a[0], a[1]);
+        case EXPR_TYPE_MIN: return fmin(a[0], a[1]);
+        case EXPR_TYPE_MAX: return fmax(a[0], a[1]);
+        case EXPR_TYPE_LT: return a[0] < a[1];
+        case EXPR_TYPE_LE: return a[0] <= a[1];
+        case EXPR_TYPE_GT: return a[0] > a[1];
+        case EXPR_TYPE_GE: return a[0] >= a[1];
+        case EXPR_TYPE_EQ: return a[0] == a[1];
+        case EXPR_TYPE_NE: return a[0] != a[1];
+        default: return NAN;
+    }
+}
+
+
+/* Returns NULL if the tree contains nodes that cannot be copied (closures or UDF calls). */
+static jug_te_expr *te_copy(const jug_te_expr *n) {
+    if (n->type == TE_CUSTOM || IS_CLOSURE(n->type)) return 0;
+
+    jug_te_expr *ret = new_expr(n->type, 0);
+    switch (TYPE_MASK(n->type)) {
+        case TE_CONSTANT: ret->value = n->value; break;
+        case TE_VARIABLE: ret->bound = n->bound; break;
+        default: ret->function = n->function; break;
+    }
+    for (int i = 0; i < ARITY(n->type); ++i) {
+        ret->parameters[i] = te_copy(n->parameters[i]);
+        if (!ret->parameters[i]) {
+            jug_te_free(ret);
+            return 0;
+        }
+    }
+    return ret;
+}
+
+
+static int te_is_function(const jug_te_expr *n, te_expr_type_t function) {
+    return n->type != TE_CUSTOM && IS_FUNCTION(n->type) && n->function == function;
+}
+
+
+jug_te_expr *jug_te_optimize(jug_te_expr *n) {
+    if (!n) return n;
+
+    if (n->type == TE_CUSTOM) {
+        const int cust_arity = jug_udf_func_get_arity((jug_udf_function_t *) n->parameters[0]);
+        for (int i = 1; i < cust_arity + 1; ++i) {
+            n->parameters[i] = jug_te_optimize(n->parameters[i]);
+        }
+        return n;
+    }
+    if (!IS_FUNCTION(n->type)) return n;
+
+    const int arity = ARITY(n->type);
+    jug_te_expr **p = (jug_te_expr **) n->parameters;
+    int known = 1;
+    for (int i = 0; i < arity; ++i) {
+        p[i] = jug_te_optimize(p[i]);
+        known = known && p[i]->type == TE_CONSTANT;
+    }
+    if (n->function == EXPR_TYPE_COMMA) return n;
+
+    /* Fold pure functions of constants. */
+    if (IS_PURE(n->type) && arity > 0 && known) {
+        double args[2] = {p[0]->value, arity > 1 ? p[1]->value : 0};
+        const double value = te_fold(n->function, args);
+        te_free_parameters(n);
+        n->type = TE_CONSTANT;
+        n->value = value;
+        return n;
+    }
+
+    if (n->function == EXPR_TYPE_POW && p[1]->type == TE_CONSTANT) {
+        /* pow(x, 1) -> x */
+        if (p[1]->value == 1.0) {
+            jug_te_expr *ret = p[0];
+            jug_te_free(p[1]);
+            free(n);
+            return ret;
+        }
+        /* pow(x, 2) -> x * x; the two operands are merged again when generating code. */
+        if (p[1]->value == 2.0) {
+            jug_te_expr *x = te_copy(p[0]);
+            if (x) {
+                jug_te_free(p[1]);
+                p[1] = x;
+                n->function = EXPR_TYPE_MUL;
+            }
+            return n;
+        }
+    }
+
+    /* exp(a) * exp(b) -> exp(a + b) */
+    if (n->function == EXPR_TYPE_MUL && te_is_function(p[0], EXPR_TYPE_EXP) && te_is_function(p[1], EXPR_TYPE_EXP)) {
+        jug_te_expr *ret = p[0];
+        jug_te_expr *sum = NEW_EXPR(TE_FUNCTION2 | TE_FLAG_PURE, ret->parameters[0], p[1]->parameters[0]);
+        sum->function = EXPR_TYPE_ADD;
+        ret->parameters[0] = jug_te_optimize(sum);
+        free(p[1]);
+        free(n);
+        return ret;
+    }
+
+    return n;
+}
+
 static const jug_te_variable functions[] = {
     /* must be in alphabetical order */
     {"abs", EXPR_TYPE_ABS,     TE_FUNCTION1 | TE_FLAG_PURE, 0},
@@ -290,6 +421,44 @@ static void next_token(state *s) {
                     case '/': s->type = TOK_INFIX; s->function = EXPR_TYPE_DIVIDE; break;
                     case '^': s->type = TOK_INFIX; s->function = EXPR_TYPE_POW; break;
                     case '%': s->type = TOK_INFIX; s->function = EXPR_TYPE_FMOD; break;
+                    case '<': {
+                        s->type = TOK_INFIX;
+                        if (s->next[0] == '<') {
+                            s->next++;
+                            s->function = EXPR_TYPE_SHL;
+                        } else if (s->next[0] == '=') {
+                            s->next++;
+                            s->function = EXPR_TYPE_LE;
+                        } else {
+                            s->function = EXPR_TYPE_LT;
+                        }
+                        break;
+                    }
+                    case '>': {
+                        s->type = TOK_INFIX;
+                        if (s->next[0] == '>') {
+                            s->next++;
+                            s->function = EXPR_TYPE_SHR;
+                        } else if (s->next[0] == '=') {
+                            s->next++;
+                            s->function = EXPR_TYPE_GE;
+                        } else {
+                            s->function = EXPR_TYPE_GT;
+                        }
+                        break;
+                    }
+                    case '=':
+                    case '!': {
+                        // only '==' and '!=' (there is no assignment nor logical not)
+                        if (s->next[0] != '=') {
+                            s->type = TOK_ERROR;
+                            break;
+                        }
+                        s->type = TOK_INFIX;
+                        s->function = s->next[-1] == '=' ? EXPR_TYPE_EQ : EXPR_TYPE_NE;
+                        s->next++;
+                        break;
+                    }
                     case '(': s->type = TOK_OPEN; break;
                     case ')': s->type = TOK_CLOSE; break;
                     case ',': s->type = TOK_SEP; break;
@@ -302,11 +471,11 @@ static void next_token(state *s) {
 }
 
 static jug_te_expr *list(state *s);
-static jug_te_expr *expr(state *s);
+static jug_te_expr *compare(state *s);
 static jug_te_expr *power(state *s);
 
 static jug_te_expr *base(state *s) {
-    /* <base>      =    <constant> | <variable> | <function-0> {"(" ")"} | <function-1> <power> | <function-X> "(" <expr> {"," <expr>} ")" | "(" <list> ")" */
+    /* <base>      =    <constant> | <variable> | <function-0> {"(" ")"} | <function-1> <power> | <function-X> "(" <compare> {"," <compare>} ")" | "(" <list> ")" */
     jug_te_expr *ret;
     int arity;
 
@@ -330,7 +499,7 @@ static jug_te_expr *base(state *s) {
             int i;
             for (i = 1; i < cust_arity + 1; i++) {
                 next_token(s);
-                ret->parameters[i] = expr(s);
+                ret->parameters[i] = compare(s);
                 if (s->type != TOK_SEP) {
                     break;
                 }
@@ -399,7 +568,7 @@ static jug_te_expr *base(state *s) {
                 int i;
                 for(i = 0; i < arity; i++) {
                     next_token(s);
-                    ret->parameters[i] = expr(s);
+                    ret->parameters[i] = compare(s);
                     if(s->type != TOK_SEP) {
                         break;
                     }
@@ -498,13 +667,45 @@ static jug_te_expr *expr(state *s) {
 }
 
 
-static jug_te_expr *list(state *s) {
-    /* <list>      =    <expr> {"," <expr>} */
+static jug_te_expr *shift(state *s) {
+    /* <shift>     =    <expr> {("<<" | ">>") <expr>} */
     jug_te_expr *ret = expr(s);
 
-    while (s->type == TOK_SEP) {
+    while (s->type == TOK_INFIX && (s->function == EXPR_TYPE_SHL || s->function == EXPR_TYPE_SHR)) {
+        te_expr_type_t t = s->function;
         next_token(s);
         ret = NEW_EXPR(TE_FUNCTION2 | TE_FLAG_PURE, ret, expr(s));
+        ret->function = t;
+    }
+
+    return ret;
+}
+
+
+static jug_te_expr *compare(state *s) {
+    /* <compare>   =    <shift> {("<" | "<=" | ">" | ">=" | "==" | "!=") <shift>} */
+    jug_te_expr *ret = shift(s);
+
+    while (s->type == TOK_INFIX && (s->function == EXPR_TYPE_LT || s->function == EXPR_TYPE_LE ||
+                                    s->function == EXPR_TYPE_GT || s->function == EXPR_TYPE_GE ||
+                                    s->function == EXPR_TYPE_EQ || s->function == EXPR_TYPE_NE)) {
+        te_expr_type_t t = s->function;
+        next_token(s);
+        ret = NEW_EXPR(TE_FUNCTION2 | TE_FLAG_PURE, ret, shift(s));
+        ret->function = t;
+    }
+
+    return ret;
+}
+
+
+static jug_te_expr *list(state *s) {
+    /* <list>      =    <compare> {"," <compare>} */
+    jug_te_expr *ret = compare(s);
+
+    while (s->type == TOK_SEP) {
+        next_token(s);
+        ret = NEW_EXPR(TE_FUNCTION2 | TE_FLAG_PURE, ret, compare(s));
         ret->function = EXPR_TYPE_COMMA;
     }
 
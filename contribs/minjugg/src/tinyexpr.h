@@ -94,6 +94,14 @@ static const char te_function_map_str[][32] = {
     "EXPR_TYPE_FMOD",
     "EXPR_TYPE_MIN",
     "EXPR_TYPE_MAX",
+    "EXPR_TYPE_LT",
+    "EXPR_TYPE_LE",
+    "EXPR_TYPE_GT",
+    "EXPR_TYPE_GE",
+    "EXPR_TYPE_EQ",
+    "EXPR_TYPE_NE",
+    "EXPR_TYPE_SHL",
+    "EXPR_TYPE_SHR",
     "EXPR_TYPE_CUSTOM"
 };
 
@@ -107,6 +115,11 @@ jug_te_expr *jug_te_compile(jug_udf_registry_t *registry, ina_mempool_t *variabl
 void jug_te_free(jug_te_expr *n);
 
 
+/* Folds constants and rewrites some patterns into cheaper ones (e.g. pow(x, 2) into x * x). */
+/* Only valid for floating point evaluation. Returns the new root; replaced nodes are freed. */
+jug_te_expr *jug_te_optimize(jug_te_expr *n);
+
+
 #ifdef __cplusplus
 }
 #endif
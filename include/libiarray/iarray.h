@@ -25,6 +25,9 @@
 #define IARRAY_EXPR_USER_PARAMS_MAX (128)
 // The maximum number of input user parameters in expressions
 
+#define IARRAY_EXPR_OUTPUTS_MAX (16)
+// The maximum number of outputs in multi-output expressions
+
 #define IARRAY_ES_CONTAINER (INA_ES_USER_DEFINED + 1)
 #define IARRAY_ES_DTSHAPE (INA_ES_USER_DEFINED + 2)
 #define IARRAY_ES_SHAPE (INA_ES_USER_DEFINED + 3)
@@ -160,6 +163,15 @@ typedef enum iarray_eval_method_e {
     IARRAY_EVAL_METHOD_ITERBLOSC = 2u,
 } iarray_eval_method_t;
 
+// Instruction set the expression kernels are compiled for.  AUTO picks the best one of the host;
+// an ISA that the host lacks is lowered to the best one available.
+typedef enum iarray_jit_isa_e {
+    IARRAY_JIT_ISA_AUTO = 0,
+    IARRAY_JIT_ISA_BASELINE = 1,  // portable x86-64 (SSE2)
+    IARRAY_JIT_ISA_AVX2 = 2,
+    IARRAY_JIT_ISA_AVX512 = 3,  // with 512-bit vectors
+} iarray_jit_isa_t;
+
 
 typedef enum iarray_filter_flags_e {
     IARRAY_COMP_SHUFFLE    = 0x1,
@@ -223,6 +235,9 @@ typedef struct iarray_config_s {
     uint8_t fp_mantissa_bits; /* Only useful together with flag: IARRAY_COMP_TRUNC_PREC */
     bool btune;  /* Enable btune */
     uint8_t compression_meta; /* Only useful together with compression codecs: IARRAY_COMPRESSION_ZFP */
+    int eval_pipeline_depth; /* Chunks read ahead and written behind by background threads (0 disables them; ITERCHUNK then works as ITERBLOSC) */
+    iarray_jit_isa_t jit_isa; /* Instruction set of the compiled expressions and their UDFs */
+    const char *scratch_dir; /* Where temporary containers are spilled (NULL means $TMPDIR or the system default) */
 } iarray_config_t;
 
 typedef struct iarray_dtshape_s {
@@ -284,6 +299,9 @@ static const iarray_config_t IARRAY_CONFIG_DEFAULTS = {
     .fp_mantissa_bits = 0,
     .btune = true,
     .compression_meta = 0,
+    .eval_pipeline_depth = 0,
+    .jit_isa = IARRAY_JIT_ISA_AUTO,
+    .scratch_dir = NULL,
 };
 
 static const iarray_config_t IARRAY_CONFIG_NO_COMPRESSION = {
@@ -301,8 +319,16 @@ static const iarray_config_t IARRAY_CONFIG_NO_COMPRESSION = {
 typedef struct _iarray_jug_var_s {
     const char *var;
     iarray_container_t *c;
+    bool stencil;  // read at `offset` from the position of the output element (e.g. `a[-1,0]`)
+    int32_t offset[IARRAY_DIMENSION_MAX];
 } _iarray_jug_var_t;
 
+// A variable bound to another (unevaluated) expression
+typedef struct _iarray_jug_subexpr_s {
+    const char *var;
+    struct iarray_expression_s *e;
+} _iarray_jug_subexpr_t;
+
 typedef struct jug_expression_s jug_expression_t;
 
 // Struct to be used as user parameter
@@ -326,7 +352,15 @@ typedef struct iarray_expression_s {
     iarray_dtshape_t *out_dtshape;
     iarray_storage_t *out_store_properties;
     iarray_container_t *out;
+    int nouts;  // the number of outputs (more than one for iarray_expr_compile_multi)
+    iarray_container_t *outs[IARRAY_EXPR_OUTPUTS_MAX];  // outs[0] is out
     _iarray_jug_var_t vars[IARRAY_EXPR_OPERANDS_MAX];
+    int nbound_vars;  // vars past this one are the operands of the bound sub-expressions
+    int nsubexprs;
+    _iarray_jug_subexpr_t subexprs[IARRAY_EXPR_OPERANDS_MAX];
+    bool index_vars;  // whether the expression (or a sub-expression) uses the index variables i0, i1...
+    uint8_t *bcast_data[IARRAY_EXPR_OPERANDS_MAX];  // padded copies of broadcast operands during an evaluation
+    int32_t *bcast_strides[IARRAY_EXPR_OPERANDS_MAX];  // their strides along the output dimensions (0 if broadcast)
     iarray_user_param_t user_params[IARRAY_EXPR_USER_PARAMS_MAX];  // the input user parameters
     unsigned int nuser_params;
 } iarray_expression_t;
@@ -731,6 +765,8 @@ typedef enum iarray_reduce_fun_e {
     IARRAY_REDUCE_NAN_MEDIAN,
     IARRAY_REDUCE_ALL,
     IARRAY_REDUCE_ANY,
+    IARRAY_REDUCE_QUANTILE,  // only through iarray_reduce_quantile
+    IARRAY_REDUCE_NAN_QUANTILE,
 } iarray_reduce_func_t;
 
 typedef struct iarray_reduce_function_s iarray_reduce_function_t;
@@ -755,6 +791,42 @@ INA_API(ina_rc_t) iarray_reduce_multi(iarray_context_t *ctx,
                                       bool oneshot,
                                       double correction);
 
+/*
+ * Compute the `q` quantile (between 0 and 1) of `a` over the `axis`, interpolating linearly
+ * between the closest items as numpy does; `func` is IARRAY_REDUCE_QUANTILE or
+ * IARRAY_REDUCE_NAN_QUANTILE.  If `approximate` is true, a t-digest is kept for every output item
+ * instead of all the items of its slice, so the memory does not grow with the reduced axes.
+ */
+INA_API(ina_rc_t) iarray_reduce_quantile(iarray_context_t *ctx,
+                                         iarray_container_t *a,
+                                         iarray_reduce_func_t func,
+                                         double q,
+                                         bool approximate,
+                                         int8_t naxis,
+                                         const int8_t *axis,
+                                         iarray_storage_t *storage,
+                                         iarray_container_t **b);
+
+/*
+ * Evaluate an expression and reduce its result in a single pass.  Each block of the expression is
+ * folded into the reduction as soon as it is computed, so the full-size result is never stored.
+ * The expression must be compiled and its output properties bound; the output partition is the one
+ * the reduction iterates over.
+ */
+INA_API(ina_rc_t) iarray_eval_reduce(iarray_expression_t *e,
+                                     iarray_reduce_func_t func,
+                                     int8_t naxis,
+                                     const int8_t *axis,
+                                     iarray_storage_t *storage,
+                                     iarray_container_t **b,
+                                     double correction);
+
+/* Same as above, but reducing over all the axes; the result is copied into `scalar` */
+INA_API(ina_rc_t) iarray_eval_reduce_scalar(iarray_expression_t *e,
+                                            iarray_reduce_func_t func,
+                                            double correction,
+                                            void *scalar,
+                                            int64_t scalar_size);
 
 /* linear algebra */
 INA_API(ina_rc_t) iarray_linalg_matmul(iarray_context_t *ctx,
@@ -830,13 +902,39 @@ INA_API(ina_rc_t) iarray_iter_write_block_has_next(iarray_iter_write_block_t *it
 INA_API(ina_rc_t) iarray_expr_new(iarray_context_t *ctx, iarray_data_type_t dtype, iarray_expression_t **e);
 INA_API(void) iarray_expr_free(iarray_context_t *ctx, iarray_expression_t **e);
 
+/*
+ * Binding a name again replaces its operand.  A compiled expression keeps its kernel as long as the new
+ * operands (and the output passed to iarray_expr_bind_out_properties) have the same dtype and shape,
+ * so it can be evaluated over and over on different data without compiling it again.
+ */
 INA_API(ina_rc_t) iarray_expr_bind(iarray_expression_t *e, const char *var, iarray_container_t *val);
+/*
+ * Bind `var` to the result of `sub`, a compiled expression that has not been evaluated.  The
+ * expression of `sub` is inlined in the kernel of `e`, so its result is never materialized.  `sub`
+ * must have the same dtype and shape as `e` and has to outlive the compilation of `e`.
+ */
+INA_API(ina_rc_t) iarray_expr_bind_expr(iarray_expression_t *e, const char *var, iarray_expression_t *sub);
 INA_API(ina_rc_t) iarray_expr_bind_out_properties(iarray_expression_t *e, iarray_dtshape_t *dtshape, iarray_storage_t *store);
 INA_API(ina_rc_t) iarray_expr_bind_param(iarray_expression_t *e, iarray_user_param_t val);
 
 INA_API(ina_rc_t) iarray_expr_bind_scalar_float(iarray_expression_t *e, const char *var, float val);
 INA_API(ina_rc_t) iarray_expr_bind_scalar_double(iarray_expression_t *e, const char *var, double val);
 
+/*
+ * Operands with the shape of the output can be read at a fixed offset from each element, e.g.
+ * `(a[-1,0] + a[1,0] + a[0,-1] + a[0,1]) / 4` for a 2-dim `a`; there must be one offset per
+ * dimension.  Positions falling outside of the operand take the value of the nearest element inside
+ * (the edges are replicated).  Stencils are not supported in reductions nor in bound sub-expressions.
+ *
+ * The variables `i0`, `i1`... hold the position of each element along the dimensions of the output
+ * (e.g. `i0 > i1` for a mask below the diagonal) and are computed inside the kernel.  Operands bound
+ * with the same names take precedence.
+ *
+ * Comparisons (`<`, `<=`, `>`, `>=`, `==`, `!=`) give 1 or 0 and bind looser than the shifts (`<<`, `>>`),
+ * which bind looser than `+` and `-`.  Shifts need integer operands and output; shifting by the width of
+ * the type or more is undefined.  Unsigned operands and outputs use unsigned arithmetic (e.g. division,
+ * `%`, comparisons and `>>`).  Bool outputs hold 1 for every non-zero result.
+ */
 INA_API(ina_rc_t) iarray_expr_compile(iarray_expression_t *e, const char *expr);
 INA_API(ina_rc_t) iarray_expr_compile_udf(iarray_expression_t *e,
                                           int llvm_bc_len,
@@ -844,6 +942,51 @@ INA_API(ina_rc_t) iarray_expr_compile_udf(iarray_expression_t *e,
                                           const char *name);
 
 INA_API(ina_rc_t) iarray_eval(iarray_expression_t *e, iarray_container_t **container);
+/*
+ * Evaluate `e` into an existing `container` with the dtype and shape of the output, replacing its
+ * chunks one by one instead of creating a new container.  The partition and the storage of
+ * `container` are kept.  `container` may also be an operand of `e`, as long as it is only read
+ * element-wise (neither through stencil offsets nor through views).
+ */
+INA_API(ina_rc_t) iarray_eval_into(iarray_expression_t *e, iarray_container_t *container);
+
+/*
+ * Compile `nexprs` expressions over the same bound variables so that they are evaluated in a single
+ * pass: every input block is decompressed once and feeds all the outputs.  The outputs share the
+ * dtype of the expression and the partition of the bound output properties.
+ */
+INA_API(ina_rc_t) iarray_expr_compile_multi(iarray_expression_t *e, int nexprs, const char **exprs);
+/*
+ * Evaluate a multi-output expression into `containers` (one per expression).  `storages` may be NULL
+ * (the bound output properties are used for every output); otherwise it holds `nexprs` storages with
+ * the same chunkshape and blockshape as the bound ones.
+ */
+INA_API(ina_rc_t) iarray_eval_multi(iarray_expression_t *e,
+                                    iarray_storage_t *storages,
+                                    iarray_container_t **containers);
+/*
+ * Evaluate `e` straight into `buffer` in C order.  The blocks are computed as in the ITERBLOSC method
+ * by max_num_threads threads (serially on Windows), and each one is copied into its place in `buffer`;
+ * no output container is created and nothing goes through blosc.  `buflen` must be at least the size
+ * in bytes of the result.
+ */
+INA_API(ina_rc_t) iarray_eval_to_buffer(iarray_expression_t *e, void *buffer, int64_t buflen);
+
+/*
+ * Compiled expressions are cached process-wide (keyed by the expression text, dtype, variables and CPU),
+ * so compiling an already known expression is just a lookup.  Clearing the cache empties it, but the
+ * code of the expressions not freed yet is kept until they are.
+ */
+INA_API(ina_rc_t) iarray_expr_cache_stats(int64_t *hits, int64_t *misses, int64_t *nentries);
+INA_API(void) iarray_expr_cache_clear(void);
+/*
+ * Keep the native code of compiled expressions and UDFs in `dirpath` so that other processes can
+ * load it instead of optimizing again (NULL disables it).  The IARRAY_EXPR_CACHE_DIR environment
+ * variable sets it at init time.
+ */
+INA_API(ina_rc_t) iarray_expr_cache_set_dir(const char *dirpath);
+/* Number of expressions and UDFs loaded from the directory above since the cache was last cleared */
+INA_API(ina_rc_t) iarray_expr_cache_disk_hits(int64_t *disk_hits);
 
 //FIXME: remove
 INA_API(ina_rc_t) iarray_expr_get_mp(iarray_expression_t *e, ina_mempool_t **mp);
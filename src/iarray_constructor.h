@@ -72,6 +72,7 @@ static inline ina_rc_t _iarray_container_new(iarray_context_t *ctx,
     (*c)->catarr = NULL;
     (*c)->container_viewed = NULL;
     (*c)->transposed = false;
+    (*c)->transposed_viewed = false;
 
     return INA_SUCCESS;
 }
@@ -130,6 +131,7 @@ inline static ina_rc_t _iarray_view_new(iarray_context_t *ctx,
         (*c)->container_viewed = container_viewed;
     }
     (*c)->transposed = false;
+    (*c)->transposed_viewed = container_viewed->transposed || container_viewed->transposed_viewed;
 
     iarray_storage_t *store = (iarray_storage_t*)ina_mem_alloc(sizeof(iarray_storage_t));
     store->contiguous = container_viewed->storage->contiguous;
@@ -195,6 +195,7 @@ ina_rc_t _iarray_container_load(iarray_context_t *ctx, char *urlpath, bool conti
 
     (*container)->container_viewed = NULL;
     (*container)->transposed = false;
+    (*container)->transposed_viewed = false;
 
     free(smeta);
     caterva_ctx_free(&cat_ctx);
@@ -353,6 +354,7 @@ INA_API(ina_rc_t) iarray_from_cframe(iarray_context_t *ctx,
 
     (*container)->container_viewed = NULL;
     (*container)->transposed = false;
+    (*container)->transposed_viewed = false;
 
     free(smeta);
     caterva_ctx_free(&cat_ctx);
@@ -13,18 +13,61 @@
 #include <libiarray/iarray.h>
 #include <minjugg.h>
 #include <caterva.h>
+#include <math.h>
 
 #if defined(_OPENMP)
 #include <omp.h>
 #endif
 
+#if !defined(_WIN32)
+#include <pthread.h>
+#define IARRAY_EVAL_PIPELINE
+#endif
+
 
 typedef enum iarray_expr_input_class_e {
     IARRAY_EXPR_EQ = 0u,  // Same chunkshape/blockshape
     IARRAY_EXPR_EQ_NCOMP = 1u, // Same chunkshape/blockshape and no-compressed data
-    IARRAY_EXPR_NEQ = 2u  // Different chunkshape/blockshape
+    IARRAY_EXPR_NEQ = 2u,  // Different chunkshape/blockshape
+    IARRAY_EXPR_BCAST = 3u,  // Broadcast to the output shape
+    IARRAY_EXPR_NEQ_BLOCK = 4u,  // Different chunkshape/blockshape, read block by block from the prefilter
+    IARRAY_EXPR_STENCIL = 5u,  // Read at an offset, from a halo gathered around the output block
+    IARRAY_EXPR_NEQ_CHUNK = 6u  // Different chunkshape/blockshape, gathered a chunk at a time by the pipeline readers
 } iarray_expr_input_class_t;
 
+#define IARRAY_EXPR_BLOCK_CACHE_SIZE 4
+
+// A few decompressed blocks of an IARRAY_EXPR_NEQ_BLOCK input, kept per prefilter thread
+typedef struct iarray_expr_block_cache_s {
+    int64_t nchunk[IARRAY_EXPR_BLOCK_CACHE_SIZE];  // -1 for empty entries
+    int64_t nblock[IARRAY_EXPR_BLOCK_CACHE_SIZE];
+    uint8_t *blocks[IARRAY_EXPR_BLOCK_CACHE_SIZE];
+    int next;  // entry to be replaced next
+} iarray_expr_block_cache_t;
+
+// Chunks of an IARRAY_EXPR_NEQ_BLOCK input overlapping the output chunk being computed
+typedef struct iarray_expr_neq_chunks_s {
+    int64_t start[IARRAY_DIMENSION_MAX];  // index of the first overlapping chunk
+    int64_t count[IARRAY_DIMENSION_MAX];  // number of overlapping chunks
+    int32_t margin_lo[IARRAY_DIMENSION_MAX];  // elements needed before the output chunk (stencil halos)
+    int32_t margin_hi[IARRAY_DIMENSION_MAX];  // elements needed after the output chunk (stencil halos)
+    int64_t nchunks;
+    uint8_t **chunks;  // lazy chunks, in C order
+    int32_t *csizes;
+    bool *needs_free;
+} iarray_expr_neq_chunks_t;
+
+// The halo of an IARRAY_EXPR_STENCIL input.  All the stencil inputs of a container share the halo of
+// the first one (the owner), which is gathered with the partition of the output block plus margins.
+typedef struct iarray_expr_stencil_s {
+    int owner;  // the input gathering the halo
+    int32_t lo[IARRAY_DIMENSION_MAX];  // margin before the block (only for the owner)
+    int32_t hi[IARRAY_DIMENSION_MAX];  // margin after the block (only for the owner)
+    int32_t strides[IARRAY_DIMENSION_MAX];  // strides of the halo (only for the owner)
+    int32_t halo_nitems;  // (only for the owner)
+    int64_t offset;  // where the element for the first one of the block is, in the halo
+} iarray_expr_stencil_t;
+
 
 // Struct to be used as info container for dealing with the expression
 typedef struct iarray_expr_pparams_s {
@@ -36,8 +79,34 @@ typedef struct iarray_expr_pparams_s {
     int32_t input_typesizes[IARRAY_EXPR_OPERANDS_MAX];  // the typesizes for data inputs
     iarray_expression_t *e;
     iarray_iter_write_block_value_t out_value;
+    int nouts;  // number of outputs
+    uint8_t *outs[IARRAY_EXPR_OUTPUTS_MAX];  // uncompressed chunks for the outputs other than the first one
+    uint8_t *out_buffer;  // when not NULL, a row-major buffer for the whole output (see iarray_eval_to_buffer)
+    int pool_nthreads;  // number of threads covered by the pools below
+    blosc2_context **dctx_pool;  // decompression contexts, indexed by [tid * ninputs + ninput]
+    uint8_t **block_pool;  // aligned scratch blocks, indexed by [tid * ninputs + ninput]
+    iarray_expr_block_cache_t *cache_pool;  // block caches, indexed by [tid * ninputs + ninput]
+    iarray_expr_neq_chunks_t *neq_chunks;  // indexed by ninput
+    iarray_expr_stencil_t *stencils;  // indexed by ninput
 } iarray_expr_pparams_t;
 
+// State to compute the blocks of an expression outside of its evaluation loop (see iarray_eval_reduce).
+// Like the pools above, everything is kept per thread and indexed by [tid * nvars + nvar]; the operand
+// chunks are only fetched again when a thread moves to another chunk of the output.
+struct iarray_expr_blocks_s {
+    iarray_expression_t *e;
+    iarray_expr_input_class_t input_class[IARRAY_EXPR_OPERANDS_MAX];  // EQ, NEQ_BLOCK or BCAST
+    int nthreads;
+    int64_t *nchunks;  // the output chunk fetched by each thread (-1 if none), indexed by tid
+    uint8_t **chunks;  // lazy chunks of the IARRAY_EXPR_EQ inputs
+    int32_t *csizes;
+    bool *needs_free;
+    iarray_expr_neq_chunks_t *neq_chunks;  // chunks of the IARRAY_EXPR_NEQ_BLOCK inputs
+    blosc2_context **dctx_pool;
+    uint8_t **block_pool;
+    iarray_expr_block_cache_t *cache_pool;  // only for the IARRAY_EXPR_NEQ_BLOCK inputs
+};
+
 // Struct to be used as argument to the evaluation function
 typedef struct iarray_eval_pparams_s {
     int ninputs;  // number of data inputs
@@ -52,6 +121,10 @@ typedef struct iarray_eval_pparams_s {
     int64_t *window_start; // the start coordinates for the window shape (NULL if not available)
     int32_t *window_strides; // the strides for the window shape (NULL if not available)
     iarray_user_param_t user_params[IARRAY_EXPR_USER_PARAMS_MAX];  // the input user parameters
+    // New fields go at the end so that the layout seen by existing UDFs does not change
+    int nouts;  // the number of outputs
+    uint8_t *outs[IARRAY_EXPR_OUTPUTS_MAX];  // the output buffers (outs[0] == out)
+    int32_t *input_strides[IARRAY_EXPR_OPERANDS_MAX];  // the strides of broadcast inputs (NULL for the rest)
 } iarray_eval_pparams_t;
 
 typedef int (*iarray_eval_fn)(iarray_eval_pparams_t *params);
@@ -64,16 +137,27 @@ INA_API(ina_rc_t) iarray_expr_new(iarray_context_t *ctx, iarray_data_type_t data
     (*e)->ctx = ctx;
     (*e)->ctx->expr_vars = NULL;
     (*e)->expr = NULL;
+    (*e)->jug_expr_func = 0;
+    (*e)->out_dtshape = NULL;
+    (*e)->out_store_properties = NULL;
     (*e)->nvars = 0;
     (*e)->max_out_len = 0;   // helper for leftovers
     (*e)->nuser_params = 0;
+    (*e)->nbound_vars = 0;
+    (*e)->nsubexprs = 0;
+    (*e)->index_vars = false;
+    ina_mem_set(&(*e)->bcast_data, 0, sizeof(uint8_t *) * IARRAY_EXPR_OPERANDS_MAX);
+    ina_mem_set(&(*e)->bcast_strides, 0, sizeof(int32_t *) * IARRAY_EXPR_OPERANDS_MAX);
+    (*e)->out = NULL;
+    (*e)->nouts = 1;
+    ina_mem_set(&(*e)->outs, 0, sizeof(iarray_container_t *) * IARRAY_EXPR_OUTPUTS_MAX);
     ina_mem_set(&(*e)->vars, 0, sizeof(_iarray_jug_var_t) * IARRAY_EXPR_OPERANDS_MAX);
     // map dtype to JUG type
     jug_expression_dtype_t dtype;
     switch (data_type) {
         case IARRAY_DATA_TYPE_BOOL:
-            // how to support?
-            dtype = JUG_EXPRESSION_DTYPE_SINT8;// is that accurate?
+            // stored as 0/1 bytes
+            dtype = JUG_EXPRESSION_DTYPE_BOOL;
             break;
         case IARRAY_DATA_TYPE_DOUBLE:
             dtype = JUG_EXPRESSION_DTYPE_DOUBLE;
@@ -99,6 +183,18 @@ INA_API(ina_rc_t) iarray_expr_new(iarray_context_t *ctx, iarray_data_type_t data
         case IARRAY_DATA_TYPE_INT64:
             dtype = JUG_EXPRESSION_DTYPE_SINT64;
             break;
+        case IARRAY_DATA_TYPE_UINT8:
+            dtype = JUG_EXPRESSION_DTYPE_UINT8;
+            break;
+        case IARRAY_DATA_TYPE_UINT16:
+            dtype = JUG_EXPRESSION_DTYPE_UINT16;
+            break;
+        case IARRAY_DATA_TYPE_UINT32:
+            dtype = JUG_EXPRESSION_DTYPE_UINT32;
+            break;
+        case IARRAY_DATA_TYPE_UINT64:
+            dtype = JUG_EXPRESSION_DTYPE_UINT64;
+            break;
         default:
             return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
     }
@@ -115,20 +211,110 @@ INA_API(void) iarray_expr_free(iarray_context_t *ctx, iarray_expression_t **e)
     for (int nvar=0; nvar < (*e)->nvars; nvar++) {
         free((void*)((*e)->vars[nvar].var));
     }
+    for (int nsubexpr = 0; nsubexpr < (*e)->nsubexprs; nsubexpr++) {
+        free((void*)((*e)->subexprs[nsubexpr].var));
+    }
     INA_MEM_FREE(ctx->expr_vars);
     ina_str_free((*e)->expr);
+    if ((*e)->out_store_properties != NULL) {
+        free((*e)->out_store_properties->urlpath);
+    }
+    INA_MEM_FREE_SAFE((*e)->out_store_properties);
+    INA_MEM_FREE_SAFE((*e)->out_dtshape);
     INA_MEM_FREE_SAFE(*e);
 }
 
+// Forget the operands pulled in from sub-expressions by a previous compilation
+static void _iarray_expr_drop_subexpr_vars(iarray_expression_t *e)
+{
+    for (int nvar = e->nbound_vars; nvar < e->nvars; nvar++) {
+        free((void*)(e->vars[nvar].var));
+        e->vars[nvar].var = NULL;
+        e->vars[nvar].c = NULL;
+        e->vars[nvar].stencil = false;
+    }
+    e->nvars = e->nbound_vars;
+}
+
+// The kernel of a compiled expression depends on the dtype and the shape of its operands and output
+static bool _iarray_expr_same_dtshape(const iarray_dtshape_t *a, const iarray_dtshape_t *b)
+{
+    if (a->dtype != b->dtype || a->ndim != b->ndim) {
+        return false;
+    }
+    for (int i = 0; i < a->ndim; ++i) {
+        if (a->shape[i] != b->shape[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
 INA_API(ina_rc_t) iarray_expr_bind(iarray_expression_t *e, const char *var, iarray_container_t *val)
 {
     INA_VERIFY_NOT_NULL(e);
     INA_VERIFY_NOT_NULL(var);
     INA_VERIFY_NOT_NULL(val);
 
+    // Binding a name again replaces its operand, and a compiled expression keeps its kernel
+    for (int nvar = 0; nvar < e->nbound_vars; nvar++) {
+        if (strcmp(e->vars[nvar].var, var) != 0) {
+            continue;
+        }
+        iarray_container_t *old = e->vars[nvar].c;
+        if (e->jug_expr_func != 0) {
+            if (!_iarray_expr_same_dtshape(val->dtshape, old->dtshape)) {
+                IARRAY_TRACE1(iarray.error, "The operands of a compiled expression can only be replaced by "
+                                            "others with the same dtype and shape");
+                return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+            }
+            bool stencil = false;
+            for (int ntap = e->nbound_vars; ntap < e->nvars; ntap++) {
+                stencil = stencil || (e->vars[ntap].stencil && e->vars[ntap].c == old);
+            }
+            bool readable = true;
+            if (stencil) {
+                IARRAY_RETURN_IF_FAILED(_iarray_expr_block_readable(e, val, &readable));
+            }
+            if (!readable) {
+                IARRAY_TRACE1(iarray.error, "Stencil operands must be plain containers with the shape of the output");
+                return INA_ERROR(INA_ERR_NOT_SUPPORTED);
+            }
+        }
+        e->vars[nvar].c = val;
+        for (int ntap = e->nbound_vars; ntap < e->nvars; ntap++) {
+            if (e->vars[ntap].stencil && e->vars[ntap].c == old) {
+                e->vars[ntap].c = val;
+            }
+        }
+        return INA_SUCCESS;
+    }
+
+    _iarray_expr_drop_subexpr_vars(e);
+    if (e->nvars >= IARRAY_EXPR_OPERANDS_MAX) {
+        return INA_ERROR(INA_ERR_FULL);
+    }
     e->vars[e->nvars].var = strdup(var);   // yes, we want a copy here!
     e->vars[e->nvars].c = val;
+    e->vars[e->nvars].stencil = false;
     e->nvars++;
+    e->nbound_vars = e->nvars;
+    return INA_SUCCESS;
+}
+
+INA_API(ina_rc_t) iarray_expr_bind_expr(iarray_expression_t *e, const char *var, iarray_expression_t *sub)
+{
+    INA_VERIFY_NOT_NULL(e);
+    INA_VERIFY_NOT_NULL(var);
+    INA_VERIFY_NOT_NULL(sub);
+
+    if (e->nsubexprs >= IARRAY_EXPR_OPERANDS_MAX) {
+        return INA_ERROR(INA_ERR_FULL);
+    }
+    e->subexprs[e->nsubexprs].var = strdup(var);
+    e->subexprs[e->nsubexprs].e = sub;
+    e->nsubexprs++;
     return INA_SUCCESS;
 }
 
@@ -148,6 +334,20 @@ INA_API(ina_rc_t) iarray_expr_bind_param(iarray_expression_t *e, iarray_user_par
 
 INA_API(ina_rc_t) iarray_expr_bind_out_properties(iarray_expression_t *e, iarray_dtshape_t *dtshape, iarray_storage_t *store)
 {
+    INA_VERIFY_NOT_NULL(e);
+    INA_VERIFY_NOT_NULL(dtshape);
+    INA_VERIFY_NOT_NULL(store);
+
+    if (e->out_dtshape != NULL) {
+        // Only the storage can change once the expression is compiled
+        if (e->jug_expr_func != 0 && !_iarray_expr_same_dtshape(dtshape, e->out_dtshape)) {
+            IARRAY_TRACE1(iarray.error, "The output of a compiled expression must keep its dtype and shape");
+            return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+        }
+        free(e->out_store_properties->urlpath);
+        INA_MEM_FREE_SAFE(e->out_store_properties);
+        INA_MEM_FREE_SAFE(e->out_dtshape);
+    }
     e->out_dtshape = ina_mem_alloc(sizeof(iarray_dtshape_t));
     ina_mem_cpy(e->out_dtshape, dtshape, sizeof(iarray_dtshape_t));
 
@@ -163,11 +363,11 @@ INA_API(ina_rc_t) iarray_expr_bind_out_properties(iarray_expression_t *e, iarray
 
 
 int caterva_blosc_array_repart_chunk(int8_t *rchunk, int64_t rchunksize, void *chunk,
-                                     int64_t chunksize, caterva_array_t *array) {
-    if (rchunksize != array->extchunknitems * array->itemsize) {
+                                     int64_t chunksize, int32_t itemsize, caterva_array_t *array) {
+    if (rchunksize != array->extchunknitems * itemsize) {
         CATERVA_ERROR(CATERVA_ERR_INVALID_ARGUMENT);
     }
-    if (chunksize != array->chunknitems * array->itemsize) {
+    if (chunksize != array->chunknitems * itemsize) {
         CATERVA_ERROR(CATERVA_ERR_INVALID_ARGUMENT);
     }
 
@@ -207,7 +407,7 @@ int caterva_blosc_array_repart_chunk(int8_t *rchunk, int64_t rchunksize, void *c
                 actual_spsize[i] = d_spshape[i];
             }
         }
-        int32_t seq_copylen = (int32_t) (actual_spsize[7] * array->itemsize);
+        int32_t seq_copylen = (int32_t) (actual_spsize[7] * itemsize);
         /* Reorder each line of data from src_b to chunk */
         int64_t ii[CATERVA_MAX_DIM];
         int64_t ncopies = 1;
@@ -231,7 +431,7 @@ int caterva_blosc_array_repart_chunk(int8_t *rchunk, int64_t rchunksize, void *c
                 s_a *= d_pshape[i];
             }
 
-            memcpy(rchunk + d_coord_f * array->itemsize, src_b + s_coord_f * array->itemsize,
+            memcpy(rchunk + d_coord_f * itemsize, src_b + s_coord_f * itemsize,
                    seq_copylen);
         }
     }
@@ -296,6 +496,11 @@ INA_API(ina_rc_t) iarray_expr_compile_udf(
     INA_VERIFY_NOT_NULL(e);
     INA_VERIFY_NOT_NULL(llvm_bc);
 
+    if (e->nsubexprs > 0) {
+        IARRAY_TRACE1(iarray.error, "Sub-expressions cannot be bound to UDFs");
+        return INA_ERROR(INA_ERR_NOT_SUPPORTED);
+    }
+
     IARRAY_RETURN_IF_FAILED(_iarray_expr_prepare(e));
 
     IARRAY_RETURN_IF_FAILED(
@@ -305,292 +510,2038 @@ INA_API(ina_rc_t) iarray_expr_compile_udf(
     return INA_SUCCESS;
 }
 
-INA_API(ina_rc_t) iarray_expr_compile(iarray_expression_t *e, const char *expr)
+static ina_rc_t _iarray_expr_input_dtype(iarray_data_type_t data_type, jug_expression_dtype_t *dtype)
 {
-    INA_VERIFY_NOT_NULL(e);
-    INA_VERIFY_NOT_NULL(expr);
-
-    e->expr = ina_str_new_fromcstr(expr);
-
-    IARRAY_RETURN_IF_FAILED(_iarray_expr_prepare(e));
-
-    jug_te_variable *jug_vars = ina_mem_alloc(e->nvars * sizeof(jug_te_variable));
-    memset(jug_vars, 0, e->nvars * sizeof(jug_te_variable));
-    for (int nvar = 0; nvar < e->nvars; nvar++) {
-        jug_vars[nvar].name = e->vars[nvar].var;
+    switch (data_type) {
+        case IARRAY_DATA_TYPE_DOUBLE:
+            *dtype = JUG_EXPRESSION_DTYPE_DOUBLE;
+            break;
+        case IARRAY_DATA_TYPE_FLOAT:
+            *dtype = JUG_EXPRESSION_DTYPE_FLOAT;
+            break;
+        case IARRAY_DATA_TYPE_INT64:
+            *dtype = JUG_EXPRESSION_DTYPE_SINT64;
+            break;
+        case IARRAY_DATA_TYPE_INT32:
+            *dtype = JUG_EXPRESSION_DTYPE_SINT32;
+            break;
+        case IARRAY_DATA_TYPE_INT16:
+            *dtype = JUG_EXPRESSION_DTYPE_SINT16;
+            break;
+        case IARRAY_DATA_TYPE_INT8:
+            *dtype = JUG_EXPRESSION_DTYPE_SINT8;
+            break;
+        case IARRAY_DATA_TYPE_UINT64:
+            *dtype = JUG_EXPRESSION_DTYPE_UINT64;
+            break;
+        case IARRAY_DATA_TYPE_UINT32:
+            *dtype = JUG_EXPRESSION_DTYPE_UINT32;
+            break;
+        case IARRAY_DATA_TYPE_UINT16:
+            *dtype = JUG_EXPRESSION_DTYPE_UINT16;
+            break;
+        case IARRAY_DATA_TYPE_UINT8:
+            *dtype = JUG_EXPRESSION_DTYPE_UINT8;
+            break;
+        case IARRAY_DATA_TYPE_BOOL:
+            *dtype = JUG_EXPRESSION_DTYPE_BOOL;
+            break;
+        default:
+            IARRAY_TRACE1(iarray.error, "The data type of an operand is not supported in expressions");
+            return INA_ERROR(IARRAY_ERR_INVALID_DTYPE);
     }
-
-    IARRAY_RETURN_IF_FAILED(jug_expression_compile(e->jug_expr, ina_str_cstr(e->expr), e->nvars,
-                                                   jug_vars, &e->jug_expr_func));
-
     return INA_SUCCESS;
 }
 
-int prefilter_func(blosc2_prefilter_params *pparams)
+// Whether an operand has to be broadcast to the output shape (NumPy rules)
+static ina_rc_t _iarray_expr_broadcast(iarray_expression_t *e, iarray_container_t *var, bool *broadcast)
 {
-    iarray_expr_pparams_t *expr_pparams = (iarray_expr_pparams_t*)pparams->user_data;
-    struct iarray_expression_s *e = expr_pparams->e;
-    int ninputs = expr_pparams->ninputs;
-    // Populate the eval_pparams
-    iarray_eval_pparams_t eval_pparams = {0};
-    eval_pparams.ninputs = ninputs;
-    memcpy(eval_pparams.input_typesizes, expr_pparams->input_typesizes, ninputs * sizeof(int32_t));
-    eval_pparams.user_data = expr_pparams;
-    eval_pparams.out = pparams->out;
-    eval_pparams.out_size = pparams->out_size;
-    eval_pparams.out_typesize = pparams->out_typesize;
-    eval_pparams.ndim = expr_pparams->e->out_dtshape->ndim;
-    int32_t blocksize = pparams->out_size;
-    int32_t typesize = pparams->out_typesize;
-
-    int8_t ndim = e->out->dtshape->ndim;
-
-    // Element strides (in elements)
-    int32_t strides[IARRAY_DIMENSION_MAX];
-    strides[ndim - 1] = 1;
-    for (int i = ndim - 2; i >= 0 ; --i) {
-        strides[i] = strides[i+1] * e->out->catarr->blockshape[i+1];
-    }
-
-    // Block strides (in blocks)
-    int32_t strides_block[IARRAY_DIMENSION_MAX];
-    strides_block[ndim - 1] = 1;
-    for (int i = ndim - 2; i >= 0 ; --i) {
-        strides_block[i] = strides_block[i+1] * (int32_t) (e->out->catarr->extchunkshape[i+1] / e->out->catarr->blockshape[i+1]);
+    iarray_dtshape_t *out_dtshape = e->out_dtshape;
+    int8_t offset = (int8_t) (out_dtshape->ndim - var->dtshape->ndim);
+    if (offset < 0) {
+        IARRAY_TRACE1(iarray.error, "An operand has more dimensions than the expression");
+        return INA_ERROR(IARRAY_ERR_INVALID_NDIM);
     }
-
-    // Flattened block number
-    int32_t nblock = pparams->out_offset / pparams->out_size;
-
-    // Multidimensional block number
-    int32_t nblock_ndim[IARRAY_DIMENSION_MAX];
-    for (int i = ndim - 1; i >= 0; --i) {
-        if (i != 0) {
-            nblock_ndim[i] = (nblock % strides_block[i-1]) / strides_block[i];
-        } else {
-            nblock_ndim[i] = (nblock % ((int32_t)e->out->catarr->extchunknitems / e->out->catarr->blocknitems)) / strides_block[i];
+    *broadcast = offset > 0;
+    for (int i = 0; i < var->dtshape->ndim; ++i) {
+        int64_t out_dim = out_dtshape->shape[offset + i];
+        if (var->dtshape->shape[i] == out_dim) {
+            continue;
         }
+        if (var->dtshape->shape[i] != 1) {
+            IARRAY_TRACE1(iarray.error, "An operand cannot be broadcast to the shape of the expression");
+            return INA_ERROR(IARRAY_ERR_INVALID_SHAPE);
+        }
+        *broadcast = true;
     }
+    return INA_SUCCESS;
+}
 
-    // Position of the first element of the block (inside current chunk)
-    int64_t start_in_chunk[IARRAY_DIMENSION_MAX];
-    for (int i = 0; i < ndim; ++i) {
-        start_in_chunk[i] = nblock_ndim[i] * e->out->catarr->blockshape[i];
-    }
-
-    // Position of the first element of the block (inside container)
-    int64_t start_in_container[IARRAY_DIMENSION_MAX];
-    for (int i = 0; i < ndim; ++i) {
-        start_in_container[i] = start_in_chunk[i] + expr_pparams->out_value.block_index[i] * e->out->catarr->chunkshape[i];
-    }
+/*
+ * Broadcast operands are decompressed once per evaluation into a buffer that spans every block
+ * of the output (padding included) along the dimensions they are not broadcast in, so the kernel
+ * can read any window through strides that are 0 along the broadcast dimensions.
+ */
+ina_rc_t _iarray_expr_bcast_prepare(iarray_expression_t *e)
+{
+    caterva_array_t *catarr = e->out->catarr;
+    int8_t ndim = e->out->dtshape->ndim;
+    ina_rc_t rc;
+    uint8_t *var_buffer = NULL;
 
-    // Check if the block is out of bounds
-    bool out_of_bounds = false;
-    for (int i = 0; i < ndim; ++i) {
-        if (start_in_container[i] > e->out->catarr->shape[i]) {
-            out_of_bounds = true;
-            break;
+    for (int nvar = 0; nvar < e->nvars; nvar++) {
+        iarray_container_t *var = e->vars[nvar].c;
+        bool broadcast;
+        rc = _iarray_expr_broadcast(e, var, &broadcast);
+        INA_FAIL_IF_ERROR(rc);
+        if (!broadcast) {
+            continue;
         }
-    }
+        int64_t itemsize = var->catarr->itemsize;
+        int8_t offset = (int8_t) (ndim - var->dtshape->ndim);
+
+        // The padded shape; broadcast dimensions have a single element
+        int64_t pshape[IARRAY_DIMENSION_MAX];
+        bool bcast_dim[IARRAY_DIMENSION_MAX];
+        for (int i = 0; i < ndim; ++i) {
+            bcast_dim[i] = i < offset || (var->dtshape->shape[i - offset] == 1 && catarr->shape[i] != 1);
+            int64_t nchunks = catarr->extshape[i] / catarr->chunkshape[i];
+            pshape[i] = bcast_dim[i] ? 1 : (nchunks - 1) * catarr->chunkshape[i] + catarr->extchunkshape[i];
+        }
+        e->bcast_strides[nvar] = ina_mem_alloc(sizeof(int32_t) * IARRAY_DIMENSION_MAX);
+        int64_t psize = 1;
+        for (int i = ndim - 1; i >= 0; --i) {
+            e->bcast_strides[nvar][i] = bcast_dim[i] ? 0 : (int32_t) psize;
+            psize *= pshape[i];
+        }
+        e->bcast_data[nvar] = ina_mem_alloc_aligned(64, psize * itemsize);
+        ina_mem_set(e->bcast_data[nvar], 0, psize * itemsize);
 
-    // Shape of the current block
-    int32_t shape[IARRAY_DIMENSION_MAX];
-    for (int i = 0; i < ndim; ++i) {
-        if (out_of_bounds) {
-            shape[i] = 0;
-        } else if (start_in_container[i] + e->out->catarr->blockshape[i] > e->out->catarr->shape[i]) {
-            shape[i] = (int32_t) (e->out->catarr->shape[i] - start_in_container[i]);
-        } else if (start_in_chunk[i] + e->out->catarr->blockshape[i] > e->out->catarr->chunkshape[i]) {
-            shape[i] = (int32_t) (e->out->catarr->chunkshape[i] - start_in_chunk[i]);
-        } else {
-            shape[i] = e->out->catarr->blockshape[i];
+        int64_t var_size = itemsize;
+        for (int i = 0; i < var->dtshape->ndim; ++i) {
+            var_size *= var->dtshape->shape[i];
+        }
+        var_buffer = ina_mem_alloc(var_size);
+        rc = iarray_to_buffer(e->ctx, var, var_buffer, var_size);
+        INA_FAIL_IF_ERROR(rc);
+
+        // Copy the operand row by row into its place in the padded buffer
+        int64_t rowlen = var->dtshape->ndim > 0 ? var->dtshape->shape[var->dtshape->ndim - 1] : 1;
+        int64_t nrows = var_size / itemsize / rowlen;
+        int64_t rows_shape[IARRAY_DIMENSION_MAX];
+        for (int i = 0; i < var->dtshape->ndim - 1; ++i) {
+            rows_shape[i] = var->dtshape->shape[i];
         }
+        for (int64_t nrow = 0; nrow < nrows; ++nrow) {
+            int64_t row_index[IARRAY_DIMENSION_MAX];
+            iarray_index_unidim_to_multidim_shape((int8_t) (var->dtshape->ndim - 1), rows_shape, nrow, row_index);
+            int64_t poffset = 0;
+            for (int i = 0; i < var->dtshape->ndim - 1; ++i) {
+                poffset += row_index[i] * e->bcast_strides[nvar][offset + i];
+            }
+            ina_mem_cpy(e->bcast_data[nvar] + poffset * itemsize, var_buffer + nrow * rowlen * itemsize,
+                        rowlen * itemsize);
+        }
+        INA_MEM_FREE_SAFE(var_buffer);
     }
 
-    // We can only set the visible shape of the output for the ITERBLOSC eval method.
-    eval_pparams.window_shape = shape;
-    eval_pparams.window_start = start_in_container;
-    eval_pparams.window_strides = strides;
+    return INA_SUCCESS;
 
-    // The code below only works for the case where inputs and output have the same typesize.
-    // More love is needed in the future, where we would want to allow mixed types in expressions.
+fail:
+    INA_MEM_FREE_SAFE(var_buffer);
+    _iarray_expr_bcast_free(e);
+    return rc;
+}
 
-    bool inputs_malloced[IARRAY_DIMENSION_MAX];
-    for (int i = 0; i < ninputs; i++) {
-        inputs_malloced[i] = false;
-        switch (expr_pparams->input_class[i]) {
-            case IARRAY_EXPR_EQ_NCOMP:
-                eval_pparams.inputs[i] = expr_pparams->inputs[i] + BLOSC_EXTENDED_HEADER_LENGTH + pparams->out_offset;
-                break;
-            case IARRAY_EXPR_EQ:
-                eval_pparams.inputs[i] = ina_mem_alloc_aligned(64, blocksize);
-                inputs_malloced[i] = true;
-                int64_t nitems = blocksize / typesize;
-                int64_t offset_index = pparams->out_offset / typesize;
-                blosc2_dparams dparams = {.nthreads = 1,
-                                          .schunk = e->vars[i].c->catarr->sc,
-                                          .postfilter = e->vars[i].c->catarr->sc->dctx->postfilter,
-                                          .postparams = e->vars[i].c->catarr->sc->dctx->postparams,
-                };
-                blosc2_context *dctx = blosc2_create_dctx(dparams);
-                int64_t rbytes = blosc2_getitem_ctx(dctx, expr_pparams->inputs[i], expr_pparams->input_csizes[i],
-                                                    (int) offset_index, (int) nitems,
-                                                    eval_pparams.inputs[i], blocksize);
-                blosc2_free_ctx(dctx);
-                if (rbytes != blocksize) {
-                    fprintf(stderr, "Read from inputs failed inside pipeline\n");
-                    return -1;
-                }
-                break;
-            case IARRAY_EXPR_NEQ:
-                eval_pparams.inputs[i] = expr_pparams->inputs[i] + pparams->out_offset;
-                break;
-            default:
-                return -1;
-        }
+void _iarray_expr_bcast_free(iarray_expression_t *e)
+{
+    for (int nvar = 0; nvar < IARRAY_EXPR_OPERANDS_MAX; nvar++) {
+        INA_MEM_FREE_SAFE(e->bcast_data[nvar]);
+        INA_MEM_FREE_SAFE(e->bcast_strides[nvar]);
     }
+}
 
-    for (unsigned int i = 0; i < e->nuser_params; i++) {
-        eval_pparams.user_params[i] = e->user_params[i];
+// Where the window starting at `start` (in output coordinates) begins inside a broadcast operand
+static uint8_t *_iarray_expr_bcast_window(iarray_expression_t *e, int nvar, const int64_t *start)
+{
+    int64_t offset = 0;
+    for (int i = 0; i < e->out_dtshape->ndim; ++i) {
+        offset += start[i] * e->bcast_strides[nvar][i];
     }
+    return e->bcast_data[nvar] + offset * e->vars[nvar].c->catarr->itemsize;
+}
 
-    // Eval the expression for this chunk
-    int ret;
+// The nodes of the kernel: the bound sub-expressions (in dependency order) followed by the outputs
+typedef struct _iarray_expr_graph_s {
+    int nnodes;
+    jug_expression_node_t nodes[IARRAY_EXPR_OPERANDS_MAX + IARRAY_EXPR_OUTPUTS_MAX];
+    iarray_expression_t *subexprs[IARRAY_EXPR_OPERANDS_MAX];
+} _iarray_expr_graph_t;
 
-    ret = ((iarray_eval_fn) e->jug_expr_func)(&eval_pparams);
-    switch (ret) {
-        case 0:
-            // 0 means success
-            break;
-        case 1:
-            IARRAY_TRACE1(iarray.error, "Out of bounds in LLVM eval engine");
-            return -2;
-        default:
-            IARRAY_TRACE1(iarray.error, "Error in executing LLVM eval engine");
-            return -3;
+static void _iarray_expr_graph_free(_iarray_expr_graph_t *graph)
+{
+    for (int j = 0; j < graph->nnodes; ++j) {
+        INA_MEM_FREE_SAFE(graph->nodes[j].var_names);
+        INA_MEM_FREE_SAFE(graph->nodes[j].var_refs);
     }
+    graph->nnodes = 0;
+}
 
-    for (int i = 0; i < ninputs; i++) {
-        if (inputs_malloced[i]) {
-            INA_MEM_FREE_SAFE(eval_pparams.inputs[i]);
+// The kernel input for a container used by a sub-expression; operands shared with other
+// expressions of the graph are read only once
+static ina_rc_t _iarray_expr_graph_input(iarray_expression_t *e, const char *var, iarray_container_t *c, int *index)
+{
+    for (int nvar = 0; nvar < e->nvars; nvar++) {
+        if (e->vars[nvar].c == c && !e->vars[nvar].stencil) {
+            *index = nvar;
+            return INA_SUCCESS;
         }
     }
-
-    return 0;
+    if (e->nvars >= IARRAY_EXPR_OPERANDS_MAX) {
+        IARRAY_TRACE1(iarray.error, "Too many operands in the expression and its sub-expressions");
+        return INA_ERROR(INA_ERR_FULL);
+    }
+    e->vars[e->nvars].var = strdup(var);
+    e->vars[e->nvars].c = c;
+    e->vars[e->nvars].stencil = false;
+    *index = e->nvars;
+    e->nvars++;
+    return INA_SUCCESS;
 }
 
+static ina_rc_t _iarray_expr_graph_add(iarray_expression_t *e, iarray_expression_t *sub,
+                                       _iarray_expr_graph_t *graph, int depth, int *node_index);
 
-ina_rc_t iarray_eval_cleanup(iarray_expression_t *e, int64_t nitems_written)
+// Map the variables seen by the expression `scope` to kernel inputs and graph nodes
+static ina_rc_t _iarray_expr_graph_scope(iarray_expression_t *e, iarray_expression_t *scope,
+                                         _iarray_expr_graph_t *graph, int depth, jug_expression_node_t *node)
 {
-    int64_t nitems_in_schunk = e->nbytes / e->typesize;
-    if (nitems_written != nitems_in_schunk) {
-        IARRAY_TRACE1(iarray.error, "The number of items written is different from items in final container");
-        return INA_ERROR(INA_ERR_NOT_COMPLETE);
+    ina_rc_t rc;
+    int num_vars = scope->nbound_vars + scope->nsubexprs;
+    node->num_vars = num_vars;
+    node->var_names = ina_mem_alloc(sizeof(char *) * (num_vars + 1));
+    node->var_refs = ina_mem_alloc(sizeof(int) * (num_vars + 1));
+
+    for (int nvar = 0; nvar < scope->nbound_vars; nvar++) {
+        node->var_names[nvar] = scope->vars[nvar].var;
+        if (scope == e) {
+            // The operands of the expression itself come first, in binding order
+            node->var_refs[nvar] = nvar;
+        } else {
+            rc = _iarray_expr_graph_input(e, scope->vars[nvar].var, scope->vars[nvar].c, &node->var_refs[nvar]);
+            INA_FAIL_IF_ERROR(rc);
+        }
+    }
+    for (int nsubexpr = 0; nsubexpr < scope->nsubexprs; nsubexpr++) {
+        int subexpr_node;
+        rc = _iarray_expr_graph_add(e, scope->subexprs[nsubexpr].e, graph, depth + 1, &subexpr_node);
+        INA_FAIL_IF_ERROR(rc);
+        node->var_names[scope->nbound_vars + nsubexpr] = scope->subexprs[nsubexpr].var;
+        node->var_refs[scope->nbound_vars + nsubexpr] = -subexpr_node - 1;
     }
 
     return INA_SUCCESS;
+
+fail:
+    INA_MEM_FREE_SAFE(node->var_names);
+    INA_MEM_FREE_SAFE(node->var_refs);
+    return rc;
 }
 
-INA_API(ina_rc_t) iarray_eval_iterchunk(iarray_expression_t *e, iarray_container_t *ret, int64_t *out_chunkshape)
+static ina_rc_t _iarray_expr_graph_add(iarray_expression_t *e, iarray_expression_t *sub,
+                                       _iarray_expr_graph_t *graph, int depth, int *node_index)
 {
-    int nvars = e->nvars;
-    int64_t nitems_written = 0;
-
-
-    // Create and initialize an iterator per variable
-    iarray_config_t cfg = IARRAY_CONFIG_DEFAULTS;
-    iarray_context_t *ctx = NULL;
-    iarray_context_new(&cfg, &ctx);
-    iarray_iter_read_block_t **iter_var = ina_mem_alloc(nvars * sizeof(iarray_iter_read_block_t));
-    iarray_iter_read_block_value_t *iter_value = ina_mem_alloc(nvars * sizeof(iarray_iter_read_block_value_t));
-
-    for (int nvar = 0; nvar < nvars; nvar++) {
-        iarray_container_t *var = e->vars[nvar].c;
-        IARRAY_RETURN_IF_FAILED(iarray_iter_read_block_new(ctx, &iter_var[nvar], var, out_chunkshape, &iter_value[nvar],
-                                                           false));
+    // A sub-expression used several times is computed once per element
+    for (int j = 0; j < graph->nnodes; ++j) {
+        if (graph->subexprs[j] == sub) {
+            *node_index = j;
+            return INA_SUCCESS;
+        }
     }
-
-    // Write iterator for output
-    iarray_iter_write_block_t *iter_out;
-    iarray_iter_write_block_value_t out_value;
-    IARRAY_RETURN_IF_FAILED(iarray_iter_write_block_new(ctx, &iter_out, ret, out_chunkshape, &out_value, false));
-
-    // Create expr pparams
-    iarray_expr_pparams_t expr_pparams = {0};
-    expr_pparams.e = e;
-    expr_pparams.ninputs = nvars;
-
-    // Create eval pparams
-    iarray_eval_pparams_t eval_pparams = {0};
-    eval_pparams.ninputs = nvars;
-    eval_pparams.out_typesize = (int32_t) e->out->catarr->itemsize;
-    eval_pparams.ndim = e->out->dtshape->ndim;
-    eval_pparams.user_data = &expr_pparams;
-    for (int i = 0; i < nvars; ++i) {
-        eval_pparams.input_typesizes[i] = (int32_t) e->vars[i].c->catarr->itemsize;
-        expr_pparams.input_typesizes[i] = (int32_t) e->vars[i].c->catarr->itemsize;
-        expr_pparams.input_class[i] = IARRAY_EXPR_NEQ;
+    if (depth > IARRAY_EXPR_OPERANDS_MAX) {
+        IARRAY_TRACE1(iarray.error, "Sub-expressions are nested too deeply (or they form a cycle)");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    if (sub->expr == NULL || sub->nouts != 1 || sub->out_dtshape == NULL) {
+        IARRAY_TRACE1(iarray.error, "A bound sub-expression must be a compiled single-output expression");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    if (strchr(ina_str_cstr(sub->expr), '[') != NULL) {
+        IARRAY_TRACE1(iarray.error, "Sub-expressions with stencils cannot be inlined");
+        return INA_ERROR(INA_ERR_NOT_SUPPORTED);
+    }
+    // Only elementwise results can be inlined; anything changing the shape has to be evaluated first
+    if (sub->out_dtshape->dtype != e->out_dtshape->dtype || sub->out_dtshape->ndim != e->out_dtshape->ndim) {
+        IARRAY_TRACE1(iarray.error, "A bound sub-expression must have the dtype and shape of the expression");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    for (int i = 0; i < e->out_dtshape->ndim; ++i) {
+        if (sub->out_dtshape->shape[i] != e->out_dtshape->shape[i]) {
+            IARRAY_TRACE1(iarray.error, "A bound sub-expression must have the dtype and shape of the expression");
+            return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+        }
     }
 
-    // Evaluate the expression for all the chunks in variables
-    while (INA_SUCCEED(iarray_iter_write_block_has_next(iter_out))) {
-        IARRAY_RETURN_IF_FAILED(iarray_iter_write_block_next(iter_out, NULL, 0));
-
-        int32_t out_items = (int32_t)(iter_out->cur_block_size);
+    jug_expression_node_t node = {0};
+    node.expr = ina_str_cstr(sub->expr);
+    IARRAY_RETURN_IF_FAILED(_iarray_expr_graph_scope(e, sub, graph, depth, &node));
+    if (graph->nnodes >= IARRAY_EXPR_OPERANDS_MAX) {
+        INA_MEM_FREE_SAFE(node.var_names);
+        INA_MEM_FREE_SAFE(node.var_refs);
+        IARRAY_TRACE1(iarray.error, "Too many sub-expressions");
+        return INA_ERROR(INA_ERR_FULL);
+    }
+    e->index_vars = e->index_vars || sub->index_vars;
+    graph->subexprs[graph->nnodes] = sub;
+    graph->nodes[graph->nnodes] = node;
+    *node_index = graph->nnodes;
+    graph->nnodes++;
+    return INA_SUCCESS;
+}
 
-        // Decompress chunks in variables into temporaries
-        for (int nvar = 0; nvar < nvars; nvar++) {
-            IARRAY_RETURN_IF_FAILED(iarray_iter_read_block_next(iter_var[nvar], NULL, 0));
+#define IARRAY_EXPR_IDENT_CHAR(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= '0' && (c) <= '9') || (c) == '_' || (c) == '.')
 
-            eval_pparams.inputs[nvar] = iter_value[nvar].block_pointer;
-            expr_pparams.inputs[nvar] = iter_value[nvar].block_pointer;
-        }
+// Resolve the names of an expression that depend on the position of the elements.  Stencil references
+// (e.g. `a[-1,0]`) are replaced with kernel inputs of their own, which read the operand at an offset
+// from the output element and are added to `node`; the use of index variables is noted in `e`.
+static ina_rc_t _iarray_expr_position_scope(iarray_expression_t *e, const char *expr, ina_str_t *rewritten,
+                                            jug_expression_node_t *node)
+{
+    ina_rc_t rc;
+    int8_t ndim = e->out_dtshape->ndim;
+    ina_str_t out = ina_str_new_fromcstr("");
+    const char *copied = expr;  // start of the text not yet copied to `out`
+    const char *p = expr;
+    while (*p != '\0') {
+        if ((*p >= '0' && *p <= '9') || *p == '.') {
+            // Skip numbers, so that exponents are not taken for names
+            while ((*p >= '0' && *p <= '9') || *p == '.') {
+                p++;
+            }
+            if (*p == 'e' || *p == 'E') {
+                p++;
+                if (*p == '+' || *p == '-') {
+                    p++;
+                }
+                while (*p >= '0' && *p <= '9') {
+                    p++;
+                }
+            }
+            continue;
+        }
+        if (*p < 'a' || *p > 'z') {
+            p++;
+            continue;
+        }
+        const char *name = p;
+        while (IARRAY_EXPR_IDENT_CHAR(*p)) {
+            p++;
+        }
+        size_t name_len = p - name;
+        const char *q = p;
+        while (*q == ' ') {
+            q++;
+        }
+        if (*q != '[') {
+            int dim = jug_index_var(name, name_len);
+            bool bound = false;
+            for (int nvar = 0; nvar < e->nbound_vars; ++nvar) {
+                const char *var = e->vars[nvar].var;
+                bound = bound || (strlen(var) == name_len && strncmp(var, name, name_len) == 0);
+            }
+            for (int nsubexpr = 0; nsubexpr < e->nsubexprs; ++nsubexpr) {
+                const char *var = e->subexprs[nsubexpr].var;
+                bound = bound || (strlen(var) == name_len && strncmp(var, name, name_len) == 0);
+            }
+            if (dim >= 0 && dim < ndim && !bound) {
+                e->index_vars = true;
+            }
+            continue;
+        }
+
+        int nbound = -1;
+        for (int nvar = 0; nvar < e->nbound_vars; ++nvar) {
+            if (strlen(e->vars[nvar].var) == name_len && strncmp(e->vars[nvar].var, name, name_len) == 0) {
+                nbound = nvar;
+                break;
+            }
+        }
+        if (nbound < 0) {
+            IARRAY_TRACE1(iarray.error, "Only the operands of an expression can have stencil offsets");
+            rc = INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+            goto fail;
+        }
+        iarray_container_t *c = e->vars[nbound].c;
+        bool readable;
+        rc = _iarray_expr_block_readable(e, c, &readable);
+        INA_FAIL_IF_ERROR(rc);
+        if (!readable) {
+            IARRAY_TRACE1(iarray.error, "Stencil operands must be plain containers with the shape of the output");
+            rc = INA_ERROR(INA_ERR_NOT_SUPPORTED);
+            goto fail;
+        }
+
+        int32_t offset[IARRAY_DIMENSION_MAX] = {0};
+        int noffsets = 0;
+        bool centered = true;
+        q++;
+        while (true) {
+            char *end;
+            long value = strtol(q, &end, 10);
+            if (end == q || noffsets >= ndim || labs(value) >= c->dtshape->shape[noffsets]) {
+                IARRAY_TRACE1(iarray.error, "Invalid stencil offsets");
+                rc = INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+                goto fail;
+            }
+            offset[noffsets++] = (int32_t) value;
+            centered = centered && value == 0;
+            q = end;
+            while (*q == ' ') {
+                q++;
+            }
+            if (*q == ']') {
+                q++;
+                break;
+            }
+            if (*q != ',') {
+                IARRAY_TRACE1(iarray.error, "Invalid stencil offsets");
+                rc = INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+                goto fail;
+            }
+            q++;
+        }
+        if (noffsets != ndim) {
+            IARRAY_TRACE1(iarray.error, "A stencil needs an offset per dimension");
+            rc = INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+            goto fail;
+        }
+
+        int ntap = nbound;
+        if (!centered) {
+            // Every distinct offset is an input of the kernel; all of them share one halo per operand
+            ntap = -1;
+            for (int nvar = e->nbound_vars; nvar < e->nvars; ++nvar) {
+                if (e->vars[nvar].stencil && e->vars[nvar].c == c &&
+                    memcmp(e->vars[nvar].offset, offset, sizeof(offset)) == 0) {
+                    ntap = nvar;
+                    break;
+                }
+            }
+            if (ntap < 0) {
+                if (e->nvars >= IARRAY_EXPR_OPERANDS_MAX) {
+                    IARRAY_TRACE1(iarray.error, "Too many operands in the expression and its stencils");
+                    rc = INA_ERROR(INA_ERR_FULL);
+                    goto fail;
+                }
+                ina_str_t tap_name = ina_str_sprintf("%.*s__s%d", (int) name_len, name, e->nvars);
+                e->vars[e->nvars].var = strdup(ina_str_cstr(tap_name));
+                ina_str_free(tap_name);
+                e->vars[e->nvars].c = c;
+                e->vars[e->nvars].stencil = true;
+                memcpy(e->vars[e->nvars].offset, offset, sizeof(offset));
+                ntap = e->nvars;
+                e->nvars++;
+            }
+            bool seen = false;
+            for (int i = 0; i < node->num_vars; ++i) {
+                seen = seen || node->var_refs[i] == ntap;
+            }
+            if (!seen) {
+                const char **var_names = ina_mem_alloc(sizeof(char *) * (node->num_vars + 2));
+                int *var_refs = ina_mem_alloc(sizeof(int) * (node->num_vars + 2));
+                memcpy(var_names, node->var_names, sizeof(char *) * node->num_vars);
+                memcpy(var_refs, node->var_refs, sizeof(int) * node->num_vars);
+                var_names[node->num_vars] = e->vars[ntap].var;
+                var_refs[node->num_vars] = ntap;
+                INA_MEM_FREE_SAFE(node->var_names);
+                INA_MEM_FREE_SAFE(node->var_refs);
+                node->var_names = var_names;
+                node->var_refs = var_refs;
+                node->num_vars++;
+            }
+        }
+
+        ina_str_t text = ina_str_new_fromblk(copied, (size_t) (name - copied));
+        out = ina_str_catcstr(out, ina_str_cstr(text));
+        ina_str_free(text);
+        out = ina_str_catcstr(out, e->vars[ntap].var);
+        copied = q;
+        p = q;
+    }
+    out = ina_str_catcstr(out, copied);
+    *rewritten = out;
+    return INA_SUCCESS;
+
+fail:
+    ina_str_free(out);
+    return rc;
+}
+
+INA_API(ina_rc_t) iarray_expr_compile(iarray_expression_t *e, const char *expr)
+{
+    INA_VERIFY_NOT_NULL(e);
+    INA_VERIFY_NOT_NULL(expr);
+
+    return iarray_expr_compile_multi(e, 1, &expr);
+}
+
+INA_API(ina_rc_t) iarray_expr_compile_multi(iarray_expression_t *e, int nexprs, const char **exprs)
+{
+    INA_VERIFY_NOT_NULL(e);
+    INA_VERIFY_NOT_NULL(exprs);
+
+    if (nexprs < 1 || nexprs > IARRAY_EXPR_OUTPUTS_MAX) {
+        IARRAY_TRACE1(iarray.error, "The number of expressions must be between 1 and IARRAY_EXPR_OUTPUTS_MAX");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+
+    ina_str_free(e->expr);
+    e->expr = ina_str_new_fromcstr(exprs[0]);
+    for (int k = 1; k < nexprs; ++k) {
+        e->expr = ina_str_catcstr(e->expr, ";");
+        e->expr = ina_str_catcstr(e->expr, exprs[k]);
+    }
+    e->nouts = nexprs;
+
+    IARRAY_RETURN_IF_FAILED(_iarray_expr_prepare(e));
+
+    // Bound sub-expressions are inlined, so their operands become inputs of this kernel
+    ina_rc_t rc;
+    jug_te_variable *jug_vars = NULL;
+    ina_str_t stencil_exprs[IARRAY_EXPR_OUTPUTS_MAX] = {0};
+    _iarray_expr_graph_t *graph = ina_mem_alloc(sizeof(_iarray_expr_graph_t));
+    ina_mem_set(graph, 0, sizeof(_iarray_expr_graph_t));
+    _iarray_expr_drop_subexpr_vars(e);
+    e->index_vars = false;
+    for (int k = 0; k < nexprs; ++k) {
+        jug_expression_node_t node = {0};
+        rc = _iarray_expr_graph_scope(e, e, graph, 0, &node);
+        INA_FAIL_IF_ERROR(rc);
+        graph->nodes[graph->nnodes] = node;
+        graph->nnodes++;
+        rc = _iarray_expr_position_scope(e, exprs[k], &stencil_exprs[k], &graph->nodes[graph->nnodes - 1]);
+        INA_FAIL_IF_ERROR(rc);
+        graph->nodes[graph->nnodes - 1].expr = ina_str_cstr(stencil_exprs[k]);
+    }
+
+    jug_vars = ina_mem_alloc((e->nvars + 1) * sizeof(jug_te_variable));
+    memset(jug_vars, 0, (e->nvars + 1) * sizeof(jug_te_variable));
+    jug_expression_dtype_t input_dtypes[IARRAY_EXPR_OPERANDS_MAX];
+    for (int nvar = 0; nvar < e->nvars; nvar++) {
+        jug_vars[nvar].name = e->vars[nvar].var;
+        rc = _iarray_expr_input_dtype(e->vars[nvar].c->dtshape->dtype, &input_dtypes[nvar]);
+        INA_FAIL_IF_ERROR(rc);
+    }
+    // Inputs are cast to a common type inside the kernel
+    rc = jug_expression_set_input_dtypes(e->jug_expr, e->nvars, input_dtypes);
+    INA_FAIL_IF_ERROR(rc);
+    bool input_bcast[IARRAY_EXPR_OPERANDS_MAX];
+    for (int nvar = 0; nvar < e->nvars; nvar++) {
+        rc = _iarray_expr_broadcast(e, e->vars[nvar].c, &input_bcast[nvar]);
+        INA_FAIL_IF_ERROR(rc);
+        // Stencil inputs are read from a halo, which is laid out with its own strides
+        input_bcast[nvar] = input_bcast[nvar] || e->vars[nvar].stencil;
+    }
+    rc = jug_expression_set_input_broadcast(e->jug_expr, e->out_dtshape->ndim, e->nvars, input_bcast);
+    INA_FAIL_IF_ERROR(rc);
+    rc = jug_expression_set_isa(e->jug_expr, (jug_expression_isa_t) e->ctx->cfg->jit_isa);
+    INA_FAIL_IF_ERROR(rc);
+
+    rc = jug_expression_compile_graph(e->jug_expr, graph->nnodes, graph->nodes, nexprs, e->nvars,
+                                      jug_vars, &e->jug_expr_func);
+    INA_FAIL_IF_ERROR(rc);
+
+    rc = INA_SUCCESS;
+
+fail:
+    _iarray_expr_graph_free(graph);
+    INA_MEM_FREE_SAFE(graph);
+    INA_MEM_FREE_SAFE(jug_vars);
+    for (int k = 0; k < nexprs; ++k) {
+        ina_str_free(stencil_exprs[k]);
+    }
+    return rc;
+}
+
+INA_API(ina_rc_t) iarray_expr_cache_stats(int64_t *hits, int64_t *misses, int64_t *nentries)
+{
+    INA_VERIFY_NOT_NULL(hits);
+    INA_VERIFY_NOT_NULL(misses);
+    INA_VERIFY_NOT_NULL(nentries);
+    jug_expression_cache_stats(hits, misses, nentries);
+    return INA_SUCCESS;
+}
+
+INA_API(ina_rc_t) iarray_expr_cache_disk_hits(int64_t *disk_hits)
+{
+    INA_VERIFY_NOT_NULL(disk_hits);
+    *disk_hits = jug_expression_cache_disk_hits();
+    return INA_SUCCESS;
+}
+
+INA_API(void) iarray_expr_cache_clear(void)
+{
+    jug_expression_cache_clear();
+}
+
+INA_API(ina_rc_t) iarray_expr_cache_set_dir(const char *dirpath)
+{
+    IARRAY_RETURN_IF_FAILED(jug_expression_cache_set_dir(dirpath));
+    return INA_SUCCESS;
+}
+
+ina_rc_t _iarray_expr_block_compatible(iarray_expression_t *e, iarray_container_t *var,
+                                       iarray_storage_t *storage, bool *compatible)
+{
+    bool is_zproxy;
+    *compatible = true;
+    IARRAY_RETURN_IF_FAILED(iarray_vlmeta_exists(e->ctx, var, "zproxy_urlpath", &is_zproxy));
+    if (is_zproxy || var->transposed) {
+        // If it is a zproxy or transposed, iterblosc cannot be used
+        *compatible = false;
+        return INA_SUCCESS;
+    }
+    if (var->dtshape->ndim != e->out_dtshape->ndim) {
+        *compatible = false;
+        return INA_SUCCESS;
+    }
+    for (int i = 0; i < var->dtshape->ndim; ++i) {
+        if (var->dtshape->shape[i] != e->out_dtshape->shape[i]) {
+            // Broadcast operands
+            *compatible = false;
+            return INA_SUCCESS;
+        }
+    }
+    if (var->container_viewed != NULL) {
+        // If shape is not the same we cannot use iterblosc
+        // See https://github.com/inaos/iron-array/issues/581
+        for (int i = 0; i < var->container_viewed->dtshape->ndim; ++i) {
+            if (var->dtshape->shape[i] != var->container_viewed->dtshape->shape[i]) {
+                *compatible = false;
+                return INA_SUCCESS;
+            }
+        }
+    }
+    for (int i = 0; i < var->dtshape->ndim; ++i) {
+        if (storage->chunkshape[i] != var->storage->chunkshape[i] ||
+            storage->blockshape[i] != var->storage->blockshape[i]) {
+            *compatible = false;
+            return INA_SUCCESS;
+        }
+    }
+    return INA_SUCCESS;
+}
+
+// Whether the prefilter can read a non-compatible operand straight from the blocks of its chunks
+ina_rc_t _iarray_expr_block_readable(iarray_expression_t *e, iarray_container_t *var, bool *readable)
+{
+    bool is_zproxy;
+    IARRAY_RETURN_IF_FAILED(iarray_vlmeta_exists(e->ctx, var, "zproxy_urlpath", &is_zproxy));
+    *readable = !is_zproxy && !var->transposed && var->container_viewed == NULL &&
+                var->dtshape->ndim == e->out_dtshape->ndim;
+    for (int i = 0; *readable && i < var->dtshape->ndim; ++i) {
+        *readable = var->dtshape->shape[i] == e->out_dtshape->shape[i];
+    }
+    return INA_SUCCESS;
+}
+
+static void _iarray_expr_block_cache_init(iarray_expr_block_cache_t *cache, int32_t blocksize)
+{
+    for (int i = 0; i < IARRAY_EXPR_BLOCK_CACHE_SIZE; ++i) {
+        cache->nchunk[i] = -1;
+        cache->nblock[i] = -1;
+        cache->blocks[i] = ina_mem_alloc_aligned(64, blocksize);
+    }
+    cache->next = 0;
+}
+
+static void _iarray_expr_block_cache_free(iarray_expr_block_cache_t *cache)
+{
+    for (int i = 0; i < IARRAY_EXPR_BLOCK_CACHE_SIZE; ++i) {
+        INA_MEM_FREE_SAFE(cache->blocks[i]);
+    }
+}
+
+// Fetch the lazy chunks of input `nvar` that overlap the output chunk `out_chunk_index`
+static ina_rc_t _iarray_expr_neq_fetch(iarray_expression_t *e, int nvar, iarray_expr_neq_chunks_t *neq,
+                                       const int64_t *out_chunk_index)
+{
+    caterva_array_t *out = e->out->catarr;
+    caterva_array_t *catarr = e->vars[nvar].c->catarr;
+    int8_t ndim = catarr->ndim;
+    neq->nchunks = 1;
+    for (int i = 0; i < ndim; ++i) {
+        int64_t first = out_chunk_index[i] * out->chunkshape[i] - neq->margin_lo[i];
+        int64_t last = out_chunk_index[i] * out->chunkshape[i] + out->chunkshape[i] + neq->margin_hi[i];
+        if (first < 0) {
+            first = 0;
+        }
+        if (last > out->shape[i]) {
+            last = out->shape[i];
+        }
+        neq->start[i] = first / catarr->chunkshape[i];
+        neq->count[i] = (last - 1) / catarr->chunkshape[i] - neq->start[i] + 1;
+        neq->nchunks *= neq->count[i];
+    }
+
+    int64_t chunks_shape[IARRAY_DIMENSION_MAX];
+    for (int i = 0; i < ndim; ++i) {
+        chunks_shape[i] = catarr->extshape[i] / catarr->chunkshape[i];
+    }
+    for (int64_t nlocal = 0; nlocal < neq->nchunks; ++nlocal) {
+        int64_t local_index[IARRAY_DIMENSION_MAX];
+        iarray_index_unidim_to_multidim_shape(ndim, neq->count, nlocal, local_index);
+        int64_t nchunk = 0;
+        for (int i = 0; i < ndim; ++i) {
+            nchunk = nchunk * chunks_shape[i] + neq->start[i] + local_index[i];
+        }
+        int csize = blosc2_schunk_get_lazychunk(catarr->sc, nchunk, &neq->chunks[nlocal], &neq->needs_free[nlocal]);
+        if (csize < 0) {
+            neq->nchunks = nlocal;
+            IARRAY_TRACE1(iarray.error, "Error in retrieving chunk from schunk");
+            return INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+        }
+        neq->csizes[nlocal] = csize;
+    }
+    return INA_SUCCESS;
+}
+
+static void _iarray_expr_neq_release(iarray_expr_neq_chunks_t *neq)
+{
+    for (int64_t nlocal = 0; nlocal < neq->nchunks; ++nlocal) {
+        if (neq->needs_free[nlocal]) {
+            free(neq->chunks[nlocal]);
+        }
+    }
+    neq->nchunks = 0;
+}
+
+// Gather the window of input `nvar` for an output block, one row segment at a time, from the
+// (cached) decompressed blocks of the input.  `window` follows the layout given by `strides`.
+static int _iarray_expr_read_window(iarray_expression_t *e, int nvar, iarray_expr_neq_chunks_t *neq,
+                                    blosc2_context *dctx, iarray_expr_block_cache_t *cache,
+                                    const int64_t *start, const int32_t *shape, const int32_t *strides,
+                                    uint8_t *window)
+{
+    caterva_array_t *catarr = e->vars[nvar].c->catarr;
+    int8_t ndim = catarr->ndim;
+    int32_t itemsize = (int32_t) catarr->itemsize;
+    int32_t blocksize = catarr->blocknitems * itemsize;
+
+    int64_t chunks_shape[IARRAY_DIMENSION_MAX];
+    int64_t blocks_shape[IARRAY_DIMENSION_MAX];
+    int64_t rows_shape[IARRAY_DIMENSION_MAX];
+    int64_t nrows = 1;
+    for (int i = 0; i < ndim; ++i) {
+        chunks_shape[i] = catarr->extshape[i] / catarr->chunkshape[i];
+        blocks_shape[i] = catarr->extchunkshape[i] / catarr->blockshape[i];
+        if (i < ndim - 1) {
+            rows_shape[i] = shape[i];
+            nrows *= shape[i];
+        }
+    }
+
+    int64_t chunk_index[IARRAY_DIMENSION_MAX];
+    int64_t block_index[IARRAY_DIMENSION_MAX];
+    int64_t elem_index[IARRAY_DIMENSION_MAX];
+    for (int64_t nrow = 0; nrow < nrows; ++nrow) {
+        int64_t row_index[IARRAY_DIMENSION_MAX];
+        iarray_index_unidim_to_multidim_shape((int8_t) (ndim - 1), rows_shape, nrow, row_index);
+        int64_t window_offset = 0;
+        for (int i = 0; i < ndim - 1; ++i) {
+            int64_t pos = start[i] + row_index[i];
+            chunk_index[i] = pos / catarr->chunkshape[i];
+            block_index[i] = (pos % catarr->chunkshape[i]) / catarr->blockshape[i];
+            elem_index[i] = (pos % catarr->chunkshape[i]) % catarr->blockshape[i];
+            window_offset += row_index[i] * strides[i];
+        }
+
+        // A row crosses the blocks (and chunks) of the input along the last dimension
+        int d = ndim - 1;
+        int64_t pos = start[d];
+        int64_t stop = start[d] + shape[d];
+        while (pos < stop) {
+            chunk_index[d] = pos / catarr->chunkshape[d];
+            int64_t pos_in_chunk = pos % catarr->chunkshape[d];
+            block_index[d] = pos_in_chunk / catarr->blockshape[d];
+            elem_index[d] = pos_in_chunk % catarr->blockshape[d];
+            int64_t len = stop - pos;
+            if (len > catarr->blockshape[d] - elem_index[d]) {
+                len = catarr->blockshape[d] - elem_index[d];
+            }
+            if (len > catarr->chunkshape[d] - pos_in_chunk) {
+                len = catarr->chunkshape[d] - pos_in_chunk;
+            }
+
+            int64_t nchunk = 0;
+            int64_t nblock = 0;
+            int64_t nlocal = 0;
+            int64_t offset_in_block = 0;
+            for (int i = 0; i < ndim; ++i) {
+                nchunk = nchunk * chunks_shape[i] + chunk_index[i];
+                nblock = nblock * blocks_shape[i] + block_index[i];
+                nlocal = nlocal * neq->count[i] + chunk_index[i] - neq->start[i];
+                offset_in_block = offset_in_block * catarr->blockshape[i] + elem_index[i];
+            }
+
+            uint8_t *block = NULL;
+            for (int i = 0; i < IARRAY_EXPR_BLOCK_CACHE_SIZE; ++i) {
+                if (cache->nchunk[i] == nchunk && cache->nblock[i] == nblock) {
+                    block = cache->blocks[i];
+                    break;
+                }
+            }
+            if (block == NULL) {
+                int entry = cache->next;
+                cache->next = (entry + 1) % IARRAY_EXPR_BLOCK_CACHE_SIZE;
+                cache->nchunk[entry] = -1;
+                int rbytes = blosc2_getitem_ctx(dctx, neq->chunks[nlocal], neq->csizes[nlocal],
+                                                (int) (nblock * catarr->blocknitems), catarr->blocknitems,
+                                                cache->blocks[entry], blocksize);
+                if (rbytes != blocksize) {
+                    return -1;
+                }
+                cache->nchunk[entry] = nchunk;
+                cache->nblock[entry] = nblock;
+                block = cache->blocks[entry];
+            }
+            memcpy(window + (window_offset + pos - start[d]) * itemsize, block + offset_in_block * itemsize,
+                   len * itemsize);
+            pos += len;
+        }
+    }
+    return 0;
+}
+
+// Gather the halo of stencil input `nvar` around the output block at `start` (with visible `shape`).
+// The positions of the halo outside of the input take the value of the nearest one inside.
+static int _iarray_expr_read_halo(iarray_expression_t *e, int nvar, const iarray_expr_stencil_t *st,
+                                  iarray_expr_neq_chunks_t *neq, blosc2_context *dctx,
+                                  iarray_expr_block_cache_t *cache, const int64_t *start, const int32_t *shape,
+                                  uint8_t *halo)
+{
+    caterva_array_t *catarr = e->vars[nvar].c->catarr;
+    int8_t ndim = catarr->ndim;
+    int32_t itemsize = (int32_t) catarr->itemsize;
+
+    // The part of the halo inside the input, [valid_lo, valid_hi) in halo coordinates
+    int64_t window_start[IARRAY_DIMENSION_MAX];
+    int32_t window_shape[IARRAY_DIMENSION_MAX];
+    int32_t halo_shape[IARRAY_DIMENSION_MAX];
+    int32_t valid_lo[IARRAY_DIMENSION_MAX];
+    int32_t valid_hi[IARRAY_DIMENSION_MAX];
+    int64_t window_offset = 0;
+    for (int i = 0; i < ndim; ++i) {
+        if (shape[i] == 0) {
+            return 0;
+        }
+        halo_shape[i] = e->out->catarr->blockshape[i] + st->lo[i] + st->hi[i];
+        int64_t first = start[i] - st->lo[i];
+        int64_t last = start[i] + shape[i] + st->hi[i];
+        if (first < 0) {
+            first = 0;
+        }
+        if (last > catarr->shape[i]) {
+            last = catarr->shape[i];
+        }
+        window_start[i] = first;
+        window_shape[i] = (int32_t) (last - first);
+        valid_lo[i] = (int32_t) (first - (start[i] - st->lo[i]));
+        valid_hi[i] = valid_lo[i] + window_shape[i];
+        window_offset += valid_lo[i] * st->strides[i];
+    }
+    if (_iarray_expr_read_window(e, nvar, neq, dctx, cache, window_start, window_shape, st->strides,
+                                 halo + window_offset * itemsize) != 0) {
+        return -1;
+    }
+
+    // Replicate the edges, one dimension at a time (the ones before are complete by then)
+    int64_t nplanes = 1;
+    for (int i = 0; i < ndim; ++i) {
+        size_t planesize = (size_t) st->strides[i] * itemsize;
+        for (int64_t nplane = 0; nplane < nplanes; ++nplane) {
+            uint8_t *plane = halo + nplane * halo_shape[i] * planesize;
+            for (int32_t j = 0; j < valid_lo[i]; ++j) {
+                memcpy(plane + j * planesize, plane + valid_lo[i] * planesize, planesize);
+            }
+            for (int32_t j = valid_hi[i]; j < halo_shape[i]; ++j) {
+                memcpy(plane + j * planesize, plane + (valid_hi[i] - 1) * planesize, planesize);
+            }
+        }
+        nplanes *= halo_shape[i];
+    }
+    return 0;
+}
+
+ina_rc_t _iarray_expr_blocks_new(iarray_expression_t *e, int nthreads, iarray_expr_blocks_t **blocks)
+{
+    int nvars = e->nvars;
+    if (nthreads < 1) {
+        nthreads = 1;
+    }
+    iarray_expr_blocks_t *b = ina_mem_alloc(sizeof(iarray_expr_blocks_t));
+    ina_mem_set(b, 0, sizeof(iarray_expr_blocks_t));
+    b->e = e;
+    b->nthreads = nthreads;
+
+    ina_rc_t rc;
+    caterva_array_t *out = e->out->catarr;
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        if (e->bcast_data[nvar] != NULL) {
+            b->input_class[nvar] = IARRAY_EXPR_BCAST;
+            continue;
+        }
+        bool compatible;
+        rc = _iarray_expr_block_compatible(e, e->vars[nvar].c, e->out->storage, &compatible);
+        INA_FAIL_IF_ERROR(rc);
+        if (compatible) {
+            b->input_class[nvar] = IARRAY_EXPR_EQ;
+            continue;
+        }
+        bool readable;
+        rc = _iarray_expr_block_readable(e, e->vars[nvar].c, &readable);
+        INA_FAIL_IF_ERROR(rc);
+        if (!readable) {
+            IARRAY_TRACE1(iarray.error, "An operand of the expression cannot be read block by block");
+            rc = INA_ERROR(INA_ERR_NOT_SUPPORTED);
+            goto fail;
+        }
+        b->input_class[nvar] = IARRAY_EXPR_NEQ_BLOCK;
+    }
+
+    int npool = nthreads * nvars;
+    b->nchunks = ina_mem_alloc(nthreads * sizeof(int64_t));
+    b->chunks = ina_mem_alloc(npool * sizeof(uint8_t *));
+    b->csizes = ina_mem_alloc(npool * sizeof(int32_t));
+    b->needs_free = ina_mem_alloc(npool * sizeof(bool));
+    b->neq_chunks = ina_mem_alloc(npool * sizeof(iarray_expr_neq_chunks_t));
+    b->dctx_pool = ina_mem_alloc(npool * sizeof(blosc2_context *));
+    b->block_pool = ina_mem_alloc(npool * sizeof(uint8_t *));
+    b->cache_pool = ina_mem_alloc(npool * sizeof(iarray_expr_block_cache_t));
+    ina_mem_set(b->needs_free, 0, npool * sizeof(bool));
+    ina_mem_set(b->neq_chunks, 0, npool * sizeof(iarray_expr_neq_chunks_t));
+    ina_mem_set(b->dctx_pool, 0, npool * sizeof(blosc2_context *));
+    ina_mem_set(b->block_pool, 0, npool * sizeof(uint8_t *));
+    ina_mem_set(b->cache_pool, 0, npool * sizeof(iarray_expr_block_cache_t));
+    for (int tid = 0; tid < nthreads; tid++) {
+        b->nchunks[tid] = -1;
+        for (int nvar = 0; nvar < nvars; nvar++) {
+            if (b->input_class[nvar] == IARRAY_EXPR_BCAST) {
+                continue;
+            }
+            int pool_index = tid * nvars + nvar;
+            caterva_array_t *catarr = e->vars[nvar].c->catarr;
+            if (b->input_class[nvar] == IARRAY_EXPR_NEQ_BLOCK) {
+                _iarray_expr_block_cache_init(&b->cache_pool[pool_index],
+                                              (int32_t) (catarr->blocknitems * catarr->itemsize));
+                iarray_expr_neq_chunks_t *neq = &b->neq_chunks[pool_index];
+                int64_t max_nchunks = 1;
+                for (int i = 0; i < catarr->ndim; ++i) {
+                    max_nchunks *= (out->chunkshape[i] + catarr->chunkshape[i] - 1) / catarr->chunkshape[i] + 1;
+                }
+                neq->chunks = ina_mem_alloc(max_nchunks * sizeof(uint8_t *));
+                neq->csizes = ina_mem_alloc(max_nchunks * sizeof(int32_t));
+                neq->needs_free = ina_mem_alloc(max_nchunks * sizeof(bool));
+            }
+            blosc2_schunk *schunk = catarr->sc;
+            blosc2_dparams dparams = {.nthreads = 1,
+                                      .schunk = schunk,
+                                      .postfilter = schunk->dctx->postfilter,
+                                      .postparams = schunk->dctx->postparams,
+            };
+            b->dctx_pool[pool_index] = blosc2_create_dctx(dparams);
+            b->block_pool[pool_index] = ina_mem_alloc_aligned(64, (int32_t) (out->blocknitems * catarr->itemsize));
+        }
+    }
+    *blocks = b;
+    return INA_SUCCESS;
+
+fail:
+    _iarray_expr_blocks_free(&b);
+    return rc;
+}
+
+// Free the operand chunks fetched by thread `tid`
+static void _iarray_expr_blocks_release(iarray_expr_blocks_t *blocks, int tid)
+{
+    int nvars = blocks->e->nvars;
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        int pool_index = tid * nvars + nvar;
+        if (blocks->needs_free[pool_index]) {
+            free(blocks->chunks[pool_index]);
+            blocks->needs_free[pool_index] = false;
+        }
+        _iarray_expr_neq_release(&blocks->neq_chunks[pool_index]);
+    }
+    blocks->nchunks[tid] = -1;
+}
+
+void _iarray_expr_blocks_free(iarray_expr_blocks_t **blocks)
+{
+    iarray_expr_blocks_t *b = *blocks;
+    if (b == NULL) {
+        return;
+    }
+    if (b->nchunks != NULL) {
+        int npool = b->nthreads * b->e->nvars;
+        for (int tid = 0; tid < b->nthreads; ++tid) {
+            _iarray_expr_blocks_release(b, tid);
+        }
+        for (int i = 0; i < npool; ++i) {
+            if (b->dctx_pool[i] != NULL) {
+                blosc2_free_ctx(b->dctx_pool[i]);
+            }
+            INA_MEM_FREE_SAFE(b->block_pool[i]);
+            _iarray_expr_block_cache_free(&b->cache_pool[i]);
+            INA_MEM_FREE_SAFE(b->neq_chunks[i].chunks);
+            INA_MEM_FREE_SAFE(b->neq_chunks[i].csizes);
+            INA_MEM_FREE_SAFE(b->neq_chunks[i].needs_free);
+        }
+    }
+    INA_MEM_FREE_SAFE(b->nchunks);
+    INA_MEM_FREE_SAFE(b->chunks);
+    INA_MEM_FREE_SAFE(b->csizes);
+    INA_MEM_FREE_SAFE(b->needs_free);
+    INA_MEM_FREE_SAFE(b->neq_chunks);
+    INA_MEM_FREE_SAFE(b->dctx_pool);
+    INA_MEM_FREE_SAFE(b->block_pool);
+    INA_MEM_FREE_SAFE(b->cache_pool);
+    INA_MEM_FREE_SAFE(*blocks);
+}
+
+ina_rc_t _iarray_expr_blocks_fetch(iarray_expr_blocks_t *blocks, int tid, int64_t nchunk)
+{
+    if (tid < 0 || tid >= blocks->nthreads) {
+        IARRAY_TRACE1(iarray.error, "More threads than expected are computing the blocks of an expression");
+        return INA_ERROR(INA_ERR_FAILED);
+    }
+    if (blocks->nchunks[tid] == nchunk) {
+        return INA_SUCCESS;
+    }
+    _iarray_expr_blocks_release(blocks, tid);
+
+    iarray_expression_t *e = blocks->e;
+    caterva_array_t *out = e->out->catarr;
+    int64_t chunks_shape[IARRAY_DIMENSION_MAX];
+    int64_t chunk_index[IARRAY_DIMENSION_MAX];
+    for (int i = 0; i < out->ndim; ++i) {
+        chunks_shape[i] = out->extshape[i] / out->chunkshape[i];
+    }
+    iarray_index_unidim_to_multidim_shape(out->ndim, chunks_shape, nchunk, chunk_index);
+
+    int nvars = e->nvars;
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        int pool_index = tid * nvars + nvar;
+        if (blocks->input_class[nvar] == IARRAY_EXPR_EQ) {
+            int csize = blosc2_schunk_get_lazychunk(e->vars[nvar].c->catarr->sc, nchunk,
+                                                    &blocks->chunks[pool_index], &blocks->needs_free[pool_index]);
+            if (csize < 0) {
+                blocks->needs_free[pool_index] = false;
+                IARRAY_TRACE1(iarray.error, "Error in retrieving chunk from schunk");
+                return INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+            }
+            blocks->csizes[pool_index] = csize;
+        } else if (blocks->input_class[nvar] == IARRAY_EXPR_NEQ_BLOCK) {
+            IARRAY_RETURN_IF_FAILED(_iarray_expr_neq_fetch(e, nvar, &blocks->neq_chunks[pool_index], chunk_index));
+        }
+    }
+    blocks->nchunks[tid] = nchunk;
+    return INA_SUCCESS;
+}
+
+ina_rc_t _iarray_expr_blocks_eval(iarray_expr_blocks_t *blocks, int tid, int32_t nblock, uint8_t *block)
+{
+    iarray_expression_t *e = blocks->e;
+    caterva_array_t *catarr = e->out->catarr;
+    int8_t ndim = e->out->dtshape->ndim;
+    int nvars = e->nvars;
+    int64_t nchunk = blocks->nchunks[tid];
+
+    iarray_eval_pparams_t eval_pparams = {0};
+    eval_pparams.ninputs = nvars;
+    eval_pparams.out = block;
+    eval_pparams.nouts = 1;
+    eval_pparams.outs[0] = block;
+    eval_pparams.out_typesize = (int32_t) catarr->itemsize;
+    eval_pparams.out_size = catarr->blocknitems * (int32_t) catarr->itemsize;
+    eval_pparams.ndim = ndim;
+
+    // Position of the block inside the container
+    int64_t chunks_shape[IARRAY_DIMENSION_MAX];
+    int64_t blocks_shape[IARRAY_DIMENSION_MAX];
+    for (int i = 0; i < ndim; ++i) {
+        chunks_shape[i] = catarr->extshape[i] / catarr->chunkshape[i];
+        blocks_shape[i] = catarr->extchunkshape[i] / catarr->blockshape[i];
+    }
+    int64_t chunk_index[IARRAY_DIMENSION_MAX];
+    int64_t block_index[IARRAY_DIMENSION_MAX];
+    iarray_index_unidim_to_multidim_shape(ndim, chunks_shape, nchunk, chunk_index);
+    iarray_index_unidim_to_multidim_shape(ndim, blocks_shape, nblock, block_index);
+
+    // Visible shape of the block
+    int64_t start[IARRAY_DIMENSION_MAX];
+    int32_t shape[IARRAY_DIMENSION_MAX];
+    int32_t strides[IARRAY_DIMENSION_MAX];
+    bool visible = true;
+    for (int i = 0; i < ndim; ++i) {
+        int64_t start_in_chunk = block_index[i] * catarr->blockshape[i];
+        start[i] = chunk_index[i] * catarr->chunkshape[i] + start_in_chunk;
+        int64_t stop_in_chunk = INA_MIN(start_in_chunk + catarr->blockshape[i], catarr->chunkshape[i]);
+        int64_t stop = INA_MIN(start[i] - start_in_chunk + stop_in_chunk, catarr->shape[i]);
+        shape[i] = stop > start[i] ? (int32_t) (stop - start[i]) : 0;
+        visible = visible && shape[i] > 0;
+    }
+    strides[ndim - 1] = 1;
+    for (int i = ndim - 2; i >= 0 ; --i) {
+        strides[i] = strides[i+1] * catarr->blockshape[i+1];
+    }
+    eval_pparams.window_shape = shape;
+    eval_pparams.window_start = start;
+    eval_pparams.window_strides = strides;
+
+    for (int nvar = 0; nvar < nvars; nvar++) {
+        int pool_index = tid * nvars + nvar;
+        int32_t input_typesize = (int32_t) e->vars[nvar].c->catarr->itemsize;
+        int32_t input_blocksize = catarr->blocknitems * input_typesize;
+        eval_pparams.input_typesizes[nvar] = input_typesize;
+        switch (blocks->input_class[nvar]) {
+            case IARRAY_EXPR_BCAST:
+                eval_pparams.inputs[nvar] = _iarray_expr_bcast_window(e, nvar, start);
+                eval_pparams.input_strides[nvar] = e->bcast_strides[nvar];
+                break;
+            case IARRAY_EXPR_EQ: {
+                // The operand shares the partition of the output, so it contributes a single block
+                eval_pparams.inputs[nvar] = blocks->block_pool[pool_index];
+                int rbytes = blosc2_getitem_ctx(blocks->dctx_pool[pool_index], blocks->chunks[pool_index],
+                                                blocks->csizes[pool_index], nblock * catarr->blocknitems,
+                                                catarr->blocknitems, eval_pparams.inputs[nvar], input_blocksize);
+                if (rbytes != input_blocksize) {
+                    IARRAY_TRACE1(iarray.error, "Error reading a block of an operand");
+                    return INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+                }
+                break;
+            }
+            case IARRAY_EXPR_NEQ_BLOCK:
+                eval_pparams.inputs[nvar] = blocks->block_pool[pool_index];
+                if (visible && _iarray_expr_read_window(e, nvar, &blocks->neq_chunks[pool_index],
+                                                        blocks->dctx_pool[pool_index], &blocks->cache_pool[pool_index],
+                                                        start, shape, strides, eval_pparams.inputs[nvar]) != 0) {
+                    IARRAY_TRACE1(iarray.error, "Error reading a block of an operand");
+                    return INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+                }
+                break;
+            default:
+                IARRAY_TRACE1(iarray.error, "Unexpected class of operand");
+                return INA_ERROR(INA_ERR_FAILED);
+        }
+    }
+
+    for (unsigned int i = 0; i < e->nuser_params; i++) {
+        eval_pparams.user_params[i] = e->user_params[i];
+    }
+    if (((iarray_eval_fn) e->jug_expr_func)(&eval_pparams) != 0) {
+        IARRAY_TRACE1(iarray.error, "Error in executing LLVM eval engine");
+        return INA_ERROR(IARRAY_ERR_EVAL_ENGINE_FAILED);
+    }
+    return INA_SUCCESS;
+}
+
+// Copy the visible part of an evaluated block into its place in a row-major buffer
+static void _iarray_expr_block_to_buffer(iarray_expression_t *e, const uint8_t *block, const int64_t *start,
+                                         const int32_t *shape, const int32_t *block_strides, uint8_t *buffer)
+{
+    int8_t ndim = e->out->dtshape->ndim;
+    int64_t itemsize = e->out->catarr->itemsize;
+    int64_t buffer_strides[IARRAY_DIMENSION_MAX];
+    buffer_strides[ndim - 1] = 1;
+    for (int i = ndim - 2; i >= 0; --i) {
+        buffer_strides[i] = buffer_strides[i + 1] * e->out->dtshape->shape[i + 1];
+    }
+
+    int64_t rows_shape[IARRAY_DIMENSION_MAX];
+    int64_t nrows = 1;
+    for (int i = 0; i < ndim - 1; ++i) {
+        rows_shape[i] = shape[i];
+        nrows *= shape[i];
+    }
+    int64_t rowsize = shape[ndim - 1] * itemsize;
+    if (rowsize <= 0) {
+        return;
+    }
+    for (int64_t nrow = 0; nrow < nrows; ++nrow) {
+        int64_t row_index[IARRAY_DIMENSION_MAX];
+        iarray_index_unidim_to_multidim_shape((int8_t) (ndim - 1), rows_shape, nrow, row_index);
+        int64_t block_offset = 0;
+        int64_t buffer_offset = start[ndim - 1];
+        for (int i = 0; i < ndim - 1; ++i) {
+            block_offset += row_index[i] * block_strides[i];
+            buffer_offset += (start[i] + row_index[i]) * buffer_strides[i];
+        }
+        memcpy(buffer + buffer_offset * itemsize, block + block_offset * itemsize, rowsize);
+    }
+}
+
+int prefilter_func(blosc2_prefilter_params *pparams)
+{
+    iarray_expr_pparams_t *expr_pparams = (iarray_expr_pparams_t*)pparams->user_data;
+    struct iarray_expression_s *e = expr_pparams->e;
+    int ninputs = expr_pparams->ninputs;
+    // Populate the eval_pparams
+    iarray_eval_pparams_t eval_pparams = {0};
+    eval_pparams.ninputs = ninputs;
+    memcpy(eval_pparams.input_typesizes, expr_pparams->input_typesizes, ninputs * sizeof(int32_t));
+    eval_pparams.user_data = expr_pparams;
+    eval_pparams.out = pparams->out;
+    eval_pparams.out_size = pparams->out_size;
+    eval_pparams.out_typesize = pparams->out_typesize;
+    eval_pparams.ndim = expr_pparams->e->out_dtshape->ndim;
+    // Only the first output goes through blosc; the rest land in uncompressed chunks
+    eval_pparams.nouts = expr_pparams->nouts;
+    eval_pparams.outs[0] = pparams->out;
+    for (int k = 1; k < expr_pparams->nouts; ++k) {
+        eval_pparams.outs[k] = expr_pparams->outs[k] + pparams->out_offset;
+    }
+    int32_t typesize = pparams->out_typesize;
+    // Inputs may have a different typesize than the output, so work in items
+    int64_t nitems = pparams->out_size / typesize;
+    int64_t offset_index = pparams->out_offset / typesize;
 
-        // Eval the expression for this chunk
-        e->max_out_len = out_items;  // so as to prevent operating beyond the limits
-        eval_pparams.out = out_value.block_pointer;
-        eval_pparams.out_size = (int32_t)out_value.block_size * e->typesize;
-        expr_pparams.out_value = out_value;
+    int8_t ndim = e->out->dtshape->ndim;
 
-        int32_t shape[IARRAY_DIMENSION_MAX];
+    // Element strides (in elements)
+    int32_t strides[IARRAY_DIMENSION_MAX];
+    strides[ndim - 1] = 1;
+    for (int i = ndim - 2; i >= 0 ; --i) {
+        strides[i] = strides[i+1] * e->out->catarr->blockshape[i+1];
+    }
+
+    // Block strides (in blocks)
+    int32_t strides_block[IARRAY_DIMENSION_MAX];
+    strides_block[ndim - 1] = 1;
+    for (int i = ndim - 2; i >= 0 ; --i) {
+        strides_block[i] = strides_block[i+1] * (int32_t) (e->out->catarr->extchunkshape[i+1] / e->out->catarr->blockshape[i+1]);
+    }
+
+    // Flattened block number
+    int32_t nblock = pparams->out_offset / pparams->out_size;
+
+    // Multidimensional block number
+    int32_t nblock_ndim[IARRAY_DIMENSION_MAX];
+    for (int i = ndim - 1; i >= 0; --i) {
+        if (i != 0) {
+            nblock_ndim[i] = (nblock % strides_block[i-1]) / strides_block[i];
+        } else {
+            nblock_ndim[i] = (nblock % ((int32_t)e->out->catarr->extchunknitems / e->out->catarr->blocknitems)) / strides_block[i];
+        }
+    }
+
+    // Position of the first element of the block (inside current chunk)
+    int64_t start_in_chunk[IARRAY_DIMENSION_MAX];
+    for (int i = 0; i < ndim; ++i) {
+        start_in_chunk[i] = nblock_ndim[i] * e->out->catarr->blockshape[i];
+    }
+
+    // Position of the first element of the block (inside container)
+    int64_t start_in_container[IARRAY_DIMENSION_MAX];
+    for (int i = 0; i < ndim; ++i) {
+        start_in_container[i] = start_in_chunk[i] + expr_pparams->out_value.block_index[i] * e->out->catarr->chunkshape[i];
+    }
+
+    // Check if the block is out of bounds
+    bool out_of_bounds = false;
+    for (int i = 0; i < ndim; ++i) {
+        if (start_in_container[i] > e->out->catarr->shape[i]) {
+            out_of_bounds = true;
+            break;
+        }
+    }
+
+    // Shape of the current block
+    int32_t shape[IARRAY_DIMENSION_MAX];
+    for (int i = 0; i < ndim; ++i) {
+        if (out_of_bounds) {
+            shape[i] = 0;
+        } else if (start_in_container[i] + e->out->catarr->blockshape[i] > e->out->catarr->shape[i]) {
+            shape[i] = (int32_t) (e->out->catarr->shape[i] - start_in_container[i]);
+        } else if (start_in_chunk[i] + e->out->catarr->blockshape[i] > e->out->catarr->chunkshape[i]) {
+            shape[i] = (int32_t) (e->out->catarr->chunkshape[i] - start_in_chunk[i]);
+        } else {
+            shape[i] = e->out->catarr->blockshape[i];
+        }
+    }
+
+    // We can only set the visible shape of the output for the ITERBLOSC eval method.
+    eval_pparams.window_shape = shape;
+    eval_pparams.window_start = start_in_container;
+    eval_pparams.window_strides = strides;
+
+    // The pools are created in iarray_eval_iterblosc; only fall back to per-block
+    // allocations if blosc happens to run with more threads than expected.
+    bool use_pool = pparams->tid >= 0 && pparams->tid < expr_pparams->pool_nthreads;
+    int ret = 0;
+    uint8_t *malloced[IARRAY_EXPR_OPERANDS_MAX];  // the inputs allocated here (if any), freed on exit
+    for (int i = 0; i < ninputs; i++) {
+        malloced[i] = NULL;
+    }
+    for (int i = 0; i < ninputs; i++) {
+        int32_t input_typesize = expr_pparams->input_typesizes[i];
+        int32_t input_blocksize = (int32_t) (nitems * input_typesize);
+        switch (expr_pparams->input_class[i]) {
+            case IARRAY_EXPR_EQ_NCOMP:
+                eval_pparams.inputs[i] = expr_pparams->inputs[i] + BLOSC_EXTENDED_HEADER_LENGTH + offset_index * input_typesize;
+                break;
+            case IARRAY_EXPR_EQ: {
+                blosc2_context *dctx;
+                if (use_pool) {
+                    int pool_index = pparams->tid * ninputs + i;
+                    eval_pparams.inputs[i] = expr_pparams->block_pool[pool_index];
+                    dctx = expr_pparams->dctx_pool[pool_index];
+                } else {
+                    eval_pparams.inputs[i] = ina_mem_alloc_aligned(64, input_blocksize);
+                    malloced[i] = eval_pparams.inputs[i];
+                    blosc2_dparams dparams = {.nthreads = 1,
+                                              .schunk = e->vars[i].c->catarr->sc,
+                                              .postfilter = e->vars[i].c->catarr->sc->dctx->postfilter,
+                                              .postparams = e->vars[i].c->catarr->sc->dctx->postparams,
+                    };
+                    dctx = blosc2_create_dctx(dparams);
+                }
+                int64_t rbytes = blosc2_getitem_ctx(dctx, expr_pparams->inputs[i], expr_pparams->input_csizes[i],
+                                                    (int) offset_index, (int) nitems,
+                                                    eval_pparams.inputs[i], input_blocksize);
+                if (!use_pool) {
+                    blosc2_free_ctx(dctx);
+                }
+                if (rbytes != input_blocksize) {
+                    IARRAY_TRACE1(iarray.error, "Error reading a block of an operand");
+                    ret = -1;
+                    goto exit;
+                }
+                break;
+            }
+            case IARRAY_EXPR_NEQ:
+            case IARRAY_EXPR_NEQ_CHUNK:
+                eval_pparams.inputs[i] = expr_pparams->inputs[i] + offset_index * input_typesize;
+                break;
+            case IARRAY_EXPR_NEQ_BLOCK: {
+                blosc2_context *dctx;
+                iarray_expr_block_cache_t *cache;
+                iarray_expr_block_cache_t local_cache;
+                if (use_pool) {
+                    int pool_index = pparams->tid * ninputs + i;
+                    eval_pparams.inputs[i] = expr_pparams->block_pool[pool_index];
+                    dctx = expr_pparams->dctx_pool[pool_index];
+                    cache = &expr_pparams->cache_pool[pool_index];
+                } else {
+                    eval_pparams.inputs[i] = ina_mem_alloc_aligned(64, input_blocksize);
+                    malloced[i] = eval_pparams.inputs[i];
+                    blosc2_dparams dparams = {.nthreads = 1, .schunk = e->vars[i].c->catarr->sc};
+                    dctx = blosc2_create_dctx(dparams);
+                    _iarray_expr_block_cache_init(&local_cache, e->vars[i].c->catarr->blocknitems * input_typesize);
+                    cache = &local_cache;
+                }
+                int err = 0;
+                if (!out_of_bounds) {
+                    err = _iarray_expr_read_window(e, i, &expr_pparams->neq_chunks[i], dctx, cache,
+                                                   start_in_container, shape, strides, eval_pparams.inputs[i]);
+                }
+                if (!use_pool) {
+                    blosc2_free_ctx(dctx);
+                    _iarray_expr_block_cache_free(&local_cache);
+                }
+                if (err != 0) {
+                    IARRAY_TRACE1(iarray.error, "Error reading the window of a mismatched operand");
+                    ret = -1;
+                    goto exit;
+                }
+                break;
+            }
+            case IARRAY_EXPR_STENCIL: {
+                iarray_expr_stencil_t *st = &expr_pparams->stencils[i];
+                if (st->owner != i) {
+                    // Pointed into the halo of the owner below
+                    break;
+                }
+                blosc2_context *dctx;
+                iarray_expr_block_cache_t *cache;
+                iarray_expr_block_cache_t local_cache;
+                if (use_pool) {
+                    int pool_index = pparams->tid * ninputs + i;
+                    eval_pparams.inputs[i] = expr_pparams->block_pool[pool_index];
+                    dctx = expr_pparams->dctx_pool[pool_index];
+                    cache = &expr_pparams->cache_pool[pool_index];
+                } else {
+                    eval_pparams.inputs[i] = ina_mem_alloc_aligned(64, st->halo_nitems * input_typesize);
+                    malloced[i] = eval_pparams.inputs[i];
+                    blosc2_dparams dparams = {.nthreads = 1, .schunk = e->vars[i].c->catarr->sc};
+                    dctx = blosc2_create_dctx(dparams);
+                    _iarray_expr_block_cache_init(&local_cache, e->vars[i].c->catarr->blocknitems * input_typesize);
+                    cache = &local_cache;
+                }
+                int err = 0;
+                if (!out_of_bounds) {
+                    err = _iarray_expr_read_halo(e, i, st, &expr_pparams->neq_chunks[i], dctx, cache,
+                                                 start_in_container, shape, eval_pparams.inputs[i]);
+                }
+                if (!use_pool) {
+                    blosc2_free_ctx(dctx);
+                    _iarray_expr_block_cache_free(&local_cache);
+                }
+                if (err != 0) {
+                    IARRAY_TRACE1(iarray.error, "Error reading the halo of a stencil operand");
+                    ret = -1;
+                    goto exit;
+                }
+                break;
+            }
+            case IARRAY_EXPR_BCAST:
+                eval_pparams.inputs[i] = _iarray_expr_bcast_window(e, i, start_in_container);
+                eval_pparams.input_strides[i] = e->bcast_strides[i];
+                break;
+            default:
+                IARRAY_TRACE1(iarray.error, "Unexpected class of operand");
+                ret = -1;
+                goto exit;
+        }
+    }
+
+    // Stencil inputs read the halo of their owner, shifted by their offset
+    uint8_t *halos[IARRAY_EXPR_OPERANDS_MAX];
+    for (int i = 0; i < ninputs; i++) {
+        halos[i] = eval_pparams.inputs[i];
+    }
+    for (int i = 0; i < ninputs; i++) {
+        if (expr_pparams->input_class[i] == IARRAY_EXPR_STENCIL) {
+            iarray_expr_stencil_t *st = &expr_pparams->stencils[i];
+            eval_pparams.inputs[i] = halos[st->owner] + st->offset * expr_pparams->input_typesizes[i];
+            eval_pparams.input_strides[i] = expr_pparams->stencils[st->owner].strides;
+        }
+    }
+
+    for (unsigned int i = 0; i < e->nuser_params; i++) {
+        eval_pparams.user_params[i] = e->user_params[i];
+    }
+
+    // Eval the expression for this chunk
+    switch (((iarray_eval_fn) e->jug_expr_func)(&eval_pparams)) {
+        case 0:
+            // 0 means success
+            break;
+        case 1:
+            IARRAY_TRACE1(iarray.error, "Out of bounds in LLVM eval engine");
+            ret = -2;
+            goto exit;
+        default:
+            IARRAY_TRACE1(iarray.error, "Error in executing LLVM eval engine");
+            ret = -3;
+            goto exit;
+    }
+
+    if (expr_pparams->out_buffer != NULL && !out_of_bounds) {
+        _iarray_expr_block_to_buffer(e, pparams->out, start_in_container, shape, strides, expr_pparams->out_buffer);
+    }
+
+exit:
+    for (int i = 0; i < ninputs; i++) {
+        INA_MEM_FREE_SAFE(malloced[i]);
+    }
+    return ret;
+}
+
+
+#if defined(IARRAY_EVAL_PIPELINE)
+
+// Bounded FIFO between the evaluation loop and the pipeline threads
+typedef struct _iarray_eval_queue_s {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    void **items;
+    int depth;
+    int head;
+    int count;
+    bool closed;  // no more pushes; pops still drain the pending items
+} _iarray_eval_queue_t;
+
+// The operands for an output chunk, read ahead by a reader thread
+typedef struct _iarray_eval_prefetch_s {
+    int64_t nchunk;
+    int error;  // negative if some operand could not be read
+    uint8_t *chunks[IARRAY_EXPR_OPERANDS_MAX];  // lazy chunks of the IARRAY_EXPR_EQ inputs
+    int32_t csizes[IARRAY_EXPR_OPERANDS_MAX];
+    bool needs_free[IARRAY_EXPR_OPERANDS_MAX];
+    uint8_t *windows[IARRAY_EXPR_OPERANDS_MAX];  // the IARRAY_EXPR_NEQ_CHUNK inputs, in the layout of the output chunk
+} _iarray_eval_prefetch_t;
+
+// A compressed output chunk waiting for the writer thread
+typedef struct _iarray_eval_written_s {
+    int64_t nchunk;
+    uint8_t *chunk;
+} _iarray_eval_written_t;
+
+// Reader `id` reads the chunks id, id + nreaders, ... so that popping from the readers in turn
+// gives the chunks in order
+typedef struct _iarray_eval_reader_s {
+    struct _iarray_eval_pipeline_s *p;
+    int id;
+    _iarray_eval_queue_t queue;
+    pthread_t thread;
+    bool started;
+    // For the IARRAY_EXPR_NEQ_CHUNK inputs, indexed by nvar
+    blosc2_context **dctxs;
+    iarray_expr_block_cache_t *caches;
+    iarray_expr_neq_chunks_t *neq_chunks;
+} _iarray_eval_reader_t;
+
+typedef struct _iarray_eval_pipeline_s {
+    iarray_expression_t *e;
+    iarray_expr_input_class_t input_class[IARRAY_EXPR_OPERANDS_MAX];  // the EQ and NEQ_CHUNK inputs are read ahead
+    int64_t nchunks;
+    blosc2_schunk *out_sc;
+    int nreaders;
+    _iarray_eval_reader_t *readers;
+    _iarray_eval_queue_t write_queue;
+    pthread_t writer;
+    bool write_failed;  // only touched by the writer until it is joined
+} _iarray_eval_pipeline_t;
+
+static void _iarray_eval_queue_init(_iarray_eval_queue_t *q, int depth)
+{
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    q->items = ina_mem_alloc(depth * sizeof(void *));
+    q->depth = depth;
+    q->head = 0;
+    q->count = 0;
+    q->closed = false;
+}
+
+static void _iarray_eval_queue_destroy(_iarray_eval_queue_t *q)
+{
+    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    INA_MEM_FREE_SAFE(q->items);
+}
+
+// Blocks while the queue is full; returns false (and does not take `item`) once it is closed
+static bool _iarray_eval_queue_push(_iarray_eval_queue_t *q, void *item)
+{
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == q->depth && !q->closed) {
+        pthread_cond_wait(&q->not_full, &q->mutex);
+    }
+    bool pushed = !q->closed;
+    if (pushed) {
+        q->items[(q->head + q->count) % q->depth] = item;
+        q->count++;
+        pthread_cond_signal(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return pushed;
+}
+
+// Blocks while the queue is empty; returns NULL once it is closed and drained
+static void *_iarray_eval_queue_pop(_iarray_eval_queue_t *q)
+{
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == 0 && !q->closed) {
+        pthread_cond_wait(&q->not_empty, &q->mutex);
+    }
+    void *item = NULL;
+    if (q->count > 0) {
+        item = q->items[q->head];
+        q->head = (q->head + 1) % q->depth;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return item;
+}
+
+static void _iarray_eval_queue_close(_iarray_eval_queue_t *q)
+{
+    pthread_mutex_lock(&q->mutex);
+    q->closed = true;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->mutex);
+}
+
+static void _iarray_eval_prefetch_free(_iarray_eval_prefetch_t **item, int nvars)
+{
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        if ((*item)->needs_free[nvar]) {
+            free((*item)->chunks[nvar]);
+        }
+        INA_MEM_FREE_SAFE((*item)->windows[nvar]);
+    }
+    INA_MEM_FREE_SAFE(*item);
+}
+
+// Gather input `nvar` for the output chunk `nchunk`, block by block in the layout of the output chunk
+static int _iarray_eval_read_chunk(_iarray_eval_reader_t *r, int nvar, int64_t nchunk, uint8_t *window)
+{
+    iarray_expression_t *e = r->p->e;
+    caterva_array_t *out = e->out->catarr;
+    int8_t ndim = out->ndim;
+    int32_t itemsize = (int32_t) e->vars[nvar].c->catarr->itemsize;
+
+    int64_t chunks_shape[IARRAY_DIMENSION_MAX];
+    int64_t blocks_shape[IARRAY_DIMENSION_MAX];
+    int64_t chunk_index[IARRAY_DIMENSION_MAX];
+    for (int i = 0; i < ndim; ++i) {
+        chunks_shape[i] = out->extshape[i] / out->chunkshape[i];
+        blocks_shape[i] = out->extchunkshape[i] / out->blockshape[i];
+    }
+    iarray_index_unidim_to_multidim_shape(ndim, chunks_shape, nchunk, chunk_index);
+    int32_t strides[IARRAY_DIMENSION_MAX];
+    strides[ndim - 1] = 1;
+    for (int i = ndim - 2; i >= 0 ; --i) {
+        strides[i] = strides[i+1] * out->blockshape[i+1];
+    }
+
+    iarray_expr_neq_chunks_t *neq = &r->neq_chunks[nvar];
+    int err = INA_SUCCEED(_iarray_expr_neq_fetch(e, nvar, neq, chunk_index)) ? 0 : -1;
+    int64_t nblocks = out->extchunknitems / out->blocknitems;
+    for (int64_t nblock = 0; err == 0 && nblock < nblocks; ++nblock) {
+        int64_t block_index[IARRAY_DIMENSION_MAX];
+        iarray_index_unidim_to_multidim_shape(ndim, blocks_shape, nblock, block_index);
+        // Visible shape of the block; the padding is left as is
         int64_t start[IARRAY_DIMENSION_MAX];
-        int32_t strides[IARRAY_DIMENSION_MAX];
+        int32_t shape[IARRAY_DIMENSION_MAX];
+        bool visible = true;
+        for (int i = 0; i < ndim; ++i) {
+            int64_t start_in_chunk = block_index[i] * out->blockshape[i];
+            start[i] = chunk_index[i] * out->chunkshape[i] + start_in_chunk;
+            int64_t stop_in_chunk = INA_MIN(start_in_chunk + out->blockshape[i], out->chunkshape[i]);
+            int64_t stop = INA_MIN(start[i] - start_in_chunk + stop_in_chunk, out->shape[i]);
+            shape[i] = stop > start[i] ? (int32_t) (stop - start[i]) : 0;
+            visible = visible && shape[i] > 0;
+        }
+        if (visible) {
+            err = _iarray_expr_read_window(e, nvar, neq, r->dctxs[nvar], &r->caches[nvar], start, shape, strides,
+                                           window + nblock * out->blocknitems * itemsize);
+        }
+    }
+    _iarray_expr_neq_release(neq);
+    return err;
+}
+
+static void *_iarray_eval_reader(void *arg)
+{
+    _iarray_eval_reader_t *r = (_iarray_eval_reader_t *) arg;
+    _iarray_eval_pipeline_t *p = r->p;
+    iarray_expression_t *e = p->e;
+    int64_t window_nitems = e->out->catarr->extchunknitems;
+    for (int64_t nchunk = r->id; nchunk < p->nchunks; nchunk += p->nreaders) {
+        _iarray_eval_prefetch_t *item = ina_mem_alloc(sizeof(_iarray_eval_prefetch_t));
+        ina_mem_set(item, 0, sizeof(_iarray_eval_prefetch_t));
+        item->nchunk = nchunk;
+        for (int nvar = 0; nvar < e->nvars; ++nvar) {
+            if (p->input_class[nvar] == IARRAY_EXPR_NEQ_CHUNK) {
+                size_t size = window_nitems * e->vars[nvar].c->catarr->itemsize;
+                item->windows[nvar] = ina_mem_alloc(size);
+                ina_mem_set(item->windows[nvar], 0, size);
+                if (_iarray_eval_read_chunk(r, nvar, nchunk, item->windows[nvar]) != 0) {
+                    item->error = -1;
+                    break;
+                }
+                continue;
+            }
+            if (p->input_class[nvar] != IARRAY_EXPR_EQ) {
+                continue;
+            }
+            blosc2_schunk *schunk = e->vars[nvar].c->catarr->sc;
+            int csize = blosc2_schunk_get_lazychunk(schunk, nchunk, &item->chunks[nvar], &item->needs_free[nvar]);
+            if (csize < 0) {
+                item->error = csize;
+                item->needs_free[nvar] = false;
+                break;
+            }
+            item->csizes[nvar] = csize;
+        }
+        bool failed = item->error < 0;
+        if (!_iarray_eval_queue_push(&r->queue, item)) {
+            _iarray_eval_prefetch_free(&item, e->nvars);
+            break;
+        }
+        if (failed) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void *_iarray_eval_writer(void *arg)
+{
+    _iarray_eval_pipeline_t *p = (_iarray_eval_pipeline_t *) arg;
+    _iarray_eval_written_t *item;
+    while ((item = _iarray_eval_queue_pop(&p->write_queue)) != NULL) {
+        // The super-chunk takes ownership of the compressed chunk
+        if (p->write_failed || blosc2_schunk_update_chunk(p->out_sc, item->nchunk, item->chunk, false) < 0) {
+            p->write_failed = true;
+            free(item->chunk);
+        }
+        INA_MEM_FREE_SAFE(item);
+    }
+    return NULL;
+}
+
+static void _iarray_eval_reader_free(_iarray_eval_reader_t *r, int nvars)
+{
+    _iarray_eval_queue_destroy(&r->queue);
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        if (r->dctxs[nvar] != NULL) {
+            blosc2_free_ctx(r->dctxs[nvar]);
+        }
+        _iarray_expr_block_cache_free(&r->caches[nvar]);
+        INA_MEM_FREE_SAFE(r->neq_chunks[nvar].chunks);
+        INA_MEM_FREE_SAFE(r->neq_chunks[nvar].csizes);
+        INA_MEM_FREE_SAFE(r->neq_chunks[nvar].needs_free);
+    }
+    INA_MEM_FREE_SAFE(r->dctxs);
+    INA_MEM_FREE_SAFE(r->caches);
+    INA_MEM_FREE_SAFE(r->neq_chunks);
+}
+
+// Stop the readers and free them, with the chunks they read that were not popped
+static void _iarray_eval_readers_stop(_iarray_eval_pipeline_t *p)
+{
+    int nvars = p->e->nvars;
+    for (int id = 0; id < p->nreaders; ++id) {
+        _iarray_eval_queue_close(&p->readers[id].queue);
+    }
+    for (int id = 0; id < p->nreaders; ++id) {
+        _iarray_eval_reader_t *r = &p->readers[id];
+        if (r->started) {
+            pthread_join(r->thread, NULL);
+        }
+        _iarray_eval_prefetch_t *item;
+        while ((item = _iarray_eval_queue_pop(&r->queue)) != NULL) {
+            _iarray_eval_prefetch_free(&item, nvars);
+        }
+        _iarray_eval_reader_free(r, nvars);
+    }
+    INA_MEM_FREE_SAFE(p->readers);
+}
+
+// `depth` chunks are read ahead (at least one per reader) and as many are written behind
+static ina_rc_t _iarray_eval_pipeline_start(iarray_expression_t *e, const iarray_expr_input_class_t *input_class,
+                                            int64_t nchunks, blosc2_schunk *out_sc, int nreaders, int depth,
+                                            _iarray_eval_pipeline_t **pipeline)
+{
+    int nvars = e->nvars;
+    _iarray_eval_pipeline_t *p = ina_mem_alloc(sizeof(_iarray_eval_pipeline_t));
+    ina_mem_set(p, 0, sizeof(_iarray_eval_pipeline_t));
+    p->e = e;
+    memcpy(p->input_class, input_class, nvars * sizeof(iarray_expr_input_class_t));
+    p->nchunks = nchunks;
+    p->out_sc = out_sc;
+    p->nreaders = nreaders;
+    p->readers = ina_mem_alloc(nreaders * sizeof(_iarray_eval_reader_t));
+    ina_mem_set(p->readers, 0, nreaders * sizeof(_iarray_eval_reader_t));
+    caterva_array_t *out = e->out->catarr;
+    for (int id = 0; id < nreaders; ++id) {
+        _iarray_eval_reader_t *r = &p->readers[id];
+        r->p = p;
+        r->id = id;
+        _iarray_eval_queue_init(&r->queue, INA_MAX(1, (depth + nreaders - 1) / nreaders));
+        r->dctxs = ina_mem_alloc(nvars * sizeof(blosc2_context *));
+        r->caches = ina_mem_alloc(nvars * sizeof(iarray_expr_block_cache_t));
+        r->neq_chunks = ina_mem_alloc(nvars * sizeof(iarray_expr_neq_chunks_t));
+        ina_mem_set(r->dctxs, 0, nvars * sizeof(blosc2_context *));
+        ina_mem_set(r->caches, 0, nvars * sizeof(iarray_expr_block_cache_t));
+        ina_mem_set(r->neq_chunks, 0, nvars * sizeof(iarray_expr_neq_chunks_t));
+        for (int nvar = 0; nvar < nvars; ++nvar) {
+            if (input_class[nvar] != IARRAY_EXPR_NEQ_CHUNK) {
+                continue;
+            }
+            caterva_array_t *catarr = e->vars[nvar].c->catarr;
+            blosc2_dparams dparams = {.nthreads = 1,
+                                      .schunk = catarr->sc,
+                                      .postfilter = catarr->sc->dctx->postfilter,
+                                      .postparams = catarr->sc->dctx->postparams,
+            };
+            r->dctxs[nvar] = blosc2_create_dctx(dparams);
+            _iarray_expr_block_cache_init(&r->caches[nvar], (int32_t) (catarr->blocknitems * catarr->itemsize));
+            iarray_expr_neq_chunks_t *neq = &r->neq_chunks[nvar];
+            int64_t max_nchunks = 1;
+            for (int i = 0; i < catarr->ndim; ++i) {
+                max_nchunks *= (out->chunkshape[i] + catarr->chunkshape[i] - 1) / catarr->chunkshape[i] + 1;
+            }
+            neq->chunks = ina_mem_alloc(max_nchunks * sizeof(uint8_t *));
+            neq->csizes = ina_mem_alloc(max_nchunks * sizeof(int32_t));
+            neq->needs_free = ina_mem_alloc(max_nchunks * sizeof(bool));
+        }
+    }
+    _iarray_eval_queue_init(&p->write_queue, depth);
+    for (int id = 0; id < nreaders; ++id) {
+        if (pthread_create(&p->readers[id].thread, NULL, _iarray_eval_reader, &p->readers[id]) != 0) {
+            goto fail;
+        }
+        p->readers[id].started = true;
+    }
+    if (pthread_create(&p->writer, NULL, _iarray_eval_writer, p) != 0) {
+        goto fail;
+    }
+    *pipeline = p;
+    return INA_SUCCESS;
+
+fail:
+    _iarray_eval_readers_stop(p);
+    _iarray_eval_queue_destroy(&p->write_queue);
+    INA_MEM_FREE_SAFE(p);
+    IARRAY_TRACE1(iarray.error, "Error creating the threads of the evaluation pipeline");
+    return INA_ERROR(INA_ERR_FAILED);
+}
+
+// Wait for the pending writes and stop the readers; returns an error if any write failed
+static ina_rc_t _iarray_eval_pipeline_stop(_iarray_eval_pipeline_t **pipeline)
+{
+    _iarray_eval_pipeline_t *p = *pipeline;
+    _iarray_eval_queue_close(&p->write_queue);
+    pthread_join(p->writer, NULL);
+    _iarray_eval_readers_stop(p);
+    bool write_failed = p->write_failed;
+    _iarray_eval_queue_destroy(&p->write_queue);
+    INA_MEM_FREE_SAFE(*pipeline);
+    if (write_failed) {
+        IARRAY_TRACE1(iarray.error, "Error updating a chunk in a blosc schunk");
+        return INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+    }
+    return INA_SUCCESS;
+}
 
-        strides[ret->dtshape->ndim - 1] = 1;
-        for (int i = ret->dtshape->ndim - 1; i >= 0; --i) {
-            shape[i] = (int32_t) out_value.block_shape[i];
-            start[i] = out_value.elem_index[i];
-            if (i != ret->dtshape->ndim - 1)
-                strides[i] = strides[i+1] * shape[i+1];
+#endif  // IARRAY_EVAL_PIPELINE
+
+
+/*
+ * When every input of the current chunk is a special chunk (zeros, NaNs, a repeated value or
+ * uninitialized), evaluate the kernel once on those values and leave one item per output in
+ * `values`.  Returns false when the chunk has to be evaluated normally.
+ */
+static bool _iarray_expr_special_eval(iarray_expression_t *e, iarray_expr_pparams_t *expr_pparams,
+                                      uint8_t **var_chunks, uint8_t *values, bool *uninit)
+{
+    int nvars = e->nvars;
+    if (nvars == 0 || e->index_vars) {
+        // The result depends on the position of the elements
+        return false;
+    }
+    *uninit = false;
+    uint8_t scalars[IARRAY_EXPR_OPERANDS_MAX][sizeof(double)];
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        if (expr_pparams->input_class[nvar] != IARRAY_EXPR_EQ &&
+            expr_pparams->input_class[nvar] != IARRAY_EXPR_EQ_NCOMP) {
+            return false;
+        }
+        iarray_container_t *var = e->vars[nvar].c;
+        if (var->container_viewed != NULL) {
+            // The chunks of a view may hold another dtype
+            return false;
+        }
+        uint8_t blosc2_flags = *(var_chunks[nvar] + BLOSC2_CHUNK_BLOSC2_FLAGS);
+        uint8_t special_value = (blosc2_flags >> 4) & BLOSC2_SPECIAL_MASK;
+        memset(scalars[nvar], 0, sizeof(double));
+        switch (special_value) {
+            case BLOSC2_SPECIAL_ZERO:
+                break;
+            case BLOSC2_SPECIAL_UNINIT:
+                // The result is undefined as well
+                *uninit = true;
+                break;
+            case BLOSC2_SPECIAL_NAN:
+                if (var->dtshape->dtype == IARRAY_DATA_TYPE_DOUBLE) {
+                    double nan = NAN;
+                    memcpy(scalars[nvar], &nan, sizeof(double));
+                } else if (var->dtshape->dtype == IARRAY_DATA_TYPE_FLOAT) {
+                    float nan = NAN;
+                    memcpy(scalars[nvar], &nan, sizeof(float));
+                } else {
+                    return false;
+                }
+                break;
+            case BLOSC2_SPECIAL_VALUE:
+                memcpy(scalars[nvar], var_chunks[nvar] + BLOSC_EXTENDED_HEADER_LENGTH, var->catarr->itemsize);
+                break;
+            default:
+                return false;
         }
-        eval_pparams.window_shape = shape;
-        eval_pparams.window_start = start;
-        eval_pparams.window_strides = strides;
+    }
 
-        int err = ((iarray_eval_fn) e->jug_expr_func)(&eval_pparams);
-        if (err != 0) {
-            return INA_ERROR(IARRAY_ERR_EVAL_ENGINE_FAILED);
+    int8_t ndim = e->out->dtshape->ndim;
+    int32_t window_shape[IARRAY_DIMENSION_MAX];
+    int32_t window_strides[IARRAY_DIMENSION_MAX];
+    int64_t window_start[IARRAY_DIMENSION_MAX];
+    for (int i = 0; i < ndim; ++i) {
+        window_shape[i] = 1;
+        window_strides[i] = 1;
+        window_start[i] = expr_pparams->out_value.block_index[i] * e->out->catarr->chunkshape[i];
+    }
+    iarray_eval_pparams_t eval_pparams = {0};
+    eval_pparams.ninputs = nvars;
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        eval_pparams.inputs[nvar] = scalars[nvar];
+        eval_pparams.input_typesizes[nvar] = expr_pparams->input_typesizes[nvar];
+    }
+    eval_pparams.user_data = expr_pparams;
+    eval_pparams.out = values;
+    eval_pparams.out_size = e->typesize;
+    eval_pparams.out_typesize = e->typesize;
+    eval_pparams.ndim = ndim;
+    eval_pparams.window_shape = window_shape;
+    eval_pparams.window_start = window_start;
+    eval_pparams.window_strides = window_strides;
+    for (unsigned int i = 0; i < e->nuser_params; i++) {
+        eval_pparams.user_params[i] = e->user_params[i];
+    }
+    eval_pparams.nouts = e->nouts;
+    for (int k = 0; k < e->nouts; ++k) {
+        eval_pparams.outs[k] = values + k * e->typesize;
+    }
+    return ((iarray_eval_fn) e->jug_expr_func)(&eval_pparams) == 0;
+}
+
+// Build a special chunk with `value` everywhere; returns its size or a negative value on errors
+static int _iarray_expr_special_chunk(iarray_expression_t *e, const uint8_t *value, bool uninit,
+                                      int32_t nbytes, uint8_t *dest, int32_t destsize)
+{
+    blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+    cparams.typesize = e->typesize;
+    if (uninit) {
+        return blosc2_chunk_uninit(cparams, nbytes, dest, destsize);
+    }
+    bool zeros = true;
+    for (int i = 0; i < e->typesize; ++i) {
+        if (value[i] != 0) {
+            zeros = false;
+            break;
         }
-        nitems_written += out_items;
     }
+    if (zeros) {
+        return blosc2_chunk_zeros(cparams, nbytes, dest, destsize);
+    }
+    bool nan = false;
+    if (e->out_dtshape->dtype == IARRAY_DATA_TYPE_DOUBLE) {
+        double v;
+        memcpy(&v, value, sizeof(double));
+        nan = isnan(v);
+    } else if (e->out_dtshape->dtype == IARRAY_DATA_TYPE_FLOAT) {
+        float v;
+        memcpy(&v, value, sizeof(float));
+        nan = isnan(v);
+    }
+    if (nan) {
+        return blosc2_chunk_nans(cparams, nbytes, dest, destsize);
+    }
+    return blosc2_chunk_repeatval(cparams, nbytes, dest, destsize, value);
+}
 
-    IARRAY_ITER_FINISH();
-    for (int nvar = 0; nvar < nvars; nvar++) {
-        iarray_iter_read_block_free(&(iter_var[nvar]));
+// Fill the part of a row-major buffer covered by an output chunk with `value`
+static void _iarray_expr_special_to_buffer(iarray_expression_t *e, const int64_t *chunk_index,
+                                           const uint8_t *value, uint8_t *buffer)
+{
+    caterva_array_t *out = e->out->catarr;
+    int8_t ndim = out->ndim;
+    int64_t start[IARRAY_DIMENSION_MAX];
+    int32_t shape[IARRAY_DIMENSION_MAX];
+    int32_t strides[IARRAY_DIMENSION_MAX];
+    for (int i = 0; i < ndim; ++i) {
+        start[i] = chunk_index[i] * out->chunkshape[i];
+        shape[i] = (int32_t) (start[i] + out->chunkshape[i] > out->shape[i] ? out->shape[i] - start[i] : out->chunkshape[i]);
+        strides[i] = 0;  // every row is the same one
     }
-    iarray_iter_write_block_free(&iter_out);
+    uint8_t *row = ina_mem_alloc(shape[ndim - 1] * e->typesize);
+    for (int i = 0; i < shape[ndim - 1]; ++i) {
+        memcpy(row + i * e->typesize, value, e->typesize);
+    }
+    _iarray_expr_block_to_buffer(e, row, start, shape, strides, buffer);
+    INA_MEM_FREE_SAFE(row);
+}
 
-    INA_MEM_FREE_SAFE(iter_var);
-    INA_MEM_FREE_SAFE(iter_value);
-    iarray_context_free(&ctx);
+// A thread computing the blocks of an output chunk straight into a plain buffer (see iarray_eval_to_buffer)
+typedef struct _iarray_eval_buffer_worker_s {
+    iarray_expr_pparams_t *expr_pparams;
+    int tid;
+    int nthreads;
+    int32_t nblocks;  // blocks in a chunk; this worker takes the ones from tid on, nthreads apart
+    int32_t blocksize;
+    int32_t typesize;
+    uint8_t *block;  // the result of a block, before the prefilter copies it into the buffer
+    int err;  // the first error returned by the prefilter
+#if defined(IARRAY_EVAL_PIPELINE)
+    pthread_t thread;
+#endif
+} _iarray_eval_buffer_worker_t;
 
-    IARRAY_RETURN_IF_FAILED(iarray_eval_cleanup(e, nitems_written));
+static void *_iarray_eval_buffer_blocks(void *arg)
+{
+    _iarray_eval_buffer_worker_t *w = arg;
+    // The prefilter of blosc without blosc: only the fields read by prefilter_func are set
+    blosc2_prefilter_params pparams = {0};
+    pparams.user_data = w->expr_pparams;
+    pparams.out = w->block;
+    pparams.out_size = w->blocksize;
+    pparams.out_typesize = w->typesize;
+    pparams.tid = w->tid;
+    w->err = 0;
+    for (int32_t nblock = w->tid; nblock < w->nblocks; nblock += w->nthreads) {
+        pparams.out_offset = nblock * w->blocksize;
+        w->err = prefilter_func(&pparams);
+        if (w->err != 0) {
+            break;
+        }
+    }
+    return NULL;
+}
 
+// Compute the blocks of the current output chunk into the buffer, spread over the workers
+static ina_rc_t _iarray_eval_buffer_chunk(_iarray_eval_buffer_worker_t *workers, int nworkers)
+{
+#if defined(IARRAY_EVAL_PIPELINE)
+    // The calling thread takes the blocks of the first worker
+    int nstarted = 1;
+    for (; nstarted < nworkers; ++nstarted) {
+        if (pthread_create(&workers[nstarted].thread, NULL, _iarray_eval_buffer_blocks, &workers[nstarted]) != 0) {
+            break;
+        }
+    }
+    _iarray_eval_buffer_blocks(&workers[0]);
+    for (int id = 1; id < nstarted; ++id) {
+        pthread_join(workers[id].thread, NULL);
+    }
+    // The blocks of the workers that could not be started are left to this thread
+    for (int id = nstarted; id < nworkers; ++id) {
+        _iarray_eval_buffer_blocks(&workers[id]);
+    }
+#else
+    for (int id = 0; id < nworkers; ++id) {
+        _iarray_eval_buffer_blocks(&workers[id]);
+    }
+#endif
+    for (int id = 0; id < nworkers; ++id) {
+        if (workers[id].err == -1) {
+            // Already traced by the prefilter
+            return INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+        }
+        if (workers[id].err != 0) {
+            return INA_ERROR(IARRAY_ERR_EVAL_ENGINE_FAILED);
+        }
+    }
     return INA_SUCCESS;
 }
 
-
-INA_API(ina_rc_t) iarray_eval_iterblosc(iarray_expression_t *e, iarray_container_t *ret, int64_t *out_chunkshape)
+/*
+ * Evaluate `e` chunk by chunk using the prefilter of blosc to compute the blocks in parallel.  When
+ * `out_buffer` is not NULL, the prefilter is run by our own threads without blosc, the blocks are only
+ * copied into it and `ret` just describes the partition (it has no super-chunk).
+ * When `chunk_inputs` is true, every operand is decompressed a whole chunk at a time through its own
+ * partition instead of block by block inside the prefilter.
+ */
+static ina_rc_t _iarray_eval_iterblosc(iarray_expression_t *e, iarray_container_t *ret, int64_t *out_chunkshape,
+                                       uint8_t *out_buffer, bool chunk_inputs)
 {
     int nvars = e->nvars;
 
@@ -608,44 +2559,27 @@ INA_API(ina_rc_t) iarray_eval_iterblosc(iarray_expression_t *e, iarray_container
     }
 
     // Determine the class of each container
-    iarray_container_t *out = e->out;
-    char *name = "zproxy_urlpath";
-    bool is_zproxy;
-    bool iterblosc_allowed;
     for (int nvar = 0; nvar < nvars; ++nvar) {
-        iterblosc_allowed = true;
-        iarray_container_t *var = e->vars[nvar].c;
-        IARRAY_RETURN_IF_FAILED(iarray_vlmeta_exists(e->ctx, e->vars[nvar].c, name, &is_zproxy));
-        if (is_zproxy || var->transposed) {
-            // If it is a zproxy or transposed, iterblosc cannot be used
-            iterblosc_allowed = false;
-        }
-        else {
-            if (var->container_viewed != NULL) {
-                // If shape is not the same we cannot use iterblosc
-                // See https://github.com/inaos/iron-array/issues/581
-                for (int i = 0; i < var->container_viewed->dtshape->ndim; ++i) {
-                    if (var->dtshape->shape[i] != var->container_viewed->dtshape->shape[i]) {
-                        iterblosc_allowed = false;
-                        break;
-                    }
-                }
-            }
+        if (e->vars[nvar].stencil) {
+            // Checked to be block readable when compiling
+            expr_pparams.input_class[nvar] = IARRAY_EXPR_STENCIL;
+            continue;
         }
-        if (iterblosc_allowed) {
-            for (int i = 0; i < var->dtshape->ndim; ++i) {
-                if (out->storage->chunkshape[i] != var->storage->chunkshape[i]) {
-                    iterblosc_allowed = false;
-                    break;
-                }
-                if (out->storage->blockshape[i] != var->storage->blockshape[i]) {
-                    iterblosc_allowed = false;
-                    break;
-                }
-            }
+        if (e->bcast_data[nvar] != NULL) {
+            expr_pparams.input_class[nvar] = IARRAY_EXPR_BCAST;
+            continue;
         }
+        bool iterblosc_allowed = false;
+        IARRAY_RETURN_IF_FAILED(_iarray_expr_block_compatible(e, e->vars[nvar].c, e->out->storage,
+                                                              &iterblosc_allowed));
         if (iterblosc_allowed == false) {
-            expr_pparams.input_class[nvar] = IARRAY_EXPR_NEQ;
+            bool block_readable = false;
+            IARRAY_RETURN_IF_FAILED(_iarray_expr_block_readable(e, e->vars[nvar].c, &block_readable));
+            if (!block_readable) {
+                expr_pparams.input_class[nvar] = IARRAY_EXPR_NEQ;
+            } else {
+                expr_pparams.input_class[nvar] = chunk_inputs ? IARRAY_EXPR_NEQ_CHUNK : IARRAY_EXPR_NEQ_BLOCK;
+            }
         }
         else {
             expr_pparams.input_class[nvar] = IARRAY_EXPR_EQ;
@@ -653,56 +2587,328 @@ INA_API(ina_rc_t) iarray_eval_iterblosc(iarray_expression_t *e, iarray_container
     }
     iarray_context_t *ctx = e->ctx;
 
-    // Need for not compatible containers
-    iarray_iter_read_block_t **iter_var = ina_mem_alloc(nvars * sizeof(iarray_iter_read_block_t));
-    iarray_iter_read_block_value_t *iter_value = ina_mem_alloc(nvars * sizeof(iarray_iter_read_block_value_t));
-    uint8_t **external_buffers = ina_mem_alloc(nvars * sizeof(void *));
-    for (int nvar = 0; nvar < nvars; nvar++) {
-        if (expr_pparams.input_class[nvar] == IARRAY_EXPR_NEQ) {
-            iarray_container_t *var = e->vars[nvar].c;
-            IARRAY_RETURN_IF_FAILED(iarray_iter_read_block_new(ctx, &iter_var[nvar], var, out_chunkshape, &iter_value[nvar],
-                                                               false));
-            external_buffers[nvar] = ina_mem_alloc(ret->catarr->extchunknitems * ret->catarr->itemsize);
-            iter_var[nvar]->padding = true;
+    // In the pipelined mode, reader threads fetch the chunks of the compatible inputs and gather the
+    // IARRAY_EXPR_NEQ_CHUNK ones ahead of this loop, and a writer thread stores the output chunks.
+#if defined(IARRAY_EVAL_PIPELINE)
+    // The chunks of an output that is also an operand (see iarray_eval_into) must be read before
+    // they are replaced, so they cannot be fetched and stored concurrently
+    bool aliased = false;
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        aliased = aliased || e->vars[nvar].c == ret;
+    }
+    // The readers get the inputs read ahead while this loop reads the mismatched and stencil ones,
+    // so a super-chunk bound both ways would be read concurrently
+    bool shared = false;
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        if (expr_pparams.input_class[nvar] != IARRAY_EXPR_EQ &&
+            expr_pparams.input_class[nvar] != IARRAY_EXPR_NEQ_CHUNK) {
+            continue;
+        }
+        for (int j = 0; j < nvars; ++j) {
+            if ((expr_pparams.input_class[j] == IARRAY_EXPR_NEQ || expr_pparams.input_class[j] == IARRAY_EXPR_NEQ_BLOCK ||
+                 expr_pparams.input_class[j] == IARRAY_EXPR_STENCIL) &&
+                e->vars[j].c->catarr->sc == e->vars[nvar].c->catarr->sc) {
+                shared = true;
+            }
+        }
+    }
+    bool pipelined = out_buffer == NULL && !aliased && !shared && ctx->cfg->eval_pipeline_depth > 0;
+#else
+    bool pipelined = false;
+#endif
+    if (!pipelined) {
+        // Without readers these are read by block inside the prefilter, as in ITERBLOSC
+        for (int nvar = 0; nvar < nvars; ++nvar) {
+            if (expr_pparams.input_class[nvar] == IARRAY_EXPR_NEQ_CHUNK) {
+                expr_pparams.input_class[nvar] = IARRAY_EXPR_NEQ_BLOCK;
+            }
+        }
+    }
+
+    // The stencil inputs of a container share the halo of the first one, which covers all their offsets
+    int8_t ndim = ret->dtshape->ndim;
+    expr_pparams.stencils = ina_mem_alloc(nvars * sizeof(iarray_expr_stencil_t));
+    ina_mem_set(expr_pparams.stencils, 0, nvars * sizeof(iarray_expr_stencil_t));
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        if (expr_pparams.input_class[nvar] != IARRAY_EXPR_STENCIL) {
+            continue;
+        }
+        iarray_expr_stencil_t *st = &expr_pparams.stencils[nvar];
+        st->owner = nvar;
+        for (int j = 0; j < nvar; ++j) {
+            if (expr_pparams.input_class[j] == IARRAY_EXPR_STENCIL && e->vars[j].c == e->vars[nvar].c) {
+                st->owner = j;
+                break;
+            }
+        }
+        iarray_expr_stencil_t *owner = &expr_pparams.stencils[st->owner];
+        for (int i = 0; i < ndim; ++i) {
+            owner->lo[i] = INA_MAX(owner->lo[i], -e->vars[nvar].offset[i]);
+            owner->hi[i] = INA_MAX(owner->hi[i], e->vars[nvar].offset[i]);
+        }
+    }
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        iarray_expr_stencil_t *st = &expr_pparams.stencils[nvar];
+        if (expr_pparams.input_class[nvar] != IARRAY_EXPR_STENCIL || st->owner != nvar) {
+            continue;
+        }
+        st->halo_nitems = 1;
+        for (int i = ndim - 1; i >= 0; --i) {
+            st->strides[i] = st->halo_nitems;
+            st->halo_nitems *= ret->catarr->blockshape[i] + st->lo[i] + st->hi[i];
+        }
+    }
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        if (expr_pparams.input_class[nvar] != IARRAY_EXPR_STENCIL) {
+            continue;
+        }
+        iarray_expr_stencil_t *st = &expr_pparams.stencils[nvar];
+        iarray_expr_stencil_t *owner = &expr_pparams.stencils[st->owner];
+        st->offset = 0;
+        for (int i = 0; i < ndim; ++i) {
+            st->offset += (int64_t) (owner->lo[i] + e->vars[nvar].offset[i]) * owner->strides[i];
+        }
+    }
+
+    // The chunks of the partition-mismatched inputs that overlap each output chunk (and its halo)
+    expr_pparams.neq_chunks = ina_mem_alloc(nvars * sizeof(iarray_expr_neq_chunks_t));
+    ina_mem_set(expr_pparams.neq_chunks, 0, nvars * sizeof(iarray_expr_neq_chunks_t));
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        bool stencil_owner = expr_pparams.input_class[nvar] == IARRAY_EXPR_STENCIL &&
+                             expr_pparams.stencils[nvar].owner == nvar;
+        if (expr_pparams.input_class[nvar] != IARRAY_EXPR_NEQ_BLOCK && !stencil_owner) {
+            continue;
+        }
+        iarray_expr_neq_chunks_t *neq = &expr_pparams.neq_chunks[nvar];
+        if (stencil_owner) {
+            memcpy(neq->margin_lo, expr_pparams.stencils[nvar].lo, sizeof(neq->margin_lo));
+            memcpy(neq->margin_hi, expr_pparams.stencils[nvar].hi, sizeof(neq->margin_hi));
+        }
+        caterva_array_t *catarr = e->vars[nvar].c->catarr;
+        int64_t max_nchunks = 1;
+        for (int i = 0; i < catarr->ndim; ++i) {
+            int64_t span = out_chunkshape[i] + neq->margin_lo[i] + neq->margin_hi[i];
+            max_nchunks *= (span + catarr->chunkshape[i] - 1) / catarr->chunkshape[i] + 1;
         }
+        neq->chunks = ina_mem_alloc(max_nchunks * sizeof(uint8_t *));
+        neq->csizes = ina_mem_alloc(max_nchunks * sizeof(int32_t));
+        neq->needs_free = ina_mem_alloc(max_nchunks * sizeof(bool));
     }
 
+    // Need for not compatible containers (their iterators are created once a failure can go to the cleanup)
+    iarray_iter_read_block_t **iter_var = ina_mem_alloc(nvars * sizeof(iarray_iter_read_block_t *));
+    iarray_iter_read_block_value_t *iter_value = ina_mem_alloc(nvars * sizeof(iarray_iter_read_block_value_t));
+    uint8_t **external_buffers = ina_mem_alloc(nvars * sizeof(void *));
+    ina_mem_set(iter_var, 0, nvars * sizeof(iarray_iter_read_block_t *));
+    ina_mem_set(external_buffers, 0, nvars * sizeof(void *));
+
     // Need for compatible containers
     uint8_t **var_chunks = ina_mem_alloc(nvars * sizeof(void*));
     bool *var_needs_free = ina_mem_alloc(nvars * sizeof(bool));
+    ina_mem_set(var_needs_free, 0, nvars * sizeof(bool));
+
+    // Per-thread pools of decompression contexts and scratch blocks for compatible containers.
+    // These are indexed by the prefilter tid, so the block loop does not need to allocate.
+    int pool_nthreads = out_buffer == NULL ? ret->catarr->sc->cctx->nthreads : 1;
+    if (pool_nthreads < ctx->cfg->max_num_threads) {
+        pool_nthreads = ctx->cfg->max_num_threads;
+    }
+    if (pool_nthreads < 1) {
+        pool_nthreads = 1;
+    }
+    expr_pparams.pool_nthreads = pool_nthreads;
+    expr_pparams.dctx_pool = ina_mem_alloc(pool_nthreads * nvars * sizeof(blosc2_context *));
+    expr_pparams.block_pool = ina_mem_alloc(pool_nthreads * nvars * sizeof(uint8_t *));
+    expr_pparams.cache_pool = ina_mem_alloc(pool_nthreads * nvars * sizeof(iarray_expr_block_cache_t));
+    ina_mem_set(expr_pparams.dctx_pool, 0, pool_nthreads * nvars * sizeof(blosc2_context *));
+    ina_mem_set(expr_pparams.block_pool, 0, pool_nthreads * nvars * sizeof(uint8_t *));
+    ina_mem_set(expr_pparams.cache_pool, 0, pool_nthreads * nvars * sizeof(iarray_expr_block_cache_t));
+    for (int tid = 0; tid < pool_nthreads; tid++) {
+        for (int nvar = 0; nvar < nvars; nvar++) {
+            bool stencil_owner = expr_pparams.input_class[nvar] == IARRAY_EXPR_STENCIL &&
+                                 expr_pparams.stencils[nvar].owner == nvar;
+            if (expr_pparams.input_class[nvar] == IARRAY_EXPR_NEQ_BLOCK || stencil_owner) {
+                caterva_array_t *catarr = e->vars[nvar].c->catarr;
+                _iarray_expr_block_cache_init(&expr_pparams.cache_pool[tid * nvars + nvar],
+                                              (int32_t) (catarr->blocknitems * catarr->itemsize));
+            } else if (expr_pparams.input_class[nvar] != IARRAY_EXPR_EQ) {
+                continue;
+            }
+            blosc2_schunk *schunk = e->vars[nvar].c->catarr->sc;
+            blosc2_dparams dparams = {.nthreads = 1,
+                                      .schunk = schunk,
+                                      .postfilter = schunk->dctx->postfilter,
+                                      .postparams = schunk->dctx->postparams,
+            };
+            expr_pparams.dctx_pool[tid * nvars + nvar] = blosc2_create_dctx(dparams);
+            int32_t pool_blocksize = (int32_t) (ret->catarr->blocknitems * e->vars[nvar].c->catarr->itemsize);
+            if (stencil_owner) {
+                pool_blocksize = (int32_t) (expr_pparams.stencils[nvar].halo_nitems * e->vars[nvar].c->catarr->itemsize);
+            }
+            expr_pparams.block_pool[tid * nvars + nvar] = ina_mem_alloc_aligned(64, pool_blocksize);
+        }
+    }
+
 
+    // The prefilter writes the outputs other than the first one into uncompressed chunks,
+    // which are compressed and stored after the first output has been computed
+    int32_t out_chunksize = (int32_t) ret->catarr->extchunknitems * e->typesize;
+    expr_pparams.nouts = e->nouts;
+    for (int k = 1; k < e->nouts; ++k) {
+        expr_pparams.outs[k] = ina_mem_alloc_aligned(64, out_chunksize);
+    }
 
     // Write iterator for output
     ctx->prefilter_fn = (blosc2_prefilter_fn)prefilter_func;
     ctx->prefilter_params = &pparams;
 
-    iarray_iter_write_block_t *iter_out;
+    iarray_iter_write_block_t *iter_out = NULL;
     iarray_iter_write_block_value_t out_value;
-    int32_t external_buffer_size = (int32_t) (ret->catarr->extchunknitems * ret->catarr->sc->typesize + BLOSC2_MAX_OVERHEAD);
+    int32_t external_buffer_size = (int32_t) (ret->catarr->extchunknitems * ret->catarr->itemsize + BLOSC2_MAX_OVERHEAD);
     void *external_buffer = NULL;  // to inform the iterator that we are passing an external buffer
-    IARRAY_RETURN_IF_FAILED(iarray_iter_write_block_new(ctx, &iter_out, ret, out_chunkshape, &out_value, true));
+
+    // When writing to a plain buffer there is no output container to iterate: walk the chunks in the
+    // same order and run the prefilter for every block in as many workers as threads, with no blosc.
+    // The pipelined mode walks the chunks in the same way too.
+    ina_rc_t rc;
+    _iarray_eval_buffer_worker_t *buffer_workers = NULL;
+    int64_t nchunks = 1;
+    int64_t chunks_shape[IARRAY_DIMENSION_MAX];
+    int64_t chunk_index[IARRAY_DIMENSION_MAX];
+    expr_pparams.out_buffer = out_buffer;
+#if defined(IARRAY_EVAL_PIPELINE)
+    _iarray_eval_pipeline_t *pipeline = NULL;
+    _iarray_eval_prefetch_t *prefetched = NULL;
+#endif
+    for (int nvar = 0; nvar < nvars; nvar++) {
+        if (expr_pparams.input_class[nvar] == IARRAY_EXPR_NEQ) {
+            iarray_container_t *var = e->vars[nvar].c;
+            rc = iarray_iter_read_block_new(ctx, &iter_var[nvar], var, out_chunkshape, &iter_value[nvar], false);
+            INA_FAIL_IF_ERROR(rc);
+            external_buffers[nvar] = ina_mem_alloc(ret->catarr->extchunknitems * var->catarr->itemsize);
+            iter_var[nvar]->padding = true;
+        }
+    }
+    bool use_iter = out_buffer == NULL && !pipelined;
+    if (use_iter) {
+        rc = iarray_iter_write_block_new(ctx, &iter_out, ret, out_chunkshape, &out_value, true);
+        INA_FAIL_IF_ERROR(rc);
+    } else {
+        for (int i = 0; i < ret->dtshape->ndim; ++i) {
+            chunks_shape[i] = ret->catarr->extshape[i] / ret->catarr->chunkshape[i];
+            nchunks *= chunks_shape[i];
+        }
+        out_value.block_index = chunk_index;
+    }
+#if defined(IARRAY_EVAL_PIPELINE)
+    if (pipelined) {
+        // The operands that have to be gathered get as many readers as threads
+        int nreaders = 1;
+        for (int nvar = 0; nvar < nvars; ++nvar) {
+            if (expr_pparams.input_class[nvar] == IARRAY_EXPR_NEQ_CHUNK) {
+                nreaders = INA_MAX(1, ctx->cfg->max_num_threads);
+            }
+        }
+        int depth = ctx->cfg->eval_pipeline_depth;
+        rc = _iarray_eval_pipeline_start(e, expr_pparams.input_class, nchunks, ret->catarr->sc, nreaders, depth,
+                                         &pipeline);
+        INA_FAIL_IF_ERROR(rc);
+    }
+#endif
+    if (out_buffer != NULL) {
+        // One worker per pool thread, so every one of them reads through its own pools
+        buffer_workers = ina_mem_alloc(pool_nthreads * sizeof(_iarray_eval_buffer_worker_t));
+        ina_mem_set(buffer_workers, 0, pool_nthreads * sizeof(_iarray_eval_buffer_worker_t));
+        for (int id = 0; id < pool_nthreads; ++id) {
+            _iarray_eval_buffer_worker_t *w = &buffer_workers[id];
+            w->expr_pparams = &expr_pparams;
+            w->tid = id;
+            w->nthreads = pool_nthreads;
+            w->nblocks = (int32_t) (ret->catarr->extchunknitems / ret->catarr->blocknitems);
+            w->typesize = e->typesize;
+            w->blocksize = ret->catarr->blocknitems * e->typesize;
+            w->block = ina_mem_alloc_aligned(64, w->blocksize);
+        }
+    }
 
     // Evaluate the expression for all the chunks in variables
     int64_t nchunk = 0;
-    while (INA_SUCCEED(iarray_iter_write_block_has_next(iter_out))) {
-        // The external buffer is needed *inside* the write iterator because
-        // this will end as a (realloc'ed) compressed chunk of a final container
-        // (we do so in order to avoid copies as much as possible)
-        // calloc to keep unwritten values as zeros
-        external_buffer = calloc(1, external_buffer_size);
+    while (use_iter ? INA_SUCCEED(iarray_iter_write_block_has_next(iter_out)) : nchunk < nchunks) {
+        if (use_iter) {
+            // The external buffer is needed *inside* the write iterator because
+            // this will end as a (realloc'ed) compressed chunk of a final container
+            // (we do so in order to avoid copies as much as possible)
+            // calloc to keep unwritten values as zeros
+            external_buffer = calloc(1, external_buffer_size);
+
+            rc = iarray_iter_write_block_next(iter_out, external_buffer, external_buffer_size);
+            INA_FAIL_IF_ERROR(rc);
+        } else {
+            iarray_index_unidim_to_multidim_shape(ret->dtshape->ndim, chunks_shape, nchunk, chunk_index);
+            if (pipelined) {
+                // The writer thread takes this one
+                external_buffer = calloc(1, external_buffer_size);
+                out_value.block_pointer = external_buffer;
+            }
+        }
 
-        IARRAY_RETURN_IF_FAILED(iarray_iter_write_block_next(iter_out, external_buffer, external_buffer_size));
+#if defined(IARRAY_EVAL_PIPELINE)
+        if (pipelined) {
+            prefetched = _iarray_eval_queue_pop(&pipeline->readers[nchunk % pipeline->nreaders].queue);
+            if (prefetched == NULL || prefetched->error < 0) {
+                IARRAY_TRACE1(iarray.error, "Error in retrieving chunk from schunk");
+                rc = INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+                goto fail;
+            }
+        }
+#endif
 
         // int32_t out_items = (int32_t)(iter_out->cur_block_size);  // TODO: add a protection against cur_block_size > 2**31
 
         // Get the chunk for each variable
         for (int nvar = 0; nvar < nvars; nvar++) {
+            if (expr_pparams.input_class[nvar] == IARRAY_EXPR_BCAST) {
+                continue;
+            }
+            if (expr_pparams.input_class[nvar] == IARRAY_EXPR_NEQ_BLOCK ||
+                expr_pparams.input_class[nvar] == IARRAY_EXPR_STENCIL) {
+                // The prefilter reads the blocks it needs from these chunks
+                if (expr_pparams.input_class[nvar] == IARRAY_EXPR_NEQ_BLOCK ||
+                    expr_pparams.stencils[nvar].owner == nvar) {
+                    _iarray_expr_neq_release(&expr_pparams.neq_chunks[nvar]);
+                    rc = _iarray_expr_neq_fetch(e, nvar, &expr_pparams.neq_chunks[nvar], out_value.block_index);
+                    INA_FAIL_IF_ERROR(rc);
+                }
+                continue;
+            }
+#if defined(IARRAY_EVAL_PIPELINE)
+            if (expr_pparams.input_class[nvar] == IARRAY_EXPR_NEQ_CHUNK) {
+                // Already in the layout of the output chunk; it stays in the prefetched item
+                expr_pparams.inputs[nvar] = prefetched->windows[nvar];
+                continue;
+            }
+#endif
             if (expr_pparams.input_class[nvar] != IARRAY_EXPR_NEQ) {
                 blosc2_schunk *schunk = e->vars[nvar].c->catarr->sc;
-                int csize = blosc2_schunk_get_lazychunk(schunk, nchunk, &var_chunks[nvar], &var_needs_free[nvar]);
+                int csize;
+#if defined(IARRAY_EVAL_PIPELINE)
+                if (pipelined) {
+                    // Moved out of the prefetched item, which only frees what is left in it
+                    var_chunks[nvar] = prefetched->chunks[nvar];
+                    var_needs_free[nvar] = prefetched->needs_free[nvar];
+                    csize = prefetched->csizes[nvar];
+                    prefetched->chunks[nvar] = NULL;
+                    prefetched->needs_free[nvar] = false;
+                } else
+#endif
+                {
+                    csize = blosc2_schunk_get_lazychunk(schunk, nchunk, &var_chunks[nvar], &var_needs_free[nvar]);
+                }
                 if (csize < 0) {
+                    var_needs_free[nvar] = false;
                     IARRAY_TRACE1(iarray.error, "Error in retrieving chunk from schunk");
-                    return INA_ERROR(INA_ERR_NOT_SUPPORTED);
+                    rc = INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+                    goto fail;
                 }
                 bool memcpyed = *(var_chunks[nvar] + 2) & (uint8_t)BLOSC_MEMCPYED;
                 if (memcpyed && schunk->storage->urlpath == NULL) {
@@ -713,12 +2919,17 @@ INA_API(ina_rc_t) iarray_eval_iterblosc(iarray_expression_t *e, iarray_container
                 expr_pparams.inputs[nvar] = var_chunks[nvar];
                 expr_pparams.input_csizes[nvar] = csize;
             } else {
-                IARRAY_RETURN_IF_FAILED(iarray_iter_read_block_next(iter_var[nvar], NULL, 0));
-                IARRAY_ERR_CATERVA(caterva_blosc_array_repart_chunk((int8_t *) external_buffers[nvar],
-                                                                    ret->catarr->extchunknitems * ret->catarr->itemsize,
-                                                                    iter_value[nvar].block_pointer,
-                                                                    ret->catarr->chunknitems * ret->catarr->itemsize,
-                                                                    ret->catarr));
+                rc = iarray_iter_read_block_next(iter_var[nvar], NULL, 0);
+                INA_FAIL_IF_ERROR(rc);
+                int32_t var_itemsize = (int32_t) e->vars[nvar].c->catarr->itemsize;
+                if (caterva_blosc_array_repart_chunk((int8_t *) external_buffers[nvar],
+                                                     ret->catarr->extchunknitems * var_itemsize,
+                                                     iter_value[nvar].block_pointer,
+                                                     ret->catarr->chunknitems * var_itemsize,
+                                                     var_itemsize, ret->catarr) != CATERVA_SUCCEED) {
+                    rc = INA_ERROR(IARRAY_ERR_CATERVA_FAILED);
+                    goto fail;
+                }
                 expr_pparams.inputs[nvar] = external_buffers[nvar];
             }
         }
@@ -726,45 +2937,171 @@ INA_API(ina_rc_t) iarray_eval_iterblosc(iarray_expression_t *e, iarray_container
         // Eval the expression for this chunk
         expr_pparams.out_value = out_value;  // useful for the prefilter function
 
-        // Assign the prefilter to the super-chunk context
-        blosc2_context *cctx = ret->catarr->sc->cctx;
-        blosc2_prefilter_fn old_prefilter = cctx->prefilter;
-        blosc2_prefilter_params *old_pparams = cctx->preparams;
-        cctx->prefilter = ctx->prefilter_fn;
-        cctx->preparams = ctx->prefilter_params;
-        // Do the compression with prefilters
-        int csize = blosc2_compress_ctx(cctx, NULL, (int32_t)ret->catarr->extchunknitems * e->typesize,
+        // Chunks where all the inputs are special values are evaluated only once
+        uint8_t special_values[IARRAY_EXPR_OUTPUTS_MAX * sizeof(double)];
+        bool special_uninit;
+        bool special = _iarray_expr_special_eval(e, &expr_pparams, var_chunks, special_values, &special_uninit);
+
+        int csize;
+        bool filled = false;  // whether the chunk went straight into out_buffer
+        if (special && out_buffer != NULL) {
+            _iarray_expr_special_to_buffer(e, out_value.block_index, special_values, out_buffer);
+            filled = true;
+            csize = 0;
+        } else if (special) {
+            csize = _iarray_expr_special_chunk(e, special_values, special_uninit,
+                                               (int32_t) ret->catarr->extchunknitems * e->typesize,
+                                               out_value.block_pointer, external_buffer_size);
+        } else if (out_buffer != NULL) {
+            rc = _iarray_eval_buffer_chunk(buffer_workers, pool_nthreads);
+            INA_FAIL_IF_ERROR(rc);
+            filled = true;
+            csize = 0;
+        } else {
+            // Assign the prefilter to the super-chunk context
+            blosc2_context *cctx = ret->catarr->sc->cctx;
+            blosc2_prefilter_fn old_prefilter = cctx->prefilter;
+            blosc2_prefilter_params *old_pparams = cctx->preparams;
+            cctx->prefilter = ctx->prefilter_fn;
+            cctx->preparams = ctx->prefilter_params;
+            // Do the compression with prefilters
+            csize = blosc2_compress_ctx(cctx, NULL, (int32_t)ret->catarr->extchunknitems * e->typesize,
                                         out_value.block_pointer,
                                         (int32_t)ret->catarr->extchunknitems * e->typesize + BLOSC2_MAX_OVERHEAD);
-        // Reset prefilters to a possible previous value
-        cctx->prefilter = old_prefilter;
-        cctx->preparams = old_pparams;
+            // Reset prefilters to a possible previous value
+            cctx->prefilter = old_prefilter;
+            cctx->preparams = old_pparams;
+        }
 
-        if (csize <= 0) {
+        if (!filled && csize <= 0) {
             IARRAY_TRACE1(iarray.error, "Error compressing a blosc chunk");
-            return INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+            rc = INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+            goto fail;
+        }
+#if defined(IARRAY_EVAL_PIPELINE)
+        if (pipelined) {
+            _iarray_eval_written_t *written = ina_mem_alloc(sizeof(_iarray_eval_written_t));
+            written->nchunk = nchunk;
+            written->chunk = realloc(external_buffer, csize);
+            external_buffer = NULL;
+            _iarray_eval_queue_push(&pipeline->write_queue, written);
+        }
+#endif
+
+        for (int k = 1; k < e->nouts; ++k) {
+            blosc2_schunk *out_sc = e->outs[k]->catarr->sc;
+            // The super-chunk takes ownership of the compressed chunk
+            uint8_t *out_chunk = malloc(out_chunksize + BLOSC2_MAX_OVERHEAD);
+            int out_csize;
+            if (special) {
+                out_csize = _iarray_expr_special_chunk(e, special_values + k * e->typesize, special_uninit,
+                                                       out_chunksize, out_chunk, out_chunksize + BLOSC2_MAX_OVERHEAD);
+            } else {
+                out_csize = blosc2_compress_ctx(out_sc->cctx, expr_pparams.outs[k], out_chunksize,
+                                                out_chunk, out_chunksize + BLOSC2_MAX_OVERHEAD);
+            }
+            if (out_csize <= 0) {
+                free(out_chunk);
+                IARRAY_TRACE1(iarray.error, "Error compressing a blosc chunk");
+                rc = INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+                goto fail;
+            }
+            if (blosc2_schunk_update_chunk(out_sc, nchunk, out_chunk, false) < 0) {
+                IARRAY_TRACE1(iarray.error, "Error updating a chunk in a blosc schunk");
+                rc = INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
+                goto fail;
+            }
         }
 
         // Free temporary chunks
         for (int nvar = 0; nvar < e->nvars; nvar++) {
-            if (var_needs_free[nvar] && expr_pparams.input_class[nvar] != IARRAY_EXPR_NEQ) {
+            if (var_needs_free[nvar]) {
                 free(var_chunks[nvar]);
+                var_needs_free[nvar] = false;
             }
         }
+#if defined(IARRAY_EVAL_PIPELINE)
+        if (prefetched != NULL) {
+            _iarray_eval_prefetch_free(&prefetched, nvars);
+        }
+#endif
 
-        iter_out->compressed_chunk_buffer = true;
+        if (use_iter) {
+            iter_out->compressed_chunk_buffer = true;
+        }
         nchunk += 1;
     }
 
-    IARRAY_ITER_FINISH();
-    iarray_iter_write_block_free(&iter_out);
+    if (use_iter) {
+        // As IARRAY_ITER_FINISH, but going through the cleanup
+        if (ina_err_get_rc() != INA_RC_PACK(IARRAY_ERR_END_ITER, 0)) {
+            rc = INA_ERROR(IARRAY_ERR_NOT_END_ITER);
+            goto fail;
+        }
+        ina_err_reset();
+    }
+    rc = INA_SUCCESS;
+
+fail:
+    if (iter_out != NULL) {
+        iarray_iter_write_block_free(&iter_out);
+    }
+    // The chunks of the compatible inputs for the chunk that failed, if any
+    for (int nvar = 0; nvar < nvars; nvar++) {
+        if (var_needs_free[nvar]) {
+            free(var_chunks[nvar]);
+        }
+    }
+#if defined(IARRAY_EVAL_PIPELINE)
+    if (prefetched != NULL) {
+        _iarray_eval_prefetch_free(&prefetched, nvars);
+    }
+    if (pipeline != NULL) {
+        ina_rc_t rc_pipeline = _iarray_eval_pipeline_stop(&pipeline);
+        if (INA_SUCCEED(rc)) {
+            rc = rc_pipeline;
+        }
+    }
+#endif
+    if (buffer_workers != NULL) {
+        for (int id = 0; id < pool_nthreads; ++id) {
+            INA_MEM_FREE_SAFE(buffer_workers[id].block);
+        }
+        INA_MEM_FREE_SAFE(buffer_workers);
+    }
+    if (!use_iter) {
+        // A chunk that never reached the writer
+        free(external_buffer);
+    }
 
     // Free initialized iterators
     for (int nvar = 0; nvar < nvars; ++nvar) {
-        if (expr_pparams.input_class[nvar] == IARRAY_EXPR_NEQ) {
+        if (iter_var[nvar] != NULL) {
             iarray_iter_read_block_free(&iter_var[nvar]);
-            ina_mem_free(external_buffers[nvar]);
         }
+        INA_MEM_FREE_SAFE(external_buffers[nvar]);
+    }
+    for (int i = 0; i < pool_nthreads * nvars; ++i) {
+        if (expr_pparams.dctx_pool[i] != NULL) {
+            blosc2_free_ctx(expr_pparams.dctx_pool[i]);
+        }
+        INA_MEM_FREE_SAFE(expr_pparams.block_pool[i]);
+        _iarray_expr_block_cache_free(&expr_pparams.cache_pool[i]);
+    }
+    INA_MEM_FREE_SAFE(expr_pparams.dctx_pool);
+    INA_MEM_FREE_SAFE(expr_pparams.block_pool);
+    INA_MEM_FREE_SAFE(expr_pparams.cache_pool);
+    for (int nvar = 0; nvar < nvars; ++nvar) {
+        iarray_expr_neq_chunks_t *neq = &expr_pparams.neq_chunks[nvar];
+        _iarray_expr_neq_release(neq);
+        INA_MEM_FREE_SAFE(neq->chunks);
+        INA_MEM_FREE_SAFE(neq->csizes);
+        INA_MEM_FREE_SAFE(neq->needs_free);
+    }
+    INA_MEM_FREE_SAFE(expr_pparams.neq_chunks);
+    INA_MEM_FREE_SAFE(expr_pparams.stencils);
+    for (int k = 1; k < e->nouts; ++k) {
+        INA_MEM_FREE_SAFE(expr_pparams.outs[k]);
     }
     INA_MEM_FREE_SAFE(external_buffers);
     INA_MEM_FREE_SAFE(var_chunks);
@@ -773,20 +3110,25 @@ INA_API(ina_rc_t) iarray_eval_iterblosc(iarray_expression_t *e, iarray_container
     INA_MEM_FREE_SAFE(iter_var);
     INA_MEM_FREE_SAFE(iter_value);
 
-    return INA_SUCCESS;
+    return rc;
 }
 
 
-INA_API(ina_rc_t) iarray_eval(iarray_expression_t *e, iarray_container_t **container)
+INA_API(ina_rc_t) iarray_eval_iterchunk(iarray_expression_t *e, iarray_container_t *ret, int64_t *out_chunkshape)
 {
-    INA_VERIFY_NOT_NULL(e);
-    INA_VERIFY_NOT_NULL(container);
+    // The operands with the partition of the output are read as in ITERBLOSC.  With a pipeline, the
+    // rest are gathered a whole output chunk at a time by as many reader threads as threads, ahead of
+    // the kernel; without it, ITERCHUNK is the same as ITERBLOSC.
+    return _iarray_eval_iterblosc(e, ret, out_chunkshape, NULL, true);
+}
 
-    IARRAY_RETURN_IF_FAILED(iarray_empty(e->ctx, e->out_dtshape, e->out_store_properties,
-                                         container));
-    e->out = *container;
-    iarray_container_t *ret = *container;
+INA_API(ina_rc_t) iarray_eval_iterblosc(iarray_expression_t *e, iarray_container_t *ret, int64_t *out_chunkshape)
+{
+    return _iarray_eval_iterblosc(e, ret, out_chunkshape, NULL, false);
+}
 
+static ina_rc_t _iarray_eval_dispatch(iarray_expression_t *e, iarray_container_t *ret)
+{
     int64_t out_chunkshape[IARRAY_DIMENSION_MAX];
     for (int i = 0; i < ret->dtshape->ndim; ++i) {
         out_chunkshape[i] = ret->storage->chunkshape[i];
@@ -794,20 +3136,198 @@ INA_API(ina_rc_t) iarray_eval(iarray_expression_t *e, iarray_container_t **conta
 
     uint32_t eval_method = e->ctx->cfg->eval_method & 0x3u;
 
+    IARRAY_RETURN_IF_FAILED(_iarray_expr_bcast_prepare(e));
+    ina_rc_t rc;
     switch (eval_method) {
         case IARRAY_EVAL_METHOD_ITERCHUNK:
-            IARRAY_RETURN_IF_FAILED( iarray_eval_iterchunk(e, ret, out_chunkshape));
+            rc = iarray_eval_iterchunk(e, ret, out_chunkshape);
             break;
         case IARRAY_EVAL_METHOD_ITERBLOSC:
-            IARRAY_RETURN_IF_FAILED(iarray_eval_iterblosc(e, ret, out_chunkshape));
+            rc = iarray_eval_iterblosc(e, ret, out_chunkshape);
             break;
         default:
             IARRAY_TRACE1(iarray.error, "Invalid eval method");
-            return INA_ERROR(IARRAY_ERR_INVALID_EVAL_METHOD);
+            rc = INA_ERROR(IARRAY_ERR_INVALID_EVAL_METHOD);
+    }
+    _iarray_expr_bcast_free(e);
+    return rc;
+}
+
+INA_API(ina_rc_t) iarray_eval(iarray_expression_t *e, iarray_container_t **container)
+{
+    INA_VERIFY_NOT_NULL(e);
+    INA_VERIFY_NOT_NULL(container);
+
+    if (e->nouts != 1) {
+        IARRAY_TRACE1(iarray.error, "Multi-output expressions must be evaluated with iarray_eval_multi");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+
+    IARRAY_RETURN_IF_FAILED(iarray_empty(e->ctx, e->out_dtshape, e->out_store_properties,
+                                         container));
+    e->out = *container;
+    e->outs[0] = *container;
+
+    IARRAY_RETURN_IF_FAILED(_iarray_eval_dispatch(e, *container));
+    return INA_SUCCESS;
+}
+
+INA_API(ina_rc_t) iarray_eval_into(iarray_expression_t *e, iarray_container_t *container)
+{
+    INA_VERIFY_NOT_NULL(e);
+    INA_VERIFY_NOT_NULL(container);
+
+    if (e->nouts != 1) {
+        IARRAY_TRACE1(iarray.error, "Multi-output expressions must be evaluated with iarray_eval_multi");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    if (!_iarray_expr_same_dtshape(container->dtshape, e->out_dtshape)) {
+        IARRAY_TRACE1(iarray.error, "The container must have the dtype and shape of the output");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    if (container->container_viewed != NULL) {
+        IARRAY_TRACE1(iarray.error, "A view can not be rewritten");
+        return INA_ERROR(IARRAY_ERR_INVALID_STORAGE);
+    }
+
+    // Every chunk of the output is computed from the same chunk of its operands and replaced right
+    // after, so the container can only be read element-wise: no stencils and no views over it
+    for (int nvar = 0; nvar < e->nvars; ++nvar) {
+        iarray_container_t *var = e->vars[nvar].c;
+        if (var == container && e->vars[nvar].stencil) {
+            IARRAY_TRACE1(iarray.error, "The container cannot be read at an offset while it is rewritten");
+            return INA_ERROR(INA_ERR_NOT_SUPPORTED);
+        }
+        if (var != container && var->container_viewed == container) {
+            IARRAY_TRACE1(iarray.error, "The container cannot be read through a view while it is rewritten");
+            return INA_ERROR(INA_ERR_NOT_SUPPORTED);
+        }
+    }
+
+    iarray_container_t *prev_out = e->out;
+    e->out = container;
+    e->outs[0] = container;
+    ina_rc_t rc = _iarray_eval_dispatch(e, container);
+    e->out = prev_out;
+    e->outs[0] = prev_out;
+
+    // The chunks cached by previous reads of the container are stale now
+    container->catarr->chunk_cache.nchunk = -1;
+    INA_MEM_FREE_SAFE(container->catarr->chunk_cache.data);
+    IARRAY_RETURN_IF_FAILED(rc);
+    return INA_SUCCESS;
+}
+
+INA_API(ina_rc_t) iarray_eval_multi(iarray_expression_t *e,
+                                    iarray_storage_t *storages,
+                                    iarray_container_t **containers)
+{
+    INA_VERIFY_NOT_NULL(e);
+    INA_VERIFY_NOT_NULL(containers);
+
+    if (storages != NULL) {
+        // All the outputs are computed block by block from the same window
+        for (int k = 0; k < e->nouts; ++k) {
+            for (int i = 0; i < e->out_dtshape->ndim; ++i) {
+                if (storages[k].chunkshape[i] != e->out_store_properties->chunkshape[i] ||
+                    storages[k].blockshape[i] != e->out_store_properties->blockshape[i]) {
+                    IARRAY_TRACE1(iarray.error, "The outputs must have the chunkshape and blockshape of the expression");
+                    return INA_ERROR(IARRAY_ERR_INVALID_STORAGE);
+                }
+            }
+        }
+    }
+
+    ina_rc_t rc;
+    int nouts = 0;
+    for (; nouts < e->nouts; ++nouts) {
+        iarray_storage_t *storage = storages != NULL ? &storages[nouts] : e->out_store_properties;
+        if (storages == NULL && nouts > 0 && storage->urlpath != NULL) {
+            IARRAY_TRACE1(iarray.error, "The outputs cannot share the urlpath of the bound output properties");
+            rc = INA_ERROR(IARRAY_ERR_INVALID_STORAGE);
+            goto fail;
+        }
+        rc = iarray_empty(e->ctx, e->out_dtshape, storage, &containers[nouts]);
+        INA_FAIL_IF_ERROR(rc);
+        e->outs[nouts] = containers[nouts];
     }
+    e->out = containers[0];
+
+    rc = _iarray_eval_dispatch(e, containers[0]);
+    INA_FAIL_IF_ERROR(rc);
+
     return INA_SUCCESS;
+
+fail:
+    for (int k = 0; k < nouts; ++k) {
+        iarray_container_free(e->ctx, &containers[k]);
+    }
+    return rc;
 }
 
+INA_API(ina_rc_t) iarray_eval_to_buffer(iarray_expression_t *e, void *buffer, int64_t buflen)
+{
+    INA_VERIFY_NOT_NULL(e);
+    INA_VERIFY_NOT_NULL(buffer);
+
+    if (e->nouts != 1) {
+        IARRAY_TRACE1(iarray.error, "Multi-output expressions must be evaluated with iarray_eval_multi");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    if (buflen < e->nbytes) {
+        IARRAY_TRACE1(iarray.error, "The buffer is smaller than the result of the expression");
+        return INA_ERROR(IARRAY_ERR_TOO_SMALL_BUFFER);
+    }
+
+    // Nothing is ever stored in the output, so it is only the chunk and block partition (the same that
+    // caterva would compute) with no super-chunk behind
+    int8_t ndim = e->out_dtshape->ndim;
+    caterva_array_t catarr;
+    ina_mem_set(&catarr, 0, sizeof(caterva_array_t));
+    catarr.ndim = ndim;
+    catarr.itemsize = (uint8_t) e->typesize;
+    catarr.nitems = 1;
+    catarr.extnitems = 1;
+    catarr.chunknitems = 1;
+    catarr.extchunknitems = 1;
+    catarr.blocknitems = 1;
+    int64_t out_chunkshape[IARRAY_DIMENSION_MAX];
+    for (int i = 0; i < ndim; ++i) {
+        int64_t shape = e->out_dtshape->shape[i];
+        int32_t chunkshape = (int32_t) e->out_store_properties->chunkshape[i];
+        int32_t blockshape = (int32_t) e->out_store_properties->blockshape[i];
+        catarr.shape[i] = shape;
+        catarr.chunkshape[i] = chunkshape;
+        catarr.blockshape[i] = blockshape;
+        catarr.extshape[i] = (shape + chunkshape - 1) / chunkshape * chunkshape;
+        catarr.extchunkshape[i] = (chunkshape + blockshape - 1) / blockshape * blockshape;
+        catarr.nitems *= catarr.shape[i];
+        catarr.extnitems *= catarr.extshape[i];
+        catarr.chunknitems *= catarr.chunkshape[i];
+        catarr.extchunknitems *= catarr.extchunkshape[i];
+        catarr.blocknitems *= catarr.blockshape[i];
+        out_chunkshape[i] = chunkshape;
+    }
+    iarray_container_t out = {0};
+    out.dtshape = e->out_dtshape;
+    out.storage = e->out_store_properties;
+    out.catarr = &catarr;
+    iarray_container_t *prev_out = e->out;
+    e->out = &out;
+    e->outs[0] = &out;
+
+    // The blocks are scattered from the prefilter, so this works the same for every eval method
+    ina_rc_t rc;
+    rc = _iarray_expr_bcast_prepare(e);
+    if (INA_SUCCEED(rc)) {
+        rc = _iarray_eval_iterblosc(e, &out, out_chunkshape, (uint8_t *) buffer, false);
+    }
+    _iarray_expr_bcast_free(e);
+
+    e->out = prev_out;
+    e->outs[0] = prev_out;
+    return rc;
+}
 
 ina_rc_t iarray_shape_size(iarray_dtshape_t *dtshape, size_t *size)
 {
@@ -110,6 +110,7 @@ struct iarray_container_s {
     iarray_storage_t *storage;
     iarray_container_t *container_viewed;
     bool transposed;
+    bool transposed_viewed;  // the view reads container_viewed through a transposed view
     union {
         float f;
         double d;
@@ -268,6 +269,22 @@ ina_rc_t iarray_temporary_new(iarray_expression_t *expr, iarray_container_t *c,
 
 ina_rc_t iarray_shape_size(iarray_dtshape_t *dtshape, size_t *size);
 
+// Whether an operand shares the chunk/block partition given by `storage` and can be read block by block
+ina_rc_t _iarray_expr_block_compatible(iarray_expression_t *e, iarray_container_t *var,
+                                       iarray_storage_t *storage, bool *compatible);
+// Whether a non-compatible operand can be read straight from the blocks of its chunks
+ina_rc_t _iarray_expr_block_readable(iarray_expression_t *e, iarray_container_t *var, bool *readable);
+ina_rc_t _iarray_expr_bcast_prepare(iarray_expression_t *e);
+void _iarray_expr_bcast_free(iarray_expression_t *e);
+// Computes the blocks of e->out from the blocks of the operands (which must be block compatible or
+// readable) in up to `nthreads` threads.  A thread fetches the operand chunks for chunk `nchunk` of
+// e->out once and then evaluates any of its blocks.
+typedef struct iarray_expr_blocks_s iarray_expr_blocks_t;
+ina_rc_t _iarray_expr_blocks_new(iarray_expression_t *e, int nthreads, iarray_expr_blocks_t **blocks);
+ina_rc_t _iarray_expr_blocks_fetch(iarray_expr_blocks_t *blocks, int tid, int64_t nchunk);
+ina_rc_t _iarray_expr_blocks_eval(iarray_expr_blocks_t *blocks, int tid, int32_t nblock, uint8_t *block);
+void _iarray_expr_blocks_free(iarray_expr_blocks_t **blocks);
+
 /* FIXME: since we want to keep the changes to tinyexpr as little as possible we deviate from our usual function decls */
 iarray_temporary_t* _iarray_func(iarray_expression_t *expr, iarray_temporary_t *operand1,
                                  iarray_temporary_t *operand2, iarray_functype_t func);
@@ -290,6 +307,8 @@ int _iarray_iter_matmul_finished(iarray_iter_matmul_t *itr);
 
 // Utilities
 bool _iarray_path_exists(const char *urlpath);
+ina_rc_t _iarray_scratch_urlpath_new(iarray_context_t *ctx, const char *name, char **urlpath);
+void _iarray_scratch_urlpath_free(char **urlpath);
 
 ina_rc_t _iarray_get_slice_buffer(iarray_context_t *ctx,
                                   iarray_container_t *container,
@@ -306,6 +325,9 @@ INA_API(ina_rc_t) _iarray_get_slice_buffer_no_copy(iarray_context_t *ctx,
                                                    void **buffer,
                                                    int64_t buflen);
 INA_API(ina_rc_t) iarray_add_view_postfilter(iarray_container_t *view, iarray_container_t *view_pred);
+// The function casting the items of a container viewed as another type
+ina_rc_t _iarray_view_cast_fn(iarray_data_type_t src_dtype, iarray_data_type_t dst_dtype,
+                              void (**cast)(void *, void *, int32_t));
 
 
 /* Logical operators -> not supported yet as we only support float and double and return would be int8 */
@@ -12,6 +12,15 @@
 #include "iarray_private.h"
 #include <libiarray/iarray.h>
 #include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <direct.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 /*
  * Check if a path (file or directory) exists using stat() function.
@@ -29,3 +38,75 @@ bool _iarray_path_exists(const char * urlpath)
     }
     return false;
 }
+
+
+/*
+ * Reserve a unique urlpath for a temporary container.  It lives in a private directory
+ * created inside `cfg->scratch_dir` (or $TMPDIR, or the system default), so that several
+ * processes reducing in the same working directory never clash.
+ *
+ * The urlpath must be released with _iarray_scratch_urlpath_free(), which removes the
+ * container (if any) and its directory.
+ */
+ina_rc_t _iarray_scratch_urlpath_new(iarray_context_t *ctx, const char *name, char **urlpath)
+{
+    INA_VERIFY_NOT_NULL(ctx);
+    INA_VERIFY_NOT_NULL(name);
+    INA_VERIFY_NOT_NULL(urlpath);
+
+    const char *dir = ctx->cfg->scratch_dir;
+    if (dir == NULL) {
+        dir = getenv("TMPDIR");
+    }
+#if defined(_WIN32)
+    if (dir == NULL) {
+        dir = getenv("TEMP");
+    }
+    if (dir == NULL) {
+        dir = ".";
+    }
+#else
+    if (dir == NULL) {
+        dir = "/tmp";
+    }
+#endif
+
+    size_t len = strlen(dir) + strlen(name) + sizeof("/iarray-XXXXXX/");
+    char *path = ina_mem_alloc(len);
+    snprintf(path, len, "%s/iarray-XXXXXX", dir);
+#if defined(_WIN32)
+    if (_mktemp_s(path, strlen(path) + 1) != 0 || _mkdir(path) != 0) {
+#else
+    if (mkdtemp(path) == NULL) {
+#endif
+        IARRAY_TRACE1(iarray.error, "Cannot create a temporary directory in %s", dir);
+        ina_mem_free(path);
+        return INA_ERROR(INA_ERR_OPERATION_INVALID);
+    }
+    size_t dirlen = strlen(path);
+    snprintf(path + dirlen, len - dirlen, "/%s", name);
+
+    *urlpath = path;
+    return INA_SUCCESS;
+}
+
+
+void _iarray_scratch_urlpath_free(char **urlpath)
+{
+    if (urlpath == NULL || *urlpath == NULL) {
+        return;
+    }
+    if (_iarray_path_exists(*urlpath)) {
+        blosc2_remove_urlpath(*urlpath);
+    }
+    char *sep = strrchr(*urlpath, '/');
+    if (sep != NULL) {
+        *sep = '\0';
+#if defined(_WIN32)
+        _rmdir(*urlpath);
+#else
+        rmdir(*urlpath);
+#endif
+    }
+    INA_MEM_FREE_SAFE(*urlpath);
+}
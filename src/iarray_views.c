@@ -281,6 +281,294 @@ ina_rc_t slice_view_postfilter(blosc2_postfilter_params *postparams)
 }
 
 
+ina_rc_t _iarray_view_cast_fn(iarray_data_type_t src_dtype, iarray_data_type_t dst_dtype,
+                              void (**cast)(void *, void *, int32_t))
+{
+    switch (src_dtype) {
+        case IARRAY_DATA_TYPE_DOUBLE: {
+            switch (dst_dtype) {
+                case IARRAY_DATA_TYPE_INT64:
+                    *cast = CAST d_i64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT64:
+                    *cast = CAST d_ui64_cast;
+                    break;
+                default:
+                    goto fail;
+            }
+            break;
+        }
+        case IARRAY_DATA_TYPE_FLOAT: {
+            switch (dst_dtype) {
+                case IARRAY_DATA_TYPE_DOUBLE:
+                    *cast = CAST f_d_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT64:
+                    *cast = CAST f_i64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT32:
+                    *cast = CAST f_i32_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT64:
+                    *cast = CAST f_ui64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT32:
+                    *cast = CAST f_ui32_cast;
+                    break;
+                default:
+                    goto fail;
+            }
+            break;
+        }
+        case IARRAY_DATA_TYPE_INT64: {
+            switch (dst_dtype) {
+                case IARRAY_DATA_TYPE_DOUBLE: {
+                    *cast = CAST i64_d_cast;
+                    break;
+                }
+                case IARRAY_DATA_TYPE_UINT64:
+                    *cast = CAST i64_ui64_cast;
+                    break;
+                default:
+                    goto fail;
+            }
+            break;
+        }
+        case IARRAY_DATA_TYPE_INT32: {
+            switch (dst_dtype) {
+                case IARRAY_DATA_TYPE_DOUBLE:
+                    *cast = CAST i32_d_cast;
+                    break;
+                case IARRAY_DATA_TYPE_FLOAT:
+                    *cast = CAST i32_f_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT64:
+                    *cast = CAST i32_i64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT64:
+                    *cast = CAST i32_ui64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT32:
+                    *cast = CAST i32_ui32_cast;
+                    break;
+                default:
+                    goto fail;
+            }
+            break;
+        }
+        case IARRAY_DATA_TYPE_INT16: {
+            switch (dst_dtype) {
+                case IARRAY_DATA_TYPE_DOUBLE:
+                    *cast = CAST i16_d_cast;
+                    break;
+                case IARRAY_DATA_TYPE_FLOAT:
+                    *cast = CAST i16_f_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT64:
+                    *cast = CAST i16_i64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT32:
+                    *cast = CAST i16_i32_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT64:
+                    *cast = CAST i16_ui64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT32:
+                    *cast = CAST i16_ui32_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT16:
+                    *cast = CAST i16_ui16_cast;
+                    break;
+                default:
+                    goto fail;
+            }
+            break;
+        }
+        case IARRAY_DATA_TYPE_INT8: {
+            switch (dst_dtype) {
+                case IARRAY_DATA_TYPE_DOUBLE:
+                    *cast = CAST i8_d_cast;
+                    break;
+                case IARRAY_DATA_TYPE_FLOAT:
+                    *cast = CAST i8_f_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT64:
+                    *cast = CAST i8_i64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT32:
+                    *cast = CAST i8_i32_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT16:
+                    *cast = CAST i8_i16_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT64:
+                    *cast = CAST i8_ui64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT32:
+                    *cast = CAST i8_ui32_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT16:
+                    *cast = CAST i8_ui16_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT8:
+                    *cast = CAST i8_ui8_cast;
+                    break;
+                case IARRAY_DATA_TYPE_BOOL:
+                    *cast = CAST i8_b_cast;
+                    break;
+                default:
+                    goto fail;
+            }
+            break;
+        }
+        case IARRAY_DATA_TYPE_UINT64: {
+            switch (dst_dtype) {
+                case IARRAY_DATA_TYPE_DOUBLE:
+                    *cast = CAST ui64_d_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT64:
+                    *cast = CAST ui64_i64_cast;
+                    break;
+                default:
+                    goto fail;
+            }
+            break;
+        }
+        case IARRAY_DATA_TYPE_UINT32: {
+            switch (dst_dtype) {
+                case IARRAY_DATA_TYPE_DOUBLE:
+                    *cast = CAST ui32_d_cast;
+                    break;
+                case IARRAY_DATA_TYPE_FLOAT:
+                    *cast = CAST ui32_f_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT64:
+                    *cast = CAST ui32_i64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT32:
+                    *cast = CAST ui32_i32_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT64:
+                    *cast = CAST ui32_ui64_cast;
+                    break;
+                default:
+                    goto fail;
+            }
+            break;
+        }
+        case IARRAY_DATA_TYPE_UINT16: {
+            switch (dst_dtype) {
+                case IARRAY_DATA_TYPE_DOUBLE:
+                    *cast = CAST ui16_d_cast;
+                    break;
+                case IARRAY_DATA_TYPE_FLOAT:
+                    *cast = CAST ui16_f_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT64:
+                    *cast = CAST ui16_i64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT32:
+                    *cast = CAST ui16_i32_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT16:
+                    *cast = CAST ui16_i16_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT64:
+                    *cast = CAST ui16_ui64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT32:
+                    *cast = CAST ui16_ui32_cast;
+                    break;
+                default:
+                    goto fail;
+            }
+            break;
+        }
+        case IARRAY_DATA_TYPE_UINT8: {
+            switch (dst_dtype) {
+                case IARRAY_DATA_TYPE_DOUBLE:
+                    *cast = CAST ui8_d_cast;
+                    break;
+                case IARRAY_DATA_TYPE_FLOAT:
+                    *cast = CAST ui8_f_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT64:
+                    *cast = CAST ui8_i64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT32:
+                    *cast = CAST ui8_i32_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT16:
+                    *cast = CAST ui8_i16_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT8:
+                    *cast = CAST ui8_i8_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT64:
+                    *cast = CAST ui8_ui64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT32:
+                    *cast = CAST ui8_ui32_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT16:
+                    *cast = CAST ui8_ui16_cast;
+                    break;
+                case IARRAY_DATA_TYPE_BOOL:
+                    *cast = CAST ui8_b_cast;
+                    break;
+                default:
+                    goto fail;
+            }
+            break;
+        }
+        case IARRAY_DATA_TYPE_BOOL: {
+            switch (dst_dtype) {
+                case IARRAY_DATA_TYPE_DOUBLE:
+                    *cast = CAST b_d_cast;
+                    break;
+                case IARRAY_DATA_TYPE_FLOAT:
+                    *cast = CAST b_f_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT64:
+                    *cast = CAST b_i64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT32:
+                    *cast = CAST b_i32_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT16:
+                    *cast = CAST b_i16_cast;
+                    break;
+                case IARRAY_DATA_TYPE_INT8:
+                    *cast = CAST b_i8_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT64:
+                    *cast = CAST b_ui64_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT32:
+                    *cast = CAST b_ui32_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT16:
+                    *cast = CAST b_ui16_cast;
+                    break;
+                case IARRAY_DATA_TYPE_UINT8:
+                    *cast = CAST b_ui8_cast;
+                    break;
+                default:
+                    goto fail;
+            }
+            break;
+        }
+        default:
+            goto fail;
+    }
+
+    return INA_SUCCESS;
+
+fail:
+    return INA_ERROR(IARRAY_ERR_INVALID_DTYPE);
+}
+
+
 INA_API(ina_rc_t) iarray_add_view_postfilter(iarray_container_t *view, iarray_container_t *view_pred)
 {
     INA_VERIFY_NOT_NULL(view);
@@ -300,282 +588,9 @@ INA_API(ina_rc_t) iarray_add_view_postfilter(iarray_container_t *view, iarray_co
     }
     else {
         dparams->postfilter = (blosc2_postfilter_fn) type_view_postfilter;
-        switch (view->container_viewed->dtshape->dtype) {
-            case IARRAY_DATA_TYPE_DOUBLE: {
-                switch (view->dtshape->dtype) {
-                    case IARRAY_DATA_TYPE_INT64:
-                        view_postparams->cast = CAST d_i64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT64:
-                        view_postparams->cast = CAST d_ui64_cast;
-                        break;
-                    default:
-                        goto fail;
-                }
-                break;
-            }
-            case IARRAY_DATA_TYPE_FLOAT: {
-                switch (view->dtshape->dtype) {
-                    case IARRAY_DATA_TYPE_DOUBLE:
-                        view_postparams->cast = CAST f_d_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT64:
-                        view_postparams->cast = CAST f_i64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT32:
-                        view_postparams->cast = CAST f_i32_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT64:
-                        view_postparams->cast = CAST f_ui64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT32:
-                        view_postparams->cast = CAST f_ui32_cast;
-                        break;
-                    default:
-                        goto fail;
-                }
-                break;
-            }
-            case IARRAY_DATA_TYPE_INT64: {
-                switch (view->dtshape->dtype) {
-                    case IARRAY_DATA_TYPE_DOUBLE: {
-                        view_postparams->cast = CAST i64_d_cast;
-                        break;
-                    }
-                    case IARRAY_DATA_TYPE_UINT64:
-                        view_postparams->cast = CAST i64_ui64_cast;
-                        break;
-                    default:
-                        goto fail;
-                }
-                break;
-            }
-            case IARRAY_DATA_TYPE_INT32: {
-                switch (view->dtshape->dtype) {
-                    case IARRAY_DATA_TYPE_DOUBLE:
-                        view_postparams->cast = CAST i32_d_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_FLOAT:
-                        view_postparams->cast = CAST i32_f_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT64:
-                        view_postparams->cast = CAST i32_i64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT64:
-                        view_postparams->cast = CAST i32_ui64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT32:
-                        view_postparams->cast = CAST i32_ui32_cast;
-                        break;
-                    default:
-                        goto fail;
-                }
-                break;
-            }
-            case IARRAY_DATA_TYPE_INT16: {
-                switch (view->dtshape->dtype) {
-                    case IARRAY_DATA_TYPE_DOUBLE:
-                        view_postparams->cast = CAST i16_d_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_FLOAT:
-                        view_postparams->cast = CAST i16_f_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT64:
-                        view_postparams->cast = CAST i16_i64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT32:
-                        view_postparams->cast = CAST i16_i32_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT64:
-                        view_postparams->cast = CAST i16_ui64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT32:
-                        view_postparams->cast = CAST i16_ui32_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT16:
-                        view_postparams->cast = CAST i16_ui16_cast;
-                        break;
-                    default:
-                        goto fail;
-                }
-                break;
-            }
-            case IARRAY_DATA_TYPE_INT8: {
-                switch (view->dtshape->dtype) {
-                    case IARRAY_DATA_TYPE_DOUBLE:
-                        view_postparams->cast = CAST i8_d_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_FLOAT:
-                        view_postparams->cast = CAST i8_f_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT64:
-                        view_postparams->cast = CAST i8_i64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT32:
-                        view_postparams->cast = CAST i8_i32_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT16:
-                        view_postparams->cast = CAST i8_i16_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT64:
-                        view_postparams->cast = CAST i8_ui64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT32:
-                        view_postparams->cast = CAST i8_ui32_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT16:
-                        view_postparams->cast = CAST i8_ui16_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT8:
-                        view_postparams->cast = CAST i8_ui8_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_BOOL:
-                        view_postparams->cast = CAST i8_b_cast;
-                        break;
-                    default:
-                        goto fail;
-                }
-                break;
-            }
-            case IARRAY_DATA_TYPE_UINT64: {
-                switch (view->dtshape->dtype) {
-                    case IARRAY_DATA_TYPE_DOUBLE:
-                        view_postparams->cast = CAST ui64_d_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT64:
-                        view_postparams->cast = CAST ui64_i64_cast;
-                        break;
-                    default:
-                        goto fail;
-                }
-                break;
-            }
-            case IARRAY_DATA_TYPE_UINT32: {
-                switch (view->dtshape->dtype) {
-                    case IARRAY_DATA_TYPE_DOUBLE:
-                        view_postparams->cast = CAST ui32_d_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_FLOAT:
-                        view_postparams->cast = CAST ui32_f_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT64:
-                        view_postparams->cast = CAST ui32_i64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT32:
-                        view_postparams->cast = CAST ui32_i32_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT64:
-                        view_postparams->cast = CAST ui32_ui64_cast;
-                        break;
-                    default:
-                        goto fail;
-                }
-                break;
-            }
-            case IARRAY_DATA_TYPE_UINT16: {
-                switch (view->dtshape->dtype) {
-                    case IARRAY_DATA_TYPE_DOUBLE:
-                        view_postparams->cast = CAST ui16_d_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_FLOAT:
-                        view_postparams->cast = CAST ui16_f_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT64:
-                        view_postparams->cast = CAST ui16_i64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT32:
-                        view_postparams->cast = CAST ui16_i32_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT16:
-                        view_postparams->cast = CAST ui16_i16_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT64:
-                        view_postparams->cast = CAST ui16_ui64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT32:
-                        view_postparams->cast = CAST ui16_ui32_cast;
-                        break;
-                    default:
-                        goto fail;
-                }
-                break;
-            }
-            case IARRAY_DATA_TYPE_UINT8: {
-                switch (view->dtshape->dtype) {
-                    case IARRAY_DATA_TYPE_DOUBLE:
-                        view_postparams->cast = CAST ui8_d_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_FLOAT:
-                        view_postparams->cast = CAST ui8_f_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT64:
-                        view_postparams->cast = CAST ui8_i64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT32:
-                        view_postparams->cast = CAST ui8_i32_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT16:
-                        view_postparams->cast = CAST ui8_i16_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT8:
-                        view_postparams->cast = CAST ui8_i8_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT64:
-                        view_postparams->cast = CAST ui8_ui64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT32:
-                        view_postparams->cast = CAST ui8_ui32_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT16:
-                        view_postparams->cast = CAST ui8_ui16_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_BOOL:
-                        view_postparams->cast = CAST ui8_b_cast;
-                        break;
-                    default:
-                        goto fail;
-                }
-                break;
-            }
-            case IARRAY_DATA_TYPE_BOOL: {
-                switch (view->dtshape->dtype) {
-                    case IARRAY_DATA_TYPE_DOUBLE:
-                        view_postparams->cast = CAST b_d_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_FLOAT:
-                        view_postparams->cast = CAST b_f_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT64:
-                        view_postparams->cast = CAST b_i64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT32:
-                        view_postparams->cast = CAST b_i32_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT16:
-                        view_postparams->cast = CAST b_i16_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_INT8:
-                        view_postparams->cast = CAST b_i8_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT64:
-                        view_postparams->cast = CAST b_ui64_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT32:
-                        view_postparams->cast = CAST b_ui32_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT16:
-                        view_postparams->cast = CAST b_ui16_cast;
-                        break;
-                    case IARRAY_DATA_TYPE_UINT8:
-                        view_postparams->cast = CAST b_ui8_cast;
-                        break;
-                    default:
-                        goto fail;
-                }
-                break;
-            }
-            default:
-                goto fail;
+        if (INA_FAILED(_iarray_view_cast_fn(view->container_viewed->dtshape->dtype, view->dtshape->dtype,
+                                            &view_postparams->cast))) {
+            goto fail;
         }
     }
 
@@ -1297,13 +1297,6 @@ ina_rc_t _iarray_reduce(iarray_context_t *ctx,
             return INA_ERROR(IARRAY_ERR_INVALID_EVAL_METHOD);
     }
 
-    iarray_storage_t storage_rechunk = {0};
-    memcpy(&storage_rechunk, a->storage, sizeof(iarray_storage_t));
-    storage_rechunk.chunkshape[axis] = a->dtshape->shape[axis];
-    storage_rechunk.blockshape[axis] = a->dtshape->shape[axis];
-    if (a->storage->urlpath) {
-        storage_rechunk.urlpath = "_iarray_red_temp.iarr";
-    }
     switch (func) {
         case IARRAY_REDUCE_MAX:
         case IARRAY_REDUCE_NAN_MAX:
@@ -1343,8 +1336,6 @@ INA_API(ina_rc_t) iarray_reduce_multi(iarray_context_t *ctx,
     INA_VERIFY_NOT_NULL(axis);
     INA_VERIFY_NOT_NULL(b);
 
-    int err_io;
-
     bool correction_allowed = false;
     if (func == IARRAY_REDUCE_VAR || func == IARRAY_REDUCE_STD ||
         func == IARRAY_REDUCE_NAN_VAR || func == IARRAY_REDUCE_NAN_STD) {
@@ -1354,6 +1345,10 @@ INA_API(ina_rc_t) iarray_reduce_multi(iarray_context_t *ctx,
         IARRAY_TRACE1(iarray.tracing, " Correction != 0 only for nanvar, nanstd, var and std");
         return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
     }
+    if (func == IARRAY_REDUCE_QUANTILE || func == IARRAY_REDUCE_NAN_QUANTILE) {
+        IARRAY_TRACE1(iarray.tracing, " Quantiles are computed with iarray_reduce_quantile");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
 
     if (func == IARRAY_REDUCE_VAR || func == IARRAY_REDUCE_STD ||
         func == IARRAY_REDUCE_NAN_VAR || func == IARRAY_REDUCE_NAN_STD ||
@@ -1363,11 +1358,10 @@ INA_API(ina_rc_t) iarray_reduce_multi(iarray_context_t *ctx,
             IARRAY_TRACE1(iarray.tracing, " Cannot use normal reduce algorithm with this reduction");
             return INA_ERROR(INA_ERR_OPERATION_INVALID);
         }
-        return _iarray_reduce_oneshot(ctx, a, func, naxis, axis, storage, b, correction);
+        return _iarray_reduce_oneshot(ctx, a, NULL, func, naxis, axis, storage, b, correction, 0.5, false);
     }
 
-    iarray_container_t *aa = a;
-    if (naxis > aa->dtshape->ndim) {
+    if (naxis > a->dtshape->ndim) {
         return INA_ERROR(IARRAY_ERR_INVALID_AXIS);
     }
 
@@ -1375,9 +1369,9 @@ INA_API(ina_rc_t) iarray_reduce_multi(iarray_context_t *ctx,
     bool axis_used[IARRAY_DIMENSION_MAX] = {0};
 
     // Check if an axis is higher than array dimensions and if an axis is repeated
-    int ii = 0;
+    int8_t ii = 0;
     for (int i = 0; i < naxis; ++i) {
-        if (axis[i] > aa->dtshape->ndim) {
+        if (axis[i] > a->dtshape->ndim) {
             return INA_ERROR(IARRAY_ERR_INVALID_AXIS);
         } else if (axis_used[axis[i]]) {
             continue;
@@ -1387,120 +1381,57 @@ INA_API(ina_rc_t) iarray_reduce_multi(iarray_context_t *ctx,
         ii++;
     }
 
-    if (a->container_viewed != NULL) {
-        iarray_storage_t view_storage = {0};
-        memcpy(&view_storage, a->storage, sizeof(iarray_storage_t));
-        iarray_copy(ctx, a, false, &view_storage, &aa);
+    if (ii > 1 || a->container_viewed != NULL) {
+        // Reduce all the axes at once, accumulating every input block into its final output item.
+        // Views are reduced there too, over the blocks of the container viewed.
+        return _iarray_reduce_oneshot(ctx, a, NULL, func, ii, axis_new, storage, b, correction, 0.5, false);
     }
 
-    // Start reductions
+    ina_rc_t rc = INA_SUCCESS;
     iarray_container_t *c = NULL;
+    char *red_urlpath = NULL;
+
+    // The result keeps the partition of the input along the other axes
     iarray_storage_t storage_red;
     storage_red.contiguous = storage->contiguous;
-    storage_red.urlpath = storage->urlpath != NULL ? "_iarray_red.iarr" : NULL;
-    blosc2_remove_urlpath(storage_red.urlpath);
-    for (int i = 0; i < ii; ++i) {
-        if (i > 0) {
-            if (storage->urlpath != NULL) {
-                if (i > 1) {
-                    err_io = blosc2_remove_urlpath("_iarray_red_2.iarr");
-                    if (err_io != 0) {
-                        IARRAY_TRACE1(iarray.tracing, "Invalid io");
-                        return INA_ERROR(INA_ERR_OPERATION_INVALID);
-                    }
-                }
-                err_io = blosc2_rename_urlpath("_iarray_red.iarr", "_iarray_red_2.iarr");
-                if (err_io != 0) {
-                    IARRAY_TRACE1(iarray.tracing, "Invalid io");
-                    return INA_ERROR(INA_ERR_OPERATION_INVALID);
-                }
-                IARRAY_RETURN_IF_FAILED(iarray_container_open(ctx, "_iarray_red_2.iarr", &aa));
-            } else {
-                aa = c;
-            }
-        }
-
-        for (int j = 0; j < aa->dtshape->ndim; ++j) {
-            if (j < axis_new[i]) {
-                storage_red.chunkshape[j] = aa->storage->chunkshape[j];
-                storage_red.blockshape[j] = aa->storage->blockshape[j];
-            } else {
-                storage_red.chunkshape[j] = aa->storage->chunkshape[j + 1];
-                storage_red.blockshape[j] = aa->storage->blockshape[j + 1];
-            }
-        }
-        IARRAY_RETURN_IF_FAILED(_iarray_reduce(ctx, aa, func, axis_new[i], &storage_red, &c));
-        if (i != 0) {
-            iarray_container_free(ctx, &aa);
-        }
-
-        for (int j = i + 1; j < ii; ++j) {
-            if (axis_new[j] > axis_new[i]) {
-                axis_new[j]--;
-            }
-        }
-    }
-
-    // Check if a copy is needed
+    storage_red.urlpath = storage->urlpath;
     bool copy = false;
-    for (int i = 0; i < c->dtshape->ndim; ++i) {
-        if (storage->chunkshape[i] != c->storage->chunkshape[i]) {
-            copy = true;
-            break;
-        }
-        if (storage->blockshape[i] != c->storage->blockshape[i]) {
+    for (int j = 0; j < a->dtshape->ndim - 1; ++j) {
+        int k = j < axis_new[0] ? j : j + 1;
+        storage_red.chunkshape[j] = a->storage->chunkshape[k];
+        storage_red.blockshape[j] = a->storage->blockshape[k];
+        if (storage->chunkshape[j] != storage_red.chunkshape[j] ||
+            storage->blockshape[j] != storage_red.blockshape[j]) {
             copy = true;
-            break;
         }
     }
-
     if (copy) {
-        IARRAY_RETURN_IF_FAILED(iarray_copy(ctx, c, false, storage, b));
-        iarray_container_free(ctx, &c);
+        // The result is repartitioned afterwards; it only goes to disk if the output does
+        storage_red.urlpath = NULL;
         if (storage->urlpath != NULL) {
-            err_io = blosc2_remove_urlpath("_iarray_red.iarr");
-            if (err_io != 0) {
-                IARRAY_TRACE1(iarray.tracing, "Invalid io");
-                return INA_ERROR(INA_ERR_OPERATION_INVALID);
-            }
-            if (ii > 1) {
-                err_io = blosc2_remove_urlpath("_iarray_red_2.iarr");
-                if (err_io != 0) {
-                    IARRAY_TRACE1(iarray.tracing, "Invalid io");
-                    return INA_ERROR(INA_ERR_OPERATION_INVALID);
-                }
-            }
-        }
-    } else {
-        if (storage->urlpath != NULL) {
-            iarray_container_free(ctx, &c);
-            err_io = blosc2_rename_urlpath("_iarray_red.iarr", storage->urlpath);
-            if (err_io != 0) {
-                IARRAY_TRACE1(iarray.tracing, "Invalid io");
-                return INA_ERROR(INA_ERR_OPERATION_INVALID);
-            }
-            if (ii > 1) {
-                err_io = blosc2_remove_urlpath("_iarray_red_2.iarr");
-                if (err_io != 0) {
-                    IARRAY_TRACE1(iarray.tracing, "Invalid io");
-                    return INA_ERROR(INA_ERR_OPERATION_INVALID);
-                }
-            }
-            IARRAY_RETURN_IF_FAILED(iarray_container_open(ctx, storage->urlpath, b));
-        } else {
-            *b = c;
+            rc = _iarray_scratch_urlpath_new(ctx, "red.iarr", &red_urlpath);
+            INA_FAIL_IF_ERROR(rc);
+            storage_red.urlpath = red_urlpath;
         }
     }
-    if (storage->urlpath != NULL) {
-        blosc2_remove_urlpath("_iarray_red.iarr");
-        blosc2_remove_urlpath("_iarray_red_2.iarr");
-    }
-    if (a->container_viewed != NULL && a->storage->urlpath != NULL) {
-        blosc2_remove_urlpath("_iarray_view.iarr");
+
+    rc = _iarray_reduce(ctx, a, func, axis_new[0], &storage_red, &c);
+    INA_FAIL_IF_ERROR(rc);
+    if (copy) {
+        rc = iarray_copy(ctx, c, false, storage, b);
+        INA_FAIL_IF_ERROR(rc);
+    } else {
+        *b = c;
+        c = NULL;
     }
 
+fail:
+    if (c != NULL) {
+        iarray_container_free(ctx, &c);
+    }
+    _iarray_scratch_urlpath_free(&red_urlpath);
 
-    return INA_SUCCESS;
+    return rc;
 }
 
 
@@ -1519,3 +1450,155 @@ INA_API(ina_rc_t) iarray_reduce(iarray_context_t *ctx,
     IARRAY_RETURN_IF_FAILED(iarray_reduce_multi(ctx, a, func, 1, axis_, storage, b, oneshot, correction));
     return INA_SUCCESS;
 }
+
+
+INA_API(ina_rc_t) iarray_reduce_quantile(iarray_context_t *ctx,
+                                         iarray_container_t *a,
+                                         iarray_reduce_func_t func,
+                                         double q,
+                                         bool approximate,
+                                         int8_t naxis,
+                                         const int8_t *axis,
+                                         iarray_storage_t *storage,
+                                         iarray_container_t **b) {
+    INA_VERIFY_NOT_NULL(ctx);
+    INA_VERIFY_NOT_NULL(a);
+    INA_VERIFY_NOT_NULL(axis);
+    INA_VERIFY_NOT_NULL(b);
+
+    if (func != IARRAY_REDUCE_QUANTILE && func != IARRAY_REDUCE_NAN_QUANTILE) {
+        IARRAY_TRACE1(iarray.error, "Only quantile reductions take a quantile");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    if (!(q >= 0 && q <= 1)) {
+        IARRAY_TRACE1(iarray.error, "The quantile must be between 0 and 1");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+
+    return _iarray_reduce_oneshot(ctx, a, NULL, func, naxis, axis, storage, b, 0.0, q, approximate);
+}
+
+
+INA_API(ina_rc_t) iarray_eval_reduce(iarray_expression_t *e,
+                                     iarray_reduce_func_t func,
+                                     int8_t naxis,
+                                     const int8_t *axis,
+                                     iarray_storage_t *storage,
+                                     iarray_container_t **b,
+                                     double correction) {
+    INA_VERIFY_NOT_NULL(e);
+    INA_VERIFY_NOT_NULL(axis);
+    INA_VERIFY_NOT_NULL(storage);
+    INA_VERIFY_NOT_NULL(b);
+
+    if (e->jug_expr_func == 0 || e->out_dtshape == NULL) {
+        IARRAY_TRACE1(iarray.error, "The expression must be compiled and have its output properties bound");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    if (e->nouts != 1) {
+        IARRAY_TRACE1(iarray.error, "Multi-output expressions cannot be reduced");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+    if (func == IARRAY_REDUCE_QUANTILE || func == IARRAY_REDUCE_NAN_QUANTILE) {
+        IARRAY_TRACE1(iarray.error, "Quantiles of expressions are not supported yet");
+        return INA_ERROR(INA_ERR_NOT_SUPPORTED);
+    }
+    for (int nvar = 0; nvar < e->nvars; ++nvar) {
+        if (e->vars[nvar].stencil) {
+            // The blocks of the expression are computed from single blocks of the operands
+            IARRAY_TRACE1(iarray.error, "Expressions with stencils cannot be reduced yet; evaluate them first");
+            return INA_ERROR(INA_ERR_NOT_SUPPORTED);
+        }
+    }
+
+    iarray_context_t *ctx = e->ctx;
+    ina_rc_t rc = INA_SUCCESS;
+
+    // The expression output is never written; this container only describes its partition
+    iarray_storage_t out_storage;
+    memcpy(&out_storage, e->out_store_properties, sizeof(iarray_storage_t));
+    out_storage.urlpath = NULL;
+    out_storage.contiguous = false;
+    iarray_container_t *input = NULL;
+    IARRAY_RETURN_IF_FAILED(iarray_empty(ctx, e->out_dtshape, &out_storage, &input));
+
+    // Operands with a different partition are read through the blocks overlapping every block
+    // of the expression; only those that cannot be read that way (views, transposed containers and
+    // proxies) are copied once with the partition of the expression
+    iarray_container_t *vars[IARRAY_EXPR_OPERANDS_MAX];
+    bool var_copied[IARRAY_EXPR_OPERANDS_MAX] = {0};
+    for (int nvar = 0; nvar < e->nvars; ++nvar) {
+        vars[nvar] = e->vars[nvar].c;
+        bool broadcast = e->vars[nvar].c->dtshape->ndim != e->out_dtshape->ndim;
+        for (int i = 0; i < e->vars[nvar].c->dtshape->ndim && !broadcast; ++i) {
+            broadcast = e->vars[nvar].c->dtshape->shape[i] != e->out_dtshape->shape[i];
+        }
+        if (broadcast) {
+            // Broadcast operands are read directly by _iarray_expr_blocks_eval
+            continue;
+        }
+        bool compatible;
+        rc = _iarray_expr_block_compatible(e, vars[nvar], &out_storage, &compatible);
+        INA_FAIL_IF_ERROR(rc);
+        bool readable = false;
+        if (!compatible) {
+            rc = _iarray_expr_block_readable(e, vars[nvar], &readable);
+            INA_FAIL_IF_ERROR(rc);
+        }
+        if (!compatible && !readable) {
+            rc = iarray_copy(ctx, vars[nvar], false, &out_storage, &e->vars[nvar].c);
+            INA_FAIL_IF_ERROR(rc);
+            var_copied[nvar] = true;
+        }
+    }
+
+    iarray_container_t *out = e->out;
+    e->out = input;
+    rc = _iarray_expr_bcast_prepare(e);
+    INA_FAIL_IF_ERROR(rc);
+    rc = _iarray_reduce_oneshot(ctx, input, e, func, naxis, axis, storage, b, correction, 0.5, false);
+
+fail:
+    _iarray_expr_bcast_free(e);
+    for (int nvar = 0; nvar < e->nvars; ++nvar) {
+        if (var_copied[nvar]) {
+            iarray_container_free(ctx, &e->vars[nvar].c);
+            e->vars[nvar].c = vars[nvar];
+        }
+    }
+    if (e->out == input) {
+        e->out = out;
+    }
+    iarray_container_free(ctx, &input);
+    return rc;
+}
+
+
+INA_API(ina_rc_t) iarray_eval_reduce_scalar(iarray_expression_t *e,
+                                            iarray_reduce_func_t func,
+                                            double correction,
+                                            void *scalar,
+                                            int64_t scalar_size) {
+    INA_VERIFY_NOT_NULL(e);
+    INA_VERIFY_NOT_NULL(scalar);
+
+    if (e->out_dtshape == NULL) {
+        IARRAY_TRACE1(iarray.error, "The expression must have its output properties bound");
+        return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+
+    int8_t axis[IARRAY_DIMENSION_MAX];
+    for (int8_t i = 0; i < e->out_dtshape->ndim; ++i) {
+        axis[i] = i;
+    }
+    iarray_storage_t storage = {0};
+    storage.contiguous = false;
+    storage.urlpath = NULL;
+
+    iarray_container_t *c;
+    IARRAY_RETURN_IF_FAILED(iarray_eval_reduce(e, func, e->out_dtshape->ndim, axis, &storage, &c, correction));
+    ina_rc_t rc = iarray_to_buffer(e->ctx, c, scalar, scalar_size);
+    iarray_container_free(e->ctx, &c);
+
+    return rc;
+}
@@ -13,14 +13,23 @@
 /**
  * Description:
  *
- * The algorithm implemented in iarray_reduce.c reduces the array dimension-by-dimension,
- * creating n-1 (if naxis=n) temporary arrays. Moreover, the std and the var reductions
- * can not be done using that algorithm.
+ * The algorithm implemented in iarray_reduce.c reduces a single dimension, and the std
+ * and the var reductions can not be done using it.
  *
  * However, the algorithm implemented in this file reduce all the dimensions at once,
- * avoiding the temporary files and allowing us to use the var and the std reductions.
- * A consequence of this implementation is that if all axis are reduced, the reduction
- * will be done in single-thread mode.
+ * accumulating every input block into its final output items, so it is used for every
+ * reduction over several axes.  The result is only repartitioned (through a temporary
+ * in the scratch directory when it goes to disk) if the requested chunk or block shapes
+ * are not the ones of the input.  A consequence of this implementation is that if all
+ * axis are reduced, the reduction will be done in single-thread mode.
+ *
+ * Every row of an input block (its innermost dimension) is handed to the reduction kernels
+ * at once: it is folded into a single output item when the innermost axis is reduced, and
+ * into a row of output items otherwise.
+ *
+ * Views are not copied before being reduced: the blocks of the container viewed are read
+ * directly, clipped to the window of the view and cast to its type right after being
+ * decompressed.  Only transposed and squeezed views are still copied first.
  *
  * In a future version of ironArray, this algorithm could be used to allow reductions
  * inside the expression machinery.
@@ -61,70 +70,66 @@ int64_t iarray_reduce_finish(blosc2_prefilter_params *pparams,
 }
 
 
-static bool _iarray_check_output_padding(const int64_t *block_index,
-                                         const int64_t *item_index,
-                                         iarray_reduce_os_params_t *rparams) {
-    int64_t elem_index_n2[IARRAY_DIMENSION_MAX];
-    for (int i = 0; i < rparams->result->catarr->ndim; ++i) {
-        elem_index_n2[i] = item_index[i] + block_index[i] *
-                                           rparams->result->catarr->blockshape[i];
-    }
-    for (int i = 0; i < rparams->result->catarr->ndim; ++i) {
-        if (rparams->out_chunkshape[i] <= elem_index_n2[i]) {
-            return true;
-        }
+static void _iarray_reduce_run(blosc2_prefilter_params *pparams,
+                               iarray_reduce_os_params_t *rparams, user_data_os_t *user_data,
+                               int64_t out_item, uint8_t *data1, int64_t nelem) {
+    user_data->i = out_item;
+    if (user_data->medians != NULL) {
+        user_data->median = &user_data->medians[out_item][user_data->median_nelems[out_item] * rparams->input->catarr->itemsize];
     }
-    return false;
+    rparams->ufunc->reduction(&pparams->out[out_item * pparams->out_typesize], 0, data1, 1, nelem, user_data);
 }
 
 
-static bool _iarray_check_input_padding(const int64_t *block_index,
-                                         const int64_t *item_index,
-                                         const int64_t *input_chunkshape,
-                                         iarray_reduce_os_params_t *rparams) {
-    int64_t elem_index_n2[IARRAY_DIMENSION_MAX];
-    for (int i = 0; i < rparams->input->catarr->ndim; ++i) {
-        elem_index_n2[i] = item_index[i] + block_index[i] *
-                                           rparams->input->catarr->blockshape[i];
+int64_t iarray_reduce_row_iter(blosc2_prefilter_params *pparams,
+                               iarray_reduce_os_params_t *rparams, user_data_os_t *user_data, int8_t ndim,
+                               bool *reduced_axis, uint8_t *block,
+                               int64_t *items_start, int64_t *items_stop,
+                               int64_t *block_index,
+                               int64_t *item_index, int64_t *item_strides, int64_t *out_item_strides) {
+    // The items of the block that are not padding and lie in the reduced window
+    int64_t *blockshape = rparams->input->catarr->blockshape;
+    int64_t item_start = items_start[ndim] - block_index[ndim] * blockshape[ndim];
+    int64_t item_stop = items_stop[ndim] - block_index[ndim] * blockshape[ndim];
+    if (item_start < 0) {
+        item_start = 0;
     }
-    for (int i = 0; i < rparams->input->catarr->ndim; ++i) {
-        if (input_chunkshape[i] <= elem_index_n2[i]) {
-            return true;
-        }
+    if (item_stop > blockshape[ndim]) {
+        item_stop = blockshape[ndim];
+    }
+    if (item_stop <= item_start) {
+        return INA_SUCCESS;
     }
-    return false;
-}
-
 
-int64_t iarray_reduce_item_iter(blosc2_prefilter_params *pparams,
-                                iarray_reduce_os_params_t *rparams,
-                                user_data_os_t *user_data, int8_t ndim, uint8_t *chunk, uint8_t *block, uint8_t *aux_block, uint8_t *out,
-                                int64_t *input_chunkshape,
-                                int64_t *block_index,
-                                int64_t *item_index, int64_t *item_start, int64_t *item_stop, int64_t *item_strides) {
-    item_index[ndim] = item_start[ndim];
-    while (item_index[ndim] < item_stop[ndim]) {
-        if (ndim < rparams->input->dtshape->ndim - 1) {
+    if (ndim < rparams->input->dtshape->ndim - 1) {
+        for (item_index[ndim] = item_start; item_index[ndim] < item_stop; ++item_index[ndim]) {
             IARRAY_RETURN_IF_FAILED(
-                    iarray_reduce_item_iter(pparams, rparams, user_data, ndim + 1, chunk, block, aux_block, out,
-                                             input_chunkshape,
-                                             block_index, item_index, item_start, item_stop, item_strides));
-        } else {
-            if (_iarray_check_input_padding(block_index, item_index, input_chunkshape, rparams)) {
-                item_index[ndim]++;
-                continue;
-            }
-            int64_t nitem = 0;
-            for (int i = 0; i < rparams->input->dtshape->ndim; ++i) {
-                nitem += item_index[i] * item_strides[i];
+                    iarray_reduce_row_iter(pparams, rparams, user_data, ndim + 1, reduced_axis, block,
+                                           items_start, items_stop, block_index,
+                                           item_index, item_strides, out_item_strides));
+        }
+        return INA_SUCCESS;
+    }
 
-            }
-            uint8_t *data1 = &block[nitem * rparams->input->catarr->itemsize];
-            uint8_t *data0 = out;
-            user_data->mean = aux_block;
-            rparams->ufunc->reduction(data0, 0, data1, 0, 0, user_data);
+    // The innermost dimension is contiguous, so the whole row goes to the kernels at once
+    int64_t nitems = item_stop - item_start;
+    int64_t nitem = item_start;
+    int64_t out_item = item_start * out_item_strides[ndim];
+    for (int i = 0; i < ndim; ++i) {
+        nitem += item_index[i] * item_strides[i];
+        out_item += item_index[i] * out_item_strides[i];
+    }
+    uint8_t *data1 = &block[nitem * rparams->input->catarr->itemsize];
+    if (reduced_axis[ndim]) {
+        _iarray_reduce_run(pparams, rparams, user_data, out_item, data1, nitems);
+    } else if (rparams->ufunc->outer != NULL) {
+        user_data->i = out_item;
+        rparams->ufunc->outer(&pparams->out[out_item * pparams->out_typesize], data1, nitems, user_data);
+    } else {
+        for (int64_t i = 0; i < nitems; ++i) {
+            _iarray_reduce_run(pparams, rparams, user_data, out_item + i,
+                               &data1[i * rparams->input->catarr->itemsize], 1);
         }
-        item_index[ndim]++;
     }
     return INA_SUCCESS;
 }
@@ -132,53 +137,64 @@ int64_t iarray_reduce_item_iter(blosc2_prefilter_params *pparams,
 
 int64_t iarray_reduce_block_iter(blosc2_prefilter_params *pparams,
                                  iarray_reduce_os_params_t *rparams, user_data_os_t *user_data, int8_t ndim,
-                                 bool *reduced_axis, uint8_t *chunk, int32_t csize, uint8_t *block, uint8_t *aux_block,
-                                 int64_t *input_chunkshape,
-                                 int64_t *block_index, int64_t *block_start, int64_t *block_stop, int64_t *block_strides, bool *is_padding,
-                                 int64_t **item_start, int64_t **item_stop, int64_t *item_strides) {
+                                 bool *reduced_axis, uint8_t *chunk, int32_t csize, uint8_t *block,
+                                 int64_t *items_start, int64_t *items_stop,
+                                 int64_t *block_index, int64_t *block_start, int64_t *block_stop, int64_t *block_strides,
+                                 int64_t *item_strides, int64_t *out_item_strides) {
+    int64_t *blockshape = rparams->input->catarr->blockshape;
     block_index[ndim] = block_start[ndim];
     while (block_index[ndim] < block_stop[ndim]) {
-        if (ndim < rparams->input->dtshape->ndim - 1) {
+        if (items_stop[ndim] <= block_index[ndim] * blockshape[ndim] ||
+            items_start[ndim] >= (block_index[ndim] + 1) * blockshape[ndim]) {
+            // The block is outside the reduced window
+        } else if (ndim < rparams->input->dtshape->ndim - 1) {
             IARRAY_RETURN_IF_FAILED(
                     iarray_reduce_block_iter(pparams, rparams, user_data, ndim + 1,
-                                             reduced_axis, chunk, csize, block, aux_block,
-                                             input_chunkshape,
-                                             block_index, block_start, block_stop, block_strides, is_padding,
-                                             item_start, item_stop, item_strides));
+                                             reduced_axis, chunk, csize, block,
+                                             items_start, items_stop,
+                                             block_index, block_start, block_stop, block_strides,
+                                             item_strides, out_item_strides));
         } else {
             int64_t nblock = 0;
             for (int i = 0; i < rparams->input->dtshape->ndim; ++i) {
                 nblock += block_index[i] * block_strides[i];
             }
 
-            int64_t start = nblock * rparams->input->catarr->blocknitems;
-            int32_t blocksize = rparams->input->catarr->blocknitems * rparams->input->catarr->itemsize;
-
-            blosc2_dparams dparams = {.nthreads = 1, .schunk = rparams->input->catarr->sc, .postfilter = NULL};
-            blosc2_context *dctx = blosc2_create_dctx(dparams);
-            int bsize = blosc2_getitem_ctx(dctx, chunk, csize, (int) start,
-                                           rparams->input->catarr->blocknitems,
-                                           block, blocksize);
-            if (bsize < 0) {
-                IARRAY_TRACE1(iarray.tracing, "Error getting block");
-                return -1;
+            if (rparams->expr != NULL) {
+                // Compute the block instead of reading it
+                IARRAY_RETURN_IF_FAILED(_iarray_expr_blocks_eval(rparams->expr_blocks, pparams->tid, (int32_t) nblock,
+                                                                 block));
+            } else {
+                int64_t start = nblock * rparams->input->catarr->blocknitems;
+                // The blocks of a type view are read with the items of the container viewed
+                uint8_t *dest = rparams->cast != NULL ? user_data->cast_block : block;
+                int32_t blocksize = rparams->input->catarr->blocknitems * rparams->input_sc->typesize;
+
+                blosc2_dparams dparams = {.nthreads = 1, .schunk = rparams->input_sc, .postfilter = NULL};
+                blosc2_context *dctx = blosc2_create_dctx(dparams);
+                int bsize = blosc2_getitem_ctx(dctx, chunk, csize, (int) start,
+                                               rparams->input->catarr->blocknitems,
+                                               dest, blocksize);
+                if (bsize < 0) {
+                    IARRAY_TRACE1(iarray.tracing, "Error getting block");
+                    return -1;
+                }
+                blosc2_free_ctx(dctx);
+                if (rparams->cast != NULL) {
+                    rparams->cast(dest, block, rparams->input->catarr->blocknitems);
+                }
             }
-            blosc2_free_ctx(dctx);
-
-            for (int out_item_offset_u = 0; out_item_offset_u < pparams->out_size / pparams->out_typesize; ++out_item_offset_u) {
 
-                user_data->i = out_item_offset_u;
-                user_data->median = &user_data->medians[out_item_offset_u][user_data->median_nelems[out_item_offset_u] * rparams->input->catarr->itemsize];
-
-                if (is_padding[out_item_offset_u]) {
-                    continue;
+            int64_t item_index[IARRAY_DIMENSION_MAX];
+            IARRAY_RETURN_IF_FAILED(
+                    iarray_reduce_row_iter(pparams, rparams, user_data, 0, reduced_axis, block,
+                                           items_start, items_stop, block_index,
+                                           item_index, item_strides, out_item_strides));
+            if (rparams->ufunc->merge != NULL) {
+                for (int64_t i = 0; i < pparams->out_size / pparams->out_typesize; ++i) {
+                    user_data->i = i;
+                    rparams->ufunc->merge(&pparams->out[i * pparams->out_typesize], user_data);
                 }
-                int64_t item_index[IARRAY_DIMENSION_MAX];
-                IARRAY_RETURN_IF_FAILED(
-                        iarray_reduce_item_iter(pparams, rparams, user_data, 0, chunk, block, &aux_block[out_item_offset_u * pparams->out_typesize], &pparams->out[out_item_offset_u * pparams->out_typesize],
-                                                input_chunkshape,
-                                                block_index,
-                                                item_index, item_start[out_item_offset_u], item_stop[out_item_offset_u], item_strides));
             }
         }
         block_index[ndim]++;
@@ -189,53 +205,62 @@ int64_t iarray_reduce_block_iter(blosc2_prefilter_params *pparams,
 
 int64_t iarray_reduce_chunk_iter(blosc2_prefilter_params *pparams,
                                  iarray_reduce_os_params_t *rparams, user_data_os_t *user_data, int8_t ndim,
-                                 bool *reduced_axis, uint8_t *block, uint8_t *aux_block,
+                                 bool *reduced_axis, uint8_t *block,
                                  int64_t *chunk_index, int64_t *chunk_start, int64_t *chunk_stop, int64_t *chunk_strides,
-                                 int64_t *block_start, int64_t *block_stop, int64_t *block_strides, bool *is_padding,
-                                 int64_t **item_start, int64_t **item_stop, int64_t *item_strides) {
+                                 int64_t *block_start, int64_t *block_stop, int64_t *block_strides,
+                                 int64_t *item_strides, int64_t *out_item_strides) {
     chunk_index[ndim] = chunk_start[ndim];
     while (chunk_index[ndim] < chunk_stop[ndim]) {
         if (ndim < rparams->input->dtshape->ndim - 1) {
             IARRAY_RETURN_IF_FAILED(
                     iarray_reduce_chunk_iter(pparams, rparams, user_data, ndim + 1,
-                                             reduced_axis, block, aux_block,
+                                             reduced_axis, block,
                                              chunk_index, chunk_start, chunk_stop, chunk_strides,
-                                             block_start, block_stop, block_strides, is_padding,
-                                             item_start, item_stop, item_strides));
+                                             block_start, block_stop, block_strides,
+                                             item_strides, out_item_strides));
         } else {
             int64_t nchunk = 0;
             for (int i = 0; i < rparams->input->dtshape->ndim; ++i) {
                 nchunk += chunk_index[i] * chunk_strides[i];
             }
 
-            int64_t elem_index[IARRAY_DIMENSION_MAX] = {0};
+            // The items of the chunk in the reduced window, relative to the chunk
+            int64_t items_start[IARRAY_DIMENSION_MAX] = {0};
+            int64_t items_stop[IARRAY_DIMENSION_MAX] = {0};
             for (int i = 0; i < rparams->input->dtshape->ndim; ++i) {
-                elem_index[i] = chunk_index[i] * rparams->input->catarr->chunkshape[i];
-            }
-            int64_t input_chunkshape[IARRAY_DIMENSION_MAX] = {0};
-            for (int i = 0; i < rparams->input->dtshape->ndim; ++i) {
-                if (elem_index[i] + rparams->input->catarr->chunkshape[i] <= rparams->input->catarr->shape[i]) {
-                    input_chunkshape[i] = rparams->input->catarr->chunkshape[i];
-                } else {
-                    input_chunkshape[i] = rparams->input->catarr->shape[i] - elem_index[i];
+                int64_t elem_index = chunk_index[i] * rparams->input->catarr->chunkshape[i];
+                items_start[i] = rparams->window_start[i] - elem_index;
+                if (items_start[i] < 0) {
+                    items_start[i] = 0;
+                }
+                items_stop[i] = rparams->window_stop[i] - elem_index;
+                if (items_stop[i] > rparams->input->catarr->chunkshape[i]) {
+                    items_stop[i] = rparams->input->catarr->chunkshape[i];
                 }
             }
-            uint8_t *chunk;
-            bool needs_free;
-            int csize = blosc2_schunk_get_lazychunk(rparams->input->catarr->sc, (int) nchunk, &chunk,
+            uint8_t *chunk = NULL;
+            bool needs_free = false;
+            int csize = 0;
+            user_data->nchunk = nchunk;
+            if (rparams->expr == NULL) {
+                csize = blosc2_schunk_get_lazychunk(rparams->input_sc, (int) nchunk, &chunk,
                                                     &needs_free);
-            if (csize < 0) {
-                IARRAY_TRACE1(iarray.tracing, "Error getting lazy chunk");
-                return -1;
+                if (csize < 0) {
+                    IARRAY_TRACE1(iarray.tracing, "Error getting lazy chunk");
+                    return -1;
+                }
+            } else {
+                // The operand chunks are kept by the thread until it moves to another chunk
+                IARRAY_RETURN_IF_FAILED(_iarray_expr_blocks_fetch(rparams->expr_blocks, pparams->tid, nchunk));
             }
 
             int64_t block_index[IARRAY_DIMENSION_MAX];
             IARRAY_RETURN_IF_FAILED(
                     iarray_reduce_block_iter(pparams, rparams, user_data, 0,
-                                             reduced_axis, chunk, csize, block, aux_block,
-                                             input_chunkshape,
-                                             block_index, block_start, block_stop, block_strides, is_padding,
-                                             item_start, item_stop, item_strides));
+                                             reduced_axis, chunk, csize, block,
+                                             items_start, items_stop,
+                                             block_index, block_start, block_stop, block_strides,
+                                             item_strides, out_item_strides));
 
             if(needs_free) {
                 free(chunk);
@@ -267,7 +292,7 @@ static int _reduce_general_prefilter(blosc2_prefilter_params *pparams) {
             (pparams->out_size / pparams->out_typesize) * sizeof(int64_t));
     user_data.rparams = rparams;
     user_data.pparams = pparams;
-    user_data.medians = malloc((pparams->out_size / pparams->out_typesize) * sizeof(uint8_t *)); \
+    user_data.q = rparams->q;
     user_data.median_nelems = malloc(
             (pparams->out_size / pparams->out_typesize) * sizeof(int64_t));
 
@@ -277,29 +302,36 @@ static int _reduce_general_prefilter(blosc2_prefilter_params *pparams) {
     for (int i = 0; i < rparams->naxis; ++i) {
         reduced_axis[rparams->axis[i]] = true;
     }
-    user_data.reduced_items = 1; \
+    user_data.reduced_items = 1;
     for (int i = 0; i < rparams->input->catarr->ndim; ++i) {
         if (reduced_axis[i]) {
-            user_data.reduced_items *= rparams->input->catarr->shape[i];
+            user_data.reduced_items *= rparams->window_stop[i] - rparams->window_start[i];
         }
     }
 
-    uint8_t *aux_block = NULL;
-    if (rparams->func == IARRAY_REDUCE_VAR || rparams->func == IARRAY_REDUCE_NAN_VAR ||
-        rparams->func == IARRAY_REDUCE_STD || rparams->func == IARRAY_REDUCE_NAN_STD) {
-        int64_t aux_start = pparams->nblock * rparams->aux->catarr->blocknitems;
-        int32_t aux_blocksize = rparams->aux->catarr->blocknitems * rparams->aux->catarr->itemsize;
-        aux_block = malloc(aux_blocksize);
-        blosc2_dparams dparams = {.nthreads = 1, .schunk = rparams->aux->catarr->sc, .postfilter = NULL};
-        blosc2_context *dctx = blosc2_create_dctx(dparams);
-        int bsize = blosc2_getitem_ctx(dctx, rparams->aux_chunk, rparams->aux_csize, (int) aux_start,
-                                       rparams->aux->catarr->blocknitems,
-                                       aux_block, aux_blocksize);
-        if (bsize < 0) {
-            IARRAY_TRACE1(iarray.tracing, "Error getting aux block");
-            return -1;
+    if (rparams->ufunc->merge != NULL) {
+        user_data.welford = malloc((pparams->out_size / pparams->out_typesize) * sizeof(iarray_welford_t));
+        user_data.welford_block = malloc((pparams->out_size / pparams->out_typesize) * sizeof(iarray_welford_t));
+    }
+
+    // The items gathered by the exact medians and quantiles, or their sketches, in a single buffer
+    int64_t out_nitems = pparams->out_size / pparams->out_typesize;
+    uint8_t *medians_buffer = NULL;
+    iarray_centroid_t *centroids = NULL;
+    bool quantile = rparams->func == IARRAY_REDUCE_MEDIAN || rparams->func == IARRAY_REDUCE_NAN_MEDIAN ||
+                    rparams->func == IARRAY_REDUCE_QUANTILE || rparams->func == IARRAY_REDUCE_NAN_QUANTILE;
+    if (quantile && rparams->approximate) {
+        user_data.tdigests = malloc(out_nitems * sizeof(iarray_tdigest_t));
+        centroids = malloc(out_nitems * IARRAY_TDIGEST_CAPACITY * sizeof(iarray_centroid_t));
+        for (int64_t i = 0; i < out_nitems; ++i) {
+            user_data.tdigests[i].centroids = &centroids[i * IARRAY_TDIGEST_CAPACITY];
+        }
+    } else if (quantile) {
+        user_data.medians = malloc(out_nitems * sizeof(uint8_t *));
+        medians_buffer = malloc(out_nitems * user_data.reduced_items * user_data.input_itemsize);
+        for (int64_t i = 0; i < out_nitems; ++i) {
+            user_data.medians[i] = &medians_buffer[i * user_data.reduced_items * user_data.input_itemsize];
         }
-        blosc2_free_ctx(dctx);
     }
 
     // Compute chunk-related variables
@@ -332,15 +364,15 @@ static int _reduce_general_prefilter(blosc2_prefilter_params *pparams) {
         in_chunks_strides[i] = in_chunks_shape[i + 1] * in_chunks_strides[i + 1];
     }
 
-    // The stop index of the input chunks
+    // The stop index of the input chunks; the output starts at the chunk holding the window start
     int64_t in_chunks_stop[IARRAY_DIMENSION_MAX] = {0};
     int8_t j = 0;
     for (int i = 0; i < rparams->input->catarr->ndim; ++i) {
         if (reduced_axis[i]) {
-            in_chunks_stop[i] = rparams->input->catarr->extshape[i] /
-                                rparams->input->catarr->chunkshape[i];
+            in_chunks_stop[i] = (rparams->window_stop[i] - 1) / rparams->input->catarr->chunkshape[i] + 1;
         } else {
-            in_chunks_stop[i] = out_chunk_offset_n[j++] + 1;
+            in_chunks_stop[i] = out_chunk_offset_n[j++] +
+                                rparams->window_start[i] / rparams->input->catarr->chunkshape[i] + 1;
         }
     }
 
@@ -348,7 +380,7 @@ static int _reduce_general_prefilter(blosc2_prefilter_params *pparams) {
     int64_t in_chunks_start[IARRAY_DIMENSION_MAX] = {0};
     for (int i = 0; i < in_ndim; ++i) {
         if (reduced_axis[i]) {
-            in_chunks_start[i] = 0;
+            in_chunks_start[i] = rparams->window_start[i] / rparams->input->catarr->chunkshape[i];
         } else {
             in_chunks_start[i] = in_chunks_stop[i] - 1;
         }
@@ -409,12 +441,6 @@ static int _reduce_general_prefilter(blosc2_prefilter_params *pparams) {
         }
     }
 
-    // The number of items that output has in each dimension
-    int64_t out_items_shape[IARRAY_DIMENSION_MAX] = {0};
-    for (int i = 0; i < rparams->result->catarr->ndim; ++i) {
-        out_items_shape[i] = rparams->result->catarr->blockshape[i];
-    }
-
     // The number of items that input has in each dimension
     int64_t in_items_shape[IARRAY_DIMENSION_MAX] = {0};
     for (int i = 0; i < rparams->input->catarr->ndim; ++i) {
@@ -428,82 +454,56 @@ static int _reduce_general_prefilter(blosc2_prefilter_params *pparams) {
         in_items_strides[i] = in_items_shape[i + 1] * in_items_strides[i + 1];
     }
 
-    bool *is_padding = malloc((pparams->out_size / pparams->out_typesize) * sizeof(bool));
-    int64_t **in_item_start = (int64_t **) malloc((pparams->out_size / pparams->out_typesize) * sizeof(int64_t *));
-    int64_t **in_item_stop = (int64_t **) malloc((pparams->out_size / pparams->out_typesize) * sizeof(int64_t *));
-    for (int out_item_offset_u = 0; out_item_offset_u < pparams->out_size / pparams->out_typesize; ++out_item_offset_u) {
-
-        int64_t out_item_offset_n[IARRAY_DIMENSION_MAX] = {0};
-
-        iarray_index_unidim_to_multidim_shape(rparams->result->catarr->ndim,
-                                              out_items_shape,
-                                              out_item_offset_u,
-                                              out_item_offset_n);
-
-        in_item_stop[out_item_offset_u] = (int64_t *) malloc(sizeof(int64_t) * IARRAY_DIMENSION_MAX);
-        j = 0;
-        for (int i = 0; i < rparams->input->catarr->ndim; ++i) {
-            if (reduced_axis[i]) {
-                in_item_stop[out_item_offset_u][i] = rparams->input->catarr->blockshape[i];
-            } else {
-                in_item_stop[out_item_offset_u][i] = out_item_offset_n[j++] + 1;
-            }
-        }
-
-        in_item_start[out_item_offset_u] =  (int64_t *) malloc(sizeof(int64_t) * IARRAY_DIMENSION_MAX);
-        for (int i = 0; i < rparams->input->catarr->ndim; ++i) {
-            if (reduced_axis[i]) {
-                in_item_start[out_item_offset_u][i] = 0;
-            } else {
-                in_item_start[out_item_offset_u][i] = in_item_stop[out_item_offset_u][i] - 1;
-            }
+    // The strides of the output items, indexed by the input dimension (0 for the reduced ones)
+    int64_t out_items_strides[IARRAY_DIMENSION_MAX] = {0};
+    int64_t out_items_stride = 1;
+    j = (int8_t) (rparams->result->catarr->ndim - 1);
+    for (int i = in_ndim - 1; i >= 0; --i) {
+        if (!reduced_axis[i]) {
+            out_items_strides[i] = out_items_stride;
+            out_items_stride *= rparams->result->catarr->blockshape[j--];
         }
-
-        is_padding[out_item_offset_u] =
-                _iarray_check_output_padding(out_block_offset_n, out_item_offset_n, rparams);
-
     }
 
     IARRAY_RETURN_IF_FAILED(
             iarray_reduce_init(pparams, rparams, &user_data));
 
     uint8_t *block = malloc(rparams->input->catarr->blocknitems * rparams->input->catarr->itemsize);
+    if (rparams->cast != NULL) {
+        user_data.cast_block = malloc(rparams->input->catarr->blocknitems * rparams->input_sc->typesize);
+    }
     IARRAY_RETURN_IF_FAILED(
             iarray_reduce_chunk_iter(pparams, rparams, &user_data, 0,
-                                     reduced_axis, block, aux_block,
+                                     reduced_axis, block,
                                      chunk_index, in_chunks_start, in_chunks_stop, in_chunks_strides,
-                                     in_blocks_start, in_blocks_stop, in_blocks_strides, is_padding,
-                                     in_item_start, in_item_stop, in_items_strides));
+                                     in_blocks_start, in_blocks_stop, in_blocks_strides,
+                                     in_items_strides, out_items_strides));
     IARRAY_RETURN_IF_FAILED(
             iarray_reduce_finish(pparams, rparams, &user_data));
 
     free(block);
+    free(user_data.cast_block);
 
-    for (int out_item_offset_u = 0; out_item_offset_u < pparams->out_size / pparams->out_typesize; ++out_item_offset_u) {
-        free(in_item_stop[out_item_offset_u]);
-        free(in_item_start[out_item_offset_u]);
-    }
-    free(in_item_start);
-    free(in_item_stop);
-    free(is_padding);
-    if (rparams->func == IARRAY_REDUCE_VAR || rparams->func == IARRAY_REDUCE_NAN_VAR ||
-        rparams->func == IARRAY_REDUCE_STD || rparams->func == IARRAY_REDUCE_NAN_STD) {
-        free(aux_block);
-    }
+    free(user_data.welford);
+    free(user_data.welford_block);
     free(user_data.not_nan_nelems);
     free(user_data.nan_nelems);
     free(user_data.median_nelems);
     free(user_data.medians);
+    free(medians_buffer);
+    free(user_data.tdigests);
+    free(centroids);
 
     return 0;
 }
 
 
 ina_rc_t
-_iarray_reduce2_udf(iarray_context_t *ctx, iarray_container_t *a, iarray_reduce_function_t *ufunc,
-                    iarray_reduce_func_t func,
+_iarray_reduce2_udf(iarray_context_t *ctx, iarray_container_t *a, iarray_expression_t *expr,
+                    iarray_reduce_function_t *ufunc, iarray_reduce_func_t func,
                     int8_t naxis, const int8_t *axis, iarray_storage_t *storage,
-                    iarray_container_t **b, iarray_data_type_t res_dtype, iarray_container_t *aux, double correction) {
+                    iarray_container_t **b, iarray_data_type_t res_dtype, double correction,
+                    double q, bool approximate) {
 
     INA_VERIFY_NOT_NULL(ctx);
     INA_VERIFY_NOT_NULL(a);
@@ -515,6 +515,20 @@ _iarray_reduce2_udf(iarray_context_t *ctx, iarray_container_t *a, iarray_reduce_
         return INA_ERROR(IARRAY_ERR_INVALID_NDIM);
     }
 
+    // Views are reduced over the blocks of the container viewed, inside the window they cover
+    iarray_reduce_os_params_t reduce_params = {0};
+    bool view = a->container_viewed != NULL && expr == NULL;
+    iarray_container_t *input = view ? a->container_viewed : a;
+    for (int i = 0; i < a->dtshape->ndim; ++i) {
+        reduce_params.window_start[i] = view ? a->auxshape->offset[i] : 0;
+        reduce_params.window_stop[i] = reduce_params.window_start[i] + a->dtshape->shape[i];
+    }
+    reduce_params.input_sc = input->catarr->sc;
+    if (a->dtshape->dtype != input->dtshape->dtype) {
+        IARRAY_RETURN_IF_FAILED(_iarray_view_cast_fn(input->dtshape->dtype, a->dtshape->dtype,
+                                                     &reduce_params.cast));
+    }
+
     iarray_dtshape_t dtshape;
     dtshape.dtype = res_dtype;
     dtshape.ndim = (int8_t) (a->dtshape->ndim - naxis);
@@ -527,12 +541,16 @@ _iarray_reduce2_udf(iarray_context_t *ctx, iarray_container_t *a, iarray_reduce_
     for (int i = 0; i < naxis; ++i) {
         dtshape.shape[axis[i]] = -1;
     }
+    // The kept axes start at the chunk holding the window start, so that the output and the
+    // input chunks stay aligned
     int inc = 0;
     for (int i = 0; i < a->dtshape->ndim; ++i) {
         if (dtshape.shape[i] == -1) {
             inc++;
         } else {
-            dtshape.shape[i - inc] = a->dtshape->shape[i];
+            int64_t chunk_start = reduce_params.window_start[i] / a->catarr->chunkshape[i] *
+                                  a->catarr->chunkshape[i];
+            dtshape.shape[i - inc] = reduce_params.window_stop[i] - chunk_start;
         }
     }
 
@@ -544,7 +562,6 @@ _iarray_reduce2_udf(iarray_context_t *ctx, iarray_container_t *a, iarray_reduce_
     iarray_context_t *prefilter_ctx;
     iarray_context_new(ctx->cfg, &prefilter_ctx);
     prefilter_ctx->prefilter_fn = (blosc2_prefilter_fn) _reduce_general_prefilter;
-    iarray_reduce_os_params_t reduce_params = {0};
     blosc2_prefilter_params pparams = {0};
     pparams.user_data = &reduce_params;
     prefilter_ctx->prefilter_params = &pparams;
@@ -555,9 +572,15 @@ _iarray_reduce2_udf(iarray_context_t *ctx, iarray_container_t *a, iarray_reduce_
     reduce_params.naxis = naxis;
     reduce_params.axis = axis;
     reduce_params.correction = correction;
+    reduce_params.q = q;
+    reduce_params.approximate = approximate;
     reduce_params.ufunc = ufunc;
     reduce_params.func = func;
-    reduce_params.aux = aux;
+    reduce_params.expr = expr;
+    if (expr != NULL) {
+        IARRAY_RETURN_IF_FAILED(_iarray_expr_blocks_new(expr, prefilter_ctx->cfg->max_num_threads,
+                                                        &reduce_params.expr_blocks));
+    }
     // Compute the amount of chunks in each dimension
     int64_t shape_of_chunks[IARRAY_DIMENSION_MAX]={0};
     for (int i = 0; i < c->dtshape->ndim; ++i) {
@@ -583,20 +606,6 @@ _iarray_reduce2_udf(iarray_context_t *ctx, iarray_container_t *a, iarray_reduce_
         }
         reduce_params.out_chunkshape = chunk_shape;
         reduce_params.nchunk = nchunk;
-        uint8_t *aux_chunk = NULL;
-        bool aux_needs_free = false;
-        if (func == IARRAY_REDUCE_VAR ||
-            func == IARRAY_REDUCE_NAN_VAR ||
-            func == IARRAY_REDUCE_STD ||
-            func == IARRAY_REDUCE_NAN_STD ) {
-            reduce_params.aux_csize = blosc2_schunk_get_lazychunk(aux->catarr->sc, nchunk, &aux_chunk,
-                                                                  &aux_needs_free);
-            if (reduce_params.aux_csize < 0) {
-                IARRAY_TRACE1(iarray.tracing, "Error getting lazy chunk");
-                return -1;
-            }
-            reduce_params.aux_chunk = aux_chunk;
-        }
 
         // Compress data
         blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
@@ -611,6 +620,7 @@ _iarray_reduce2_udf(iarray_context_t *ctx, iarray_container_t *a, iarray_reduce_
                                         (int32_t) (c->catarr->extchunknitems * c->catarr->itemsize +
                                         BLOSC2_MAX_OVERHEAD));
         if (csize <= 0) {
+            _iarray_expr_blocks_free(&reduce_params.expr_blocks);
             IARRAY_TRACE1(iarray.error, "Error compressing a blosc chunk");
             return INA_ERROR(IARRAY_ERR_BLOSC_FAILED);
         }
@@ -621,16 +631,9 @@ _iarray_reduce2_udf(iarray_context_t *ctx, iarray_container_t *a, iarray_reduce_
         nchunk++;
         iarray_index_unidim_to_multidim_shape(c->dtshape->ndim, shape_of_chunks, nchunk,
                                               chunk_index);
-        if (func == IARRAY_REDUCE_VAR ||
-            func == IARRAY_REDUCE_NAN_VAR ||
-            func == IARRAY_REDUCE_STD ||
-            func == IARRAY_REDUCE_NAN_STD ) {
-            if (aux_needs_free) {
-                free(aux_chunk);
-            }
-        }
     }
 
+    _iarray_expr_blocks_free(&reduce_params.expr_blocks);
     iarray_context_free(&prefilter_ctx);
 
     return INA_SUCCESS;
@@ -638,13 +641,19 @@ _iarray_reduce2_udf(iarray_context_t *ctx, iarray_container_t *a, iarray_reduce_
 
 ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
                         iarray_container_t *a,
+                        iarray_expression_t *expr,
                         iarray_reduce_func_t func,
                         int8_t naxis,
                         const int8_t *axis,
                         iarray_storage_t *storage,
                         iarray_container_t **b,
-                        double correction) {
+                        double correction,
+                        double q,
+                        bool approximate) {
     void *reduce_function = NULL;
+    if (func == IARRAY_REDUCE_MEDIAN || func == IARRAY_REDUCE_NAN_MEDIAN) {
+        q = 0.5;
+    }
     // res data type
     iarray_data_type_t dtype;
     switch (func) {
@@ -785,50 +794,51 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
             }
             break;
         case IARRAY_REDUCE_MEDIAN:
+        case IARRAY_REDUCE_QUANTILE:
             // If the input is of type integer or unsigned int the result will be of type double
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &REDUCTION(MEDIAN, double);
+                    reduce_function = approximate ? &REDUCTION(TDIGEST, double) : &REDUCTION(MEDIAN, double);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &REDUCTION(MEDIAN, float);
+                    reduce_function = approximate ? &REDUCTION(TDIGEST, float) : &REDUCTION(MEDIAN, float);
                     dtype = IARRAY_DATA_TYPE_FLOAT;
                     break;
                 case IARRAY_DATA_TYPE_INT64:
-                    reduce_function = &REDUCTION(MEDIAN, int64_t);
+                    reduce_function = approximate ? &REDUCTION(TDIGEST, int64_t) : &REDUCTION(MEDIAN, int64_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_INT32:
-                    reduce_function = &REDUCTION(MEDIAN, int32_t);
+                    reduce_function = approximate ? &REDUCTION(TDIGEST, int32_t) : &REDUCTION(MEDIAN, int32_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_INT16:
-                    reduce_function = &REDUCTION(MEDIAN, int16_t);
+                    reduce_function = approximate ? &REDUCTION(TDIGEST, int16_t) : &REDUCTION(MEDIAN, int16_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_INT8:
-                    reduce_function = &REDUCTION(MEDIAN, int8_t);
+                    reduce_function = approximate ? &REDUCTION(TDIGEST, int8_t) : &REDUCTION(MEDIAN, int8_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_UINT64:
-                    reduce_function = &REDUCTION(MEDIAN, uint64_t);
+                    reduce_function = approximate ? &REDUCTION(TDIGEST, uint64_t) : &REDUCTION(MEDIAN, uint64_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_UINT32:
-                    reduce_function = &REDUCTION(MEDIAN, uint32_t);
+                    reduce_function = approximate ? &REDUCTION(TDIGEST, uint32_t) : &REDUCTION(MEDIAN, uint32_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_UINT16:
-                    reduce_function = &REDUCTION(MEDIAN, uint16_t);
+                    reduce_function = approximate ? &REDUCTION(TDIGEST, uint16_t) : &REDUCTION(MEDIAN, uint16_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_UINT8:
-                    reduce_function = &REDUCTION(MEDIAN, uint8_t);
+                    reduce_function = approximate ? &REDUCTION(TDIGEST, uint8_t) : &REDUCTION(MEDIAN, uint8_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_BOOL:
-                    reduce_function = &REDUCTION(MEDIAN, bool);
+                    reduce_function = approximate ? &REDUCTION(TDIGEST, bool) : &REDUCTION(MEDIAN, bool);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 default:
@@ -837,13 +847,14 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
             }
             break;
         case IARRAY_REDUCE_NAN_MEDIAN:
+        case IARRAY_REDUCE_NAN_QUANTILE:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &NANREDUCTION(MEDIAN, double);
+                    reduce_function = approximate ? &NANREDUCTION(TDIGEST, double) : &NANREDUCTION(MEDIAN, double);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &NANREDUCTION(MEDIAN, float);
+                    reduce_function = approximate ? &NANREDUCTION(TDIGEST, float) : &NANREDUCTION(MEDIAN, float);
                     dtype = IARRAY_DATA_TYPE_FLOAT;
                     break;
                 default:
@@ -869,47 +880,47 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
         case IARRAY_REDUCE_MAX:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &ONESHOTREDUCTION(MAX, double);
+                    reduce_function = &REDUCTION(MAX, double);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &ONESHOTREDUCTION(MAX, float);
+                    reduce_function = &REDUCTION(MAX, float);
                     dtype = IARRAY_DATA_TYPE_FLOAT;
                     break;
                 case IARRAY_DATA_TYPE_INT64:
-                    reduce_function = &ONESHOTREDUCTION(MAX, int64_t);
+                    reduce_function = &REDUCTION(MAX, int64_t);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 case IARRAY_DATA_TYPE_INT32:
-                    reduce_function = &ONESHOTREDUCTION(MAX, int32_t);
+                    reduce_function = &REDUCTION(MAX, int32_t);
                     dtype = IARRAY_DATA_TYPE_INT32;
                     break;
                 case IARRAY_DATA_TYPE_INT16:
-                    reduce_function = &ONESHOTREDUCTION(MAX, int16_t);
+                    reduce_function = &REDUCTION(MAX, int16_t);
                     dtype = IARRAY_DATA_TYPE_INT16;
                     break;
                 case IARRAY_DATA_TYPE_INT8:
-                    reduce_function = &ONESHOTREDUCTION(MAX, int8_t);
+                    reduce_function = &REDUCTION(MAX, int8_t);
                     dtype = IARRAY_DATA_TYPE_INT8;
                     break;
                 case IARRAY_DATA_TYPE_UINT64:
-                    reduce_function = &ONESHOTREDUCTION(MAX, uint64_t);
+                    reduce_function = &REDUCTION(MAX, uint64_t);
                     dtype = IARRAY_DATA_TYPE_UINT64;
                     break;
                 case IARRAY_DATA_TYPE_UINT32:
-                    reduce_function = &ONESHOTREDUCTION(MAX, uint32_t);
+                    reduce_function = &REDUCTION(MAX, uint32_t);
                     dtype = IARRAY_DATA_TYPE_UINT32;
                     break;
                 case IARRAY_DATA_TYPE_UINT16:
-                    reduce_function = &ONESHOTREDUCTION(MAX, uint16_t);
+                    reduce_function = &REDUCTION(MAX, uint16_t);
                     dtype = IARRAY_DATA_TYPE_UINT16;
                     break;
                 case IARRAY_DATA_TYPE_UINT8:
-                    reduce_function = &ONESHOTREDUCTION(MAX, uint8_t);
+                    reduce_function = &REDUCTION(MAX, uint8_t);
                     dtype = IARRAY_DATA_TYPE_UINT8;
                     break;
                 case IARRAY_DATA_TYPE_BOOL:
-                    reduce_function = &ONESHOTREDUCTION(MAX, bool);
+                    reduce_function = &REDUCTION(MAX, bool);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 default:
@@ -920,11 +931,11 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
         case IARRAY_REDUCE_NAN_MAX:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &ONESHOTNANREDUCTION(MAX, double);
+                    reduce_function = &NANREDUCTION(MAX, double);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &ONESHOTNANREDUCTION(MAX, float);
+                    reduce_function = &NANREDUCTION(MAX, float);
                     dtype = IARRAY_DATA_TYPE_FLOAT;
                     break;
                 default:
@@ -935,47 +946,47 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
         case IARRAY_REDUCE_MIN:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &ONESHOTREDUCTION(MIN, double);
+                    reduce_function = &REDUCTION(MIN, double);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &ONESHOTREDUCTION(MIN, float);
+                    reduce_function = &REDUCTION(MIN, float);
                     dtype = IARRAY_DATA_TYPE_FLOAT;
                     break;
                 case IARRAY_DATA_TYPE_INT64:
-                    reduce_function = &ONESHOTREDUCTION(MIN, int64_t);
+                    reduce_function = &REDUCTION(MIN, int64_t);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 case IARRAY_DATA_TYPE_INT32:
-                    reduce_function = &ONESHOTREDUCTION(MIN, int32_t);
+                    reduce_function = &REDUCTION(MIN, int32_t);
                     dtype = IARRAY_DATA_TYPE_INT32;
                     break;
                 case IARRAY_DATA_TYPE_INT16:
-                    reduce_function = &ONESHOTREDUCTION(MIN, int16_t);
+                    reduce_function = &REDUCTION(MIN, int16_t);
                     dtype = IARRAY_DATA_TYPE_INT16;
                     break;
                 case IARRAY_DATA_TYPE_INT8:
-                    reduce_function = &ONESHOTREDUCTION(MIN, int8_t);
+                    reduce_function = &REDUCTION(MIN, int8_t);
                     dtype = IARRAY_DATA_TYPE_INT8;
                     break;
                 case IARRAY_DATA_TYPE_UINT64:
-                    reduce_function = &ONESHOTREDUCTION(MIN, uint64_t);
+                    reduce_function = &REDUCTION(MIN, uint64_t);
                     dtype = IARRAY_DATA_TYPE_UINT64;
                     break;
                 case IARRAY_DATA_TYPE_UINT32:
-                    reduce_function = &ONESHOTREDUCTION(MIN, uint32_t);
+                    reduce_function = &REDUCTION(MIN, uint32_t);
                     dtype = IARRAY_DATA_TYPE_UINT32;
                     break;
                 case IARRAY_DATA_TYPE_UINT16:
-                    reduce_function = &ONESHOTREDUCTION(MIN, uint16_t);
+                    reduce_function = &REDUCTION(MIN, uint16_t);
                     dtype = IARRAY_DATA_TYPE_UINT16;
                     break;
                 case IARRAY_DATA_TYPE_UINT8:
-                    reduce_function = &ONESHOTREDUCTION(MIN, uint8_t);
+                    reduce_function = &REDUCTION(MIN, uint8_t);
                     dtype = IARRAY_DATA_TYPE_UINT8;
                     break;
                 case IARRAY_DATA_TYPE_BOOL:
-                    reduce_function = &ONESHOTREDUCTION(MIN, bool);
+                    reduce_function = &REDUCTION(MIN, bool);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 default:
@@ -986,11 +997,11 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
         case IARRAY_REDUCE_NAN_MIN:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &ONESHOTNANREDUCTION(MIN, double);
+                    reduce_function = &NANREDUCTION(MIN, double);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &ONESHOTNANREDUCTION(MIN, float);
+                    reduce_function = &NANREDUCTION(MIN, float);
                     dtype = IARRAY_DATA_TYPE_FLOAT;
                     break;
                 default:
@@ -1001,47 +1012,47 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
         case IARRAY_REDUCE_SUM:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &ONESHOTREDUCTION(SUM, double);
+                    reduce_function = &REDUCTION(SUM, double);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &ONESHOTREDUCTION(SUM, float);
+                    reduce_function = &REDUCTION(SUM, float);
                     dtype = IARRAY_DATA_TYPE_FLOAT;
                     break;
                 case IARRAY_DATA_TYPE_INT64:
-                    reduce_function = &ONESHOTREDUCTION(SUM, int64_t);
+                    reduce_function = &REDUCTION(SUM, int64_t);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 case IARRAY_DATA_TYPE_INT32:
-                    reduce_function = &ONESHOTREDUCTION(SUM, int32_t);
+                    reduce_function = &REDUCTION(SUM, int32_t);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 case IARRAY_DATA_TYPE_INT16:
-                    reduce_function = &ONESHOTREDUCTION(SUM, int16_t);
+                    reduce_function = &REDUCTION(SUM, int16_t);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 case IARRAY_DATA_TYPE_INT8:
-                    reduce_function = &ONESHOTREDUCTION(SUM, int8_t);
+                    reduce_function = &REDUCTION(SUM, int8_t);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 case IARRAY_DATA_TYPE_UINT64:
-                    reduce_function = &ONESHOTREDUCTION(SUM, uint64_t);
+                    reduce_function = &REDUCTION(SUM, uint64_t);
                     dtype = IARRAY_DATA_TYPE_UINT64;
                     break;
                 case IARRAY_DATA_TYPE_UINT32:
-                    reduce_function = &ONESHOTREDUCTION(SUM, uint32_t);
+                    reduce_function = &REDUCTION(SUM, uint32_t);
                     dtype = IARRAY_DATA_TYPE_UINT64;
                     break;
                 case IARRAY_DATA_TYPE_UINT16:
-                    reduce_function = &ONESHOTREDUCTION(SUM, uint16_t);
+                    reduce_function = &REDUCTION(SUM, uint16_t);
                     dtype = IARRAY_DATA_TYPE_UINT64;
                     break;
                 case IARRAY_DATA_TYPE_UINT8:
-                    reduce_function = &ONESHOTREDUCTION(SUM, uint8_t);
+                    reduce_function = &REDUCTION(SUM, uint8_t);
                     dtype = IARRAY_DATA_TYPE_UINT64;
                     break;
                 case IARRAY_DATA_TYPE_BOOL:
-                    reduce_function = &ONESHOTREDUCTION(SUM, bool);
+                    reduce_function = &REDUCTION(SUM, bool);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 default:
@@ -1052,11 +1063,11 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
         case IARRAY_REDUCE_NAN_SUM:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &ONESHOTNANREDUCTION(SUM, double);
+                    reduce_function = &NANREDUCTION(SUM, double);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &ONESHOTNANREDUCTION(SUM, float);
+                    reduce_function = &NANREDUCTION(SUM, float);
                     dtype = IARRAY_DATA_TYPE_FLOAT;
                     break;
                 default:
@@ -1067,47 +1078,47 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
         case IARRAY_REDUCE_PROD:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &ONESHOTREDUCTION(PROD, double);
+                    reduce_function = &REDUCTION(PROD, double);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &ONESHOTREDUCTION(PROD, float);
+                    reduce_function = &REDUCTION(PROD, float);
                     dtype = IARRAY_DATA_TYPE_FLOAT;
                     break;
                 case IARRAY_DATA_TYPE_INT64:
-                    reduce_function = &ONESHOTREDUCTION(PROD, int64_t);
+                    reduce_function = &REDUCTION(PROD, int64_t);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 case IARRAY_DATA_TYPE_INT32:
-                    reduce_function = &ONESHOTREDUCTION(PROD, int32_t);
+                    reduce_function = &REDUCTION(PROD, int32_t);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 case IARRAY_DATA_TYPE_INT16:
-                    reduce_function = &ONESHOTREDUCTION(PROD, int16_t);
+                    reduce_function = &REDUCTION(PROD, int16_t);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 case IARRAY_DATA_TYPE_INT8:
-                    reduce_function = &ONESHOTREDUCTION(PROD, int8_t);
+                    reduce_function = &REDUCTION(PROD, int8_t);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 case IARRAY_DATA_TYPE_UINT64:
-                    reduce_function = &ONESHOTREDUCTION(PROD, uint64_t);
+                    reduce_function = &REDUCTION(PROD, uint64_t);
                     dtype = IARRAY_DATA_TYPE_UINT64;
                     break;
                 case IARRAY_DATA_TYPE_UINT32:
-                    reduce_function = &ONESHOTREDUCTION(PROD, uint32_t);
+                    reduce_function = &REDUCTION(PROD, uint32_t);
                     dtype = IARRAY_DATA_TYPE_UINT64;
                     break;
                 case IARRAY_DATA_TYPE_UINT16:
-                    reduce_function = &ONESHOTREDUCTION(PROD, uint16_t);
+                    reduce_function = &REDUCTION(PROD, uint16_t);
                     dtype = IARRAY_DATA_TYPE_UINT64;
                     break;
                 case IARRAY_DATA_TYPE_UINT8:
-                    reduce_function = &ONESHOTREDUCTION(PROD, uint8_t);
+                    reduce_function = &REDUCTION(PROD, uint8_t);
                     dtype = IARRAY_DATA_TYPE_UINT64;
                     break;
                 case IARRAY_DATA_TYPE_BOOL:
-                    reduce_function = &ONESHOTREDUCTION(PROD, bool);
+                    reduce_function = &REDUCTION(PROD, bool);
                     dtype = IARRAY_DATA_TYPE_INT64;
                     break;
                 default:
@@ -1118,11 +1129,11 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
         case IARRAY_REDUCE_NAN_PROD:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &ONESHOTNANREDUCTION(PROD, double);
+                    reduce_function = &NANREDUCTION(PROD, double);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &ONESHOTNANREDUCTION(PROD, float);
+                    reduce_function = &NANREDUCTION(PROD, float);
                     dtype = IARRAY_DATA_TYPE_FLOAT;
                     break;
                 default:
@@ -1133,47 +1144,47 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
         case IARRAY_REDUCE_MEAN:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &ONESHOTREDUCTION(MEAN, double);
+                    reduce_function = &REDUCTION(MEAN, double);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &ONESHOTREDUCTION(MEAN, float);
+                    reduce_function = &REDUCTION(MEAN, float);
                     dtype = IARRAY_DATA_TYPE_FLOAT;
                     break;
                 case IARRAY_DATA_TYPE_INT64:
-                    reduce_function = &ONESHOTREDUCTION(MEAN, int64_t);
+                    reduce_function = &REDUCTION(MEAN, int64_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_INT32:
-                    reduce_function = &ONESHOTREDUCTION(MEAN, int32_t);
+                    reduce_function = &REDUCTION(MEAN, int32_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_INT16:
-                    reduce_function = &ONESHOTREDUCTION(MEAN, int16_t);
+                    reduce_function = &REDUCTION(MEAN, int16_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_INT8:
-                    reduce_function = &ONESHOTREDUCTION(MEAN, int8_t);
+                    reduce_function = &REDUCTION(MEAN, int8_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_UINT64:
-                    reduce_function = &ONESHOTREDUCTION(MEAN, uint64_t);
+                    reduce_function = &REDUCTION(MEAN, uint64_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_UINT32:
-                    reduce_function = &ONESHOTREDUCTION(MEAN, uint32_t);
+                    reduce_function = &REDUCTION(MEAN, uint32_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_UINT16:
-                    reduce_function = &ONESHOTREDUCTION(MEAN, uint16_t);
+                    reduce_function = &REDUCTION(MEAN, uint16_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_UINT8:
-                    reduce_function = &ONESHOTREDUCTION(MEAN, uint8_t);
+                    reduce_function = &REDUCTION(MEAN, uint8_t);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 case IARRAY_DATA_TYPE_BOOL:
-                    reduce_function = &ONESHOTREDUCTION(MEAN, bool);
+                    reduce_function = &REDUCTION(MEAN, bool);
                     dtype = IARRAY_DATA_TYPE_DOUBLE;
                     break;
                 default:
@@ -1184,47 +1195,47 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
         case IARRAY_REDUCE_ALL:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &ONESHOTREDUCTION(ALL, double);
+                    reduce_function = &REDUCTION(ALL, double);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &ONESHOTREDUCTION(ALL, float);
+                    reduce_function = &REDUCTION(ALL, float);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_INT64:
-                    reduce_function = &ONESHOTREDUCTION(ALL, int64_t);
+                    reduce_function = &REDUCTION(ALL, int64_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_INT32:
-                    reduce_function = &ONESHOTREDUCTION(ALL, int32_t);
+                    reduce_function = &REDUCTION(ALL, int32_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_INT16:
-                    reduce_function = &ONESHOTREDUCTION(ALL, int16_t);
+                    reduce_function = &REDUCTION(ALL, int16_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_INT8:
-                    reduce_function = &ONESHOTREDUCTION(ALL, int8_t);
+                    reduce_function = &REDUCTION(ALL, int8_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_UINT64:
-                    reduce_function = &ONESHOTREDUCTION(ALL, uint64_t);
+                    reduce_function = &REDUCTION(ALL, uint64_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_UINT32:
-                    reduce_function = &ONESHOTREDUCTION(ALL, uint32_t);
+                    reduce_function = &REDUCTION(ALL, uint32_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_UINT16:
-                    reduce_function = &ONESHOTREDUCTION(ALL, uint16_t);
+                    reduce_function = &REDUCTION(ALL, uint16_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_UINT8:
-                    reduce_function = &ONESHOTREDUCTION(ALL, uint8_t);
+                    reduce_function = &REDUCTION(ALL, uint8_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_BOOL:
-                    reduce_function = &ONESHOTREDUCTION(ALL, bool);
+                    reduce_function = &REDUCTION(ALL, bool);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 default:
@@ -1235,47 +1246,47 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
         case IARRAY_REDUCE_ANY:
             switch (a->dtshape->dtype) {
                 case IARRAY_DATA_TYPE_DOUBLE:
-                    reduce_function = &ONESHOTREDUCTION(ANY, double);
+                    reduce_function = &REDUCTION(ANY, double);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_FLOAT:
-                    reduce_function = &ONESHOTREDUCTION(ANY, float);
+                    reduce_function = &REDUCTION(ANY, float);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_INT64:
-                    reduce_function = &ONESHOTREDUCTION(ANY, int64_t);
+                    reduce_function = &REDUCTION(ANY, int64_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_INT32:
-                    reduce_function = &ONESHOTREDUCTION(ANY, int32_t);
+                    reduce_function = &REDUCTION(ANY, int32_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_INT16:
-                    reduce_function = &ONESHOTREDUCTION(ANY, int16_t);
+                    reduce_function = &REDUCTION(ANY, int16_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_INT8:
-                    reduce_function = &ONESHOTREDUCTION(ANY, int8_t);
+                    reduce_function = &REDUCTION(ANY, int8_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_UINT64:
-                    reduce_function = &ONESHOTREDUCTION(ANY, uint64_t);
+                    reduce_function = &REDUCTION(ANY, uint64_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_UINT32:
-                    reduce_function = &ONESHOTREDUCTION(ANY, uint32_t);
+                    reduce_function = &REDUCTION(ANY, uint32_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_UINT16:
-                    reduce_function = &ONESHOTREDUCTION(ANY, uint16_t);
+                    reduce_function = &REDUCTION(ANY, uint16_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_UINT8:
-                    reduce_function = &ONESHOTREDUCTION(ANY, uint8_t);
+                    reduce_function = &REDUCTION(ANY, uint8_t);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 case IARRAY_DATA_TYPE_BOOL:
-                    reduce_function = &ONESHOTREDUCTION(ANY, bool);
+                    reduce_function = &REDUCTION(ANY, bool);
                     dtype = IARRAY_DATA_TYPE_BOOL;
                     break;
                 default:
@@ -1288,60 +1299,43 @@ ina_rc_t _iarray_reduce2(iarray_context_t *ctx,
             return INA_ERROR(IARRAY_ERR_INVALID_EVAL_METHOD);
     }
 
-    iarray_container_t *mean = NULL;
-    iarray_storage_t mean_storage;
-    memcpy(&mean_storage, storage, sizeof(iarray_storage_t));
-    mean_storage.urlpath = storage->urlpath ? "_iarray_mean_reduce.iarray" : NULL;
-
-    switch (func) {
-        case IARRAY_REDUCE_STD:
-        case IARRAY_REDUCE_VAR:
-            IARRAY_RETURN_IF_FAILED(
-                    iarray_reduce_multi(ctx, a, IARRAY_REDUCE_MEAN, naxis, axis, &mean_storage, &mean, true, 0.0));
-            break;
-        case IARRAY_REDUCE_NAN_STD:
-        case IARRAY_REDUCE_NAN_VAR:
-            IARRAY_RETURN_IF_FAILED(
-                    iarray_reduce_multi(ctx, a, IARRAY_REDUCE_NAN_MEAN, naxis, axis, &mean_storage, &mean, true, 0.0));
-            break;
-        default:
-            ;
-    }
-
     IARRAY_RETURN_IF_FAILED(
-            _iarray_reduce2_udf(ctx, a, reduce_function, func, naxis, axis, storage, b, dtype,
-                                mean, correction));
-    switch (func) {
-        case IARRAY_REDUCE_STD:
-        case IARRAY_REDUCE_VAR:
-        case IARRAY_REDUCE_NAN_STD:
-        case IARRAY_REDUCE_NAN_VAR:
-            iarray_container_free(ctx, &mean);
-            iarray_container_remove(mean_storage.urlpath);
-            break;
-        default:
-            ;
-    }
+            _iarray_reduce2_udf(ctx, a, expr, reduce_function, func, naxis, axis, storage, b, dtype,
+                                correction, q, approximate));
 
     return INA_SUCCESS;
 }
 
+// Whether the items of a view can be read from the blocks of the container viewed
+static bool _iarray_reduce_view_readable(iarray_container_t *a) {
+    if (a->transposed || a->transposed_viewed || a->dtshape->ndim != a->catarr->ndim) {
+        return false;
+    }
+    for (int i = 0; i < a->dtshape->ndim; ++i) {
+        if (a->auxshape->index[i] != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
 ina_rc_t _iarray_reduce_oneshot(iarray_context_t *ctx,
                                 iarray_container_t *a,
+                                iarray_expression_t *expr,
                                 iarray_reduce_func_t func,
                                 int8_t naxis,
                                 const int8_t *axis,
                                 iarray_storage_t *storage,
                                 iarray_container_t **b,
-                                double correction) {
+                                double correction,
+                                double q,
+                                bool approximate) {
 
     INA_VERIFY_NOT_NULL(ctx);
     INA_VERIFY_NOT_NULL(a);
     INA_VERIFY_NOT_NULL(axis);
     INA_VERIFY_NOT_NULL(b);
 
-    int err_io;
-
     iarray_container_t *aa = a;
     if (naxis > aa->dtshape->ndim) {
         return INA_ERROR(IARRAY_ERR_INVALID_AXIS);
@@ -1349,104 +1343,98 @@ ina_rc_t _iarray_reduce_oneshot(iarray_context_t *ctx,
 
     bool axis_used[IARRAY_DIMENSION_MAX] = {0};
     // Check if an axis is higher than array dimensions and if an axis is repeated
-    int ii = 0;
     for (int i = 0; i < naxis; ++i) {
         if (axis[i] > aa->dtshape->ndim || axis_used[axis[i]]) {
             return INA_ERROR(IARRAY_ERR_INVALID_AXIS);
         }
         axis_used[axis[i]] = true;
-        ii++;
     }
 
-    if (a->container_viewed != NULL) {
+    ina_rc_t rc = INA_SUCCESS;
+    iarray_container_t *c = NULL;
+    iarray_container_t *c_view = NULL;
+    char *view_urlpath = NULL;
+    char *red_urlpath = NULL;
+
+    if (a->container_viewed != NULL && (expr != NULL || !_iarray_reduce_view_readable(a))) {
+        // The items of the view are not laid out as in the container viewed
         iarray_storage_t view_storage = {0};
         memcpy(&view_storage, a->storage, sizeof(iarray_storage_t));
-        if (a->storage->urlpath) {
-            view_storage.urlpath = "_iarray_view.iarr";
-            if (access(view_storage.urlpath, 0) == 0) {
-                IARRAY_TRACE1(iarray.tracing, "The temporary file %s already exists, delete it first",
-                              view_storage.urlpath);
-                return INA_ERROR(INA_ERR_INVALID);
-            }
+        view_storage.urlpath = NULL;
+        if (a->storage->urlpath != NULL) {
+            rc = _iarray_scratch_urlpath_new(ctx, "view.iarr", &view_urlpath);
+            INA_FAIL_IF_ERROR(rc);
+            view_storage.urlpath = view_urlpath;
         }
-        iarray_copy(ctx, a, false, &view_storage, &aa);
+        rc = iarray_copy(ctx, a, false, &view_storage, &aa);
+        INA_FAIL_IF_ERROR(rc);
     }
 
-    // Start reductions
-    iarray_container_t *c = NULL;
+    // The result keeps the partition of the input along the other axes, and starts at the
+    // chunk holding the window start of a view
     iarray_storage_t storage_red;
     storage_red.contiguous = storage->contiguous;
-    storage_red.urlpath = storage->urlpath != NULL ? "_iarray_red.iarr" : NULL;
-    for (int j = 0; j < aa->dtshape->ndim; ++j) {
-        storage_red.chunkshape[j] = aa->storage->chunkshape[j];
-        storage_red.blockshape[j] = aa->storage->blockshape[j];
-    }
-    if (storage_red.urlpath != NULL && access(storage_red.urlpath, 0) == 0) {
-        IARRAY_TRACE1(iarray.tracing, "The temporary file %s already exists, delete it first", storage_red.urlpath);
-        return INA_ERROR(INA_ERR_INVALID);
-    }
-
-    for (int i = 0; i < naxis; ++i) {
-        storage_red.chunkshape[axis[i]] = -1;
-        storage_red.blockshape[axis[i]] = -1;
-    }
-
-    int inc = 0;
+    storage_red.urlpath = storage->urlpath;
+    int64_t start[IARRAY_DIMENSION_MAX] = {0};
+    int64_t stop[IARRAY_DIMENSION_MAX] = {0};
+    int8_t j = 0;
+    bool copy = false;
+    bool shifted = false;
     for (int i = 0; i < aa->dtshape->ndim; ++i) {
-        if (storage_red.chunkshape[i] == -1) {
-            inc += 1;
-        } else {
-            storage_red.chunkshape[i - inc] = storage_red.chunkshape[i];
-            storage_red.blockshape[i - inc] = storage_red.blockshape[i];
+        if (axis_used[i]) {
+            continue;
         }
-    }
-
-    IARRAY_RETURN_IF_FAILED(_iarray_reduce2(ctx, aa, func, naxis, axis, &storage_red, &c, correction));
-
-
-    // Check if a copy is needed
-    bool copy = false;
-    for (int i = 0; i < c->dtshape->ndim; ++i) {
-        if (storage->chunkshape[i] != c->storage->chunkshape[i]) {
+        storage_red.chunkshape[j] = aa->storage->chunkshape[i];
+        storage_red.blockshape[j] = aa->storage->blockshape[i];
+        if (storage->chunkshape[j] != storage_red.chunkshape[j] ||
+            storage->blockshape[j] != storage_red.blockshape[j]) {
             copy = true;
-            break;
         }
-        if (storage->blockshape[i] != c->storage->blockshape[i]) {
-            copy = true;
-            break;
+        if (aa->container_viewed != NULL) {
+            start[j] = aa->auxshape->offset[i] % aa->storage->chunkshape[i];
+            shifted |= start[j] != 0;
         }
+        stop[j] = start[j] + aa->dtshape->shape[i];
+        j++;
     }
-
+    copy |= shifted;
     if (copy) {
-        IARRAY_RETURN_IF_FAILED(iarray_copy(ctx, c, false, storage, b));
-        iarray_container_free(ctx, &c);
+        // The result is repartitioned afterwards; it only goes to disk if the output does
+        storage_red.urlpath = NULL;
         if (storage->urlpath != NULL) {
-            err_io = blosc2_remove_urlpath("_iarray_red.iarr");
-            if (err_io != 0) {
-                IARRAY_TRACE1(iarray.tracing, "Invalid io");
-                return INA_ERROR(INA_ERR_OPERATION_INVALID);
-            }
+            rc = _iarray_scratch_urlpath_new(ctx, "red.iarr", &red_urlpath);
+            INA_FAIL_IF_ERROR(rc);
+            storage_red.urlpath = red_urlpath;
         }
+    }
+
+    rc = _iarray_reduce2(ctx, aa, expr, func, naxis, axis, &storage_red, &c, correction, q, approximate);
+    INA_FAIL_IF_ERROR(rc);
+    if (shifted) {
+        rc = iarray_get_slice(ctx, c, start, stop, true, NULL, &c_view);
+        INA_FAIL_IF_ERROR(rc);
+        rc = iarray_copy(ctx, c_view, false, storage, b);
+        INA_FAIL_IF_ERROR(rc);
+    } else if (copy) {
+        rc = iarray_copy(ctx, c, false, storage, b);
+        INA_FAIL_IF_ERROR(rc);
     } else {
-        if (storage->urlpath != NULL) {
-            iarray_container_free(ctx, &c);
-            err_io = blosc2_rename_urlpath("_iarray_red.iarr", storage->urlpath);
-            if (err_io != 0) {
-                IARRAY_TRACE1(iarray.tracing, "Invalid io");
-                return INA_ERROR(INA_ERR_OPERATION_INVALID);
-            }
-            IARRAY_RETURN_IF_FAILED(iarray_container_open(ctx, storage->urlpath, b));
-        } else {
-            *b = c;
-        }
+        *b = c;
+        c = NULL;
     }
 
-    if (storage->urlpath != NULL) {
-        blosc2_remove_urlpath("_iarray_red.iarr");
+fail:
+    if (c_view != NULL) {
+        iarray_container_free(ctx, &c_view);
+    }
+    if (c != NULL) {
+        iarray_container_free(ctx, &c);
     }
-    if (a->container_viewed != NULL && a->storage->urlpath != NULL) {
-        blosc2_remove_urlpath("_iarray_view.iarr");
+    if (aa != a) {
+        iarray_container_free(ctx, &aa);
     }
+    _iarray_scratch_urlpath_free(&red_urlpath);
+    _iarray_scratch_urlpath_free(&view_urlpath);
 
-    return INA_SUCCESS;
+    return rc;
 }
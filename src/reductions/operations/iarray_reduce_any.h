@@ -15,6 +15,11 @@
 #include "iarray_reduce_private.h"
 
 
+// NaN and infinity are truthy, as in numpy
+#define ANY_OP(a, b) ((a) | (b))
+
+#define ANY_PRED(x) ((x) != 0)
+
 #define ANY_I(type, inival, nan) \
     INA_UNUSED(user_data); \
     *res = inival;
@@ -22,42 +27,13 @@
 #define ANY_R(type, inival, nan) \
     INA_UNUSED(user_data); \
     INA_UNUSED(strides0); \
-    for (int i = 0; i < nelem; ++i) { \
-        if ((bool)(*data1)) { \
-            *data0 = true;      \
-            break;               \
-        } \
-        data1 += strides1; \
-    }
-
-#define oneshotANY_R(type, inival, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
-    if ((bool)(*data1)) { \
-        *data0 = true;  \
-    }
+    bool found = *data0; \
+    IARRAY_REDUCE_FIND(found, data1, strides1, nelem, ANY_PRED) \
+    *data0 = found;
 
-#define DFANY_R(type, inival, nan) \
+#define ANY_O(type, inival, nan) \
     INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    for (int i = 0; i < nelem; ++i) { \
-        if (!isfinite(*data1) || (bool)(*data1)) { \
-            *data0 = true;        \
-            break;                  \
-        } \
-        data1 += strides1; \
-    }
-
-#define oneshotDFANY_R(type, inival, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
-    if (!isfinite(*data1) || (bool)(*data1)) { \
-        *data0 = true;                   \
-    }                                 \
+    IARRAY_REDUCE_OUTER(bool, data0, data1, nelem, ANY_OP)
 
 #define ANY_F(type, inival, nan) \
     INA_UNUSED(user_data); \
@@ -65,45 +41,36 @@
     ;
 
 
-#define ANY(type, inival, nan, rprefix, oneshot) \
-    static void type##_##oneshot##_##nan##_any_ini(PARAMS_O_I(type, bool)) { \
+#define ANY(type, inival, nan) \
+    static void type##_##nan##_any_ini(PARAMS_O_I(type, bool)) { \
         ANY_I(type, inival, nan) \
     } \
-    static void type##_##oneshot##_##nan##_any_red(PARAMS_O_R(type, bool)) { \
-        oneshot##rprefix##nan##ANY_R(type, inival, nan) \
+    IARRAY_REDUCE_KERNEL static void type##_##nan##_any_red(PARAMS_O_R(type, bool)) { \
+        ANY_R(type, inival, nan) \
     } \
-    static void type##_##oneshot##_##nan##_any_fin(PARAMS_O_F(type, bool)) { \
+    IARRAY_REDUCE_KERNEL static void type##_##nan##_any_out(PARAMS_O_O(type, bool)) { \
+        ANY_O(type, inival, nan) \
+    } \
+    static void type##_##nan##_any_fin(PARAMS_O_F(type, bool)) { \
         ANY_F(type, inival, nan) \
     } \
-    static iarray_reduce_function_t type##oneshot##nan##_ANY = { \
-            .init = CAST_I type##_##oneshot##_##nan##_any_ini, \
-            .reduction = CAST_R type##_##oneshot##_##nan##_any_red, \
-            .finish = CAST_F type##_##oneshot##_##nan##_any_fin, \
+    static iarray_reduce_function_t type##nan##_ANY = { \
+            .init = CAST_I type##_##nan##_any_ini, \
+            .reduction = CAST_R type##_##nan##_any_red, \
+            .finish = CAST_F type##_##nan##_any_fin, \
+            .outer = CAST_O type##_##nan##_any_out, \
     };
 
-ANY(double, false, , DF, )
-ANY(float, false, , DF, )
-ANY(int64_t, false, , , )
-ANY(int32_t, false, , , )
-ANY(int16_t, false, , , )
-ANY(int8_t, false, , , )
-ANY(uint64_t, false, , , )
-ANY(uint32_t, false, , , )
-ANY(uint16_t, false, , , )
-ANY(uint8_t, false, , , )
-ANY(bool, false, , , )
-
-// Oneshot
-ANY(double, false, , DF, oneshot)
-ANY(float, false, , DF, oneshot)
-ANY(int64_t, false, , , oneshot)
-ANY(int32_t, false, , , oneshot)
-ANY(int16_t, false, , , oneshot)
-ANY(int8_t, false, , , oneshot)
-ANY(uint64_t, false, , , oneshot)
-ANY(uint32_t, false, , , oneshot)
-ANY(uint16_t, false, , , oneshot)
-ANY(uint8_t, false, , , oneshot)
-ANY(bool, false, , , oneshot)
+ANY(double, false, )
+ANY(float, false, )
+ANY(int64_t, false, )
+ANY(int32_t, false, )
+ANY(int16_t, false, )
+ANY(int8_t, false, )
+ANY(uint64_t, false, )
+ANY(uint32_t, false, )
+ANY(uint16_t, false, )
+ANY(uint8_t, false, )
+ANY(bool, false, )
 
 #endif //IARRAY_IARRAY_REDUCE_ANY_H
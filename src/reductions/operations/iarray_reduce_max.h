@@ -15,76 +15,27 @@
 #include "iarray_reduce_private.h"
 
 
-#define MAX_I(type, inival, nan) \
-    INA_UNUSED(user_data); \
-    *res = inival;
+#define MAX_OP(a, b) ((b) > (a) ? (b) : (a))
 
-#define MAX_R(type, inival, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    for (int i = 0; i < nelem; ++i) { \
-        if (*data1 > *data0) { \
-            *data0 = *data1; \
-        } \
-        data1 += strides1; \
-    }
+// NaN propagates, as in numpy
+#define DFMAX_OP(a, b) (((b) > (a)) | ((b) != (b)) ? (b) : (a))
 
-#define oneshotMAX_R(type, inival, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
-    if (*data1 > *data0) { \
-        *data0 = *data1; \
-    }
+#define nanMAX_OP(a, b) (((b) == (b)) & (((b) > (a)) | ((a) != (a))) ? (b) : (a))
 
-#define DFMAX_R(type, inival, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    for (int i = 0; i < nelem; ++i) { \
-        if(isnan(*data1)) {\
-            *data0 = NAN;  \
-            break;      \
-        }\
-        if (*data1 > *data0) { \
-            *data0 = *data1; \
-        } \
-        data1 += strides1; \
-    }
-
-#define oneshotDFMAX_R(type, inival, nan) \
+#define MAX_I(type, inival, nan) \
     INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
-    if(isnan(*data1)) {\
-        *data0 = NAN;  \
-    }                                     \
-    else {                                \
-        if (*data1 > *data0) { \
-            *data0 = *data1; \
-        }                                 \
-    }\
-
+    *res = inival;
 
-#define nanMAX_R(type, inival, nan) \
+#define MAX_R(type, inival, op) \
     INA_UNUSED(user_data); \
     INA_UNUSED(strides0); \
-    for (int i = 0; i < nelem; ++i) { \
-        if (!isnan(*data1) && (*data1 > *data0 || isnan(*data0))) {    \
-            *data0 = *data1; \
-        } \
-        data1 += strides1; \
-    }
+    type acc = *data0; \
+    IARRAY_REDUCE_RUN(type, acc, inival, data1, strides1, nelem, op) \
+    *data0 = acc;
 
-#define oneshotnanMAX_R(type, inival, nan) \
+#define MAX_O(type, inival, op) \
     INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
-    if (!isnan(*data1) && (*data1 > *data0 || isnan(*data0))) {    \
-        *data0 = *data1; \
-    }
+    IARRAY_REDUCE_OUTER(type, data0, data1, nelem, op)
 
 #define MAX_F(type, inival, nan) \
     INA_UNUSED(user_data); \
@@ -92,49 +43,38 @@
     ;
 
 
-#define MAX(type, inival, nan, rprefix, oneshot) \
-    static void type##_##oneshot##_##nan##_max_ini(PARAMS_O_I(type, type)) { \
+#define MAX(type, inival, nan, rprefix) \
+    static void type##_##nan##_max_ini(PARAMS_O_I(type, type)) { \
         MAX_I(type, inival, nan) \
     } \
-    static void type##_##oneshot##_##nan##_max_red(PARAMS_O_R(type, type)) { \
-        oneshot##rprefix##nan##MAX_R(type, inival, nan) \
+    IARRAY_REDUCE_KERNEL static void type##_##nan##_max_red(PARAMS_O_R(type, type)) { \
+        MAX_R(type, inival, rprefix##nan##MAX_OP) \
     } \
-    static void type##_##oneshot##_##nan##_max_fin(PARAMS_O_F(type, type)) { \
+    IARRAY_REDUCE_KERNEL static void type##_##nan##_max_out(PARAMS_O_O(type, type)) { \
+        MAX_O(type, inival, rprefix##nan##MAX_OP) \
+    } \
+    static void type##_##nan##_max_fin(PARAMS_O_F(type, type)) { \
         MAX_F(type, inival, nan) \
     } \
-    static iarray_reduce_function_t type##oneshot##nan##_MAX = { \
-            .init = CAST_I type##_##oneshot##_##nan##_max_ini, \
-            .reduction = CAST_R type##_##oneshot##_##nan##_max_red, \
-            .finish = CAST_F type##_##oneshot##_##nan##_max_fin, \
+    static iarray_reduce_function_t type##nan##_MAX = { \
+            .init = CAST_I type##_##nan##_max_ini, \
+            .reduction = CAST_R type##_##nan##_max_red, \
+            .finish = CAST_F type##_##nan##_max_fin, \
+            .outer = CAST_O type##_##nan##_max_out, \
     };
 
-MAX(double, -INFINITY, , DF, )
-MAX(float, -INFINITY, , DF, )
-MAX(int64_t, LLONG_MIN, , , )
-MAX(int32_t, INT_MIN, , , )
-MAX(int16_t, SHRT_MIN, , , )
-MAX(int8_t, SCHAR_MIN, , , )
-MAX(uint64_t, 0ULL, , , )
-MAX(uint32_t, 0U, , , )
-MAX(uint16_t, 0, , , )
-MAX(uint8_t, 0, , , )
-MAX(bool, false, , , )
-MAX(double, NAN, nan, , )
-MAX(float, NAN, nan, , )
-
-// Oneshot
-MAX(double, -INFINITY, , DF, oneshot)
-MAX(float, -INFINITY, , DF, oneshot)
-MAX(int64_t, LLONG_MIN, , , oneshot)
-MAX(int32_t, INT_MIN, , , oneshot)
-MAX(int16_t, SHRT_MIN, , , oneshot)
-MAX(int8_t, SCHAR_MIN, , , oneshot)
-MAX(uint64_t, 0ULL, , , oneshot)
-MAX(uint32_t, 0U, , , oneshot)
-MAX(uint16_t, 0, , , oneshot)
-MAX(uint8_t, 0, , , oneshot)
-MAX(bool, false, , , oneshot)
-MAX(double, NAN, nan, , oneshot)
-MAX(float, NAN, nan, , oneshot)
+MAX(double, -INFINITY, , DF)
+MAX(float, -INFINITY, , DF)
+MAX(int64_t, LLONG_MIN, , )
+MAX(int32_t, INT_MIN, , )
+MAX(int16_t, SHRT_MIN, , )
+MAX(int8_t, SCHAR_MIN, , )
+MAX(uint64_t, 0ULL, , )
+MAX(uint32_t, 0U, , )
+MAX(uint16_t, 0, , )
+MAX(uint8_t, 0, , )
+MAX(bool, false, , )
+MAX(double, NAN, nan, )
+MAX(float, NAN, nan, )
 
 #endif //IARRAY_IARRAY_REDUCE_MAX_H
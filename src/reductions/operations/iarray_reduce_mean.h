@@ -13,6 +13,7 @@
 #define IARRAY_IARRAY_REDUCE_MEAN_H
 
 #include "iarray_reduce_private.h"
+#include "iarray_reduce_sum.h"
 
 
 #define MEAN_I(itype, otype, nan) \
@@ -27,30 +28,27 @@
     *res = 0;
 
 #define MEAN_R(itype, otype, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    for (int i = 0; i < nelem; ++i) { \
-        *data0 = *data0 + *data1; \
-        data1 += strides1; \
-    }
-
-#define oneshotMEAN_R(itype, otype, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
-    *data0 = *data0 + *data1;
+    SUM_R(itype, otype, nan)
 
 #define nanMEAN_R(itype, otype, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0);  \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
+    SUM_R(itype, otype, nan) \
     user_data_os_t *u_data = (user_data_os_t *) user_data; \
-    if (!isnan(*data1)) {          \
-        *data0 = *data0 + *data1;                      \
-        u_data->not_nan_nelems[u_data->i]++;             \
-   }
+    int64_t not_nan_nelems = 0; \
+    for (int64_t i = 0; i < nelem; ++i) { \
+        not_nan_nelems += data1[i * strides1] == data1[i * strides1]; \
+    } \
+    u_data->not_nan_nelems[u_data->i] += not_nan_nelems;
+
+#define MEAN_O(itype, otype, nan) \
+    SUM_O(itype, otype, nan)
+
+#define nanMEAN_O(itype, otype, nan) \
+    SUM_O(itype, otype, nan) \
+    user_data_os_t *u_data = (user_data_os_t *) user_data; \
+    int64_t *not_nan_nelems = &u_data->not_nan_nelems[u_data->i]; \
+    for (int64_t i = 0; i < nelem; ++i) { \
+        not_nan_nelems[i] += data1[i] == data1[i]; \
+    }
 
 #define MEAN_F(itype, otype, nan) \
     user_data_os_t *u_data = (user_data_os_t *) user_data; \
@@ -61,47 +59,39 @@
     *res = *res / u_data->not_nan_nelems[u_data->i];
 
 
-#define MEAN(itype, otype, nan, oneshot) \
-    static void itype##_##oneshot##_##nan##_mean_ini(PARAMS_O_I(itype, otype)) { \
+#define MEAN(itype, otype, nan) \
+    static void itype##_##nan##_mean_ini(PARAMS_O_I(itype, otype)) { \
         nan##MEAN_I(itype, otype, nan) \
     } \
-    static void itype##_##oneshot##_##nan##_mean_red(PARAMS_O_R(itype, otype)) { \
-        oneshot##nan##MEAN_R(itype, otype, nan) \
+    IARRAY_REDUCE_KERNEL static void itype##_##nan##_mean_red(PARAMS_O_R(itype, otype)) { \
+        nan##MEAN_R(itype, otype, nan) \
+    } \
+    IARRAY_REDUCE_KERNEL static void itype##_##nan##_mean_out(PARAMS_O_O(itype, otype)) { \
+        nan##MEAN_O(itype, otype, nan) \
     } \
-    static void itype##_##oneshot##_##nan##_mean_fin(PARAMS_O_F(itype, otype)) { \
+    static void itype##_##nan##_mean_fin(PARAMS_O_F(itype, otype)) { \
         nan##MEAN_F(itype, otype, nan) \
     } \
-    static iarray_reduce_function_t itype##oneshot##nan##_MEAN = { \
-            .init = CAST_I itype##_##oneshot##_##nan##_mean_ini, \
-            .reduction = CAST_R itype##_##oneshot##_##nan##_mean_red, \
-            .finish = CAST_F itype##_##oneshot##_##nan##_mean_fin, \
+    static iarray_reduce_function_t itype##nan##_MEAN = { \
+            .init = CAST_I itype##_##nan##_mean_ini, \
+            .reduction = CAST_R itype##_##nan##_mean_red, \
+            .finish = CAST_F itype##_##nan##_mean_fin, \
+            .outer = CAST_O itype##_##nan##_mean_out, \
     };
 
-MEAN(double, double, , )
-MEAN(float, float, , )
-MEAN(int64_t, double, , )
-MEAN(int32_t, double, , )
-MEAN(int16_t, double, , )
-MEAN(int8_t, double, , )
-MEAN(uint64_t, double, , )
-MEAN(uint32_t, double, , )
-MEAN(uint16_t, double, , )
-MEAN(uint8_t, double, , )
-MEAN(bool, double, , )
-MEAN(double, double, nan, )
-MEAN(float, float, nan, )
-
-MEAN(double, double, , oneshot)
-MEAN(float, float, , oneshot)
-MEAN(int64_t, double, , oneshot)
-MEAN(int32_t, double, , oneshot)
-MEAN(int16_t, double, , oneshot)
-MEAN(int8_t, double, , oneshot)
-MEAN(uint64_t, double, , oneshot)
-MEAN(uint32_t, double, , oneshot)
-MEAN(uint16_t, double, , oneshot)
-MEAN(uint8_t, double, , oneshot)
-MEAN(bool, double, , oneshot)
+MEAN(double, double, )
+MEAN(float, float, )
+MEAN(int64_t, double, )
+MEAN(int32_t, double, )
+MEAN(int16_t, double, )
+MEAN(int8_t, double, )
+MEAN(uint64_t, double, )
+MEAN(uint32_t, double, )
+MEAN(uint16_t, double, )
+MEAN(uint8_t, double, )
+MEAN(bool, double, )
+MEAN(double, double, nan)
+MEAN(float, float, nan)
 
 #endif //IARRAY_IARRAY_REDUCE_MEAN_H
 
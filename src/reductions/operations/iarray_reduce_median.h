@@ -17,87 +17,172 @@
 #define IARRAY_DTYPE_IS_FLOAT(dtype) \
     ((dtype) == IARRAY_DATA_TYPE_FLOAT || (dtype) == IARRAY_DATA_TYPE_DOUBLE)
 
-#define COMPARE(type, nan) \
-    static int iarray_##type##_##nan##_median_compare(const type *a, const type *b) { \
-        return *a > *b ? 1 : (*a < *b ? -1 : 0); \
+/*
+ * The median and the exact quantiles gather the items of every output item in its slice of
+ * `u_data->medians` and pick the ones they need with an introselect: quickselect with a
+ * median-of-three pivot, falling back to a heapsort of the remaining range if the
+ * partitions do not shrink fast enough.  Only the items are compared, so the slice must not
+ * contain NaNs.  The quantiles are interpolated linearly between the closest ranks, as the
+ * default method of numpy.
+ */
+
+#define IARRAY_SELECT_INSERTION 16
+
+#define SELECT(type) \
+    static void iarray_##type##_heapsort(type *v, int64_t n) { \
+        for (int64_t start = n / 2 - 1, end = n - 1; end > 0; ) { \
+            int64_t root; \
+            if (start >= 0) { \
+                root = start--; \
+            } else { \
+                type t = v[0]; \
+                v[0] = v[end]; \
+                v[end--] = t; \
+                root = 0; \
+            } \
+            for (int64_t child = 2 * root + 1; child <= end; root = child, child = 2 * root + 1) { \
+                if (child < end && v[child] < v[child + 1]) { \
+                    child++; \
+                } \
+                if (!(v[root] < v[child])) { \
+                    break; \
+                } \
+                type t = v[root]; \
+                v[root] = v[child]; \
+                v[child] = t; \
+            } \
+        } \
+    } \
+    static void iarray_##type##_select(type *v, int64_t n, int64_t k) { \
+        int64_t lo = 0; \
+        int64_t hi = n - 1; \
+        int depth = 2; \
+        for (int64_t m = n; m > 1; m >>= 1) { \
+            depth += 2; \
+        } \
+        while (hi - lo > IARRAY_SELECT_INSERTION) { \
+            if (depth-- == 0) { \
+                iarray_##type##_heapsort(&v[lo], hi - lo + 1); \
+                return; \
+            } \
+            int64_t mid = lo + (hi - lo) / 2; \
+            type t; \
+            if (v[mid] < v[lo]) { t = v[mid]; v[mid] = v[lo]; v[lo] = t; } \
+            if (v[hi] < v[lo]) { t = v[hi]; v[hi] = v[lo]; v[lo] = t; } \
+            if (v[hi] < v[mid]) { t = v[hi]; v[hi] = v[mid]; v[mid] = t; } \
+            type pivot = v[mid]; \
+            int64_t i = lo; \
+            int64_t j = hi; \
+            while (i <= j) { \
+                while (v[i] < pivot) { \
+                    i++; \
+                } \
+                while (pivot < v[j]) { \
+                    j--; \
+                } \
+                if (i <= j) { \
+                    t = v[i]; \
+                    v[i++] = v[j]; \
+                    v[j--] = t; \
+                } \
+            } \
+            if (k <= j) { \
+                hi = j; \
+            } else if (k >= i) { \
+                lo = i; \
+            } else { \
+                return; \
+            } \
+        } \
+        for (int64_t i = lo + 1; i <= hi; ++i) { \
+            type t = v[i]; \
+            int64_t j = i; \
+            for (; j > lo && t < v[j - 1]; --j) { \
+                v[j] = v[j - 1]; \
+            } \
+            v[j] = t; \
+        } \
+    } \
+    static double iarray_##type##_quantile(type *v, int64_t n, double q) { \
+        double pos = q * (double) (n - 1); \
+        int64_t k = (int64_t) pos; \
+        iarray_##type##_select(v, n, k); \
+        double lo = (double) v[k]; \
+        if (pos == (double) k) { \
+            return lo; \
+        } \
+        /* The next rank is the smallest item on the right of the k-th one */ \
+        type hi = v[k + 1]; \
+        for (int64_t i = k + 2; i < n; ++i) { \
+            if (v[i] < hi) { \
+                hi = v[i]; \
+            } \
+        } \
+        return lo + (pos - (double) k) * ((double) hi - lo); \
     }
 
 #define MEDIAN_I(itype, otype, nan) \
+    INA_UNUSED(res); \
     user_data_os_t *u_data = (user_data_os_t *) user_data; \
-    u_data->medians[u_data->i] = malloc(u_data->reduced_items * u_data->pparams->out_typesize); \
     u_data->not_nan_nelems[u_data->i] = 0; \
     u_data->nan_nelems[u_data->i] = 0;
 
 #define MEDIAN_R(itype, otype, nan) \
-    INA_UNUSED(user_data); \
+    INA_UNUSED(data0); \
     INA_UNUSED(strides0);  \
     user_data_os_t *u_data = (user_data_os_t *) user_data; \
-    *((itype *) u_data->median) = *((itype *) data1);       \
-    u_data->median += u_data->rparams->input->catarr->itemsize; \
-    itype d1 = *((itype *) data1);                              \
-    if (isnan((double) d1)) { \
-        u_data->nan_nelems[u_data->i]++; \
-    } else {               \
-        u_data->not_nan_nelems[u_data->i]++; \
+    itype *median = (itype *) u_data->median; \
+    int64_t nan_nelems = 0; \
+    for (int64_t i = 0; i < nelem; ++i) { \
+        itype d1 = data1[i * strides1]; \
+        median[i] = d1; \
+        nan_nelems += isnan((double) d1); \
     } \
-    u_data->median_nelems[u_data->i]++;
-
-
-#define MEDIAN_F(itype, otype, nan) \
-    int (*compare)(const void *a, const void *b) = (int(*)(const void *, const void*)) iarray_##itype##_##nan##_median_compare; \
-    user_data_os_t *u_data = (user_data_os_t *) user_data;                                                             \
-    int64_t nelem = u_data->not_nan_nelems[u_data->i];                                                                         \
-    if(u_data->nan_nelems[u_data->i] == 0) {                                                                                        \
-        qsort(u_data->medians[u_data->i], nelem, u_data->input_itemsize, compare);                                                     \
-        if (nelem % 2 == 0) {      \
-            *res = (otype) ((((itype *) u_data->medians[u_data->i])[(int64_t) (nelem / 2 - 1)] + \
-                              ((itype *) u_data->medians[u_data->i])[(int64_t) (nelem / 2)]) * 0.5); \
-        } else {     \
-            *res = (otype) ((itype *) u_data->medians[u_data->i])[(int64_t) (nelem / 2)];             \
-    }                       \
-    } else {                        \
-        *res = NAN;                        \
-    }                       \
-    free(u_data->medians[u_data->i]); \
+    u_data->median += nelem * sizeof(itype); \
+    u_data->nan_nelems[u_data->i] += nan_nelems; \
+    u_data->not_nan_nelems[u_data->i] += nelem - nan_nelems; \
+    u_data->median_nelems[u_data->i] += nelem;
+
+#define MEDIAN_F(itype, otype, quantile) \
+    user_data_os_t *u_data = (user_data_os_t *) user_data; \
+    int64_t nelem = u_data->not_nan_nelems[u_data->i]; \
+    if (u_data->nan_nelems[u_data->i] == 0 && nelem != 0) { \
+        *res = (otype) quantile((itype *) u_data->medians[u_data->i], nelem, u_data->q); \
+    } else { \
+        *res = NAN; \
+    }
 
 #define nanMEDIAN_I(itype, otype, nan) \
     MEDIAN_I(itype, otype, nan)
 
 #define nanMEDIAN_R(itype, otype, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(user_data); \
+    INA_UNUSED(data0); \
     INA_UNUSED(strides0);  \
     user_data_os_t *u_data = (user_data_os_t *) user_data; \
-    itype d1 = *((itype *) data1);                \
-    if(isnan(d1)) {                    \
-        u_data->nan_nelems[u_data->i]++;                   \
+    itype *median = (itype *) u_data->median; \
+    int64_t not_nan_nelems = 0; \
+    for (int64_t i = 0; i < nelem; ++i) { \
+        itype d1 = data1[i * strides1]; \
+        if (!isnan(d1)) { \
+            median[not_nan_nelems++] = d1; \
+        } \
+    } \
+    u_data->median += not_nan_nelems * sizeof(itype); \
+    u_data->nan_nelems[u_data->i] += nelem - not_nan_nelems; \
+    u_data->not_nan_nelems[u_data->i] += not_nan_nelems; \
+    u_data->median_nelems[u_data->i] += not_nan_nelems;
+
+#define nanMEDIAN_F(itype, otype, quantile) \
+    user_data_os_t *u_data = (user_data_os_t *) user_data; \
+    int64_t nelem = u_data->not_nan_nelems[u_data->i]; \
+    if (nelem != 0) { \
+        *res = (otype) quantile((itype *) u_data->medians[u_data->i], nelem, u_data->q); \
     } else { \
-        *((itype *) u_data->median) = d1;       \
-        u_data->median += u_data->rparams->input->catarr->itemsize; \
-        u_data->median_nelems[u_data->i]++; \
-        u_data->not_nan_nelems[u_data->i]++;                   \
-    }                       \
-
-#define nanMEDIAN_F(itype, otype, nan) \
-    int (*compare)(const void *a, const void *b) = (int(*)(const void *, const void*)) iarray_##itype##_##nan##_median_compare; \
-    user_data_os_t *u_data = (user_data_os_t *) user_data;                                                             \
-    int64_t nelem = u_data->not_nan_nelems[u_data->i];                                                                         \
-    if(nelem != 0) {                        \
-        qsort(u_data->medians[u_data->i], nelem, u_data->input_itemsize, compare);                                                     \
-        if (nelem % 2 == 0) {      \
-            *res = (otype) ((((itype *) u_data->medians[u_data->i])[(int64_t) (nelem / 2 - 1)] + \
-                              ((itype *) u_data->medians[u_data->i])[(int64_t) (nelem / 2)]) * 0.5); \
-        } else {     \
-            *res = (otype) ((itype *) u_data->medians[u_data->i])[(int64_t) (nelem / 2)];             \
-    }                       \
-    } else {                \
-        *res = NAN;                        \
-    }                       \
-    free(u_data->medians[u_data->i]);
+        *res = NAN; \
+    }
 
 
 #define MEDIAN(itype, otype, nan) \
-    COMPARE(itype, nan) \
     static void itype##_##nan##_median_ini(PARAMS_O_I(itype, otype)) { \
         nan##MEDIAN_I(itype, otype, nan) \
     } \
@@ -105,7 +190,7 @@
         nan##MEDIAN_R(itype, otype, nan) \
     } \
     static void itype##_##nan##_median_fin(PARAMS_O_F(itype, otype)) { \
-        nan##MEDIAN_F(itype, otype, nan) \
+        nan##MEDIAN_F(itype, otype, iarray_##itype##_quantile) \
     } \
     static iarray_reduce_function_t itype##nan##_MEDIAN = { \
             .init = CAST_I itype##_##nan##_median_ini, \
@@ -113,6 +198,18 @@
             .finish = CAST_F itype##_##nan##_median_fin, \
     };
 
+SELECT(double)
+SELECT(float)
+SELECT(int64_t)
+SELECT(int32_t)
+SELECT(int16_t)
+SELECT(int8_t)
+SELECT(uint64_t)
+SELECT(uint32_t)
+SELECT(uint16_t)
+SELECT(uint8_t)
+SELECT(bool)
+
 MEDIAN(double, double,)
 MEDIAN(double, double, nan)
 MEDIAN(float,float, )
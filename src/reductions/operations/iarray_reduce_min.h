@@ -15,75 +15,27 @@
 #include "iarray_reduce_private.h"
 
 
-#define MIN_I(type, inival, nan) \
-    INA_UNUSED(user_data); \
-    *res = inival;
-
-#define MIN_R(type, inival, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    for (int i = 0; i < nelem; ++i) { \
-        if (*data1 < *data0) {    \
-            *data0 = *data1; \
-        } \
-        data1 += strides1; \
-    }
+#define MIN_OP(a, b) ((b) < (a) ? (b) : (a))
 
-#define oneshotMIN_R(type, inival, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
-    if (*data1 < *data0) {    \
-        *data0 = *data1; \
-    }
+// NaN propagates, as in numpy
+#define DFMIN_OP(a, b) (((b) < (a)) | ((b) != (b)) ? (b) : (a))
 
-#define DFMIN_R(type, inival, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    for (int i = 0; i < nelem; ++i) { \
-        if(isnan(*data1)) {\
-            *data0 = NAN;  \
-            break;      \
-        }\
-        if (*data1 < *data0) {    \
-            *data0 = *data1; \
-        } \
-        data1 += strides1; \
-    }
+#define nanMIN_OP(a, b) (((b) == (b)) & (((b) < (a)) | ((a) != (a))) ? (b) : (a))
 
-#define oneshotDFMIN_R(type, inival, nan) \
+#define MIN_I(type, inival, nan) \
     INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
-    if(isnan(*data1)) {\
-        *data0 = NAN;  \
-    }                                 \
-    else {                            \
-        if (*data1 < *data0) {    \
-            *data0 = *data1; \
-        }\
-    }
+    *res = inival;
 
-#define nanMIN_R(type, inival, nan) \
+#define MIN_R(type, inival, op) \
     INA_UNUSED(user_data); \
     INA_UNUSED(strides0); \
-    for (int i = 0; i < nelem; ++i) { \
-        if (!isnan(*data1) && (isnan(*data0) || *data1 < *data0)) {    \
-            *data0 = *data1; \
-        } \
-        data1 += strides1; \
-    }
+    type acc = *data0; \
+    IARRAY_REDUCE_RUN(type, acc, inival, data1, strides1, nelem, op) \
+    *data0 = acc;
 
-#define oneshotnanMIN_R(type, inival, nan) \
+#define MIN_O(type, inival, op) \
     INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
-    if (!isnan(*data1) && (isnan(*data0) || *data1 < *data0)) {    \
-        *data0 = *data1; \
-    }
+    IARRAY_REDUCE_OUTER(type, data0, data1, nelem, op)
 
 #define MIN_F(type, inival, nan) \
     INA_UNUSED(user_data); \
@@ -91,48 +43,38 @@
     ;
 
 
-#define MIN(type, inival, nan, rprefix, oneshot) \
-    static void type##_##oneshot##_##nan##_min_ini(PARAMS_O_I(type, type)) { \
+#define MIN(type, inival, nan, rprefix) \
+    static void type##_##nan##_min_ini(PARAMS_O_I(type, type)) { \
         MIN_I(type, inival, nan) \
     } \
-    static void type##_##oneshot##_##nan##_min_red(PARAMS_O_R(type, type)) { \
-        oneshot##rprefix##nan##MIN_R(type, inival, nan) \
+    IARRAY_REDUCE_KERNEL static void type##_##nan##_min_red(PARAMS_O_R(type, type)) { \
+        MIN_R(type, inival, rprefix##nan##MIN_OP) \
     } \
-    static void type##_##oneshot##_##nan##_min_fin(PARAMS_O_F(type, type)) { \
+    IARRAY_REDUCE_KERNEL static void type##_##nan##_min_out(PARAMS_O_O(type, type)) { \
+        MIN_O(type, inival, rprefix##nan##MIN_OP) \
+    } \
+    static void type##_##nan##_min_fin(PARAMS_O_F(type, type)) { \
         MIN_F(type, inival, nan) \
     } \
-    static iarray_reduce_function_t type##oneshot##nan##_MIN = { \
-            .init = CAST_I type##_##oneshot##_##nan##_min_ini, \
-            .reduction = CAST_R type##_##oneshot##_##nan##_min_red, \
-            .finish = CAST_F type##_##oneshot##_##nan##_min_fin, \
+    static iarray_reduce_function_t type##nan##_MIN = { \
+            .init = CAST_I type##_##nan##_min_ini, \
+            .reduction = CAST_R type##_##nan##_min_red, \
+            .finish = CAST_F type##_##nan##_min_fin, \
+            .outer = CAST_O type##_##nan##_min_out, \
     };
 
-MIN(double, INFINITY, , DF, )
-MIN(float, INFINITY, , DF, )
-MIN(int64_t, LLONG_MAX, , , )
-MIN(int32_t, INT_MAX, , , )
-MIN(int16_t, SHRT_MAX, , , )
-MIN(int8_t, SCHAR_MAX, , , )
-MIN(uint64_t, ULLONG_MAX, , , )
-MIN(uint32_t, UINT_MAX, , , )
-MIN(uint16_t, USHRT_MAX, , , )
-MIN(uint8_t, UCHAR_MAX, , , )
-MIN(bool, true, , , )
-MIN(double, NAN, nan, , )
-MIN(float, NAN, nan, , )
-
-MIN(double, INFINITY, , DF, oneshot)
-MIN(float, INFINITY, , DF, oneshot)
-MIN(int64_t, LLONG_MAX, , , oneshot)
-MIN(int32_t, INT_MAX, , , oneshot)
-MIN(int16_t, SHRT_MAX, , , oneshot)
-MIN(int8_t, SCHAR_MAX, , , oneshot)
-MIN(uint64_t, ULLONG_MAX, , , oneshot)
-MIN(uint32_t, UINT_MAX, , , oneshot)
-MIN(uint16_t, USHRT_MAX, , , oneshot)
-MIN(uint8_t, UCHAR_MAX, , , oneshot)
-MIN(bool, true, , , oneshot)
-MIN(double, NAN, nan, , oneshot)
-MIN(float, NAN, nan, , oneshot)
+MIN(double, INFINITY, , DF)
+MIN(float, INFINITY, , DF)
+MIN(int64_t, LLONG_MAX, , )
+MIN(int32_t, INT_MAX, , )
+MIN(int16_t, SHRT_MAX, , )
+MIN(int8_t, SCHAR_MAX, , )
+MIN(uint64_t, ULLONG_MAX, , )
+MIN(uint32_t, UINT_MAX, , )
+MIN(uint16_t, USHRT_MAX, , )
+MIN(uint8_t, UCHAR_MAX, , )
+MIN(bool, true, , )
+MIN(double, NAN, nan, )
+MIN(float, NAN, nan, )
 
 #endif //IARRAY_IARRAY_REDUCE_MIN_H
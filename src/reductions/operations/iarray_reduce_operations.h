@@ -49,6 +49,10 @@
 
 #include "iarray_reduce_median.h"
 
+/* APPROXIMATE QUANTILE REDUCTION */
+
+#include "iarray_reduce_tdigest.h"
+
 /* ALL REDUCTION */
 
 #include "iarray_reduce_all.h"
@@ -22,6 +22,8 @@ struct iarray_reduce_function_s {
     void (*init)(void *, void *);
     void (*reduction)(void *, int64_t, void *, int64_t, int64_t, void *);
     void (*finish)(void *, void *);
+    void (*merge)(void *, void *);  // optional, called once per output item after each input block
+    void (*outer)(void *, const void *, int64_t, void *);  // optional, folds a run into as many output items
 };
 
 typedef struct iarray_reduce_params_s {
@@ -41,41 +43,136 @@ typedef struct iarray_reduce_os_params_s {
     int8_t naxis;
     const int8_t *axis;
     double correction; // Only used for std and var
+    double q;  // Only used for median and quantile
+    bool approximate;  // Only used for quantile, which then keeps a t-digest per output item
     int64_t *out_chunkshape;
     int64_t nchunk;
-    uint8_t *aux_chunk;
-    int32_t aux_csize;
-    iarray_container_t *aux;
+    iarray_expression_t *expr;  // if not NULL, the input blocks are computed by this expression
+    iarray_expr_blocks_t *expr_blocks;  // the state of each thread computing the blocks of expr
+    // The items reduced, in the coordinates of the blocks read (those of the viewed container for views)
+    int64_t window_start[IARRAY_DIMENSION_MAX];
+    int64_t window_stop[IARRAY_DIMENSION_MAX];
+    blosc2_schunk *input_sc;  // where the input blocks are read from
+    void (*cast)(void *, void *, int32_t);  // if not NULL, casts the blocks read to the input type
 } iarray_reduce_os_params_t;
 
+// Running moments of a var/std reduction (count, mean and sum of squared deviations)
+typedef struct iarray_welford_s {
+    int64_t n;
+    double mean;
+    double m2;
+} iarray_welford_t;
+
+// A centroid of a t-digest; unmerged items are centroids of weight 1
+typedef struct iarray_centroid_s {
+    double mean;
+    double weight;
+} iarray_centroid_t;
+
+// Mergeable sketch of an approximate quantile reduction, with a bounded number of centroids
+typedef struct iarray_tdigest_s {
+    int64_t ncentroids;  // merged centroids, sorted by mean
+    int64_t nitems;  // items not merged yet, after the centroids
+    double weight;  // the weight of the merged centroids
+    double min;
+    double max;
+    iarray_centroid_t *centroids;
+} iarray_tdigest_t;
+
 typedef struct user_data_os_s {
     blosc2_prefilter_params *pparams;
     iarray_reduce_os_params_t *rparams;
     int64_t reduced_items;
+    int64_t nchunk;  // the input chunk being reduced
     int64_t i;
     double inv_nelem;
     uint8_t input_itemsize;
     int64_t *not_nan_nelems;
     int64_t *nan_nelems;
-    uint8_t *mean;
+    iarray_welford_t *welford;  // moments accumulated so far, one per output item
+    iarray_welford_t *welford_block;  // moments of the current input block, one per output item
+    double q;
     uint8_t **medians;
     uint8_t *median;
     int64_t *median_nelems;
+    iarray_tdigest_t *tdigests;  // one per output item, for approximate quantiles
+    uint8_t *cast_block;  // a block read, before it is cast to the input type
 } user_data_os_t;
 
 
 #define REDUCTION(name, type) \
     type##_##name
-#define ONESHOTREDUCTION(name, type) \
-    type##oneshot_##name
 #define NANREDUCTION(name, type) \
     type##nan_##name
-#define ONESHOTNANREDUCTION(name, type) \
-    type##oneshotnan_##name
 
 #define CAST_I (void (*)(void *, void *))
 #define CAST_R (void (*)(void *, int64_t, void *, int64_t, int64_t, void *))
 #define CAST_F (void (*)(void *, void *))
+#define CAST_O (void (*)(void *, const void *, int64_t, void *))
+
+/*
+ * The reduction kernels get a whole run of `nelem` input items per call: `reduction` folds a
+ * (possibly strided) run into a single output item, and `outer` folds a contiguous run into as
+ * many consecutive output items, which is what happens when the innermost axis is not reduced.
+ * Contiguous runs are folded into IARRAY_REDUCE_LANES independent partial results, so that the
+ * compiler can keep them in SIMD registers.  On x86-64 Linux with GCC, the kernels are also
+ * cloned for AVX2 and AVX-512 and the best one is picked at load time.
+ */
+#define IARRAY_REDUCE_LANES 16
+
+// The items that any and all look at before checking whether they can stop
+#define IARRAY_REDUCE_BATCH 256
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define IARRAY_REDUCE_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define IARRAY_REDUCE_KERNEL
+#endif
+
+#define IARRAY_REDUCE_RUN(otype, acc, identity, data1, strides1, nelem, op) \
+    if (strides1 == 1) { \
+        otype lanes_[IARRAY_REDUCE_LANES]; \
+        for (int l_ = 0; l_ < IARRAY_REDUCE_LANES; ++l_) { \
+            lanes_[l_] = identity; \
+        } \
+        int64_t i_ = 0; \
+        for (; i_ + IARRAY_REDUCE_LANES <= nelem; i_ += IARRAY_REDUCE_LANES) { \
+            for (int l_ = 0; l_ < IARRAY_REDUCE_LANES; ++l_) { \
+                lanes_[l_] = op(lanes_[l_], (otype) data1[i_ + l_]); \
+            } \
+        } \
+        for (int l_ = 0; l_ < IARRAY_REDUCE_LANES; ++l_) { \
+            acc = op(acc, lanes_[l_]); \
+        } \
+        for (; i_ < nelem; ++i_) { \
+            acc = op(acc, (otype) data1[i_]); \
+        } \
+    } else { \
+        for (int64_t i_ = 0; i_ < nelem; ++i_) { \
+            acc = op(acc, (otype) data1[i_ * strides1]); \
+        } \
+    }
+
+#define IARRAY_REDUCE_FIND(found, data1, strides1, nelem, pred) \
+    for (int64_t i_ = 0; i_ < nelem && !found; i_ += IARRAY_REDUCE_BATCH) { \
+        int64_t n_ = nelem - i_ < IARRAY_REDUCE_BATCH ? nelem - i_ : IARRAY_REDUCE_BATCH; \
+        int hits_ = 0; \
+        if (strides1 == 1) { \
+            for (int64_t j_ = 0; j_ < n_; ++j_) { \
+                hits_ |= pred(data1[i_ + j_]); \
+            } \
+        } else { \
+            for (int64_t j_ = 0; j_ < n_; ++j_) { \
+                hits_ |= pred(data1[(i_ + j_) * strides1]); \
+            } \
+        } \
+        found = hits_ != 0; \
+    }
+
+#define IARRAY_REDUCE_OUTER(otype, data0, data1, nelem, op) \
+    for (int64_t i_ = 0; i_ < nelem; ++i_) { \
+        data0[i_] = op(data0[i_], (otype) data1[i_]); \
+    }
 
 
 #define PARAMS_O_I(itype, otype) \
@@ -91,15 +188,22 @@ typedef struct user_data_os_s {
 #define PARAMS_O_F(itype, otype) \
     otype *res, void *user_data
 
+#define PARAMS_O_O(itype, otype) \
+    otype *data0, const itype *data1, \
+    int64_t nelem, void *user_data
+
 
 ina_rc_t _iarray_reduce_oneshot(iarray_context_t *ctx,
                                 iarray_container_t *a,
+                                iarray_expression_t *expr,
                                 iarray_reduce_func_t func,
                                 int8_t naxis,
                                 const int8_t *axis,
                                 iarray_storage_t *storage,
                                 iarray_container_t **b,
-                                double correction);
+                                double correction,
+                                double q,
+                                bool approximate);
 
 
 #endif //IARRAY_IARRAY_REDUCE_PRIVATE_H
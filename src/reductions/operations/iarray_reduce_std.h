@@ -70,6 +70,7 @@
             .init = CAST_I itype##_##nan##_std_ini, \
             .reduction = CAST_R itype##_##nan##_std_red, \
             .finish = CAST_F itype##_##nan##_std_fin, \
+            .merge = _iarray_welford_merge, \
     };
 
 STD(double, double, , )
@@ -14,6 +14,10 @@
 
 #include "iarray_reduce_private.h"
 
+#define SUM_OP(a, b) ((a) + (b))
+
+#define nanSUM_OP(a, b) ((b) != (b) ? (a) : (a) + (b))
+
 #define SUM_I(itype, otype, nan) \
     INA_UNUSED(user_data); \
     *res = 0;
@@ -21,36 +25,13 @@
 #define SUM_R(itype, otype, nan) \
     INA_UNUSED(user_data); \
     INA_UNUSED(strides0); \
-    for (int i = 0; i < nelem; ++i) { \
-        *data0 = *data0 + *data1; \
-        data1 += strides1; \
-    }
-
-#define oneshotSUM_R(itype, otype, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
-    *data0 = *data0 + *data1; \
+    otype acc = *data0; \
+    IARRAY_REDUCE_RUN(otype, acc, 0, data1, strides1, nelem, nan##SUM_OP) \
+    *data0 = acc;
 
-#define nanSUM_R(itype, otype, nan) \
+#define SUM_O(itype, otype, nan) \
     INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    for (int i = 0; i < nelem; ++i) { \
-        if (!isnan(*data1)) {         \
-            *data0 = *data0 + *data1; \
-        }\
-        data1 += strides1; \
-    }
-
-#define oneshotnanSUM_R(itype, otype, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0); \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem); \
-    if (!isnan(*data1)) {         \
-        *data0 = *data0 + *data1; \
-    }
+    IARRAY_REDUCE_OUTER(otype, data0, data1, nelem, nan##SUM_OP)
 
 #define SUM_F(itype, otype, nan) \
     INA_UNUSED(user_data); \
@@ -58,48 +39,38 @@
     ;
 
 
-#define SUM(itype, otype, nan, oneshot) \
-    static void itype##_##oneshot##_##nan##_sum_ini(PARAMS_O_I(itype, otype)) { \
+#define SUM(itype, otype, nan) \
+    static void itype##_##nan##_sum_ini(PARAMS_O_I(itype, otype)) { \
         SUM_I(itype, otype, nan) \
     } \
-    static void itype##_##oneshot##_##nan##_sum_red(PARAMS_O_R(itype, otype)) { \
-        oneshot##nan##SUM_R(itype, otype, nan) \
+    IARRAY_REDUCE_KERNEL static void itype##_##nan##_sum_red(PARAMS_O_R(itype, otype)) { \
+        SUM_R(itype, otype, nan) \
     } \
-    static void itype##_##oneshot##_##nan##_sum_fin(PARAMS_O_F(itype, otype)) { \
+    IARRAY_REDUCE_KERNEL static void itype##_##nan##_sum_out(PARAMS_O_O(itype, otype)) { \
+        SUM_O(itype, otype, nan) \
+    } \
+    static void itype##_##nan##_sum_fin(PARAMS_O_F(itype, otype)) { \
         SUM_F(itype, otype, nan) \
     } \
-    static iarray_reduce_function_t itype##oneshot##nan##_SUM = { \
-            .init = CAST_I itype##_##oneshot##_##nan##_sum_ini, \
-            .reduction = CAST_R itype##_##oneshot##_##nan##_sum_red, \
-            .finish = CAST_F itype##_##oneshot##_##nan##_sum_fin, \
+    static iarray_reduce_function_t itype##nan##_SUM = { \
+            .init = CAST_I itype##_##nan##_sum_ini, \
+            .reduction = CAST_R itype##_##nan##_sum_red, \
+            .finish = CAST_F itype##_##nan##_sum_fin, \
+            .outer = CAST_O itype##_##nan##_sum_out, \
     };
 
-SUM(double, double, , )
-SUM(float, float, , )
-SUM(int64_t, int64_t, , )
-SUM(int32_t, int64_t, , )
-SUM(int16_t, int64_t, , )
-SUM(int8_t, int64_t, , )
-SUM(uint64_t, uint64_t, , )
-SUM(uint32_t, uint64_t, , )
-SUM(uint16_t, uint64_t, , )
-SUM(uint8_t, uint64_t, , )
-SUM(bool, int64_t, , )
-SUM(double, double, nan, )
-SUM(float, float, nan, )
-
-SUM(double, double, , oneshot)
-SUM(float, float, , oneshot)
-SUM(int64_t, int64_t, , oneshot)
-SUM(int32_t, int64_t, , oneshot)
-SUM(int16_t, int64_t, , oneshot)
-SUM(int8_t, int64_t, , oneshot)
-SUM(uint64_t, uint64_t, , oneshot)
-SUM(uint32_t, uint64_t, , oneshot)
-SUM(uint16_t, uint64_t, , oneshot)
-SUM(uint8_t, uint64_t, , oneshot)
-SUM(bool, int64_t, , oneshot)
-SUM(double, double, nan, oneshot)
-SUM(float, float, nan, oneshot)
+SUM(double, double, )
+SUM(float, float, )
+SUM(int64_t, int64_t, )
+SUM(int32_t, int64_t, )
+SUM(int16_t, int64_t, )
+SUM(int8_t, int64_t, )
+SUM(uint64_t, uint64_t, )
+SUM(uint32_t, uint64_t, )
+SUM(uint16_t, uint64_t, )
+SUM(uint8_t, uint64_t, )
+SUM(bool, int64_t, )
+SUM(double, double, nan)
+SUM(float, float, nan)
 
 #endif //IARRAY_IARRAY_REDUCE_SUM_H
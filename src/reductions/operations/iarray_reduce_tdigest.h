@@ -0,0 +1,186 @@
+/*
+ * Copyright ironArray SL 2022.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#ifndef IARRAY_IARRAY_REDUCE_TDIGEST_H
+#define IARRAY_IARRAY_REDUCE_TDIGEST_H
+
+#include "iarray_reduce_private.h"
+
+/*
+ * Approximate quantiles keep a merging t-digest per output item instead of all its items, so
+ * their memory does not depend on the length of the reduced axes.  The items of every input
+ * block are appended to the digest, and once it is full they are sorted together with the
+ * centroids and merged greedily, bounding the weight of every centroid with the arcsine scale
+ * function.  Centroids stay small near the tails, where the quantiles are the most sensitive.
+ */
+
+#define IARRAY_TDIGEST_COMPRESSION 100
+// The centroids plus the items not merged yet; a merge never leaves more than COMPRESSION + 2
+#define IARRAY_TDIGEST_CAPACITY (3 * IARRAY_TDIGEST_COMPRESSION)
+
+static int _iarray_centroid_compare(const void *a, const void *b) {
+    double ma = ((const iarray_centroid_t *) a)->mean;
+    double mb = ((const iarray_centroid_t *) b)->mean;
+    return ma > mb ? 1 : (ma < mb ? -1 : 0);
+}
+
+static inline double _iarray_tdigest_k(double q) {
+    return IARRAY_TDIGEST_COMPRESSION / (2 * M_PI) * asin(2 * q - 1);
+}
+
+static inline double _iarray_tdigest_q(double k) {
+    double x = k * 2 * M_PI / IARRAY_TDIGEST_COMPRESSION;
+    return x >= M_PI / 2 ? 1 : (sin(x) + 1) / 2;
+}
+
+static void _iarray_tdigest_compress(iarray_tdigest_t *td) {
+    if (td->nitems == 0) {
+        return;
+    }
+    iarray_centroid_t *c = td->centroids;
+    int64_t n = td->ncentroids + td->nitems;
+    qsort(c, n, sizeof(iarray_centroid_t), _iarray_centroid_compare);
+
+    double total = td->weight + (double) td->nitems;
+    double cum = 0;
+    double limit = total * _iarray_tdigest_q(_iarray_tdigest_k(0) + 1);
+    int64_t ncentroids = 0;
+    iarray_centroid_t cur = c[0];
+    for (int64_t i = 1; i < n; ++i) {
+        if (cum + cur.weight + c[i].weight <= limit) {
+            cur.weight += c[i].weight;
+            cur.mean += (c[i].mean - cur.mean) * c[i].weight / cur.weight;
+        } else {
+            cum += cur.weight;
+            c[ncentroids++] = cur;
+            limit = total * _iarray_tdigest_q(_iarray_tdigest_k(cum / total) + 1);
+            cur = c[i];
+        }
+    }
+    c[ncentroids++] = cur;
+
+    td->ncentroids = ncentroids;
+    td->nitems = 0;
+    td->weight = total;
+}
+
+static inline void _iarray_tdigest_add(iarray_tdigest_t *td, double x) {
+    if (td->ncentroids + td->nitems == IARRAY_TDIGEST_CAPACITY) {
+        _iarray_tdigest_compress(td);
+    }
+    td->centroids[td->ncentroids + td->nitems++] = (iarray_centroid_t) {x, 1};
+    td->min = x < td->min ? x : td->min;
+    td->max = x > td->max ? x : td->max;
+}
+
+// Interpolate between the centres of the centroids as numpy does between the sorted items
+static double _iarray_tdigest_quantile(iarray_tdigest_t *td, double q) {
+    _iarray_tdigest_compress(td);
+    iarray_centroid_t *c = td->centroids;
+    int64_t n = td->ncentroids;
+    if (n == 0) {
+        return NAN;
+    }
+    double index = q * (td->weight - 1) + 0.5;
+    if (index < c[0].weight / 2) {
+        // Between the minimum, centred at 0.5, and the first centroid
+        double span = c[0].weight / 2 - 0.5;
+        return span <= 0 ? c[0].mean : td->min + (index - 0.5) / span * (c[0].mean - td->min);
+    }
+    double cum = c[0].weight / 2;
+    for (int64_t i = 0; i < n - 1; ++i) {
+        double dw = (c[i].weight + c[i + 1].weight) / 2;
+        if (index < cum + dw) {
+            return c[i].mean + (index - cum) / dw * (c[i + 1].mean - c[i].mean);
+        }
+        cum += dw;
+    }
+    double span = td->weight - 0.5 - cum;
+    return span <= 0 ? c[n - 1].mean : c[n - 1].mean + (index - cum) / span * (td->max - c[n - 1].mean);
+}
+
+#define TDIGEST_I(itype, otype, nan) \
+    INA_UNUSED(res); \
+    user_data_os_t *u_data = (user_data_os_t *) user_data; \
+    iarray_tdigest_t *td = &u_data->tdigests[u_data->i]; \
+    td->ncentroids = 0; \
+    td->nitems = 0; \
+    td->weight = 0; \
+    td->min = INFINITY; \
+    td->max = -INFINITY; \
+    u_data->nan_nelems[u_data->i] = 0;
+
+#define nanTDIGEST_I(itype, otype, nan) \
+    TDIGEST_I(itype, otype, nan)
+
+#define TDIGEST_R(itype, otype, nan) \
+    INA_UNUSED(data0); \
+    INA_UNUSED(strides0); \
+    user_data_os_t *u_data = (user_data_os_t *) user_data; \
+    iarray_tdigest_t *td = &u_data->tdigests[u_data->i]; \
+    int64_t nan_nelems = 0; \
+    for (int64_t i = 0; i < nelem; ++i) { \
+        double d1 = (double) data1[i * strides1]; \
+        if (isnan(d1)) { \
+            nan_nelems++; \
+        } else { \
+            _iarray_tdigest_add(td, d1); \
+        } \
+    } \
+    u_data->nan_nelems[u_data->i] += nan_nelems;
+
+#define nanTDIGEST_R(itype, otype, nan) \
+    TDIGEST_R(itype, otype, nan)
+
+#define TDIGEST_F(itype, otype, nan) \
+    user_data_os_t *u_data = (user_data_os_t *) user_data; \
+    if (u_data->nan_nelems[u_data->i] == 0) { \
+        *res = (otype) _iarray_tdigest_quantile(&u_data->tdigests[u_data->i], u_data->q); \
+    } else { \
+        *res = NAN; \
+    }
+
+#define nanTDIGEST_F(itype, otype, nan) \
+    user_data_os_t *u_data = (user_data_os_t *) user_data; \
+    *res = (otype) _iarray_tdigest_quantile(&u_data->tdigests[u_data->i], u_data->q);
+
+
+#define TDIGEST(itype, otype, nan) \
+    static void itype##_##nan##_tdigest_ini(PARAMS_O_I(itype, otype)) { \
+        nan##TDIGEST_I(itype, otype, nan) \
+    } \
+    static void itype##_##nan##_tdigest_red(PARAMS_O_R(itype, otype)) { \
+        nan##TDIGEST_R(itype, otype, nan) \
+    } \
+    static void itype##_##nan##_tdigest_fin(PARAMS_O_F(itype, otype)) { \
+        nan##TDIGEST_F(itype, otype, nan) \
+    } \
+    static iarray_reduce_function_t itype##nan##_TDIGEST = { \
+            .init = CAST_I itype##_##nan##_tdigest_ini, \
+            .reduction = CAST_R itype##_##nan##_tdigest_red, \
+            .finish = CAST_F itype##_##nan##_tdigest_fin, \
+    };
+
+TDIGEST(double, double,)
+TDIGEST(double, double, nan)
+TDIGEST(float, float,)
+TDIGEST(float, float, nan)
+TDIGEST(int64_t, double,)
+TDIGEST(int32_t, double,)
+TDIGEST(int16_t, double,)
+TDIGEST(int8_t, double,)
+TDIGEST(uint64_t, double,)
+TDIGEST(uint32_t, double,)
+TDIGEST(uint16_t, double,)
+TDIGEST(uint8_t, double,)
+TDIGEST(bool, double,)
+
+#endif //IARRAY_IARRAY_REDUCE_TDIGEST_H
@@ -14,53 +14,96 @@
 
 #include "iarray_reduce_private.h"
 
+/*
+ * The variance is computed in a single pass.  The (count, mean, M2) moments of every run of
+ * items are computed with two sweeps over the run, which is hot in cache, and folded into the
+ * moments of the current input block with Chan's parallel formula.  Once the block is done,
+ * these are folded into the moments of the output item in the same way.  M2 is only divided by
+ * the number of items in the finish step.
+ */
+
+static inline void _iarray_welford_combine(iarray_welford_t *acc, int64_t n, double mean, double m2) {
+    if (n == 0) {
+        return;
+    }
+    int64_t total = acc->n + n;
+    double delta = mean - acc->mean;
+    acc->mean += delta * (double) n / (double) total;
+    acc->m2 += m2 + delta * delta * (double) acc->n * (double) n / (double) total;
+    acc->n = total;
+}
+
+static inline void _iarray_welford_merge(void *res, void *user_data) {
+    INA_UNUSED(res);
+    user_data_os_t *u_data = (user_data_os_t *) user_data;
+    iarray_welford_t *blk = &u_data->welford_block[u_data->i];
+    _iarray_welford_combine(&u_data->welford[u_data->i], blk->n, blk->mean, blk->m2);
+    blk->n = 0;
+    blk->mean = 0;
+    blk->m2 = 0;
+}
+
+#define VAR_SKIP(x) false
+
+#define nanVAR_SKIP(x) isnan(x)
+
 #define VAR_I(itype, otype, nan) \
     user_data_os_t *u_data = (user_data_os_t *) user_data; \
     *res = 0; \
-    u_data->not_nan_nelems[u_data->i] = 0;
+    u_data->welford[u_data->i] = (iarray_welford_t) {0}; \
+    u_data->welford_block[u_data->i] = (iarray_welford_t) {0};
 
 #define nanVAR_I(itype, otype, nan) \
     VAR_I(itype, otype, nan)
 
 #define VAR_R(itype, otype, nan) \
-    INA_UNUSED(user_data); \
+    INA_UNUSED(data0); \
     INA_UNUSED(strides0);  \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem);  \
     user_data_os_t *u_data = (user_data_os_t *) user_data; \
-    const double *mean = (double *) u_data->mean;    \
-    double dif = (double) *data1 - *mean;          \
-    *data0 += dif * dif;
+    int64_t n = 0; \
+    double sum = 0; \
+    for (int64_t i = 0; i < nelem; ++i) { \
+        double x = (double) data1[i * strides1]; \
+        if (nan##VAR_SKIP(x)) { \
+            continue; \
+        } \
+        sum += x; \
+        n++; \
+    } \
+    if (n == 0) { \
+        return; \
+    } \
+    double mean = sum / (double) n; \
+    double m2 = 0; \
+    for (int64_t i = 0; i < nelem; ++i) { \
+        double x = (double) data1[i * strides1]; \
+        if (nan##VAR_SKIP(x)) { \
+            continue; \
+        } \
+        m2 += (x - mean) * (x - mean); \
+    } \
+    _iarray_welford_combine(&u_data->welford_block[u_data->i], n, mean, m2);
 
 #define nanVAR_R(itype, otype, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0);  \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem);  \
-    user_data_os_t *u_data = (user_data_os_t *) user_data; \
-    const double *mean = (double *) u_data->mean;    \
-    if (!isnan(*data1)) {  \
-        double dif = (double) *data1 - *mean;          \
-        *data0 += dif * dif;         \
-        u_data->not_nan_nelems[u_data->i]++; \
-    }
+    VAR_R(itype, otype, nan)
 
 #define VAR_F(itype, otype, nan) \
-    INA_UNUSED(user_data); \
     user_data_os_t *u_data = (user_data_os_t *) user_data; \
-    *res = *res * u_data->inv_nelem;
+    _iarray_welford_merge(res, user_data); \
+    *res = (otype) (u_data->welford[u_data->i].m2 * u_data->inv_nelem);
 
 #define nanVAR_F(itype, otype, nan) \
-    INA_UNUSED(user_data); \
     user_data_os_t *u_data = (user_data_os_t *) user_data; \
-    if (u_data->not_nan_nelems[u_data->i] - u_data->rparams->correction < 0){\
-        *res = *res / u_data->not_nan_nelems[u_data->i];\
+    _iarray_welford_merge(res, user_data); \
+    iarray_welford_t *w = &u_data->welford[u_data->i]; \
+    if (w->n - u_data->rparams->correction < 0){\
+        *res = (otype) (w->m2 / w->n);\
     }\
     else {\
-        *res = *res / (u_data->not_nan_nelems[u_data->i] - u_data->rparams->correction);\
+        *res = (otype) (w->m2 / (w->n - u_data->rparams->correction));\
     }\
 
-// Only used for float output
+// Only used for float output; the moments are always kept in double precision
 #define FVAR_I(itype, otype, nan) \
     VAR_I(itype, otype, nan)
 
@@ -68,27 +111,10 @@
     nanVAR_I(itype, otype, nan)
 
 #define FVAR_R(itype, otype, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0);  \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem);  \
-    user_data_os_t *u_data = (user_data_os_t *) user_data; \
-    const float *mean = (float *) u_data->mean;      \
-    float dif = (float) *data1 - *mean;          \
-    *data0 += dif * dif;
+    VAR_R(itype, otype, nan)
 
 #define FnanVAR_R(itype, otype, nan) \
-    INA_UNUSED(user_data); \
-    INA_UNUSED(strides0);  \
-    INA_UNUSED(strides1);  \
-    INA_UNUSED(nelem);  \
-    user_data_os_t *u_data = (user_data_os_t *) user_data; \
-    const float *mean = (float *) u_data->mean;    \
-    if (!isnan(*data1)) {  \
-        float dif = (float) *data1 - *mean;          \
-        *data0 += dif * dif;         \
-        u_data->not_nan_nelems[u_data->i]++; \
-    }
+    nanVAR_R(itype, otype, nan)
 
 #define FVAR_F(itype, otype, nan) \
     VAR_F(itype, otype, nan)
@@ -111,6 +137,7 @@
             .init = CAST_I itype##_##nan##_var_ini, \
             .reduction = CAST_R itype##_##nan##_var_red, \
             .finish = CAST_F itype##_##nan##_var_fin, \
+            .merge = _iarray_welford_merge, \
     };
 
 VAR(double, double, , )
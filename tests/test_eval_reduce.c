@@ -0,0 +1,144 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+#include <math.h>
+
+
+static ina_rc_t test_eval_reduce(iarray_context_t *ctx, iarray_reduce_func_t func, int8_t axis,
+                                 const int64_t *ycshape, const int64_t *ybshape)
+{
+    int8_t ndim = 2;
+    int64_t shape[] = {110, 73};
+    int64_t nelem = shape[0] * shape[1];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    iarray_storage_t ystore;
+    ystore.contiguous = false;
+    ystore.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = 40;
+        store.blockshape[i] = 12;
+        ystore.chunkshape[i] = ycshape[i];
+        ystore.blockshape[i] = ybshape[i];
+    }
+
+    double *buffer_x = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_y = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_z = ina_mem_alloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        buffer_x[i] = (double) (i % 97) / 10.;
+        buffer_y[i] = (double) (i % 13) - 6.;
+        buffer_z[i] = buffer_x[i] * buffer_y[i] + 1;
+    }
+
+    iarray_container_t *c_x;
+    iarray_container_t *c_y;
+    iarray_container_t *c_z;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_x, nelem * sizeof(double), &store, &c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_y, nelem * sizeof(double), &ystore, &c_y));
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_z, nelem * sizeof(double), &store, &c_z));
+
+    iarray_expression_t *e;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "y", c_y));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, "x * y + 1"));
+
+    // The reference is the reduction of the materialized result
+    iarray_storage_t rstore;
+    rstore.contiguous = false;
+    rstore.urlpath = NULL;
+    rstore.chunkshape[0] = 40;
+    rstore.blockshape[0] = 12;
+    iarray_container_t *c_ref;
+    iarray_container_t *c_res;
+    INA_TEST_ASSERT_SUCCEED(iarray_reduce(ctx, c_z, func, axis, &rstore, &c_ref, true, 0.0));
+    int8_t axes[] = {axis};
+    INA_TEST_ASSERT_SUCCEED(iarray_eval_reduce(e, func, 1, axes, &rstore, &c_res, 0.0));
+
+    int64_t rnelem = shape[1 - axis];
+    double *buffer_ref = ina_mem_alloc(rnelem * sizeof(double));
+    INA_TEST_ASSERT_SUCCEED(iarray_to_buffer(ctx, c_ref, buffer_ref, rnelem * sizeof(double)));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_res, buffer_ref, rnelem * sizeof(double), 1e-12, 1e-12));
+
+    // Full reductions give a scalar
+    double scalar;
+    double scalar_ref = 0;
+    INA_TEST_ASSERT_SUCCEED(iarray_eval_reduce_scalar(e, IARRAY_REDUCE_SUM, 0.0, &scalar, sizeof(double)));
+    for (int64_t i = 0; i < nelem; ++i) {
+        scalar_ref += buffer_z[i];
+    }
+    // The summation order differs from the loop above
+    INA_TEST_ASSERT(fabs(scalar - scalar_ref) <= 1e-10 * fabs(scalar_ref));
+
+    iarray_expr_free(ctx, &e);
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_y);
+    iarray_container_free(ctx, &c_z);
+    iarray_container_free(ctx, &c_ref);
+    iarray_container_free(ctx, &c_res);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_y);
+    ina_mem_free(buffer_z);
+    ina_mem_free(buffer_ref);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(eval_reduce) {
+    iarray_context_t *ctx;
+};
+
+INA_TEST_SETUP(eval_reduce)
+{
+    iarray_init();
+
+    iarray_config_t cfg = IARRAY_CONFIG_DEFAULTS;
+    cfg.max_num_threads = 2;
+    iarray_context_new(&cfg, &data->ctx);
+}
+
+INA_TEST_TEARDOWN(eval_reduce)
+{
+    iarray_context_free(&data->ctx);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(eval_reduce, sum_0)
+{
+    int64_t cshape[] = {40, 40};
+    int64_t bshape[] = {12, 12};
+    INA_TEST_ASSERT_SUCCEED(test_eval_reduce(data->ctx, IARRAY_REDUCE_SUM, 0, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(eval_reduce, mean_1)
+{
+    int64_t cshape[] = {40, 40};
+    int64_t bshape[] = {12, 12};
+    INA_TEST_ASSERT_SUCCEED(test_eval_reduce(data->ctx, IARRAY_REDUCE_MEAN, 1, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(eval_reduce, var_0_repart)
+{
+    // y has a different partition, so its blocks are gathered from the overlapping ones
+    int64_t cshape[] = {30, 50};
+    int64_t bshape[] = {10, 10};
+    INA_TEST_ASSERT_SUCCEED(test_eval_reduce(data->ctx, IARRAY_REDUCE_VAR, 0, cshape, bshape));
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+
+
+static ina_rc_t from_buffer(iarray_context_t *ctx, int8_t ndim, const int64_t *shape, const int64_t *cshape,
+                            const int64_t *bshape, double *buffer, iarray_container_t **c)
+{
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    int64_t nelem = 1;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = cshape[i];
+        store.blockshape[i] = bshape[i];
+        nelem *= shape[i];
+    }
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer, nelem * sizeof(double), &store, c));
+    return INA_SUCCESS;
+}
+
+static ina_rc_t test_broadcast(iarray_config_t *cfg)
+{
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(cfg, &ctx));
+
+    int8_t ndim = 2;
+    int64_t shape[] = {110, 75};
+    int64_t cshape[] = {40, 30};
+    int64_t bshape[] = {15, 10};
+    int64_t m = shape[0];
+    int64_t n = shape[1];
+
+    double *buffer_x = ina_mem_alloc(m * n * sizeof(double));
+    double *buffer_row = ina_mem_alloc(n * sizeof(double));
+    double *buffer_col = ina_mem_alloc(m * sizeof(double));
+    double *buffer_vec = ina_mem_alloc(n * sizeof(double));
+    double *buffer_z = ina_mem_alloc(m * n * sizeof(double));
+    for (int64_t j = 0; j < n; ++j) {
+        buffer_row[j] = (double) j / 3.;
+        buffer_vec[j] = 100. - (double) j;
+    }
+    for (int64_t i = 0; i < m; ++i) {
+        buffer_col[i] = (double) (i % 7) - 3.;
+    }
+    for (int64_t i = 0; i < m; ++i) {
+        for (int64_t j = 0; j < n; ++j) {
+            buffer_x[i * n + j] = (double) (i * n + j) / 10.;
+            buffer_z[i * n + j] = buffer_x[i * n + j] + buffer_row[j] * buffer_col[i] - buffer_vec[j];
+        }
+    }
+
+    iarray_container_t *c_x;
+    iarray_container_t *c_row;
+    iarray_container_t *c_col;
+    iarray_container_t *c_vec;
+    INA_TEST_ASSERT_SUCCEED(from_buffer(ctx, ndim, shape, cshape, bshape, buffer_x, &c_x));
+    int64_t row_shape[] = {1, n};
+    int64_t row_cshape[] = {1, 30};
+    int64_t row_bshape[] = {1, 10};
+    INA_TEST_ASSERT_SUCCEED(from_buffer(ctx, 2, row_shape, row_cshape, row_bshape, buffer_row, &c_row));
+    int64_t col_shape[] = {m, 1};
+    int64_t col_cshape[] = {50, 1};
+    int64_t col_bshape[] = {25, 1};
+    INA_TEST_ASSERT_SUCCEED(from_buffer(ctx, 2, col_shape, col_cshape, col_bshape, buffer_col, &c_col));
+    int64_t vec_shape[] = {n};
+    int64_t vec_cshape[] = {20};
+    int64_t vec_bshape[] = {10};
+    INA_TEST_ASSERT_SUCCEED(from_buffer(ctx, 1, vec_shape, vec_cshape, vec_bshape, buffer_vec, &c_vec));
+
+    iarray_expression_t *e;
+    iarray_container_t *c_z;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, IARRAY_DATA_TYPE_DOUBLE, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "r", c_row));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "c", c_col));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "v", c_vec));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, c_x->dtshape, c_x->storage));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, "x + r * c - v"));
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e, &c_z));
+
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_z, m * n * sizeof(double), 1e-14, 1e-14));
+
+    iarray_expr_free(ctx, &e);
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_row);
+    iarray_container_free(ctx, &c_col);
+    iarray_container_free(ctx, &c_vec);
+    iarray_container_free(ctx, &c_z);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_row);
+    ina_mem_free(buffer_col);
+    ina_mem_free(buffer_vec);
+    ina_mem_free(buffer_z);
+    iarray_context_free(&ctx);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_eval_broadcast) {
+    iarray_config_t cfg;
+};
+
+INA_TEST_SETUP(expression_eval_broadcast)
+{
+    iarray_init();
+
+    data->cfg = IARRAY_CONFIG_DEFAULTS;
+    data->cfg.max_num_threads = 2;
+}
+
+INA_TEST_TEARDOWN(expression_eval_broadcast)
+{
+    INA_UNUSED(data);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_eval_broadcast, iterblosc)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    INA_TEST_ASSERT_SUCCEED(test_broadcast(&data->cfg));
+}
+
+INA_TEST_FIXTURE(expression_eval_broadcast, iterchunk)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERCHUNK;
+    INA_TEST_ASSERT_SUCCEED(test_broadcast(&data->cfg));
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+
+
+static ina_rc_t test_eval_buffer(iarray_config_t *cfg, const int64_t *ycshape, const int64_t *ybshape)
+{
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(cfg, &ctx));
+
+    int8_t ndim = 3;
+    int64_t shape[] = {33, 41, 27};
+    int64_t nelem = shape[0] * shape[1] * shape[2];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    iarray_storage_t ystore;
+    ystore.contiguous = false;
+    ystore.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = 16;
+        store.blockshape[i] = 7;
+        ystore.chunkshape[i] = ycshape[i];
+        ystore.blockshape[i] = ybshape[i];
+    }
+
+    double *buffer_x = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_y = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_z = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_res = ina_mem_alloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        buffer_x[i] = (double) i / 11.;
+        buffer_y[i] = (double) (i % 29) - 14.;
+        buffer_z[i] = buffer_x[i] * buffer_y[i] - 2;
+    }
+
+    iarray_container_t *c_x;
+    iarray_container_t *c_y;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_x, nelem * sizeof(double), &store, &c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_y, nelem * sizeof(double), &ystore, &c_y));
+
+    iarray_expression_t *e;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "y", c_y));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, "x * y - 2"));
+
+    INA_TEST_ASSERT(INA_FAILED(iarray_eval_to_buffer(e, buffer_res, nelem * sizeof(double) - 1)));
+    INA_TEST_ASSERT_SUCCEED(iarray_eval_to_buffer(e, buffer_res, nelem * sizeof(double)));
+    for (int64_t i = 0; i < nelem; ++i) {
+        INA_TEST_ASSERT_EQUAL_FLOATING(buffer_z[i], buffer_res[i]);
+    }
+
+    // The expression can still be evaluated into a container afterwards
+    iarray_container_t *c_z;
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e, &c_z));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_z, nelem * sizeof(double), 0, 0));
+
+    iarray_expr_free(ctx, &e);
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_y);
+    iarray_container_free(ctx, &c_z);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_y);
+    ina_mem_free(buffer_z);
+    ina_mem_free(buffer_res);
+    iarray_context_free(&ctx);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_eval_buffer) {
+    iarray_config_t cfg;
+};
+
+INA_TEST_SETUP(expression_eval_buffer)
+{
+    iarray_init();
+
+    data->cfg = IARRAY_CONFIG_DEFAULTS;
+    data->cfg.max_num_threads = 2;
+}
+
+INA_TEST_TEARDOWN(expression_eval_buffer)
+{
+    INA_UNUSED(data);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_eval_buffer, iterblosc)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    int64_t cshape[] = {16, 16, 16};
+    int64_t bshape[] = {7, 7, 7};
+    INA_TEST_ASSERT_SUCCEED(test_eval_buffer(&data->cfg, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(expression_eval_buffer, iterchunk)
+{
+    // The direct-to-buffer path does not depend on the eval method
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERCHUNK;
+    int64_t cshape[] = {16, 16, 16};
+    int64_t bshape[] = {7, 7, 7};
+    INA_TEST_ASSERT_SUCCEED(test_eval_buffer(&data->cfg, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(expression_eval_buffer, iterblosc_repart)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    int64_t cshape[] = {20, 12, 10};
+    int64_t bshape[] = {5, 6, 5};
+    INA_TEST_ASSERT_SUCCEED(test_eval_buffer(&data->cfg, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(expression_eval_buffer, iterblosc_repart_small_blocks)
+{
+    // Every output block gathers pieces of many blocks and chunks of y
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    int64_t cshape[] = {8, 9, 10};
+    int64_t bshape[] = {3, 2, 4};
+    INA_TEST_ASSERT_SUCCEED(test_eval_buffer(&data->cfg, cshape, bshape));
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+#include <src/iarray_private.h>
+
+
+static ina_rc_t eval_expr(iarray_context_t *ctx, iarray_container_t *c_x, iarray_container_t *c_y,
+                          bool swap_vars, const char *expr_str, const double *buffer_z, int64_t nelem)
+{
+    iarray_expression_t *e;
+    iarray_container_t *c_z;
+
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, c_x->dtshape->dtype, &e));
+    if (swap_vars) {
+        INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "y", c_y));
+        INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+    } else {
+        INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+        INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "y", c_y));
+    }
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, c_x->dtshape, c_x->storage));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, expr_str));
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e, &c_z));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_z, nelem * sizeof(double), 0, 0));
+
+    iarray_expr_free(ctx, &e);
+    iarray_container_free(ctx, &c_z);
+
+    return INA_SUCCESS;
+}
+
+static ina_rc_t test_expression_cache(iarray_context_t *ctx, const char *cache_dir)
+{
+    int8_t ndim = 2;
+    int64_t shape[] = {100, 70};
+    int64_t nelem = shape[0] * shape[1];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = 50;
+        store.blockshape[i] = 20;
+    }
+
+    double *buffer_x = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_y = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_z = ina_mem_alloc(nelem * sizeof(double));
+    fill_buf(dtshape.dtype, buffer_x, nelem);
+    fill_buf(dtshape.dtype, buffer_y, nelem);
+    for (int64_t i = 0; i < nelem; ++i) {
+        buffer_y[i] += 1;
+        buffer_z[i] = buffer_x[i] * 2 - buffer_y[i];
+    }
+
+    iarray_container_t *c_x;
+    iarray_container_t *c_y;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_x, nelem * sizeof(double), &store, &c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_y, nelem * sizeof(double), &store, &c_y));
+
+    if (cache_dir != NULL) {
+        INA_TEST_ASSERT_SUCCEED(iarray_expr_cache_set_dir(cache_dir));
+    }
+
+    int64_t hits, misses, nentries, disk_hits;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_cache_stats(&hits, &misses, &nentries));
+    INA_TEST_ASSERT_EQUAL_INT64(0, hits);
+    INA_TEST_ASSERT_EQUAL_INT64(0, nentries);
+
+    // First compilation populates the cache
+    INA_TEST_ASSERT_SUCCEED(eval_expr(ctx, c_x, c_y, false, "x * 2 - y", buffer_z, nelem));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_cache_stats(&hits, &misses, &nentries));
+    INA_TEST_ASSERT_EQUAL_INT64(0, hits);
+    INA_TEST_ASSERT_EQUAL_INT64(1, misses);
+    INA_TEST_ASSERT_EQUAL_INT64(1, nentries);
+
+    // Whitespace differences still hit the cache
+    INA_TEST_ASSERT_SUCCEED(eval_expr(ctx, c_x, c_y, false, "x*2 -   y", buffer_z, nelem));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_cache_stats(&hits, &misses, &nentries));
+    INA_TEST_ASSERT_EQUAL_INT64(1, hits);
+    INA_TEST_ASSERT_EQUAL_INT64(1, misses);
+    INA_TEST_ASSERT_EQUAL_INT64(1, nentries);
+
+    // A different binding order is a different kernel
+    INA_TEST_ASSERT_SUCCEED(eval_expr(ctx, c_x, c_y, true, "x * 2 - y", buffer_z, nelem));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_cache_stats(&hits, &misses, &nentries));
+    INA_TEST_ASSERT_EQUAL_INT64(1, hits);
+    INA_TEST_ASSERT_EQUAL_INT64(2, misses);
+    INA_TEST_ASSERT_EQUAL_INT64(2, nentries);
+    // The directory starts empty, so everything so far has been compiled
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_cache_disk_hits(&disk_hits));
+    INA_TEST_ASSERT_EQUAL_INT64(0, disk_hits);
+
+    iarray_expr_cache_clear();
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_cache_stats(&hits, &misses, &nentries));
+    INA_TEST_ASSERT_EQUAL_INT64(0, nentries);
+
+    if (cache_dir != NULL) {
+        // The in-memory cache is empty now, so this has to come from the on-disk objects
+        INA_TEST_ASSERT_SUCCEED(eval_expr(ctx, c_x, c_y, false, "x * 2 - y", buffer_z, nelem));
+        INA_TEST_ASSERT_SUCCEED(eval_expr(ctx, c_x, c_y, true, "x*2-y", buffer_z, nelem));
+        INA_TEST_ASSERT_SUCCEED(iarray_expr_cache_stats(&hits, &misses, &nentries));
+        INA_TEST_ASSERT_EQUAL_INT64(2, nentries);
+        INA_TEST_ASSERT_SUCCEED(iarray_expr_cache_disk_hits(&disk_hits));
+        INA_TEST_ASSERT_EQUAL_INT64(2, disk_hits);
+        INA_TEST_ASSERT_SUCCEED(iarray_expr_cache_set_dir(NULL));
+    }
+
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_y);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_y);
+    ina_mem_free(buffer_z);
+
+    return INA_SUCCESS;
+}
+
+static ina_rc_t test_expression_cache_clear_while_used(iarray_context_t *ctx)
+{
+    int8_t ndim = 2;
+    int64_t shape[] = {100, 70};
+    int64_t nelem = shape[0] * shape[1];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = 50;
+        store.blockshape[i] = 20;
+    }
+
+    double *buffer_x = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_z = ina_mem_alloc(nelem * sizeof(double));
+    fill_buf(dtshape.dtype, buffer_x, nelem);
+    for (int64_t i = 0; i < nelem; ++i) {
+        buffer_z[i] = buffer_x[i] * 3 + 1;
+    }
+
+    iarray_container_t *c_x;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_x, nelem * sizeof(double), &store, &c_x));
+
+    // Two expressions share the same cache entry
+    iarray_expression_t *e1;
+    iarray_expression_t *e2;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e1));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e1, "x", c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e1, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e1, "x * 3 + 1"));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e2));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e2, "x", c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e2, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e2, "x * 3 + 1"));
+
+    // Clearing the cache must keep the code of the live expressions
+    iarray_expr_cache_clear();
+    int64_t hits, misses, nentries;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_cache_stats(&hits, &misses, &nentries));
+    INA_TEST_ASSERT_EQUAL_INT64(0, nentries);
+
+    iarray_container_t *c_z;
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e1, &c_z));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_z, nelem * sizeof(double), 0, 0));
+    iarray_container_free(ctx, &c_z);
+    iarray_expr_free(ctx, &e1);
+
+    // The other user still holds the entry
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e2, &c_z));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_z, nelem * sizeof(double), 0, 0));
+    iarray_container_free(ctx, &c_z);
+    iarray_expr_free(ctx, &e2);
+
+    iarray_container_free(ctx, &c_x);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_z);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_eval_cache) {
+    iarray_context_t *ctx;
+    char *cache_dir;
+};
+
+INA_TEST_SETUP(expression_eval_cache)
+{
+    iarray_init();
+    iarray_expr_cache_clear();
+
+    // Scratch directory for the on-disk cache, removed (objects included) on teardown
+    data->cache_dir = "test_expression_eval_cache.d";
+    blosc2_remove_urlpath(data->cache_dir);
+
+    iarray_config_t cfg = IARRAY_CONFIG_DEFAULTS;
+    cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    iarray_context_new(&cfg, &data->ctx);
+}
+
+INA_TEST_TEARDOWN(expression_eval_cache)
+{
+    iarray_context_free(&data->ctx);
+    iarray_expr_cache_set_dir(NULL);
+    blosc2_remove_urlpath(data->cache_dir);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_eval_cache, hits_and_misses)
+{
+    INA_TEST_ASSERT_SUCCEED(test_expression_cache(data->ctx, NULL));
+}
+
+INA_TEST_FIXTURE(expression_eval_cache, on_disk)
+{
+    INA_TEST_ASSERT_SUCCEED(test_expression_cache(data->ctx, data->cache_dir));
+}
+
+INA_TEST_FIXTURE(expression_eval_cache, clear_while_used)
+{
+    INA_TEST_ASSERT_SUCCEED(test_expression_cache_clear_while_used(data->ctx));
+}
@@ -192,6 +192,22 @@ INA_TEST_FIXTURE(expression_eval_double, iterblosc2_superchunk)
 }
 
 
+INA_TEST_FIXTURE(expression_eval_double, iterblosc_pipeline)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    data->cfg.eval_pipeline_depth = 2;
+    data->func = expr_;
+    data->expr_str = "(x - 2.3) * (x - 1.35) * (x + 4.2)";
+
+    int8_t ndim = 3;
+    int64_t shape[] = {10, 23, 12};
+    int64_t cshape[] = {3, 3, 7};
+    int64_t bshape[] = {2, 1, 5};
+
+    INA_TEST_ASSERT_SUCCEED(execute_iarray_eval(&data->cfg, ndim, shape, cshape, bshape, data->func, data->expr_str, true, "arr.iarr"));
+}
+
+
 /* Avoid heavy tests
 INA_TEST_FIXTURE(expression_eval_double, iterblosc2_superchunk)
 {
@@ -427,3 +443,54 @@ INA_TEST_FIXTURE(expression_eval_double, iterblosc_max)
 
     INA_TEST_ASSERT_SUCCEED(execute_iarray_eval(&data->cfg, ndim, shape, cshape, bshape, data->func, data->expr_str, true, NULL));
 }
+
+static double expr_simplify(const double x)
+{
+    return exp(1.5 * x) + (x + 1) * (x + 1) - 2;
+}
+
+INA_TEST_FIXTURE(expression_eval_double, iterblosc_simplify)
+{
+    // Constants are folded and exp(a) * exp(b), pow(a, 2) are rewritten before generating code
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    data->func = expr_simplify;
+    data->expr_str = "exp(x) * exp(x / 2) + pow(x + 1, 2) - sqrt(2 * 2)";
+
+    int8_t ndim = 2;
+    int64_t shape[] = {100, 40};
+    int64_t cshape[] = {50, 20};
+    int64_t bshape[] = {15, 20};
+
+    INA_TEST_ASSERT_SUCCEED(execute_iarray_eval(&data->cfg, ndim, shape, cshape, bshape, data->func, data->expr_str, true, NULL));
+}
+
+INA_TEST_FIXTURE(expression_eval_double, iterblosc_isa_baseline)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    data->cfg.jit_isa = IARRAY_JIT_ISA_BASELINE;
+    data->func = expr4;
+    data->expr_str = "sin(x) * sin(x) + cos(x) * cos(x)";
+
+    int8_t ndim = 2;
+    int64_t shape[] = {100, 40};
+    int64_t cshape[] = {50, 20};
+    int64_t bshape[] = {15, 20};
+
+    INA_TEST_ASSERT_SUCCEED(execute_iarray_eval(&data->cfg, ndim, shape, cshape, bshape, data->func, data->expr_str, true, NULL));
+}
+
+INA_TEST_FIXTURE(expression_eval_double, iterblosc_isa_avx512)
+{
+    // Hosts without AVX-512 lower it to the best ISA they have
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    data->cfg.jit_isa = IARRAY_JIT_ISA_AVX512;
+    data->func = expr4;
+    data->expr_str = "sin(x) * sin(x) + cos(x) * cos(x)";
+
+    int8_t ndim = 2;
+    int64_t shape[] = {100, 40};
+    int64_t cshape[] = {50, 20};
+    int64_t bshape[] = {15, 20};
+
+    INA_TEST_ASSERT_SUCCEED(execute_iarray_eval(&data->cfg, ndim, shape, cshape, bshape, data->func, data->expr_str, true, NULL));
+}
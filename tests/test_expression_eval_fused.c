@@ -0,0 +1,151 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+#include <math.h>
+
+
+static ina_rc_t test_fused(iarray_config_t *cfg, const int64_t *ccshape, const int64_t *cbshape)
+{
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(cfg, &ctx));
+
+    int8_t ndim = 2;
+    int64_t shape[] = {120, 90};
+    int64_t nelem = shape[0] * shape[1];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    iarray_storage_t cstore;
+    cstore.contiguous = false;
+    cstore.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = 50;
+        store.blockshape[i] = 20;
+        cstore.chunkshape[i] = ccshape[i];
+        cstore.blockshape[i] = cbshape[i];
+    }
+
+    double *buffer_a = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_b = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_c = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_u = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_v = ina_mem_alloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        buffer_a[i] = (double) (i % 77) / 7.;
+        buffer_b[i] = (double) (i % 13);
+        buffer_c[i] = (double) i / (double) nelem - 0.5;
+        double t = buffer_a[i] + buffer_b[i];
+        buffer_u[i] = sqrt(t) * buffer_c[i];
+        // The same sub-expression is used twice, and `a` is an operand at two levels
+        buffer_v[i] = buffer_u[i] * buffer_a[i] + t;
+    }
+
+    iarray_container_t *c_a;
+    iarray_container_t *c_b;
+    iarray_container_t *c_c;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_a, nelem * sizeof(double), &store, &c_a));
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_b, nelem * sizeof(double), &store, &c_b));
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_c, nelem * sizeof(double), &cstore, &c_c));
+
+    // t = a + b is compiled, but never evaluated
+    iarray_expression_t *e_t;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e_t));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e_t, "a", c_a));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e_t, "b", c_b));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e_t, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e_t, "a + b"));
+
+    iarray_expression_t *e_u;
+    iarray_container_t *c_u;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e_u));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e_u, "c", c_c));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_expr(e_u, "t", e_t));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e_u, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e_u, "sqrt(t) * c"));
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e_u, &c_u));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_u, buffer_u, nelem * sizeof(double), 1e-13, 1e-13));
+
+    iarray_expression_t *e_v;
+    iarray_container_t *c_v;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e_v));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e_v, "x", c_a));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_expr(e_v, "u", e_u));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_expr(e_v, "t", e_t));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e_v, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e_v, "u * x + t"));
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e_v, &c_v));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_v, buffer_v, nelem * sizeof(double), 1e-13, 1e-13));
+
+    iarray_expr_free(ctx, &e_v);
+    iarray_expr_free(ctx, &e_u);
+    iarray_expr_free(ctx, &e_t);
+    iarray_container_free(ctx, &c_a);
+    iarray_container_free(ctx, &c_b);
+    iarray_container_free(ctx, &c_c);
+    iarray_container_free(ctx, &c_u);
+    iarray_container_free(ctx, &c_v);
+    ina_mem_free(buffer_a);
+    ina_mem_free(buffer_b);
+    ina_mem_free(buffer_c);
+    ina_mem_free(buffer_u);
+    ina_mem_free(buffer_v);
+    iarray_context_free(&ctx);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_eval_fused) {
+    iarray_config_t cfg;
+};
+
+INA_TEST_SETUP(expression_eval_fused)
+{
+    iarray_init();
+
+    data->cfg = IARRAY_CONFIG_DEFAULTS;
+    data->cfg.max_num_threads = 2;
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+}
+
+INA_TEST_TEARDOWN(expression_eval_fused)
+{
+    INA_UNUSED(data);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_eval_fused, iterblosc)
+{
+    int64_t cshape[] = {50, 50};
+    int64_t bshape[] = {20, 20};
+    INA_TEST_ASSERT_SUCCEED(test_fused(&data->cfg, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(expression_eval_fused, iterblosc_repart)
+{
+    int64_t cshape[] = {40, 30};
+    int64_t bshape[] = {20, 10};
+    INA_TEST_ASSERT_SUCCEED(test_fused(&data->cfg, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(expression_eval_fused, iterchunk)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERCHUNK;
+    int64_t cshape[] = {50, 50};
+    int64_t bshape[] = {20, 20};
+    INA_TEST_ASSERT_SUCCEED(test_fused(&data->cfg, cshape, bshape));
+}
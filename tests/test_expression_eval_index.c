@@ -0,0 +1,193 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+#include <math.h>
+
+
+static ina_rc_t test_index(iarray_config_t *cfg, bool zeros_x, bool bind_i1)
+{
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(cfg, &ctx));
+
+    int8_t ndim = 2;
+    int64_t shape[] = {90, 70};
+    int64_t nelem = shape[0] * shape[1];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = 40;
+        store.blockshape[i] = 15;
+    }
+
+    double *buffer_x = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_y = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_z = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_res = ina_mem_alloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < shape[0]; ++i) {
+        for (int64_t j = 0; j < shape[1]; ++j) {
+            int64_t n = i * shape[1] + j;
+            buffer_x[n] = zeros_x ? 0. : (double) n / 7.;
+            buffer_y[n] = (double) (n % 13);
+            double i1 = bind_i1 ? buffer_y[n] : (double) j;
+            buffer_z[n] = buffer_x[n] + (double) i * 100 + i1 + exp(-((double) (i - 40) * (i - 40)) / 200);
+        }
+    }
+
+    // x is made of zero chunks when zeros_x, which must not be taken for a constant result
+    iarray_container_t *c_x;
+    iarray_container_t *c_y;
+    if (zeros_x) {
+        INA_TEST_ASSERT_SUCCEED(iarray_zeros(ctx, &dtshape, &store, &c_x));
+    } else {
+        INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_x, nelem * sizeof(double), &store, &c_x));
+    }
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_y, nelem * sizeof(double), &store, &c_y));
+
+    iarray_expression_t *e;
+    iarray_container_t *c_z;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+    if (bind_i1) {
+        // An operand hides the index variable with the same name
+        INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "i1", c_y));
+    }
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, "x + i0 * 100 + i1 + exp(-((i0 - 40) * (i0 - 40)) / 200)"));
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e, &c_z));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_z, nelem * sizeof(double), 1e-14, 1e-14));
+
+    INA_TEST_ASSERT_SUCCEED(iarray_eval_to_buffer(e, buffer_res, nelem * sizeof(double)));
+    for (int64_t i = 0; i < nelem; ++i) {
+        INA_TEST_ASSERT_EQUAL_FLOATING(buffer_z[i], buffer_res[i]);
+    }
+
+    iarray_expr_free(ctx, &e);
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_y);
+    iarray_container_free(ctx, &c_z);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_y);
+    ina_mem_free(buffer_z);
+    ina_mem_free(buffer_res);
+    iarray_context_free(&ctx);
+
+    return INA_SUCCESS;
+}
+
+static ina_rc_t test_diagonal_mask(iarray_config_t *cfg)
+{
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(cfg, &ctx));
+
+    int8_t ndim = 2;
+    int64_t shape[] = {90, 70};
+    int64_t nelem = shape[0] * shape[1];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = 40;
+        store.blockshape[i] = 15;
+    }
+
+    double *buffer_x = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_z = ina_mem_alloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < shape[0]; ++i) {
+        for (int64_t j = 0; j < shape[1]; ++j) {
+            int64_t n = i * shape[1] + j;
+            buffer_x[n] = (double) n / 7. + 1;
+            // Only the elements below the diagonal are kept
+            buffer_z[n] = i > j ? buffer_x[n] : 0.;
+        }
+    }
+
+    iarray_container_t *c_x;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_x, nelem * sizeof(double), &store, &c_x));
+
+    iarray_expression_t *e;
+    iarray_container_t *c_z;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, "x * (i0 > i1)"));
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e, &c_z));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_z, nelem * sizeof(double), 0, 0));
+
+    iarray_expr_free(ctx, &e);
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_z);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_z);
+    iarray_context_free(&ctx);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_eval_index) {
+    iarray_config_t cfg;
+};
+
+INA_TEST_SETUP(expression_eval_index)
+{
+    iarray_init();
+
+    data->cfg = IARRAY_CONFIG_DEFAULTS;
+    data->cfg.max_num_threads = 2;
+}
+
+INA_TEST_TEARDOWN(expression_eval_index)
+{
+    INA_UNUSED(data);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_eval_index, iterblosc)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    INA_TEST_ASSERT_SUCCEED(test_index(&data->cfg, false, false));
+}
+
+INA_TEST_FIXTURE(expression_eval_index, iterchunk)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERCHUNK;
+    INA_TEST_ASSERT_SUCCEED(test_index(&data->cfg, false, false));
+}
+
+INA_TEST_FIXTURE(expression_eval_index, zeros)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    INA_TEST_ASSERT_SUCCEED(test_index(&data->cfg, true, false));
+}
+
+INA_TEST_FIXTURE(expression_eval_index, bound_name)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    INA_TEST_ASSERT_SUCCEED(test_index(&data->cfg, false, true));
+}
+
+INA_TEST_FIXTURE(expression_eval_index, diagonal_mask)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    INA_TEST_ASSERT_SUCCEED(test_diagonal_mask(&data->cfg));
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+
+
+static ina_rc_t test_eval_into(iarray_config_t *cfg, int64_t chunkshape, int64_t blockshape)
+{
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(cfg, &ctx));
+
+    int8_t ndim = 2;
+    int64_t shape[] = {90, 70};
+    int64_t nelem = shape[0] * shape[1];
+    int nsteps = 4;
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = chunkshape;
+        store.blockshape[i] = blockshape;
+    }
+
+    double *buffer_x = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_y = ina_mem_alloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        buffer_x[i] = (double) i / 7.;
+        buffer_y[i] = (double) (i % 31) - 15.;
+    }
+    iarray_container_t *c_x;
+    iarray_container_t *c_y;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_x, nelem * sizeof(double), &store, &c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_y, nelem * sizeof(double), &store, &c_y));
+
+    // The state `x` is both an operand and the output of every step
+    iarray_expression_t *e;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "y", c_y));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, "x * 0.5 + y"));
+    for (int step = 0; step < nsteps; ++step) {
+        INA_TEST_ASSERT_SUCCEED(iarray_eval_into(e, c_x));
+        for (int64_t i = 0; i < nelem; ++i) {
+            buffer_x[i] = buffer_x[i] * 0.5 + buffer_y[i];
+        }
+        INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_x, buffer_x, nelem * sizeof(double), 0, 0));
+    }
+
+    // A container with another partition can be the output too
+    iarray_storage_t other_store = store;
+    for (int i = 0; i < ndim; ++i) {
+        other_store.chunkshape[i] = chunkshape / 2;
+        other_store.blockshape[i] = blockshape / 2;
+    }
+    iarray_container_t *c_z;
+    INA_TEST_ASSERT_SUCCEED(iarray_zeros(ctx, &dtshape, &other_store, &c_z));
+    INA_TEST_ASSERT_SUCCEED(iarray_eval_into(e, c_z));
+    for (int64_t i = 0; i < nelem; ++i) {
+        buffer_x[i] = buffer_x[i] * 0.5 + buffer_y[i];
+    }
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_x, nelem * sizeof(double), 0, 0));
+
+    // Containers of another shape are rejected
+    iarray_dtshape_t small_dtshape = dtshape;
+    small_dtshape.shape[0] = 10;
+    iarray_container_t *c_small;
+    INA_TEST_ASSERT_SUCCEED(iarray_zeros(ctx, &small_dtshape, &store, &c_small));
+    INA_TEST_ASSERT(INA_FAILED(iarray_eval_into(e, c_small)));
+    iarray_expr_free(ctx, &e);
+
+    // The output cannot be read at an offset while it is rewritten
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, "x[1,0] - x"));
+    INA_TEST_ASSERT(INA_FAILED(iarray_eval_into(e, c_x)));
+
+    iarray_expr_free(ctx, &e);
+    iarray_container_free(ctx, &c_small);
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_y);
+    iarray_container_free(ctx, &c_z);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_y);
+    iarray_context_free(&ctx);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_eval_into) {
+    iarray_config_t cfg;
+};
+
+INA_TEST_SETUP(expression_eval_into)
+{
+    iarray_init();
+
+    data->cfg = IARRAY_CONFIG_DEFAULTS;
+    data->cfg.max_num_threads = 2;
+}
+
+INA_TEST_TEARDOWN(expression_eval_into)
+{
+    INA_UNUSED(data);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_eval_into, iterblosc)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    INA_TEST_ASSERT_SUCCEED(test_eval_into(&data->cfg, 40, 20));
+}
+
+INA_TEST_FIXTURE(expression_eval_into, iterchunk)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERCHUNK;
+    INA_TEST_ASSERT_SUCCEED(test_eval_into(&data->cfg, 40, 20));
+}
+
+INA_TEST_FIXTURE(expression_eval_into, pipeline)
+{
+    // The reads are not pipelined when the output is an operand too
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    data->cfg.eval_pipeline_depth = 2;
+    INA_TEST_ASSERT_SUCCEED(test_eval_into(&data->cfg, 30, 10));
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+
+
+static ina_rc_t test_mixed(iarray_context_t *ctx, const int64_t *ycshape, const int64_t *ybshape)
+{
+    int8_t ndim = 2;
+    int64_t shape[] = {120, 75};
+    int64_t cshape[] = {50, 40};
+    int64_t bshape[] = {20, 15};
+    int64_t nelem = shape[0] * shape[1];
+
+    iarray_dtshape_t dtshape;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    iarray_storage_t ystore;
+    ystore.contiguous = false;
+    ystore.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = cshape[i];
+        store.blockshape[i] = bshape[i];
+        ystore.chunkshape[i] = ycshape[i];
+        ystore.blockshape[i] = ybshape[i];
+    }
+
+    float *buffer_x = ina_mem_alloc(nelem * sizeof(float));
+    int16_t *buffer_y = ina_mem_alloc(nelem * sizeof(int16_t));
+    double *buffer_z = ina_mem_alloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        buffer_x[i] = (float) i / 7.f;
+        buffer_y[i] = (int16_t) (i % 1000 - 500);
+        // float32 and int16 promote to float32
+        buffer_z[i] = (double) (buffer_x[i] * (float) buffer_y[i] + 1.f);
+    }
+
+    iarray_container_t *c_x;
+    iarray_container_t *c_y;
+    dtshape.dtype = IARRAY_DATA_TYPE_FLOAT;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_x, nelem * sizeof(float), &store, &c_x));
+    dtshape.dtype = IARRAY_DATA_TYPE_INT16;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_y, nelem * sizeof(int16_t), &ystore, &c_y));
+
+    iarray_expression_t *e;
+    iarray_container_t *c_z;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, IARRAY_DATA_TYPE_DOUBLE, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "y", c_y));
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, "x * y + 1"));
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e, &c_z));
+
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_z, nelem * sizeof(double), 1e-6, 1e-6));
+
+    iarray_expr_free(ctx, &e);
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_y);
+    iarray_container_free(ctx, &c_z);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_y);
+    ina_mem_free(buffer_z);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_eval_mixed) {
+    iarray_context_t *ctx;
+};
+
+INA_TEST_SETUP(expression_eval_mixed)
+{
+    iarray_init();
+
+    iarray_config_t cfg = IARRAY_CONFIG_DEFAULTS;
+    cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    iarray_context_new(&cfg, &data->ctx);
+}
+
+INA_TEST_TEARDOWN(expression_eval_mixed)
+{
+    iarray_context_free(&data->ctx);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_eval_mixed, float_int16)
+{
+    int64_t cshape[] = {50, 40};
+    int64_t bshape[] = {20, 15};
+    INA_TEST_ASSERT_SUCCEED(test_mixed(data->ctx, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(expression_eval_mixed, float_int16_repart)
+{
+    // A different partition for y goes through the non-compatible path
+    int64_t cshape[] = {30, 30};
+    int64_t bshape[] = {10, 10};
+    INA_TEST_ASSERT_SUCCEED(test_mixed(data->ctx, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(expression_eval_mixed, float_int16_repart_iterchunk)
+{
+    INA_UNUSED(data);
+    // x keeps the partition of the output and y is gathered by the chunk readers in parallel
+    iarray_config_t cfg = IARRAY_CONFIG_DEFAULTS;
+    cfg.eval_method = IARRAY_EVAL_METHOD_ITERCHUNK;
+    cfg.max_num_threads = 4;
+    cfg.eval_pipeline_depth = 4;
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(&cfg, &ctx));
+    int64_t cshape[] = {30, 30};
+    int64_t bshape[] = {10, 10};
+    INA_TEST_ASSERT_SUCCEED(test_mixed(ctx, cshape, bshape));
+    iarray_context_free(&ctx);
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+#include <math.h>
+
+
+static ina_rc_t test_multi(iarray_config_t *cfg, const int64_t *tcshape, const int64_t *tbshape)
+{
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(cfg, &ctx));
+
+    int8_t ndim = 2;
+    int64_t shape[] = {130, 85};
+    int64_t nelem = shape[0] * shape[1];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    iarray_storage_t tstore;
+    tstore.contiguous = false;
+    tstore.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = 50;
+        store.blockshape[i] = 20;
+        tstore.chunkshape[i] = tcshape[i];
+        tstore.blockshape[i] = tbshape[i];
+    }
+
+    double *buffer_u = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_t = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_x = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_y = ina_mem_alloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        buffer_u[i] = (double) (i % 101) / 10.;
+        buffer_t[i] = (double) i / (double) nelem * 6.;
+        buffer_x[i] = buffer_u[i] * cos(buffer_t[i]);
+        buffer_y[i] = buffer_u[i] * sin(buffer_t[i]);
+    }
+
+    iarray_container_t *c_u;
+    iarray_container_t *c_t;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_u, nelem * sizeof(double), &store, &c_u));
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_t, nelem * sizeof(double), &tstore, &c_t));
+
+    iarray_expression_t *e;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "u", c_u));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "t", c_t));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, &store));
+    const char *exprs[] = {"u * cos(t)", "u * sin(t)"};
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile_multi(e, 2, exprs));
+
+    // A single-output evaluation is not allowed for a multi-output expression
+    iarray_container_t *c_z;
+    INA_TEST_ASSERT(INA_FAILED(iarray_eval(e, &c_z)));
+
+    iarray_container_t *c_outs[2];
+    INA_TEST_ASSERT_SUCCEED(iarray_eval_multi(e, NULL, c_outs));
+
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_outs[0], buffer_x, nelem * sizeof(double), 1e-12, 1e-12));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_outs[1], buffer_y, nelem * sizeof(double), 1e-12, 1e-12));
+
+    iarray_expr_free(ctx, &e);
+    iarray_container_free(ctx, &c_u);
+    iarray_container_free(ctx, &c_t);
+    iarray_container_free(ctx, &c_outs[0]);
+    iarray_container_free(ctx, &c_outs[1]);
+    ina_mem_free(buffer_u);
+    ina_mem_free(buffer_t);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_y);
+    iarray_context_free(&ctx);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_eval_multi) {
+    iarray_config_t cfg;
+};
+
+INA_TEST_SETUP(expression_eval_multi)
+{
+    iarray_init();
+
+    data->cfg = IARRAY_CONFIG_DEFAULTS;
+    data->cfg.max_num_threads = 2;
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+}
+
+INA_TEST_TEARDOWN(expression_eval_multi)
+{
+    INA_UNUSED(data);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_eval_multi, iterblosc)
+{
+    int64_t cshape[] = {50, 50};
+    int64_t bshape[] = {20, 20};
+    INA_TEST_ASSERT_SUCCEED(test_multi(&data->cfg, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(expression_eval_multi, iterblosc_repart)
+{
+    int64_t cshape[] = {40, 30};
+    int64_t bshape[] = {10, 15};
+    INA_TEST_ASSERT_SUCCEED(test_multi(&data->cfg, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(expression_eval_multi, iterchunk)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERCHUNK;
+    int64_t cshape[] = {50, 50};
+    int64_t bshape[] = {20, 20};
+    INA_TEST_ASSERT_SUCCEED(test_multi(&data->cfg, cshape, bshape));
+}
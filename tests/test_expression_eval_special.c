@@ -0,0 +1,116 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+
+
+static ina_rc_t test_special(iarray_config_t *cfg, const char *expr_str, double fill_value, bool regular_x)
+{
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(cfg, &ctx));
+
+    int8_t ndim = 2;
+    int64_t shape[] = {90, 70};
+    int64_t nelem = shape[0] * shape[1];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = 40;
+        store.blockshape[i] = 15;
+    }
+
+    double *buffer_x = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_z = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_res = ina_mem_alloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        buffer_x[i] = regular_x ? (double) i / 3. : 0.;
+        buffer_z[i] = buffer_x[i] * 2 + fill_value;
+    }
+
+    // x is made of zero chunks (unless regular_x) and y of chunks with a repeated value
+    iarray_container_t *c_x;
+    iarray_container_t *c_y;
+    if (regular_x) {
+        INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_x, nelem * sizeof(double), &store, &c_x));
+    } else {
+        INA_TEST_ASSERT_SUCCEED(iarray_zeros(ctx, &dtshape, &store, &c_x));
+    }
+    INA_TEST_ASSERT_SUCCEED(iarray_fill(ctx, &dtshape, &fill_value, &store, &c_y));
+
+    iarray_expression_t *e;
+    iarray_container_t *c_z;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "y", c_y));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, expr_str));
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e, &c_z));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_z, nelem * sizeof(double), 0, 0));
+
+    INA_TEST_ASSERT_SUCCEED(iarray_eval_to_buffer(e, buffer_res, nelem * sizeof(double)));
+    for (int64_t i = 0; i < nelem; ++i) {
+        INA_TEST_ASSERT_EQUAL_FLOATING(buffer_z[i], buffer_res[i]);
+    }
+
+    iarray_expr_free(ctx, &e);
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_y);
+    iarray_container_free(ctx, &c_z);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_z);
+    ina_mem_free(buffer_res);
+    iarray_context_free(&ctx);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_eval_special) {
+    iarray_config_t cfg;
+};
+
+INA_TEST_SETUP(expression_eval_special)
+{
+    iarray_init();
+
+    data->cfg = IARRAY_CONFIG_DEFAULTS;
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    data->cfg.max_num_threads = 2;
+}
+
+INA_TEST_TEARDOWN(expression_eval_special)
+{
+    INA_UNUSED(data);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_eval_special, repeated_value)
+{
+    INA_TEST_ASSERT_SUCCEED(test_special(&data->cfg, "x * 2 + y", 3.5, false));
+}
+
+INA_TEST_FIXTURE(expression_eval_special, zeros)
+{
+    // The result is zero everywhere
+    INA_TEST_ASSERT_SUCCEED(test_special(&data->cfg, "x * 2 + y", 0., false));
+}
+
+INA_TEST_FIXTURE(expression_eval_special, mixed)
+{
+    // x has regular chunks, so the chunks are evaluated as usual
+    INA_TEST_ASSERT_SUCCEED(test_special(&data->cfg, "x * 2 + y", 3.5, true));
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+
+
+// a[i + di, j + dj, k + dk], with the edges of `a` replicated
+static double stencil_at(const double *a, const int64_t *shape, int64_t i, int64_t j, int64_t k,
+                         int64_t di, int64_t dj, int64_t dk)
+{
+    i = INA_MIN(INA_MAX(i + di, 0), shape[0] - 1);
+    j = INA_MIN(INA_MAX(j + dj, 0), shape[1] - 1);
+    k = INA_MIN(INA_MAX(k + dk, 0), shape[2] - 1);
+    return a[(i * shape[1] + j) * shape[2] + k];
+}
+
+static ina_rc_t test_stencil(iarray_config_t *cfg, const int64_t *cshape, const int64_t *bshape,
+                             const int64_t *acshape, const int64_t *abshape)
+{
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(cfg, &ctx));
+
+    int8_t ndim = 3;
+    int64_t shape[] = {23, 31, 17};
+    int64_t nelem = shape[0] * shape[1] * shape[2];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    iarray_storage_t astore;
+    astore.contiguous = false;
+    astore.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = cshape[i];
+        store.blockshape[i] = bshape[i];
+        astore.chunkshape[i] = acshape[i];
+        astore.blockshape[i] = abshape[i];
+    }
+
+    double *buffer_a = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_b = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_z = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_res = ina_mem_alloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        buffer_a[i] = (double) ((i * 7) % 53) / 4.;
+        buffer_b[i] = (double) (i % 5);
+    }
+    for (int64_t i = 0; i < shape[0]; ++i) {
+        for (int64_t j = 0; j < shape[1]; ++j) {
+            for (int64_t k = 0; k < shape[2]; ++k) {
+                double a = buffer_a[(i * shape[1] + j) * shape[2] + k];
+                double b = buffer_b[(i * shape[1] + j) * shape[2] + k];
+                buffer_z[(i * shape[1] + j) * shape[2] + k] =
+                    (stencil_at(buffer_a, shape, i, j, k, -1, 0, 0) + stencil_at(buffer_a, shape, i, j, k, 1, 0, 0) +
+                     stencil_at(buffer_a, shape, i, j, k, 0, -1, 0) + stencil_at(buffer_a, shape, i, j, k, 0, 1, 0) +
+                     stencil_at(buffer_a, shape, i, j, k, 0, 0, -3) - 5 * a) / 4 + b;
+            }
+        }
+    }
+
+    iarray_container_t *c_a;
+    iarray_container_t *c_b;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_a, nelem * sizeof(double), &astore, &c_a));
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_b, nelem * sizeof(double), &store, &c_b));
+
+    iarray_expression_t *e;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "a", c_a));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "b", c_b));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, &store));
+    // A missing offset is an error
+    INA_TEST_ASSERT(INA_FAILED(iarray_expr_compile(e, "a[1,0] + b")));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, "(a[-1,0,0] + a[1,0,0] + a[0,-1,0] + a[0, 1, 0] + "
+                                                   "a[0,0,-3] - 5 * a[0,0,0]) / 4 + b"));
+
+    iarray_container_t *c_z;
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e, &c_z));
+    INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_z, nelem * sizeof(double), 1e-14, 1e-14));
+
+    INA_TEST_ASSERT_SUCCEED(iarray_eval_to_buffer(e, buffer_res, nelem * sizeof(double)));
+    for (int64_t i = 0; i < nelem; ++i) {
+        INA_TEST_ASSERT_EQUAL_FLOATING(buffer_z[i], buffer_res[i]);
+    }
+
+    iarray_expr_free(ctx, &e);
+    iarray_container_free(ctx, &c_a);
+    iarray_container_free(ctx, &c_b);
+    iarray_container_free(ctx, &c_z);
+    ina_mem_free(buffer_a);
+    ina_mem_free(buffer_b);
+    ina_mem_free(buffer_z);
+    ina_mem_free(buffer_res);
+    iarray_context_free(&ctx);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_eval_stencil) {
+    iarray_config_t cfg;
+};
+
+INA_TEST_SETUP(expression_eval_stencil)
+{
+    iarray_init();
+
+    data->cfg = IARRAY_CONFIG_DEFAULTS;
+    data->cfg.max_num_threads = 2;
+}
+
+INA_TEST_TEARDOWN(expression_eval_stencil)
+{
+    INA_UNUSED(data);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_eval_stencil, iterblosc)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    int64_t cshape[] = {12, 16, 9};
+    int64_t bshape[] = {6, 5, 4};
+    INA_TEST_ASSERT_SUCCEED(test_stencil(&data->cfg, cshape, bshape, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(expression_eval_stencil, iterchunk)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERCHUNK;
+    int64_t cshape[] = {12, 16, 9};
+    int64_t bshape[] = {6, 5, 4};
+    INA_TEST_ASSERT_SUCCEED(test_stencil(&data->cfg, cshape, bshape, cshape, bshape));
+}
+
+INA_TEST_FIXTURE(expression_eval_stencil, iterblosc_repart)
+{
+    // The halos cross the blocks and chunks of a differently partitioned operand
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    int64_t cshape[] = {12, 16, 9};
+    int64_t bshape[] = {6, 5, 4};
+    int64_t acshape[] = {5, 7, 10};
+    int64_t abshape[] = {2, 3, 4};
+    INA_TEST_ASSERT_SUCCEED(test_stencil(&data->cfg, cshape, bshape, acshape, abshape));
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+
+
+typedef enum test_func {
+    EXPR_DIV_UINT16 = 0,
+    EXPR_WRAP_UINT16 = 1,
+    EXPR_FMOD_UINT32 = 2,
+    EXPR_BOOL_UINT8 = 3,
+    EXPR_CMP_UINT64 = 4,
+    EXPR_SHR_UINT64 = 5,
+} test_func;
+
+static ina_rc_t execute_iarray_eval(iarray_config_t *cfg, enum test_func func, const char *expr_str)
+{
+    int8_t ndim = 2;
+    int64_t shape[] = {120, 70};
+    int64_t cshape[] = {50, 40};
+    int64_t bshape[] = {20, 15};
+    int64_t nelem = shape[0] * shape[1];
+
+    iarray_data_type_t in_dtype;
+    iarray_data_type_t out_dtype;
+    switch (func) {
+        case EXPR_DIV_UINT16:
+        case EXPR_WRAP_UINT16:
+            in_dtype = IARRAY_DATA_TYPE_UINT16;
+            out_dtype = IARRAY_DATA_TYPE_UINT16;
+            break;
+        case EXPR_FMOD_UINT32:
+            in_dtype = IARRAY_DATA_TYPE_UINT32;
+            out_dtype = IARRAY_DATA_TYPE_UINT32;
+            break;
+        case EXPR_BOOL_UINT8:
+            in_dtype = IARRAY_DATA_TYPE_UINT8;
+            out_dtype = IARRAY_DATA_TYPE_BOOL;
+            break;
+        case EXPR_CMP_UINT64:
+            in_dtype = IARRAY_DATA_TYPE_UINT64;
+            out_dtype = IARRAY_DATA_TYPE_BOOL;
+            break;
+        case EXPR_SHR_UINT64:
+            in_dtype = IARRAY_DATA_TYPE_UINT64;
+            out_dtype = IARRAY_DATA_TYPE_UINT64;
+            break;
+        default:
+            return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+    }
+
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(cfg, &ctx));
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = in_dtype;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = cshape[i];
+        store.blockshape[i] = bshape[i];
+    }
+    iarray_dtshape_t out_dtshape = dtshape;
+    out_dtshape.dtype = out_dtype;
+
+    // Values past the signed range, so that signed arithmetic would give other results
+    void *buffer_x = ina_mem_alloc(nelem * sizeof(uint64_t));
+    void *buffer_y = ina_mem_alloc(nelem * sizeof(uint64_t));
+    size_t in_size = 0;
+    size_t out_size = 0;
+    for (int64_t i = 0; i < nelem; ++i) {
+        switch (func) {
+            case EXPR_DIV_UINT16: {
+                uint16_t x = (uint16_t) (i * 977);
+                ((uint16_t *) buffer_x)[i] = x;
+                ((uint16_t *) buffer_y)[i] = (uint16_t) (x / 3 + 1);
+                in_size = out_size = sizeof(uint16_t);
+                break;
+            }
+            case EXPR_WRAP_UINT16: {
+                uint16_t x = (uint16_t) (i % 5);
+                ((uint16_t *) buffer_x)[i] = x;
+                ((uint16_t *) buffer_y)[i] = (uint16_t) (x - 1);
+                in_size = out_size = sizeof(uint16_t);
+                break;
+            }
+            case EXPR_FMOD_UINT32: {
+                uint32_t x = (uint32_t) (4000000000u - i * 131);
+                ((uint32_t *) buffer_x)[i] = x;
+                ((uint32_t *) buffer_y)[i] = (x % 7) * 2;
+                in_size = out_size = sizeof(uint32_t);
+                break;
+            }
+            case EXPR_BOOL_UINT8: {
+                uint8_t x = (uint8_t) (i % 13 + 5);
+                ((uint8_t *) buffer_x)[i] = x;
+                // Every non-zero result is stored as a 1
+                ((bool *) buffer_y)[i] = (uint8_t) (x - 10) != 0;
+                in_size = sizeof(uint8_t);
+                out_size = sizeof(bool);
+                break;
+            }
+            case EXPR_CMP_UINT64: {
+                // Half of the values are above INT64_MAX (negative if compared as signed)
+                uint64_t x = 9223372036854775808u - nelem / 2 + i;
+                ((uint64_t *) buffer_x)[i] = x;
+                ((bool *) buffer_y)[i] = x >= 9223372036854775808u && x % 2 != 0;
+                in_size = sizeof(uint64_t);
+                out_size = sizeof(bool);
+                break;
+            }
+            case EXPR_SHR_UINT64: {
+                // All the values are above INT64_MAX, so an arithmetic shift would drag the sign bit
+                uint64_t x = 18446744073709551615u - i * 1000000000000000u;
+                ((uint64_t *) buffer_x)[i] = x;
+                ((uint64_t *) buffer_y)[i] = (x >> 61) + (x << 1 >> 62);
+                in_size = out_size = sizeof(uint64_t);
+                break;
+            }
+        }
+    }
+
+    iarray_container_t *c_x;
+    INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_x, nelem * in_size, &store, &c_x));
+
+    iarray_expression_t *e;
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, out_dtype, &e));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &out_dtshape, &store));
+    INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, expr_str));
+    iarray_container_t *c_out;
+    INA_TEST_ASSERT_SUCCEED(iarray_eval(e, &c_out));
+
+    void *buffer_out = ina_mem_alloc(nelem * out_size);
+    INA_TEST_ASSERT_SUCCEED(iarray_to_buffer(ctx, c_out, buffer_out, nelem * out_size));
+    INA_TEST_ASSERT(memcmp(buffer_out, buffer_y, nelem * out_size) == 0);
+
+    iarray_expr_free(ctx, &e);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_y);
+    ina_mem_free(buffer_out);
+    iarray_container_free(ctx, &c_out);
+    iarray_container_free(ctx, &c_x);
+    iarray_context_free(&ctx);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_eval_uint) {
+    iarray_config_t cfg;
+};
+
+INA_TEST_SETUP(expression_eval_uint)
+{
+    iarray_init();
+
+    data->cfg = IARRAY_CONFIG_DEFAULTS;
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    data->cfg.max_num_threads = 2;
+}
+
+INA_TEST_TEARDOWN(expression_eval_uint)
+{
+    INA_UNUSED(data);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_eval_uint, uint16_div)
+{
+    INA_TEST_ASSERT_SUCCEED(execute_iarray_eval(&data->cfg, EXPR_DIV_UINT16, "x / 3 + 1"));
+}
+
+INA_TEST_FIXTURE(expression_eval_uint, uint16_wrap)
+{
+    INA_TEST_ASSERT_SUCCEED(execute_iarray_eval(&data->cfg, EXPR_WRAP_UINT16, "x - 1"));
+}
+
+INA_TEST_FIXTURE(expression_eval_uint, uint32_fmod)
+{
+    INA_TEST_ASSERT_SUCCEED(execute_iarray_eval(&data->cfg, EXPR_FMOD_UINT32, "x % 7 * 2"));
+}
+
+INA_TEST_FIXTURE(expression_eval_uint, uint8_to_bool)
+{
+    INA_TEST_ASSERT_SUCCEED(execute_iarray_eval(&data->cfg, EXPR_BOOL_UINT8, "x - 10"));
+}
+
+INA_TEST_FIXTURE(expression_eval_uint, uint64_cmp)
+{
+    INA_TEST_ASSERT_SUCCEED(execute_iarray_eval(&data->cfg, EXPR_CMP_UINT64,
+                                                "(x >= 9223372036854775808) * (x % 2 != 0)"));
+}
+
+INA_TEST_FIXTURE(expression_eval_uint, uint64_shr)
+{
+    INA_TEST_ASSERT_SUCCEED(execute_iarray_eval(&data->cfg, EXPR_SHR_UINT64, "(x >> 61) + (x << 1 >> 62)"));
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <tests/iarray_test.h>
+
+
+static ina_rc_t test_rebind(iarray_config_t *cfg, const char *expr_str)
+{
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(cfg, &ctx));
+
+    int8_t ndim = 2;
+    int64_t shape[] = {90, 70};
+    int64_t nelem = shape[0] * shape[1];
+    int nsteps = 3;
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = IARRAY_DATA_TYPE_DOUBLE;
+    dtshape.ndim = ndim;
+    iarray_storage_t store;
+    store.contiguous = false;
+    store.urlpath = NULL;
+    // A partition for the operands and the output of the last step
+    iarray_storage_t other_store;
+    other_store.contiguous = false;
+    other_store.urlpath = NULL;
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        store.chunkshape[i] = 40;
+        store.blockshape[i] = 15;
+        other_store.chunkshape[i] = 30;
+        other_store.blockshape[i] = 10;
+    }
+
+    double *buffer_x = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_y = ina_mem_alloc(nelem * sizeof(double));
+    double *buffer_z = ina_mem_alloc(nelem * sizeof(double));
+
+    iarray_expression_t *e = NULL;
+    uint64_t expr_func = 0;
+    int nvars = 0;
+    for (int step = 0; step < nsteps; ++step) {
+        for (int64_t i = 0; i < nelem; ++i) {
+            buffer_x[i] = (double) (i + step) / 11.;
+            buffer_y[i] = (double) ((i * (step + 1)) % 29) - 14.;
+            buffer_z[i] = buffer_x[i] * buffer_y[i] - 2;
+        }
+        iarray_storage_t *step_store = step == nsteps - 1 ? &other_store : &store;
+        iarray_container_t *c_x;
+        iarray_container_t *c_y;
+        INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_x, nelem * sizeof(double), &store, &c_x));
+        INA_TEST_ASSERT_SUCCEED(iarray_from_buffer(ctx, &dtshape, buffer_y, nelem * sizeof(double), step_store, &c_y));
+
+        if (e == NULL) {
+            INA_TEST_ASSERT_SUCCEED(iarray_expr_new(ctx, dtshape.dtype, &e));
+            INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+            INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "y", c_y));
+            INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, step_store));
+            INA_TEST_ASSERT_SUCCEED(iarray_expr_compile(e, expr_str));
+            expr_func = e->jug_expr_func;
+            nvars = e->nvars;
+        } else {
+            INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "x", c_x));
+            INA_TEST_ASSERT_SUCCEED(iarray_expr_bind(e, "y", c_y));
+            INA_TEST_ASSERT_SUCCEED(iarray_expr_bind_out_properties(e, &dtshape, step_store));
+        }
+        // The operands are replaced, not added
+        INA_TEST_ASSERT_EQUAL_INT(e->nvars, nvars);
+
+        iarray_container_t *c_z;
+        INA_TEST_ASSERT_SUCCEED(iarray_eval(e, &c_z));
+        INA_TEST_ASSERT_SUCCEED(test_double_buffer_cmp(ctx, c_z, buffer_z, nelem * sizeof(double), 0, 0));
+        // The kernel is not compiled again
+        INA_TEST_ASSERT(e->jug_expr_func == expr_func);
+
+        iarray_container_free(ctx, &c_x);
+        iarray_container_free(ctx, &c_y);
+        iarray_container_free(ctx, &c_z);
+    }
+
+    // Operands (or outputs) of another shape need a new compilation
+    iarray_dtshape_t small_dtshape = dtshape;
+    small_dtshape.shape[0] = 10;
+    iarray_container_t *c_small;
+    INA_TEST_ASSERT_SUCCEED(iarray_zeros(ctx, &small_dtshape, &store, &c_small));
+    INA_TEST_ASSERT(INA_FAILED(iarray_expr_bind(e, "x", c_small)));
+    INA_TEST_ASSERT(INA_FAILED(iarray_expr_bind_out_properties(e, &small_dtshape, &store)));
+
+    iarray_container_free(ctx, &c_small);
+    iarray_expr_free(ctx, &e);
+    ina_mem_free(buffer_x);
+    ina_mem_free(buffer_y);
+    ina_mem_free(buffer_z);
+    iarray_context_free(&ctx);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(expression_rebind) {
+    iarray_config_t cfg;
+};
+
+INA_TEST_SETUP(expression_rebind)
+{
+    iarray_init();
+
+    data->cfg = IARRAY_CONFIG_DEFAULTS;
+    data->cfg.max_num_threads = 2;
+}
+
+INA_TEST_TEARDOWN(expression_rebind)
+{
+    INA_UNUSED(data);
+    iarray_destroy();
+}
+
+INA_TEST_FIXTURE(expression_rebind, iterblosc)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    INA_TEST_ASSERT_SUCCEED(test_rebind(&data->cfg, "x * y - 2"));
+}
+
+INA_TEST_FIXTURE(expression_rebind, iterchunk)
+{
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERCHUNK;
+    INA_TEST_ASSERT_SUCCEED(test_rebind(&data->cfg, "x * y - 2"));
+}
+
+INA_TEST_FIXTURE(expression_rebind, stencil)
+{
+    // The stencil inputs follow the operand they read from
+    data->cfg.eval_method = IARRAY_EVAL_METHOD_ITERBLOSC;
+    INA_TEST_ASSERT_SUCCEED(test_rebind(&data->cfg, "x[0,0] * (y[1,0] + y - y[1,0]) - 2"));
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <src/iarray_private.h>
+#include <math.h>
+
+
+static ina_rc_t test_reduce_kernels(iarray_context_t *ctx, iarray_data_type_t dtype, iarray_reduce_func_t func,
+                                    int8_t naxis, const int8_t *axis) {
+    int8_t ndim = 3;
+    int64_t shape[] = {23, 18, 37};
+    int64_t cshape[] = {10, 8, 20};
+    int64_t bshape[] = {4, 5, 8};
+    int64_t nelem = shape[0] * shape[1] * shape[2];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = dtype;
+    dtshape.ndim = ndim;
+    iarray_storage_t storage = {0};
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        storage.chunkshape[i] = cshape[i];
+        storage.blockshape[i] = bshape[i];
+    }
+
+    // Every item is different, so that folding a row into the wrong output item is noticed
+    bool with_nans = dtype == IARRAY_DATA_TYPE_DOUBLE || dtype == IARRAY_DATA_TYPE_FLOAT;
+    double *values = malloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        values[i] = (double) (i * 37 % 101) - 50;
+        if (with_nans && i % 157 == 5) {
+            values[i] = NAN;
+        }
+    }
+    size_t itemsize;
+    void *buffer;
+    switch (dtype) {
+        case IARRAY_DATA_TYPE_DOUBLE:
+            itemsize = sizeof(double);
+            buffer = malloc(nelem * itemsize);
+            for (int64_t i = 0; i < nelem; ++i) {
+                ((double *) buffer)[i] = values[i];
+            }
+            break;
+        case IARRAY_DATA_TYPE_FLOAT:
+            itemsize = sizeof(float);
+            buffer = malloc(nelem * itemsize);
+            for (int64_t i = 0; i < nelem; ++i) {
+                ((float *) buffer)[i] = (float) values[i];
+            }
+            break;
+        case IARRAY_DATA_TYPE_INT32:
+            itemsize = sizeof(int32_t);
+            buffer = malloc(nelem * itemsize);
+            for (int64_t i = 0; i < nelem; ++i) {
+                ((int32_t *) buffer)[i] = (int32_t) values[i];
+            }
+            break;
+        default:
+            return INA_ERROR(IARRAY_ERR_INVALID_DTYPE);
+    }
+    iarray_container_t *c_x;
+    IARRAY_RETURN_IF_FAILED(iarray_from_buffer(ctx, &dtshape, buffer, nelem * itemsize, &storage, &c_x));
+
+    // Reference over the reduced axes
+    bool reduced[3] = {false, false, false};
+    for (int i = 0; i < naxis; ++i) {
+        reduced[axis[i]] = true;
+    }
+    int8_t out_ndim = 0;
+    int64_t out_nelem = 1;
+    iarray_storage_t dest_storage = {0};
+    for (int i = 0; i < ndim; ++i) {
+        if (!reduced[i]) {
+            dest_storage.chunkshape[out_ndim] = cshape[i];
+            dest_storage.blockshape[out_ndim] = bshape[i];
+            out_ndim++;
+            out_nelem *= shape[i];
+        }
+    }
+    double *expected = malloc(out_nelem * sizeof(double));
+    int64_t *count = calloc(out_nelem, sizeof(int64_t));
+    for (int64_t i = 0; i < out_nelem; ++i) {
+        switch (func) {
+            case IARRAY_REDUCE_MAX:
+                expected[i] = -INFINITY;
+                break;
+            case IARRAY_REDUCE_NAN_MIN:
+                expected[i] = NAN;
+                break;
+            case IARRAY_REDUCE_ALL:
+                expected[i] = 1;
+                break;
+            default:
+                expected[i] = 0;
+        }
+    }
+    for (int64_t i = 0; i < nelem; ++i) {
+        int64_t index[3] = {i / (shape[1] * shape[2]), i / shape[2] % shape[1], i % shape[2]};
+        int64_t o = 0;
+        for (int j = 0; j < ndim; ++j) {
+            if (!reduced[j]) {
+                o = o * shape[j] + index[j];
+            }
+        }
+        double x = values[i];
+        switch (func) {
+            case IARRAY_REDUCE_SUM:
+                expected[o] += x;
+                break;
+            case IARRAY_REDUCE_MAX:
+                if (isnan(x) || x > expected[o]) {
+                    expected[o] = isnan(expected[o]) ? expected[o] : x;
+                }
+                break;
+            case IARRAY_REDUCE_NAN_MIN:
+                if (!isnan(x) && (isnan(expected[o]) || x < expected[o])) {
+                    expected[o] = x;
+                }
+                break;
+            case IARRAY_REDUCE_NAN_MEAN:
+                if (!isnan(x)) {
+                    expected[o] += x;
+                    count[o]++;
+                }
+                break;
+            case IARRAY_REDUCE_ALL:
+                if (x == 0) {
+                    expected[o] = 0;
+                }
+                break;
+            default:
+                return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+        }
+    }
+    if (func == IARRAY_REDUCE_NAN_MEAN) {
+        for (int64_t i = 0; i < out_nelem; ++i) {
+            expected[i] /= (double) count[i];
+        }
+    }
+
+    iarray_container_t *c_z;
+    IARRAY_RETURN_IF_FAILED(iarray_reduce_multi(ctx, c_x, func, naxis, axis, &dest_storage, &c_z, true, 0.0));
+
+    uint8_t *res = malloc(out_nelem * c_z->catarr->itemsize);
+    IARRAY_RETURN_IF_FAILED(iarray_to_buffer(ctx, c_z, res, out_nelem * c_z->catarr->itemsize));
+    for (int64_t i = 0; i < out_nelem; ++i) {
+        switch (c_z->dtshape->dtype) {
+            case IARRAY_DATA_TYPE_DOUBLE:
+                if (isnan(expected[i])) {
+                    INA_TEST_ASSERT(isnan(((double *) res)[i]));
+                } else {
+                    INA_TEST_ASSERT_EQUAL_FLOATING(((double *) res)[i], expected[i]);
+                }
+                break;
+            case IARRAY_DATA_TYPE_FLOAT:
+                if (isnan(expected[i])) {
+                    INA_TEST_ASSERT(isnan(((float *) res)[i]));
+                } else {
+                    INA_TEST_ASSERT(fabs(((float *) res)[i] - expected[i]) <= 1e-5 * fabs(expected[i]) + 1e-5);
+                }
+                break;
+            case IARRAY_DATA_TYPE_INT64:
+                INA_TEST_ASSERT_EQUAL_INT64(((int64_t *) res)[i], (int64_t) expected[i]);
+                break;
+            case IARRAY_DATA_TYPE_BOOL:
+                INA_TEST_ASSERT(((bool *) res)[i] == (expected[i] != 0));
+                break;
+            default:
+                return INA_ERROR(IARRAY_ERR_INVALID_DTYPE);
+        }
+    }
+
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_z);
+    free(values);
+    free(buffer);
+    free(expected);
+    free(count);
+    free(res);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(reduce_kernels) {
+    iarray_context_t *ctx;
+};
+
+INA_TEST_SETUP(reduce_kernels) {
+    iarray_init();
+
+    iarray_config_t cfg = IARRAY_CONFIG_DEFAULTS;
+    cfg.compression_codec = IARRAY_COMPRESSION_LZ4;
+    cfg.max_num_threads = 2;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(&cfg, &data->ctx));
+}
+
+INA_TEST_TEARDOWN(reduce_kernels) {
+    iarray_context_free(&data->ctx);
+    iarray_destroy();
+}
+
+
+INA_TEST_FIXTURE(reduce_kernels, sum_i_inner) {
+    int8_t axis[] = {2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_kernels(data->ctx, IARRAY_DATA_TYPE_INT32, IARRAY_REDUCE_SUM, 1, axis));
+}
+
+INA_TEST_FIXTURE(reduce_kernels, sum_i_outer) {
+    int8_t axis[] = {0, 1};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_kernels(data->ctx, IARRAY_DATA_TYPE_INT32, IARRAY_REDUCE_SUM, 2, axis));
+}
+
+INA_TEST_FIXTURE(reduce_kernels, max_d_inner) {
+    int8_t axis[] = {0, 2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_kernels(data->ctx, IARRAY_DATA_TYPE_DOUBLE, IARRAY_REDUCE_MAX, 2, axis));
+}
+
+INA_TEST_FIXTURE(reduce_kernels, nanmin_f_outer) {
+    int8_t axis[] = {1};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_kernels(data->ctx, IARRAY_DATA_TYPE_FLOAT, IARRAY_REDUCE_NAN_MIN, 1, axis));
+}
+
+INA_TEST_FIXTURE(reduce_kernels, nanmean_d_outer) {
+    int8_t axis[] = {0};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_kernels(data->ctx, IARRAY_DATA_TYPE_DOUBLE, IARRAY_REDUCE_NAN_MEAN, 1, axis));
+}
+
+INA_TEST_FIXTURE(reduce_kernels, all_f_inner) {
+    int8_t axis[] = {2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_kernels(data->ctx, IARRAY_DATA_TYPE_FLOAT, IARRAY_REDUCE_ALL, 1, axis));
+}
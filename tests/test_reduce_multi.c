@@ -11,6 +11,14 @@
 
 #include <libiarray/iarray.h>
 #include <src/iarray_private.h>
+#if defined(_WIN32)
+#include <direct.h>
+#define rmdir _rmdir
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 
 static ina_rc_t test_reduce_multi(iarray_context_t *ctx, iarray_data_type_t dtype, int8_t ndim, iarray_reduce_func_t func,
@@ -1155,3 +1163,39 @@ INA_TEST_FIXTURE(reduce_multi, any_2_b_1) {
                                               naxis, axis, dest_cshape, dest_bshape, src_contiguous, src_urlpath,
                                               dest_contiguous, dest_urlpath, false));
 }
+
+
+INA_TEST_FIXTURE(reduce_multi, sum_3_d_2_scratch) {
+    iarray_data_type_t dtype = IARRAY_DATA_TYPE_DOUBLE;
+
+    int8_t ndim = 3;
+    int64_t shape[] = {40, 31, 25};
+    int64_t cshape[] = {20, 10, 10};
+    int64_t bshape[] = {10, 5, 5};
+    int8_t naxis = 2;
+    int8_t axis[] = {2, 0};
+
+    // The output partition is not the one of the input, so the result is spilled before the copy
+    int64_t dest_cshape[] = {12};
+    int64_t dest_bshape[] = {4};
+    bool src_contiguous = false;
+    char *src_urlpath = "srcarr.iarr";
+    bool dest_contiguous = true;
+    char *dest_urlpath = "destarr.iarr";
+
+    char *scratch_dir = "reduce_scratch";
+    INA_TEST_ASSERT(mkdir(scratch_dir, 0700) == 0);
+    iarray_config_t cfg = IARRAY_CONFIG_DEFAULTS;
+    cfg.scratch_dir = scratch_dir;
+    iarray_context_t *ctx;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(&cfg, &ctx));
+    INA_TEST_ASSERT_SUCCEED(test_reduce_multi(ctx, dtype, ndim, IARRAY_REDUCE_SUM, shape, cshape, bshape,
+                                              naxis, axis, dest_cshape, dest_bshape, src_contiguous, src_urlpath,
+                                              dest_contiguous, dest_urlpath, false));
+    iarray_context_free(&ctx);
+
+    // No temporaries are left behind, neither in the scratch nor in the working directory
+    INA_TEST_ASSERT(!_iarray_path_exists("_iarray_red.iarr"));
+    INA_TEST_ASSERT(!_iarray_path_exists("_iarray_red_2.iarr"));
+    INA_TEST_ASSERT(rmdir(scratch_dir) == 0);
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <src/iarray_private.h>
+#include <math.h>
+
+
+static int double_compare(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return x > y ? 1 : (x < y ? -1 : 0);
+}
+
+static ina_rc_t test_reduce_quantile(iarray_context_t *ctx, iarray_data_type_t dtype, iarray_reduce_func_t func,
+                                     const int64_t *shape, const int64_t *cshape, const int64_t *bshape,
+                                     int8_t naxis, const int8_t *axis, double q, bool approximate) {
+    int8_t ndim = 3;
+    int64_t nelem = shape[0] * shape[1] * shape[2];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = dtype;
+    dtshape.ndim = ndim;
+    iarray_storage_t storage = {0};
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        storage.chunkshape[i] = cshape[i];
+        storage.blockshape[i] = bshape[i];
+    }
+
+    // Many repeated values, so that the selection has to deal with ties
+    bool with_nans = func == IARRAY_REDUCE_NAN_QUANTILE;
+    double *values = malloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        values[i] = (double) (i * 7919 % 1009) - 300;
+        if (with_nans && i % 13 == 4) {
+            values[i] = NAN;
+        }
+    }
+    size_t itemsize;
+    void *buffer;
+    switch (dtype) {
+        case IARRAY_DATA_TYPE_DOUBLE:
+            itemsize = sizeof(double);
+            buffer = malloc(nelem * itemsize);
+            for (int64_t i = 0; i < nelem; ++i) {
+                ((double *) buffer)[i] = values[i];
+            }
+            break;
+        case IARRAY_DATA_TYPE_FLOAT:
+            itemsize = sizeof(float);
+            buffer = malloc(nelem * itemsize);
+            for (int64_t i = 0; i < nelem; ++i) {
+                ((float *) buffer)[i] = (float) values[i];
+            }
+            break;
+        case IARRAY_DATA_TYPE_INT16:
+            itemsize = sizeof(int16_t);
+            buffer = malloc(nelem * itemsize);
+            for (int64_t i = 0; i < nelem; ++i) {
+                ((int16_t *) buffer)[i] = (int16_t) values[i];
+            }
+            break;
+        default:
+            return INA_ERROR(IARRAY_ERR_INVALID_DTYPE);
+    }
+    iarray_container_t *c_x;
+    IARRAY_RETURN_IF_FAILED(iarray_from_buffer(ctx, &dtshape, buffer, nelem * itemsize, &storage, &c_x));
+
+    // Gather the items of every output item
+    bool reduced[3] = {false, false, false};
+    for (int i = 0; i < naxis; ++i) {
+        reduced[axis[i]] = true;
+    }
+    int64_t out_nelem = 1;
+    int64_t reduced_nelem = 1;
+    iarray_storage_t dest_storage = {0};
+    int8_t out_ndim = 0;
+    for (int i = 0; i < ndim; ++i) {
+        if (reduced[i]) {
+            reduced_nelem *= shape[i];
+        } else {
+            dest_storage.chunkshape[out_ndim] = cshape[i];
+            dest_storage.blockshape[out_ndim] = bshape[i];
+            out_ndim++;
+            out_nelem *= shape[i];
+        }
+    }
+    double *slices = malloc(out_nelem * reduced_nelem * sizeof(double));
+    int64_t *count = calloc(out_nelem, sizeof(int64_t));
+    for (int64_t i = 0; i < nelem; ++i) {
+        int64_t index[3] = {i / (shape[1] * shape[2]), i / shape[2] % shape[1], i % shape[2]};
+        int64_t o = 0;
+        for (int j = 0; j < ndim; ++j) {
+            if (!reduced[j]) {
+                o = o * shape[j] + index[j];
+            }
+        }
+        if (!isnan(values[i])) {
+            slices[o * reduced_nelem + count[o]++] = values[i];
+        }
+    }
+
+    iarray_container_t *c_z;
+    IARRAY_RETURN_IF_FAILED(iarray_reduce_quantile(ctx, c_x, func, q, approximate, naxis, axis, &dest_storage, &c_z));
+
+    uint8_t *res = malloc(out_nelem * c_z->catarr->itemsize);
+    IARRAY_RETURN_IF_FAILED(iarray_to_buffer(ctx, c_z, res, out_nelem * c_z->catarr->itemsize));
+    for (int64_t i = 0; i < out_nelem; ++i) {
+        double *slice = &slices[i * reduced_nelem];
+        int64_t n = count[i];
+        qsort(slice, n, sizeof(double), double_compare);
+        double value = c_z->dtshape->dtype == IARRAY_DATA_TYPE_FLOAT ? (double) ((float *) res)[i] :
+                       ((double *) res)[i];
+        if (approximate) {
+            // The rank of the result must be close to the requested one
+            int64_t below = 0;
+            int64_t below_eq = 0;
+            for (int64_t j = 0; j < n; ++j) {
+                below += slice[j] < value;
+                below_eq += slice[j] <= value;
+            }
+            INA_TEST_ASSERT((double) below / (double) n <= q + 0.02);
+            INA_TEST_ASSERT((double) below_eq / (double) n >= q - 0.02);
+        } else {
+            double pos = q * (double) (n - 1);
+            int64_t k = (int64_t) pos;
+            double expected = slice[k];
+            if (pos > (double) k) {
+                expected += (pos - (double) k) * (slice[k + 1] - slice[k]);
+            }
+            INA_TEST_ASSERT(fabs(value - expected) <= 1e-6 * fabs(expected));
+        }
+    }
+
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_z);
+    free(values);
+    free(buffer);
+    free(slices);
+    free(count);
+    free(res);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(reduce_quantile) {
+    iarray_context_t *ctx;
+};
+
+INA_TEST_SETUP(reduce_quantile) {
+    iarray_init();
+
+    iarray_config_t cfg = IARRAY_CONFIG_DEFAULTS;
+    cfg.compression_codec = IARRAY_COMPRESSION_LZ4;
+    cfg.max_num_threads = 2;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(&cfg, &data->ctx));
+}
+
+INA_TEST_TEARDOWN(reduce_quantile) {
+    iarray_context_free(&data->ctx);
+    iarray_destroy();
+}
+
+
+INA_TEST_FIXTURE(reduce_quantile, quantile_d_02) {
+    int64_t shape[] = {21, 9, 33};
+    int64_t cshape[] = {10, 5, 16};
+    int64_t bshape[] = {4, 3, 7};
+    int8_t axis[] = {0, 2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_quantile(data->ctx, IARRAY_DATA_TYPE_DOUBLE, IARRAY_REDUCE_QUANTILE,
+                                                 shape, cshape, bshape, 2, axis, 0.3, false));
+}
+
+INA_TEST_FIXTURE(reduce_quantile, quantile_i16_1) {
+    int64_t shape[] = {12, 40, 10};
+    int64_t cshape[] = {6, 16, 5};
+    int64_t bshape[] = {3, 7, 5};
+    int8_t axis[] = {1};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_quantile(data->ctx, IARRAY_DATA_TYPE_INT16, IARRAY_REDUCE_QUANTILE,
+                                                 shape, cshape, bshape, 1, axis, 0.9, false));
+}
+
+INA_TEST_FIXTURE(reduce_quantile, nanquantile_f_2) {
+    int64_t shape[] = {8, 11, 50};
+    int64_t cshape[] = {4, 6, 20};
+    int64_t bshape[] = {2, 3, 9};
+    int8_t axis[] = {2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_quantile(data->ctx, IARRAY_DATA_TYPE_FLOAT, IARRAY_REDUCE_NAN_QUANTILE,
+                                                 shape, cshape, bshape, 1, axis, 0.75, false));
+}
+
+INA_TEST_FIXTURE(reduce_quantile, quantile_d_01_approximate) {
+    int64_t shape[] = {60, 70, 6};
+    int64_t cshape[] = {25, 30, 6};
+    int64_t bshape[] = {10, 12, 3};
+    int8_t axis[] = {0, 1};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_quantile(data->ctx, IARRAY_DATA_TYPE_DOUBLE, IARRAY_REDUCE_QUANTILE,
+                                                 shape, cshape, bshape, 2, axis, 0.5, true));
+}
+
+INA_TEST_FIXTURE(reduce_quantile, nanquantile_d_2_approximate) {
+    int64_t shape[] = {5, 4, 2000};
+    int64_t cshape[] = {3, 2, 800};
+    int64_t bshape[] = {2, 2, 150};
+    int8_t axis[] = {2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_quantile(data->ctx, IARRAY_DATA_TYPE_DOUBLE, IARRAY_REDUCE_NAN_QUANTILE,
+                                                 shape, cshape, bshape, 1, axis, 0.95, true));
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <src/iarray_private.h>
+#include <math.h>
+
+
+static ina_rc_t test_reduce_var(iarray_context_t *ctx, iarray_data_type_t dtype, iarray_reduce_func_t func,
+                                const int64_t *shape, const int64_t *cshape, const int64_t *bshape,
+                                int8_t naxis, const int8_t *axis, double correction, bool with_nans) {
+    int8_t ndim = 3;
+    int64_t nelem = shape[0] * shape[1] * shape[2];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = dtype;
+    dtshape.ndim = ndim;
+    iarray_storage_t storage = {0};
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        storage.chunkshape[i] = cshape[i];
+        storage.blockshape[i] = bshape[i];
+    }
+
+    // A large offset, so that accumulating raw squares would lose all the precision
+    double *values = malloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        values[i] = 1e6 + (double) (i % 13) * 0.25 + (double) (i % 7);
+        if (with_nans && i % 11 == 3) {
+            values[i] = NAN;
+        }
+    }
+
+    size_t itemsize = dtype == IARRAY_DATA_TYPE_FLOAT ? sizeof(float) : sizeof(double);
+    void *buffer = malloc(nelem * itemsize);
+    for (int64_t i = 0; i < nelem; ++i) {
+        if (dtype == IARRAY_DATA_TYPE_FLOAT) {
+            ((float *) buffer)[i] = (float) values[i];
+            values[i] = (double) ((float *) buffer)[i];
+        } else {
+            ((double *) buffer)[i] = values[i];
+        }
+    }
+    iarray_container_t *c_x;
+    IARRAY_RETURN_IF_FAILED(iarray_from_buffer(ctx, &dtshape, buffer, nelem * itemsize, &storage, &c_x));
+
+    // Two-pass reference over the reduced axes
+    bool reduced[3] = {false, false, false};
+    for (int i = 0; i < naxis; ++i) {
+        reduced[axis[i]] = true;
+    }
+    int64_t out_shape[3];
+    int8_t out_ndim = 0;
+    for (int i = 0; i < ndim; ++i) {
+        if (!reduced[i]) {
+            out_shape[out_ndim++] = shape[i];
+        }
+    }
+    int64_t out_nelem = 1;
+    for (int i = 0; i < out_ndim; ++i) {
+        out_nelem *= out_shape[i];
+    }
+    double *sum = calloc(out_nelem, sizeof(double));
+    double *m2 = calloc(out_nelem, sizeof(double));
+    int64_t *count = calloc(out_nelem, sizeof(int64_t));
+    int64_t *out_index = malloc(nelem * sizeof(int64_t));
+    for (int64_t i = 0; i < nelem; ++i) {
+        int64_t index[3] = {i / (shape[1] * shape[2]), i / shape[2] % shape[1], i % shape[2]};
+        int64_t o = 0;
+        for (int j = 0; j < ndim; ++j) {
+            if (!reduced[j]) {
+                o = o * shape[j] + index[j];
+            }
+        }
+        out_index[i] = o;
+        if (!isnan(values[i])) {
+            sum[o] += values[i];
+            count[o]++;
+        }
+    }
+    for (int64_t i = 0; i < nelem; ++i) {
+        if (!isnan(values[i])) {
+            double dif = values[i] - sum[out_index[i]] / (double) count[out_index[i]];
+            m2[out_index[i]] += dif * dif;
+        }
+    }
+
+    iarray_storage_t dest_storage = {0};
+    for (int i = 0; i < out_ndim; ++i) {
+        dest_storage.chunkshape[i] = out_shape[i] / 2 + 1;
+        dest_storage.blockshape[i] = out_shape[i] / 4 + 1;
+    }
+    iarray_container_t *c_z;
+    IARRAY_RETURN_IF_FAILED(iarray_reduce_multi(ctx, c_x, func, naxis, axis, &dest_storage, &c_z, true, correction));
+
+    double *res = malloc(out_nelem * sizeof(double));
+    float *fres = (float *) res;
+    IARRAY_RETURN_IF_FAILED(iarray_to_buffer(ctx, c_z, res, out_nelem * c_z->catarr->itemsize));
+    double tol = dtype == IARRAY_DATA_TYPE_FLOAT ? 1e-4 : 1e-9;
+    for (int64_t i = 0; i < out_nelem; ++i) {
+        double expected = m2[i] / ((double) count[i] - correction);
+        if (func == IARRAY_REDUCE_STD || func == IARRAY_REDUCE_NAN_STD) {
+            expected = sqrt(expected);
+        }
+        double value = dtype == IARRAY_DATA_TYPE_FLOAT ? (double) fres[i] : res[i];
+        INA_TEST_ASSERT(fabs(value - expected) <= tol * fabs(expected));
+    }
+
+    iarray_container_free(ctx, &c_x);
+    iarray_container_free(ctx, &c_z);
+    free(values);
+    free(buffer);
+    free(sum);
+    free(m2);
+    free(count);
+    free(out_index);
+    free(res);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(reduce_var) {
+    iarray_context_t *ctx;
+};
+
+INA_TEST_SETUP(reduce_var) {
+    iarray_init();
+
+    iarray_config_t cfg = IARRAY_CONFIG_DEFAULTS;
+    cfg.compression_codec = IARRAY_COMPRESSION_LZ4;
+    cfg.max_num_threads = 2;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(&cfg, &data->ctx));
+}
+
+INA_TEST_TEARDOWN(reduce_var) {
+    iarray_context_free(&data->ctx);
+    iarray_destroy();
+}
+
+
+INA_TEST_FIXTURE(reduce_var, var_d_02) {
+    int64_t shape[] = {30, 25, 20};
+    int64_t cshape[] = {12, 10, 8};
+    int64_t bshape[] = {5, 4, 3};
+    int8_t axis[] = {0, 2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_var(data->ctx, IARRAY_DATA_TYPE_DOUBLE, IARRAY_REDUCE_VAR,
+                                            shape, cshape, bshape, 2, axis, 0.0, false));
+}
+
+INA_TEST_FIXTURE(reduce_var, std_d_1_correction) {
+    int64_t shape[] = {17, 31, 9};
+    int64_t cshape[] = {8, 12, 9};
+    int64_t bshape[] = {4, 5, 3};
+    int8_t axis[] = {1};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_var(data->ctx, IARRAY_DATA_TYPE_DOUBLE, IARRAY_REDUCE_STD,
+                                            shape, cshape, bshape, 1, axis, 1.0, false));
+}
+
+INA_TEST_FIXTURE(reduce_var, var_f_012) {
+    int64_t shape[] = {20, 15, 11};
+    int64_t cshape[] = {10, 8, 6};
+    int64_t bshape[] = {4, 4, 3};
+    int8_t axis[] = {0, 1, 2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_var(data->ctx, IARRAY_DATA_TYPE_FLOAT, IARRAY_REDUCE_VAR,
+                                            shape, cshape, bshape, 3, axis, 0.0, false));
+}
+
+INA_TEST_FIXTURE(reduce_var, nanvar_d_12_correction) {
+    int64_t shape[] = {13, 22, 19};
+    int64_t cshape[] = {7, 10, 10};
+    int64_t bshape[] = {3, 4, 5};
+    int8_t axis[] = {1, 2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_var(data->ctx, IARRAY_DATA_TYPE_DOUBLE, IARRAY_REDUCE_NAN_VAR,
+                                            shape, cshape, bshape, 2, axis, 1.0, true));
+}
+
+INA_TEST_FIXTURE(reduce_var, nanstd_f_0) {
+    int64_t shape[] = {40, 6, 7};
+    int64_t cshape[] = {16, 6, 4};
+    int64_t bshape[] = {6, 3, 2};
+    int8_t axis[] = {0};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_var(data->ctx, IARRAY_DATA_TYPE_FLOAT, IARRAY_REDUCE_NAN_STD,
+                                            shape, cshape, bshape, 1, axis, 0.0, true));
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright ironArray SL 2021.
+ *
+ * All rights reserved.
+ *
+ * This software is the confidential and proprietary information of ironArray SL
+ * ("Confidential Information"). You shall not disclose such Confidential
+ * Information and shall use it only in accordance with the terms of the license agreement.
+ *
+ */
+
+#include <libiarray/iarray.h>
+#include <src/iarray_private.h>
+#include <math.h>
+
+
+static int double_compare(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return x > y ? 1 : (x < y ? -1 : 0);
+}
+
+static ina_rc_t test_reduce_view(iarray_context_t *ctx, iarray_data_type_t dtype, iarray_data_type_t view_dtype,
+                                 iarray_reduce_func_t func, const int64_t *view_start, const int64_t *view_stop,
+                                 int8_t naxis, const int8_t *axis, char *dest_urlpath) {
+    blosc2_remove_urlpath(dest_urlpath);
+
+    int8_t ndim = 3;
+    int64_t shape[] = {23, 18, 37};
+    int64_t cshape[] = {10, 8, 20};
+    int64_t bshape[] = {4, 5, 8};
+    int64_t nelem = shape[0] * shape[1] * shape[2];
+
+    iarray_dtshape_t dtshape;
+    dtshape.dtype = dtype;
+    dtshape.ndim = ndim;
+    iarray_storage_t storage = {0};
+    for (int i = 0; i < ndim; ++i) {
+        dtshape.shape[i] = shape[i];
+        storage.chunkshape[i] = cshape[i];
+        storage.blockshape[i] = bshape[i];
+    }
+
+    // Every item is different, so that reading outside the window is noticed
+    double *values = malloc(nelem * sizeof(double));
+    for (int64_t i = 0; i < nelem; ++i) {
+        values[i] = (double) (i * 37 % 1001) - 500;
+    }
+    size_t itemsize;
+    void *buffer;
+    switch (dtype) {
+        case IARRAY_DATA_TYPE_FLOAT:
+            itemsize = sizeof(float);
+            buffer = malloc(nelem * itemsize);
+            for (int64_t i = 0; i < nelem; ++i) {
+                ((float *) buffer)[i] = (float) values[i];
+            }
+            break;
+        case IARRAY_DATA_TYPE_INT32:
+            itemsize = sizeof(int32_t);
+            buffer = malloc(nelem * itemsize);
+            for (int64_t i = 0; i < nelem; ++i) {
+                ((int32_t *) buffer)[i] = (int32_t) values[i];
+            }
+            break;
+        default:
+            return INA_ERROR(IARRAY_ERR_INVALID_DTYPE);
+    }
+    iarray_container_t *c_x;
+    IARRAY_RETURN_IF_FAILED(iarray_from_buffer(ctx, &dtshape, buffer, nelem * itemsize, &storage, &c_x));
+
+    iarray_container_t *c_slice;
+    IARRAY_RETURN_IF_FAILED(iarray_get_slice(ctx, c_x, view_start, view_stop, true, NULL, &c_slice));
+    iarray_container_t *c_view = c_slice;
+    if (view_dtype != dtype) {
+        IARRAY_RETURN_IF_FAILED(iarray_get_type_view(ctx, c_slice, view_dtype, &c_view));
+    }
+
+    // Gather the items of every output item inside the view
+    bool reduced[3] = {false, false, false};
+    for (int i = 0; i < naxis; ++i) {
+        reduced[axis[i]] = true;
+    }
+    int64_t view_shape[3];
+    int64_t out_nelem = 1;
+    int64_t reduced_nelem = 1;
+    iarray_storage_t dest_storage = {0};
+    dest_storage.urlpath = dest_urlpath;
+    int8_t out_ndim = 0;
+    for (int i = 0; i < ndim; ++i) {
+        view_shape[i] = view_stop[i] - view_start[i];
+        if (reduced[i]) {
+            reduced_nelem *= view_shape[i];
+        } else {
+            dest_storage.chunkshape[out_ndim] = cshape[i];
+            dest_storage.blockshape[out_ndim] = bshape[i];
+            out_ndim++;
+            out_nelem *= view_shape[i];
+        }
+    }
+    double *slices = malloc(out_nelem * reduced_nelem * sizeof(double));
+    int64_t *count = calloc(out_nelem, sizeof(int64_t));
+    for (int64_t i = 0; i < nelem; ++i) {
+        int64_t index[3] = {i / (shape[1] * shape[2]), i / shape[2] % shape[1], i % shape[2]};
+        bool inside = true;
+        int64_t o = 0;
+        for (int j = 0; j < ndim; ++j) {
+            inside &= index[j] >= view_start[j] && index[j] < view_stop[j];
+            if (!reduced[j]) {
+                o = o * view_shape[j] + index[j] - view_start[j];
+            }
+        }
+        if (inside) {
+            slices[o * reduced_nelem + count[o]++] = values[i];
+        }
+    }
+
+    iarray_container_t *c_z;
+    IARRAY_RETURN_IF_FAILED(iarray_reduce_multi(ctx, c_view, func, naxis, axis, &dest_storage, &c_z, true, 0.0));
+    for (int i = 0, j = 0; i < ndim; ++i) {
+        if (!reduced[i]) {
+            INA_TEST_ASSERT_EQUAL_INT64(c_z->dtshape->shape[j++], view_shape[i]);
+        }
+    }
+
+    uint8_t *res = malloc(out_nelem * c_z->catarr->itemsize);
+    IARRAY_RETURN_IF_FAILED(iarray_to_buffer(ctx, c_z, res, out_nelem * c_z->catarr->itemsize));
+    for (int64_t i = 0; i < out_nelem; ++i) {
+        double *slice = &slices[i * reduced_nelem];
+        double expected = 0;
+        switch (func) {
+            case IARRAY_REDUCE_SUM:
+                for (int64_t j = 0; j < reduced_nelem; ++j) {
+                    expected += slice[j];
+                }
+                break;
+            case IARRAY_REDUCE_MAX:
+                expected = -INFINITY;
+                for (int64_t j = 0; j < reduced_nelem; ++j) {
+                    expected = slice[j] > expected ? slice[j] : expected;
+                }
+                break;
+            case IARRAY_REDUCE_MEDIAN:
+                qsort(slice, reduced_nelem, sizeof(double), double_compare);
+                expected = (slice[(reduced_nelem - 1) / 2] + slice[reduced_nelem / 2]) / 2;
+                break;
+            default:
+                return INA_ERROR(INA_ERR_INVALID_ARGUMENT);
+        }
+        double value;
+        switch (c_z->dtshape->dtype) {
+            case IARRAY_DATA_TYPE_DOUBLE:
+                value = ((double *) res)[i];
+                break;
+            case IARRAY_DATA_TYPE_FLOAT:
+                value = ((float *) res)[i];
+                break;
+            case IARRAY_DATA_TYPE_INT64:
+                value = (double) ((int64_t *) res)[i];
+                break;
+            case IARRAY_DATA_TYPE_INT32:
+                value = ((int32_t *) res)[i];
+                break;
+            default:
+                return INA_ERROR(IARRAY_ERR_INVALID_DTYPE);
+        }
+        INA_TEST_ASSERT_EQUAL_FLOATING(value, expected);
+    }
+
+    iarray_container_free(ctx, &c_z);
+    if (c_view != c_slice) {
+        iarray_container_free(ctx, &c_view);
+    }
+    iarray_container_free(ctx, &c_slice);
+    iarray_container_free(ctx, &c_x);
+    blosc2_remove_urlpath(dest_urlpath);
+    free(values);
+    free(buffer);
+    free(slices);
+    free(count);
+    free(res);
+
+    return INA_SUCCESS;
+}
+
+INA_TEST_DATA(reduce_view) {
+    iarray_context_t *ctx;
+};
+
+INA_TEST_SETUP(reduce_view) {
+    iarray_init();
+
+    iarray_config_t cfg = IARRAY_CONFIG_DEFAULTS;
+    cfg.compression_codec = IARRAY_COMPRESSION_LZ4;
+    cfg.max_num_threads = 2;
+    INA_TEST_ASSERT_SUCCEED(iarray_context_new(&cfg, &data->ctx));
+}
+
+INA_TEST_TEARDOWN(reduce_view) {
+    iarray_context_free(&data->ctx);
+    iarray_destroy();
+}
+
+
+INA_TEST_FIXTURE(reduce_view, sum_i_aligned) {
+    int64_t view_start[] = {10, 0, 20};
+    int64_t view_stop[] = {23, 16, 37};
+    int8_t axis[] = {1};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_view(data->ctx, IARRAY_DATA_TYPE_INT32, IARRAY_DATA_TYPE_INT32,
+                                             IARRAY_REDUCE_SUM, view_start, view_stop, 1, axis, NULL));
+}
+
+INA_TEST_FIXTURE(reduce_view, sum_i_shifted) {
+    int64_t view_start[] = {3, 5, 13};
+    int64_t view_stop[] = {21, 17, 34};
+    int8_t axis[] = {2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_view(data->ctx, IARRAY_DATA_TYPE_INT32, IARRAY_DATA_TYPE_INT32,
+                                             IARRAY_REDUCE_SUM, view_start, view_stop, 1, axis, NULL));
+}
+
+INA_TEST_FIXTURE(reduce_view, max_i_shifted_persistent) {
+    int64_t view_start[] = {7, 2, 1};
+    int64_t view_stop[] = {19, 11, 30};
+    int8_t axis[] = {0, 2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_view(data->ctx, IARRAY_DATA_TYPE_INT32, IARRAY_DATA_TYPE_INT32,
+                                             IARRAY_REDUCE_MAX, view_start, view_stop, 2, axis, "reduce_view.iarr"));
+}
+
+INA_TEST_FIXTURE(reduce_view, sum_f_d_type_view) {
+    int64_t view_start[] = {1, 9, 5};
+    int64_t view_stop[] = {22, 18, 29};
+    int8_t axis[] = {0};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_view(data->ctx, IARRAY_DATA_TYPE_FLOAT, IARRAY_DATA_TYPE_DOUBLE,
+                                             IARRAY_REDUCE_SUM, view_start, view_stop, 1, axis, NULL));
+}
+
+INA_TEST_FIXTURE(reduce_view, median_i_d_type_view) {
+    int64_t view_start[] = {4, 3, 11};
+    int64_t view_stop[] = {17, 14, 36};
+    int8_t axis[] = {0, 1, 2};
+
+    INA_TEST_ASSERT_SUCCEED(test_reduce_view(data->ctx, IARRAY_DATA_TYPE_INT32, IARRAY_DATA_TYPE_DOUBLE,
+                                             IARRAY_REDUCE_MEDIAN, view_start, view_stop, 3, axis, NULL));
+}